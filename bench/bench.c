@@ -0,0 +1,799 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * bench/bench.c  This file is part of LibWoofer
+ * Copyright (C) 2023  Quico Augustijn
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this library.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+// Dependency includes
+#include <woofer/constants.h>
+#include <woofer/song.h>
+#include <woofer/song_private.h>
+#include <woofer/library.h>
+#include <woofer/library_private.h>
+#include <woofer/library_cache.h>
+#include <woofer/intelligence.h>
+#include <woofer/intelligence_private.h>
+#include <woofer/settings.h>
+#include <woofer/settings_private.h>
+#include <woofer/characters.h>
+#include <woofer/ring.h>
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * Benchmarks of the operations that scale with the size of the library.  A
+ * synthetic library is generated in the same key file format as the library
+ * file written by the library module, which is then read, written and used to
+ * choose songs, look up songs and hash strings.  At last, a directory with
+ * generated files is imported.
+ *
+ * Every benchmark takes a number of samples.  Fast operations are timed in
+ * batches, so the overhead of reading the clock does not dominate; the latency
+ * of such a sample is the time of the batch divided by the amount of
+ * operations in it.  The percentiles of the latencies are reported together
+ * with the average amount of allocations per operation (only with the GNU C
+ * library, where malloc() can be wrapped).
+ *
+ * The generator can also be used on its own, to write a library file for
+ * testing the software with a large library:
+ *
+ *   woofer-bench --generate=library.ini --songs=1000000
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+#define BENCH_DEFAULT_SONGS 10000
+#define BENCH_DEFAULT_ITERATIONS 5
+#define BENCH_DEFAULT_OPERATIONS 10000
+#define BENCH_DEFAULT_IMPORT_FILES 1000
+#define BENCH_DEFAULT_SEED 20230101
+
+// Amount of fast operations timed together in a single sample
+#define BENCH_BATCH_SIZE 64
+
+// Amount of picks in a single simulation run
+#define BENCH_SIMULATION_PICKS 1000
+
+#define BENCH_GROUP_PROPERTIES "Properties"
+
+// Start of an ID3v2 tag, so the generated files are recognized as audio
+#define BENCH_AUDIO_HEADER "ID3\x04\x00\x00\x00\x00\x00\x00"
+
+#if defined(__GLIBC__)
+#define BENCH_COUNT_ALLOCATIONS TRUE
+#else
+#define BENCH_COUNT_ALLOCATIONS FALSE
+#endif
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef struct _WfBenchResult WfBenchResult;
+typedef struct _WfBenchSample WfBenchSample;
+
+struct _WfBenchResult
+{
+	const gchar *name;
+
+	GArray *latencies; // Nanoseconds per operation, one for each sample
+	gint64 operations;
+	gint64 allocations;
+};
+
+struct _WfBenchSample
+{
+	gint64 start;
+	gint allocations;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static gboolean wf_bench_generate_library(const gchar *path, gint songs, guint32 seed);
+static gboolean wf_bench_generate_directory(const gchar *path, gint files);
+
+static void wf_bench_library_read(const gchar *path, gint iterations);
+static void wf_bench_library_write(gint iterations);
+static void wf_bench_choose_new_song(gint iterations);
+static void wf_bench_pool_choose_new_song(gint operations);
+static void wf_bench_simulate(gint iterations, guint64 seed);
+static void wf_bench_song_get_by_hash(gint operations, guint32 seed);
+static void wf_bench_chars_get_hash_converted(gint operations);
+static void wf_bench_directory_import(const gchar *path, gint files, gint iterations);
+
+static void wf_bench_result_init(WfBenchResult *result, const gchar *name);
+static void wf_bench_sample_begin(WfBenchSample *sample);
+static void wf_bench_sample_end(WfBenchResult *result, WfBenchSample *sample, gint operations);
+static void wf_bench_result_report(WfBenchResult *result);
+
+static void wf_bench_remove_recursive(const gchar *path);
+static gint64 wf_bench_time_now(void);
+static gint wf_bench_get_allocations(void);
+static gint wf_bench_latency_compare_cb(gconstpointer a, gconstpointer b);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+static gint BenchSongs = BENCH_DEFAULT_SONGS;
+static gint BenchIterations = BENCH_DEFAULT_ITERATIONS;
+static gint BenchOperations = BENCH_DEFAULT_OPERATIONS;
+static gint BenchImportFiles = BENCH_DEFAULT_IMPORT_FILES;
+static gint BenchSeed = BENCH_DEFAULT_SEED;
+static gchar *BenchGenerate = NULL;
+
+static GOptionEntry BenchOptions[] =
+{
+	{ "songs", 's', 0, G_OPTION_ARG_INT, &BenchSongs, "Amount of songs in the generated library", "N" },
+	{ "iterations", 'i', 0, G_OPTION_ARG_INT, &BenchIterations, "Amount of samples for the slow benchmarks", "N" },
+	{ "operations", 'n', 0, G_OPTION_ARG_INT, &BenchOperations, "Amount of operations for the fast benchmarks", "N" },
+	{ "import-files", 'f', 0, G_OPTION_ARG_INT, &BenchImportFiles, "Amount of files to import from a directory", "N" },
+	{ "seed", 0, 0, G_OPTION_ARG_INT, &BenchSeed, "Seed of the generated library", "SEED" },
+	{ "generate", 'g', 0, G_OPTION_ARG_FILENAME, &BenchGenerate, "Only write a generated library to PATH", "PATH" },
+	{ NULL }
+};
+
+#if BENCH_COUNT_ALLOCATIONS
+static gint BenchAllocations = 0;
+#endif
+
+/* GLOBAL VARIABLES END */
+
+/* ALLOCATION COUNTING BEGIN */
+
+#if BENCH_COUNT_ALLOCATIONS
+extern void * __libc_malloc(size_t size);
+extern void * __libc_calloc(size_t members, size_t size);
+extern void * __libc_realloc(void *ptr, size_t size);
+
+// Wrappers around the allocator of the C library, only counting the calls
+void *
+malloc(size_t size)
+{
+	g_atomic_int_inc(&BenchAllocations);
+
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t members, size_t size)
+{
+	g_atomic_int_inc(&BenchAllocations);
+
+	return __libc_calloc(members, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	g_atomic_int_inc(&BenchAllocations);
+
+	return __libc_realloc(ptr, size);
+}
+#endif
+
+/* ALLOCATION COUNTING END */
+
+/* MAIN BEGIN */
+
+int
+main(int argc, char *argv[])
+{
+	GOptionContext *context;
+	GError *err = NULL;
+	gchar *dir, *library_path, *import_path;
+	gint status = EXIT_SUCCESS;
+
+	context = g_option_context_new("- benchmark LibWoofer");
+	g_option_context_add_main_entries(context, BenchOptions, NULL /* translation_domain */);
+
+	if (!g_option_context_parse(context, &argc, &argv, &err))
+	{
+		g_printerr("%s\n", err->message);
+		g_error_free(err);
+		g_option_context_free(context);
+
+		return EXIT_FAILURE;
+	}
+
+	g_option_context_free(context);
+
+	BenchSongs = MAX(BenchSongs, 1);
+	BenchIterations = MAX(BenchIterations, 1);
+	BenchOperations = MAX(BenchOperations, BENCH_BATCH_SIZE);
+
+	if (BenchGenerate != NULL)
+	{
+		// Generator only
+		status = wf_bench_generate_library(BenchGenerate, BenchSongs, (guint32) BenchSeed) ? EXIT_SUCCESS : EXIT_FAILURE;
+		g_free(BenchGenerate);
+
+		return status;
+	}
+
+	dir = g_dir_make_tmp("woofer-bench-XXXXXX", &err);
+
+	if (dir == NULL)
+	{
+		g_printerr("Could not create a temporary directory: %s\n", err->message);
+		g_error_free(err);
+
+		return EXIT_FAILURE;
+	}
+
+	library_path = g_build_filename(dir, WF_LIBRARY_FILENAME, NULL /* terminator */);
+	import_path = g_build_filename(dir, "import", NULL /* terminator */);
+
+	g_print("Generating a library of %d songs in %s\n", BenchSongs, dir);
+
+	if (!wf_bench_generate_library(library_path, BenchSongs, (guint32) BenchSeed) ||
+	    !wf_bench_generate_directory(import_path, BenchImportFiles))
+	{
+		status = EXIT_FAILURE;
+	}
+	else
+	{
+		wf_settings_init();
+		wf_library_init();
+		wf_library_set_file(library_path);
+
+		g_print("\n%-32s %10s %10s %10s %10s %10s %10s\n", "benchmark", "ops", "p50 (ns)", "p90 (ns)", "p99 (ns)", "max (ns)", "allocs/op");
+
+		wf_bench_library_read(library_path, BenchIterations);
+		wf_bench_library_write(BenchIterations);
+		wf_bench_choose_new_song(BenchIterations);
+		wf_bench_pool_choose_new_song(BenchOperations);
+		wf_bench_simulate(BenchIterations, (guint64) BenchSeed);
+		wf_bench_song_get_by_hash(BenchOperations, (guint32) BenchSeed);
+		wf_bench_chars_get_hash_converted(BenchOperations);
+
+		// Clears the library, so this has to be last
+		wf_bench_directory_import(import_path, BenchImportFiles, BenchIterations);
+
+		wf_library_finalize();
+		wf_intelligence_pool_invalidate();
+	}
+
+	// Clean up the generated files
+	wf_bench_remove_recursive(dir);
+
+	g_free(import_path);
+	g_free(library_path);
+	g_free(dir);
+
+	return status;
+}
+
+/* MAIN END */
+
+/* GENERATORS BEGIN */
+
+/*
+ * Write a library file with @songs songs to @path.  The songs get artists and
+ * albums with a realistic amount of songs each and random statistics.  The
+ * same @seed results in the same library.
+ */
+static gboolean
+wf_bench_generate_library(const gchar *path, gint songs, guint32 seed)
+{
+	GKeyFile *key_file;
+	GError *err = NULL;
+	GRand *rand;
+	gchar *group, *uri, *title, *artist, *album;
+	gint artists = MAX(songs / 20, 1);
+	gint artist_nr, album_nr;
+	gboolean success;
+	gint x;
+
+	g_return_val_if_fail(path != NULL, FALSE);
+
+	key_file = g_key_file_new();
+	rand = g_rand_new_with_seed(seed);
+
+	g_key_file_set_integer(key_file, BENCH_GROUP_PROPERTIES, "FileVersion", WF_LIBRARY_FILE_VERSION);
+
+	for (x = 0; x < songs; x++)
+	{
+		artist_nr = g_rand_int_range(rand, 0, artists);
+		album_nr = g_rand_int_range(rand, 0, 4);
+
+		uri = g_strdup_printf("file:///music/Artist %d/Album %d/%06d Track.flac", artist_nr, album_nr, x);
+		title = g_strdup_printf("Tr\xc3\xa0" "ck N\xc3\xbamber %d", x);
+		artist = g_strdup_printf("Artist %d", artist_nr);
+		album = g_strdup_printf("Album %d of artist %d", album_nr, artist_nr);
+		group = g_strdup_printf("song-%x", wf_chars_get_hash(uri));
+
+		g_key_file_set_string(key_file, group, "URI", uri);
+		g_key_file_set_integer(key_file, group, "Rating", g_rand_int_range(rand, 0, 11) * 10);
+		g_key_file_set_double(key_file, group, "Score", g_rand_double_range(rand, 0.0, 100.0));
+		g_key_file_set_integer(key_file, group, "PlayCount", g_rand_int_range(rand, 0, 200));
+		g_key_file_set_integer(key_file, group, "SkipCount", g_rand_int_range(rand, 0, 50));
+		g_key_file_set_int64(key_file, group, "LastPlayed", (gint64) g_rand_int_range(rand, 0, G_MAXINT32));
+		g_key_file_set_int64(key_file, group, "LastMetadataUpdate", (gint64) G_MAXINT32);
+		g_key_file_set_integer(key_file, group, "TrackNumber", (x % 15) + 1);
+		g_key_file_set_string(key_file, group, "Title", title);
+		g_key_file_set_string(key_file, group, "Artist", artist);
+		g_key_file_set_string(key_file, group, "AlbumArtist", artist);
+		g_key_file_set_string(key_file, group, "Album", album);
+		g_key_file_set_integer(key_file, group, "Duration", g_rand_int_range(rand, 60, 600));
+
+		g_free(group);
+		g_free(album);
+		g_free(artist);
+		g_free(title);
+		g_free(uri);
+	}
+
+	success = g_key_file_save_to_file(key_file, path, &err);
+
+	if (!success)
+	{
+		g_printerr("Could not write the generated library: %s\n", err->message);
+		g_error_free(err);
+	}
+
+	g_rand_free(rand);
+	g_key_file_free(key_file);
+
+	return success;
+}
+
+// Create a directory with @files small audio files in a few subdirectories
+static gboolean
+wf_bench_generate_directory(const gchar *path, gint files)
+{
+	GError *err = NULL;
+	gchar *sub, *file;
+	gint x;
+
+	for (x = 0; x < files; x++)
+	{
+		sub = g_strdup_printf("%s/Album %d", path, x / 20);
+		file = g_strdup_printf("%s/%05d Track.mp3", sub, x);
+
+		if (g_mkdir_with_parents(sub, 0700) != 0 ||
+		    !g_file_set_contents(file, BENCH_AUDIO_HEADER, sizeof(BENCH_AUDIO_HEADER) - 1, &err))
+		{
+			g_printerr("Could not create file %s: %s\n", file, (err == NULL) ? g_strerror(errno) : err->message);
+			g_clear_error(&err);
+			g_free(file);
+			g_free(sub);
+
+			return FALSE;
+		}
+
+		g_free(file);
+		g_free(sub);
+	}
+
+	return TRUE;
+}
+
+/* GENERATORS END */
+
+/* BENCHMARKS BEGIN */
+
+// Read the library from the key file and from the cache it leaves behind
+static void
+wf_bench_library_read(const gchar *path, gint iterations)
+{
+	WfBenchResult key_file, cache;
+	WfBenchSample sample;
+	gchar *cache_path;
+	gint x;
+
+	wf_bench_result_init(&key_file, "wf_library_read (key file)");
+	wf_bench_result_init(&cache, "wf_library_read (cache)");
+	cache_path = wf_library_cache_get_path(path);
+
+	for (x = 0; x < iterations; x++)
+	{
+		g_remove(cache_path);
+
+		wf_bench_sample_begin(&sample);
+		wf_library_read();
+		wf_bench_sample_end(&key_file, &sample, 1);
+
+		wf_bench_sample_begin(&sample);
+		wf_library_read();
+		wf_bench_sample_end(&cache, &sample, 1);
+	}
+
+	wf_bench_result_report(&key_file);
+	wf_bench_result_report(&cache);
+
+	g_free(cache_path);
+}
+
+static void
+wf_bench_library_write(gint iterations)
+{
+	WfBenchResult result;
+	WfBenchSample sample;
+	gint x;
+
+	wf_bench_result_init(&result, "wf_library_write (full)");
+
+	for (x = 0; x < iterations; x++)
+	{
+		wf_bench_sample_begin(&sample);
+		wf_library_write(TRUE /* force */);
+		wf_bench_sample_end(&result, &sample, 1);
+	}
+
+	wf_bench_result_report(&result);
+}
+
+// Choose a song by filtering and weighing a copy of the whole library
+static void
+wf_bench_choose_new_song(gint iterations)
+{
+	WfBenchResult result;
+	WfBenchSample sample;
+	GList *library;
+	gint x;
+
+	wf_bench_result_init(&result, "wf_intelligence_choose_new_song");
+
+	for (x = 0; x < iterations; x++)
+	{
+		wf_bench_sample_begin(&sample);
+
+		library = wf_library_get();
+		wf_intelligence_choose_new_song(&library,
+		                                NULL /* previous_songs */,
+		                                NULL /* play_next */,
+		                                NULL /* recent_artists */,
+		                                wf_settings_get_filter(),
+		                                wf_settings_get_song_entry_modifiers());
+		g_list_free(library);
+
+		wf_bench_sample_end(&result, &sample, 1);
+	}
+
+	wf_bench_result_report(&result);
+}
+
+// Choose songs from the candidate pool, like the song manager does
+static void
+wf_bench_pool_choose_new_song(gint operations)
+{
+	WfBenchResult result;
+	WfBenchSample sample;
+	const WfSettingsSnapshot *settings;
+	WfRing *previous, *next, *artists;
+	gint x, y;
+
+	wf_bench_result_init(&result, "wf_intelligence_pool_choose_new_song");
+
+	previous = wf_ring_new(100 /* limit */, NULL /* free_func */);
+	next = wf_ring_new(0 /* limit */, NULL /* free_func */);
+	artists = wf_ring_new(50 /* limit */, NULL /* free_func */);
+
+	// Build the pool outside of the measurements
+	settings = wf_settings_get_snapshot();
+	wf_intelligence_pool_choose_new_song(NULL /* current */, previous, next, artists, settings);
+
+	for (x = 0; x < operations; x += BENCH_BATCH_SIZE)
+	{
+		wf_bench_sample_begin(&sample);
+
+		for (y = 0; y < BENCH_BATCH_SIZE; y++)
+		{
+			wf_intelligence_pool_choose_new_song(NULL /* current */, previous, next, artists, settings);
+		}
+
+		wf_bench_sample_end(&result, &sample, BENCH_BATCH_SIZE);
+	}
+
+	wf_bench_result_report(&result);
+
+	wf_ring_free(artists);
+	wf_ring_free(next);
+	wf_ring_free(previous);
+}
+
+// Simulate full runs of picks, like an optimizer of the entry multipliers would
+static void
+wf_bench_simulate(gint iterations, guint64 seed)
+{
+	WfBenchResult result;
+	WfBenchSample sample;
+	guint *counts;
+	guint length;
+	gint x;
+
+	wf_bench_result_init(&result, "wf_intelligence_simulate");
+
+	for (x = 0; x < iterations; x++)
+	{
+		wf_bench_sample_begin(&sample);
+
+		counts = wf_intelligence_simulate(wf_settings_get_song_entry_modifiers(), BENCH_SIMULATION_PICKS, seed + x, &length);
+		g_free(counts);
+
+		wf_bench_sample_end(&result, &sample, BENCH_SIMULATION_PICKS);
+	}
+
+	wf_bench_result_report(&result);
+}
+
+static void
+wf_bench_song_get_by_hash(gint operations, guint32 seed)
+{
+	WfBenchResult result;
+	WfBenchSample sample;
+	WfSong *song;
+	GArray *hashes;
+	guint32 *lookups;
+	GRand *rand;
+	guint32 hash;
+	gint x, y;
+
+	wf_bench_result_init(&result, "wf_song_get_by_hash");
+
+	hashes = g_array_sized_new(FALSE /* zero_terminated */, FALSE /* clear */, sizeof(guint32), wf_song_get_count());
+
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	{
+		hash = wf_song_get_hash(song);
+		g_array_append_val(hashes, hash);
+	}
+
+	if (hashes->len > 0)
+	{
+		// Draw the hashes up front, so the random generator is not timed
+		lookups = g_new(guint32, BENCH_BATCH_SIZE);
+		rand = g_rand_new_with_seed(seed);
+
+		for (x = 0; x < operations; x += BENCH_BATCH_SIZE)
+		{
+			for (y = 0; y < BENCH_BATCH_SIZE; y++)
+			{
+				lookups[y] = g_array_index(hashes, guint32, g_rand_int_range(rand, 0, (gint32) hashes->len));
+			}
+
+			wf_bench_sample_begin(&sample);
+
+			for (y = 0; y < BENCH_BATCH_SIZE; y++)
+			{
+				wf_song_get_by_hash(lookups[y]);
+			}
+
+			wf_bench_sample_end(&result, &sample, BENCH_BATCH_SIZE);
+		}
+
+		g_rand_free(rand);
+		g_free(lookups);
+	}
+
+	wf_bench_result_report(&result);
+
+	g_array_free(hashes, TRUE);
+}
+
+static void
+wf_bench_chars_get_hash_converted(gint operations)
+{
+	WfBenchResult result;
+	WfBenchSample sample;
+	WfSong *song;
+	GPtrArray *titles;
+	guint index = 0;
+	gint x, y;
+
+	wf_bench_result_init(&result, "wf_chars_get_hash_converted");
+
+	titles = g_ptr_array_new();
+
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	{
+		g_ptr_array_add(titles, (gpointer) wf_song_get_title(song));
+	}
+
+	if (titles->len > 0)
+	{
+		for (x = 0; x < operations; x += BENCH_BATCH_SIZE)
+		{
+			wf_bench_sample_begin(&sample);
+
+			for (y = 0; y < BENCH_BATCH_SIZE; y++)
+			{
+				wf_chars_get_hash_converted(g_ptr_array_index(titles, index));
+				index = (index + 1) % titles->len;
+			}
+
+			wf_bench_sample_end(&result, &sample, BENCH_BATCH_SIZE);
+		}
+	}
+
+	wf_bench_result_report(&result);
+
+	g_ptr_array_free(titles, TRUE);
+}
+
+// Import a directory into an empty library, without reading any metadata
+static void
+wf_bench_directory_import(const gchar *path, gint files, gint iterations)
+{
+	WfBenchResult result;
+	WfBenchSample sample;
+	GFile *dir;
+	gint x;
+
+	wf_bench_result_init(&result, "wf_library_add_by_file (dir)");
+
+	dir = g_file_new_for_path(path);
+
+	for (x = 0; x < iterations && files > 0; x++)
+	{
+		wf_intelligence_pool_invalidate();
+		wf_song_remove_all();
+
+		wf_bench_sample_begin(&sample);
+		wf_library_add_by_file(dir, NULL /* func */, WF_LIBRARY_CHECK_AUDIO, TRUE /* skip_metadata */);
+		wf_bench_sample_end(&result, &sample, files);
+	}
+
+	g_object_unref(dir);
+
+	wf_bench_result_report(&result);
+}
+
+/* BENCHMARKS END */
+
+/* UTILITIES BEGIN */
+
+static void
+wf_bench_result_init(WfBenchResult *result, const gchar *name)
+{
+	*result = (WfBenchResult) { 0 };
+
+	result->name = name;
+	result->latencies = g_array_new(FALSE /* zero_terminated */, FALSE /* clear */, sizeof(gint64));
+}
+
+static void
+wf_bench_sample_begin(WfBenchSample *sample)
+{
+	sample->allocations = wf_bench_get_allocations();
+	sample->start = wf_bench_time_now();
+}
+
+static void
+wf_bench_sample_end(WfBenchResult *result, WfBenchSample *sample, gint operations)
+{
+	gint64 latency;
+
+	latency = (wf_bench_time_now() - sample->start) / MAX(operations, 1);
+
+	result->allocations += wf_bench_get_allocations() - sample->allocations;
+	result->operations += operations;
+
+	g_array_append_val(result->latencies, latency);
+}
+
+// Print the percentiles of the latencies and free them
+static void
+wf_bench_result_report(WfBenchResult *result)
+{
+	GArray *lat = result->latencies;
+	gchar allocations[32] = "-";
+
+	if (lat->len == 0)
+	{
+		g_print("%-32s %10s\n", result->name, "skipped");
+		g_array_free(lat, TRUE);
+
+		return;
+	}
+
+	g_array_sort(lat, wf_bench_latency_compare_cb);
+
+	if (BENCH_COUNT_ALLOCATIONS)
+	{
+		g_snprintf(allocations, sizeof(allocations), "%.1f", (gdouble) result->allocations / (gdouble) result->operations);
+	}
+
+	g_print("%-32s %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT " %10s\n",
+	        result->name,
+	        result->operations,
+	        g_array_index(lat, gint64, (lat->len - 1) * 50 / 100),
+	        g_array_index(lat, gint64, (lat->len - 1) * 90 / 100),
+	        g_array_index(lat, gint64, (lat->len - 1) * 99 / 100),
+	        g_array_index(lat, gint64, lat->len - 1),
+	        allocations);
+
+	g_array_free(lat, TRUE);
+	result->latencies = NULL;
+}
+
+// Remove @path, including everything inside it if it is a directory
+static void
+wf_bench_remove_recursive(const gchar *path)
+{
+	const gchar *name;
+	gchar *child;
+	GDir *dir;
+
+	dir = g_dir_open(path, 0 /* flags */, NULL /* error */);
+
+	if (dir != NULL)
+	{
+		while ((name = g_dir_read_name(dir)) != NULL)
+		{
+			child = g_build_filename(path, name, NULL /* terminator */);
+			wf_bench_remove_recursive(child);
+			g_free(child);
+		}
+
+		g_dir_close(dir);
+	}
+
+	g_remove(path);
+}
+
+// Monotonic time in nanoseconds
+static gint64
+wf_bench_time_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((gint64) ts.tv_sec * G_GINT64_CONSTANT(1000000000)) + ts.tv_nsec;
+}
+
+static gint
+wf_bench_get_allocations(void)
+{
+#if BENCH_COUNT_ALLOCATIONS
+	return g_atomic_int_get(&BenchAllocations);
+#else
+	return 0;
+#endif
+}
+
+static gint
+wf_bench_latency_compare_cb(gconstpointer a, gconstpointer b)
+{
+	gint64 x = *((const gint64 *) a);
+	gint64 y = *((const gint64 *) b);
+
+	return (x > y) - (x < y);
+}
+
+/* UTILITIES END */
+
+/* END OF FILE */
@@ -47,6 +47,7 @@
 
 // Dependency includes
 #include <woofer/song.h>
+#include <woofer/song_metadata.h>
 #include <woofer/remote.h>
 #include <woofer/notifications.h>
 #include <woofer/player.h>
@@ -55,7 +56,10 @@
 #include <woofer/library.h>
 #include <woofer/library_private.h>
 #include <woofer/song_manager.h>
+#include <woofer/intelligence_private.h>
 #include <woofer/mpris.h>
+#include <woofer/metrics.h>
+#include <woofer/daemon.h>
 
 // Resource includes
 #include <woofer/static/options.h>
@@ -164,6 +168,7 @@ static void wf_event_report_msg_cb(const gchar *message);
 static void wf_event_songs_updated_cb(WfSong *song_previous, WfSong *song_current, WfSong *song_next);
 static void wf_event_state_changed_cb(WfPlayerStatus state, gdouble duration);
 static void wf_event_position_updated_cb(gdouble position, gdouble duration);
+static gboolean wf_event_position_wanted_cb(void);
 static void wf_event_player_notification_cb(WfSong *song, gint64 duration);
 
 static void wf_app_action_play_pause_cb(GSimpleAction *action, GVariant *parameter, gpointer user_data);
@@ -179,13 +184,19 @@ static void wf_app_startup_cb(GApplication *app, gpointer user_data);
 static void wf_app_activate_cb(GApplication *app, gpointer user_data);
 static gint wf_app_handle_local_options_cb(GApplication *app, GVariantDict *options, gpointer user_data);
 static void wf_app_handle_open_command_cb(GApplication *app, gpointer files, gint n_files, gchar *hint, gpointer user_data);
+static void wf_app_open_finished_cb(gint added, gboolean cancelled, gpointer user_data);
 static void wf_app_shutdown_cb(GApplication *app, gpointer user_data);
 
 static void wf_app_constructed(GObject *object);
 static void wf_app_get_property(GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
 static void wf_app_set_property(GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
 
+static void wf_app_startup_modules(void);
+static void wf_app_shutdown_modules(void);
+static gint wf_app_run_daemon(const gchar *socket_path);
+
 static gint wf_app_handle_playback_options(void);
+static gint wf_app_activate_playback_action(const gchar *action);
 
 static gboolean wf_app_is_remote(void);
 
@@ -235,6 +246,9 @@ gboolean WfDestruct;
 // Name of the desktop entry file
 gchar *WfDesktopEntry;
 
+// Main loop used instead of #GApplication when running as a daemon
+static GMainLoop *WfDaemonLoop;
+
 // Type info and callbacks for handling #WfApp instances
 static const GTypeInfo WfAppTypeInfo =
 {
@@ -308,6 +322,7 @@ wf_app_class_init(gpointer g_class, gpointer class_data)
 	// Provide a callback function to internal application events
 	wf_player_connect_event_report_msg(wf_event_report_msg_cb);
 	wf_player_connect_event_position_updated(wf_event_position_updated_cb);
+	wf_player_connect_event_position_wanted(wf_event_position_wanted_cb);
 	wf_player_connect_event_state_changed(wf_event_state_changed_cb);
 	wf_player_connect_event_notification(wf_event_player_notification_cb);
 	wf_song_manager_connect_event_songs_changed(wf_event_songs_updated_cb);
@@ -717,9 +732,6 @@ wf_app_instance_init(GTypeInstance *instance, gpointer g_class)
 
 	// Add main option context
 	g_application_add_main_option_entries(gapp, wf_option_entries_get_main());
-
-	// Initialize remote D-Bus interface
-	wf_remote_init(NULL /* GDBusConnection */);
 }
 
 /* CONSTRUCTORS END */
@@ -932,6 +944,31 @@ wf_app_set_incognito(gboolean incognito)
 	wf_song_manager_set_incognito(incognito);
 }
 
+/**
+ * wf_app_get_metrics:
+ *
+ * Get the timing metrics of metadata parsing, reading and writing the
+ * library, choosing songs, changing tracks and handling D-Bus calls.  This is
+ * a dictionary of the metric name to a tuple with the amount of measurements,
+ * the total, shortest and longest duration in microseconds and a histogram,
+ * in which item x is the amount of measurements below 2^x microseconds (and
+ * not in an earlier item).  The last item contains all longer measurements.
+ *
+ * The counts only increase while the application is running.  The same
+ * metrics are available as the Metrics property of the org.woofer.app D-Bus
+ * interface.  If the library has been built without metrics, the dictionary
+ * is empty.
+ *
+ * Returns: (transfer floating): a #GVariant of type "a{s(ttttat)}"
+ *
+ * Since: 0.3
+ **/
+GVariant *
+wf_app_get_metrics(void)
+{
+	return wf_metrics_get_variant();
+}
+
 /* GETTERS/SETTERS END */
 
 /* CALLBACK FUNCTIONS BEGIN */
@@ -982,6 +1019,15 @@ wf_event_position_updated_cb(gdouble position, gdouble duration)
 	g_signal_emit(WfAppInstance, signal, 0 /* detail */, position, duration, NULL /* return value */);
 }
 
+// Only worth the effort if the front-end listens to the position
+static gboolean
+wf_event_position_wanted_cb(void)
+{
+	guint signal = WfSignals[WF_SIGNAL_POSITION_UPDATED];
+
+	return g_signal_has_handler_pending(WfAppInstance, signal, 0 /* detail */, FALSE /* may be blocked */);
+}
+
 static void
 wf_event_player_notification_cb(WfSong *song, gint64 duration)
 {
@@ -1066,8 +1112,6 @@ wf_app_startup_cb(GApplication *app, gpointer user_data)
 {
 	g_info("Application startup (application time %fsec)", wf_app_get_app_time());
 
-	gst_init(NULL /* argc */, NULL /* argv */);
-
 	wf_mpris_set_root_desktop_entry(wf_app_get_desktop_entry());
 	wf_mpris_set_root_identity(WF_DISPLAY_NAME);
 	wf_mpris_set_root_can_raise(TRUE);
@@ -1076,13 +1120,10 @@ wf_app_startup_cb(GApplication *app, gpointer user_data)
 
 	wf_notifications_init(GAppInstance);
 
-	wf_settings_init();
-	wf_settings_read_file();
-
-	wf_library_init();
-	wf_library_read();
+	// Initialize remote D-Bus interface
+	wf_remote_init(NULL /* GDBusConnection */);
 
-	wf_player_init();
+	wf_app_startup_modules();
 
 	g_info("Application startup completed (application time %fsec).", wf_app_get_app_time());
 }
@@ -1155,6 +1196,13 @@ wf_app_handle_local_options_cb(GApplication *app, GVariantDict *options, gpointe
 		g_free(entries->library);
 	}
 
+	if (entries->lazy)
+	{
+		g_info("Found command-line option lazy");
+
+		wf_library_set_lazy_loading(TRUE);
+	}
+
 	if (entries->background)
 	{
 		/*
@@ -1165,6 +1213,22 @@ wf_app_handle_local_options_cb(GApplication *app, GVariantDict *options, gpointe
 		g_info("Found command-line option background");
 	}
 
+	if (entries->daemon)
+	{
+		g_info("Found command-line option daemon");
+
+		// Runs until quit, the application does not get registered at all
+		return wf_app_run_daemon(entries->socket);
+	}
+
+	if (entries->socket != NULL)
+	{
+		g_info("Found command-line option socket (specified path <%s>)", entries->socket);
+
+		// Send the playback options to the daemon instead of over D-Bus
+		return wf_app_handle_playback_options();
+	}
+
 	/*
 	 * Process the playback options if this instance is remote (if not,
 	 * processing these options should be done later)
@@ -1185,9 +1249,8 @@ wf_app_handle_open_command_cb(GApplication *app, gpointer files, gint n_files, g
 {
 	GFile **file_list = files;
 	GFile *file;
+	GSList *list = NULL;
 	gint i;
-	gint amount;
-	gint added = 0;
 
 	g_return_if_fail(app != NULL);
 	g_return_if_fail(files != NULL);
@@ -1210,34 +1273,46 @@ wf_app_handle_open_command_cb(GApplication *app, gpointer files, gint n_files, g
 			break;
 		}
 
-		/*
-		 * Because all #GFiles will be unreffed by GLib after opening,
-		 * make sure to add reference that the library may remove if it
-		 * decides it doesn't want the file.  This to prevent GLib from
-		 * unreffing all files and creating a segmentation fault as the
-		 * objects were already freed.
-		 */
-		g_object_ref(file);
-
-		amount = wf_library_add_by_file(file, NULL /* func */, 0 /* checks: default */, FALSE);
-		added += amount;
+		list = g_slist_prepend(list, file);
 	}
 
-	wf_library_write(FALSE);
+	/*
+	 * Add the files in the background, so whole directories can be opened
+	 * without blocking the interface.  The library keeps its own references
+	 * to the files, and the application is held until it is done.
+	 */
+	list = g_slist_reverse(list);
+	g_application_hold(app);
+
+	wf_library_add_files_async(list, NULL /* func */, 0 /* checks: default */, FALSE /* skip_metadata */,
+	                           NULL /* cancellable */, wf_app_open_finished_cb, app);
 
-	// Files have been opened, now show the interface window
+	g_slist_free(list);
+
+	// Files are being opened, now show the interface window
 	g_application_activate(GAppInstance);
 }
 
+// All files passed to the open command have been added
+static void
+wf_app_open_finished_cb(gint added, gboolean cancelled, gpointer user_data)
+{
+	GApplication *app = user_data;
+
+	g_info("Added %d songs from the opened files", added);
+
+	wf_library_write(FALSE);
+
+	g_application_release(app);
+}
+
 // Time to shutdown and finalize all internal modules
 static void
 wf_app_shutdown_cb(GApplication *app, gpointer user_data)
 {
 	g_info("Shutting down...");
 
-	wf_player_finalize();
-	wf_library_finalize();
-	wf_settings_finalize();
+	wf_app_shutdown_modules();
 	wf_notifications_finalize();
 }
 
@@ -1524,6 +1599,12 @@ wf_app_run(int argc, char **argv)
 void
 wf_app_raise(void)
 {
+	if (WfDaemonLoop != NULL)
+	{
+		// Nothing to show
+		return;
+	}
+
 	g_application_activate(GAppInstance);
 }
 
@@ -1548,7 +1629,11 @@ wf_app_quit(void)
 	 * interface should always be available anyway.  Just in case the hold
 	 * does have any impact, release it here.
 	 */
-	if (!WfDestruct)
+	if (WfDaemonLoop != NULL)
+	{
+		g_main_loop_quit(WfDaemonLoop);
+	}
+	else if (!WfDestruct)
 	{
 		WfDestruct = TRUE;
 
@@ -1760,6 +1845,7 @@ wf_app_handle_playback_options(void)
 
 	const gchar *options = "--play-pause, --play, --pause, --stop, --previous or --next";
 	const WfApplicationEntries *entries = wf_option_entries_get_entries();
+	gint result = RETURN_SUCCESS;
 
 	gboolean play_pause;
 	gboolean play;
@@ -1796,44 +1882,168 @@ wf_app_handle_playback_options(void)
 	{
 		g_info("Found command-line option play-pause");
 
-		g_action_group_activate_action(G_ACTION_GROUP(WfAppInstance), ACTION_PLAY_PAUSE, NULL /* parameter */);
+		result = wf_app_activate_playback_action(ACTION_PLAY_PAUSE);
 	}
 
 	if (play)
 	{
 		g_info("Found command-line option play");
 
-		g_action_group_activate_action(G_ACTION_GROUP(WfAppInstance), ACTION_PLAY, NULL /* parameter */);
+		result = wf_app_activate_playback_action(ACTION_PLAY);
 	}
 
 	if (pause)
 	{
 		g_info("Found command-line option pause");
 
-		g_action_group_activate_action(G_ACTION_GROUP(WfAppInstance), ACTION_PAUSE, NULL /* parameter */);
+		result = wf_app_activate_playback_action(ACTION_PAUSE);
 	}
 
 	if (stop)
 	{
 		g_info("Found command-line option stop");
 
-		g_action_group_activate_action(G_ACTION_GROUP(WfAppInstance), ACTION_STOP, NULL /* parameter */);
+		result = wf_app_activate_playback_action(ACTION_STOP);
 	}
 
 	if (previous)
 	{
 		g_info("Found command-line option previous");
 
-		g_action_group_activate_action(G_ACTION_GROUP(WfAppInstance), ACTION_PREVIOUS, NULL /* parameter */);
+		result = wf_app_activate_playback_action(ACTION_PREVIOUS);
 	}
 
 	if (next)
 	{
 		g_info("Found command-line option next");
 
-		g_action_group_activate_action(G_ACTION_GROUP(WfAppInstance), ACTION_NEXT, NULL /* parameter */);
+		result = wf_app_activate_playback_action(ACTION_NEXT);
 	}
 
+	return result;
+}
+
+/*
+ * Activate a playback action.  The action names double as the commands of the
+ * control socket, so they can also be executed by the daemon itself or sent to
+ * a running one.
+ */
+static gint
+wf_app_activate_playback_action(const gchar *action)
+{
+	const WfApplicationEntries *entries = wf_option_entries_get_entries();
+	GError *error = NULL;
+	gchar *reply;
+	gint result = RETURN_SUCCESS;
+
+	if (wf_daemon_is_active())
+	{
+		// This is the daemon
+		reply = wf_daemon_execute(action);
+	}
+	else if (entries->socket != NULL)
+	{
+		reply = wf_daemon_send(entries->socket, action, &error);
+
+		if (reply == NULL)
+		{
+			g_printerr("Could not reach the daemon: %s\n", error->message);
+			g_error_free(error);
+
+			return RETURN_ERROR;
+		}
+	}
+	else
+	{
+		g_action_group_activate_action(G_ACTION_GROUP(WfAppInstance), action, NULL /* parameter */);
+
+		return RETURN_SUCCESS;
+	}
+
+	if (!g_str_has_prefix(reply, "OK"))
+	{
+		g_printerr("%s\n", reply);
+		result = RETURN_ERROR;
+	}
+
+	g_free(reply);
+
+	return result;
+}
+
+// Initialize the internal modules, for both the application and the daemon
+static void
+wf_app_startup_modules(void)
+{
+	gst_init(NULL /* argc */, NULL /* argv */);
+
+	wf_settings_init();
+	wf_settings_read_file();
+
+	/*
+	 * When loading lazily, this only reads what is needed to choose and play
+	 * songs, so the player (and with it MPRIS) is up right away.  The rest
+	 * of the library follows while the main loop is idle.
+	 */
+	wf_library_init();
+	wf_library_read();
+
+	wf_player_init();
+}
+
+// Finalize the internal modules started by wf_app_startup_modules()
+static void
+wf_app_shutdown_modules(void)
+{
+	wf_player_finalize();
+	wf_library_finalize();
+	wf_intelligence_finalize();
+	wf_settings_finalize();
+	wf_song_metadata_release_probe();
+}
+
+/*
+ * Run as a daemon: without #GApplication, notifications, MPRIS and the remote
+ * D-Bus interface, controlled through the control socket only.  This does not
+ * return until the daemon quits.
+ */
+static gint
+wf_app_run_daemon(const gchar *socket_path)
+{
+	GError *error = NULL;
+
+	g_info("Daemon startup (application time %fsec)", wf_app_get_app_time());
+
+	// Open the socket first, so a second daemon fails before reading anything
+	if (!wf_daemon_init(socket_path, &error))
+	{
+		g_printerr("Could not open the control socket: %s\n", error->message);
+		g_error_free(error);
+
+		return RETURN_ERROR;
+	}
+
+	WfDaemonLoop = g_main_loop_new(NULL /* GMainContext */, FALSE /* is_running */);
+	WfActive = TRUE;
+
+	wf_player_set_remote_enabled(FALSE);
+	wf_app_startup_modules();
+
+	// Execute the playback options right away, like the primary instance does
+	wf_app_handle_playback_options();
+
+	g_info("Daemon startup completed (application time %fsec).", wf_app_get_app_time());
+
+	g_main_loop_run(WfDaemonLoop);
+
+	g_info("Shutting down...");
+
+	wf_daemon_finalize();
+	wf_app_shutdown_modules();
+
+	g_main_loop_unref(WfDaemonLoop);
+	WfDaemonLoop = NULL;
+
 	return RETURN_SUCCESS;
 }
 
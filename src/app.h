@@ -105,6 +105,7 @@ gdouble wf_app_get_volume_percentage(void);
 void wf_app_set_volume_percentage(gdouble percentage);
 gboolean wf_app_get_incognito(void);
 void wf_app_set_incognito(gboolean incognito);
+GVariant * wf_app_get_metrics(void);
 
 /* GETTER/SETTER PROTOTYPES END */
 
@@ -22,6 +22,7 @@
 /* INCLUDES BEGIN */
 
 // Library includes
+#include <string.h>
 #include <glib.h>
 
 // Global includes
@@ -54,6 +55,20 @@
 /* DESCRIPTION END */
 
 /* DEFINES BEGIN */
+
+// Range of Unicode characters that have a normal variant (Latin-1 and Extended-A)
+#define CHARS_TABLE_FIRST 0x00C0
+#define CHARS_TABLE_LAST 0x017F
+
+// Masks to check multiple bytes at once in a #guint64
+#define CHARS_WORD_ONES G_GUINT64_CONSTANT(0x0101010101010101)
+#define CHARS_WORD_HIGH G_GUINT64_CONSTANT(0x8080808080808080)
+
+// Odd constants used to mix the input of the 64-bit hash
+#define CHARS_HASH64_K0 G_GUINT64_CONSTANT(0xa0761d6478bd642f)
+#define CHARS_HASH64_K1 G_GUINT64_CONSTANT(0xe7037ed1a0b428db)
+#define CHARS_HASH64_K2 G_GUINT64_CONSTANT(0x8ebc6af09c88c6e3)
+
 /* DEFINES END */
 
 /* CUSTOM TYPES BEGIN */
@@ -63,11 +78,22 @@
 
 static gboolean wf_chars_is_start_of_multibyte(guchar ch);
 
+static void wf_chars_table_init(void);
+static guchar wf_chars_lookup_normal(gunichar ch);
 static guchar wf_chars_special_to_normal(gunichar ch);
 
+static guint64 wf_chars_mix(guint64 a, guint64 b);
+
+static gboolean wf_chars_word_is_ascii(guint64 word);
+static guint64 wf_chars_word_to_lower(guint64 word);
+
 /* FUNCTION PROTOTYPES END */
 
 /* GLOBAL VARIABLES BEGIN */
+
+// Normal variant of each special character in the table range, 0 if none
+static guchar NormalTable[CHARS_TABLE_LAST - CHARS_TABLE_FIRST + 1];
+
 /* GLOBAL VARIABLES END */
 
 /* MODULE FUNCTIONS BEGIN */
@@ -83,8 +109,9 @@ wf_chars_is_start_of_multibyte(guchar ch)
 	return (0x80 != (0xC0 & ch));
 }
 
-static guchar
-wf_chars_special_to_normal(gunichar ch)
+// Fill the lookup table from the character arrays, only done once
+static void
+wf_chars_table_init(void)
 {
 	/*
 	 * These are statically allocated char arrays containing hexadecimal values
@@ -121,34 +148,91 @@ wf_chars_special_to_normal(gunichar ch)
 
 	static const gunichar *special_char_array[] = { special_a, special_c, special_d, special_e, special_g, special_h, special_i, special_j, special_k, special_l, special_n, special_o, special_r, special_s, special_t, special_u, special_w, special_y, special_z, NULL };
 
+	static gsize initialized = 0;
 	const gunichar **arrays, *chars;
 	gunichar item;
 
-	// Loop through all arrays
+	if (!g_once_init_enter(&initialized))
+	{
+		return;
+	}
+
 	for (arrays = special_char_array; *arrays != NULL; arrays++)
 	{
-		chars = *arrays; // Current array to search through
-		item = *chars; // On match, use this character as replacement
+		chars = *arrays; // Current array to go through
+		item = *chars; // The replacement for all characters in this array
 
 		// Start at array position 1 (past the first and single ASCII char)
-		chars++;
-
-		// Loop through all special characters
-		while (*chars != 0)
+		for (chars++; *chars != 0; chars++)
 		{
-			// Matched?
-			if (ch == *chars)
-			{
-				// Use this character as a replacement
-				return (gchar) item;
-			}
-
-			chars++;
+			NormalTable[*chars - CHARS_TABLE_FIRST] = (guchar) item;
 		}
 	}
 
+	g_once_init_leave(&initialized, 1);
+}
+
+// Get the normal variant of special character @ch, or 0 if it has none
+static guchar
+wf_chars_lookup_normal(gunichar ch)
+{
+	if (ch < CHARS_TABLE_FIRST || ch > CHARS_TABLE_LAST)
+	{
+		return 0;
+	}
+
+	wf_chars_table_init();
+
+	return NormalTable[ch - CHARS_TABLE_FIRST];
+}
+
+static guchar
+wf_chars_special_to_normal(gunichar ch)
+{
+	guchar normal = wf_chars_lookup_normal(ch);
+
 	// If no match, just keep this character
-	return ch;
+	return (normal != 0) ? normal : (guchar) ch;
+}
+
+/*
+ * Multiply @a and @b into a 128-bit result and fold both halves together.
+ * This is done using 32-bit parts, as not every compiler has 128-bit types.
+ */
+static guint64
+wf_chars_mix(guint64 a, guint64 b)
+{
+	guint64 a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+	guint64 b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+	guint64 lo_lo = a_lo * b_lo;
+	guint64 hi_lo = a_hi * b_lo;
+	guint64 lo_hi = a_lo * b_hi;
+	guint64 hi_hi = a_hi * b_hi;
+	guint64 cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+	guint64 upper = hi_hi + (hi_lo >> 32) + (cross >> 32);
+	guint64 lower = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+
+	return upper ^ lower;
+}
+
+// Check if none of the 8 bytes in @word is a NUL or non-ASCII byte
+static gboolean
+wf_chars_word_is_ascii(guint64 word)
+{
+	return ((word | ((word - CHARS_WORD_ONES) & ~word)) & CHARS_WORD_HIGH) == 0;
+}
+
+// Lowercase the ASCII letters in all 8 bytes of @word at once
+static guint64
+wf_chars_word_to_lower(guint64 word)
+{
+	guint64 heptets = word & ~CHARS_WORD_HIGH;
+	guint64 above_z = heptets + (CHARS_WORD_ONES * (0x7F - 'Z'));
+	guint64 from_a = heptets + (CHARS_WORD_ONES * (0x80 - 'A'));
+	guint64 upper = from_a & ~above_z & ~word & CHARS_WORD_HIGH;
+
+	// The high bit of every uppercase letter, shifted to the 0x20 bit
+	return word | (upper >> 2);
 }
 
 guint32
@@ -177,16 +261,55 @@ wf_chars_get_hash(const gchar *str)
 	return hash;
 }
 
+/*
+ * Get a 64-bit hash of @str.  Unlike wf_chars_get_hash(), this reads 8 bytes
+ * at a time and mixes them using multiplications, which makes it both faster
+ * and far better distributed (in the style of wyhash).  This should be used
+ * for in-memory lookups; wf_chars_get_hash() is kept for the song IDs that
+ * are stored in the library file and used by remotes.
+ */
+guint64
+wf_chars_get_hash64(const gchar *str)
+{
+	const gchar *p;
+	gsize length, remaining;
+	guint64 word, hash;
+
+	if (str == NULL)
+	{
+		return 0;
+	}
+
+	length = strlen(str);
+	hash = wf_chars_mix(length ^ CHARS_HASH64_K0, CHARS_HASH64_K1);
+
+	for (p = str, remaining = length; remaining >= 8; p += 8, remaining -= 8)
+	{
+		memcpy(&word, p, sizeof(word));
+		hash = wf_chars_mix(word ^ CHARS_HASH64_K1, hash ^ CHARS_HASH64_K2);
+	}
+
+	if (remaining > 0)
+	{
+		word = 0;
+		memcpy(&word, p, remaining);
+		hash = wf_chars_mix(word ^ CHARS_HASH64_K2, hash ^ CHARS_HASH64_K0);
+	}
+
+	return wf_chars_mix(hash ^ CHARS_HASH64_K0, length ^ CHARS_HASH64_K1);
+}
+
 // Get hash with some special characters converted
 guint32
 wf_chars_get_hash_converted(const gchar *str)
 {
 	const gchar *p;
+	const gchar *end;
 	gchar ch;
 	guchar uchar;
 	gunichar unichar;
+	guint64 word;
 	guint x;
-	guint pos = 0;
 	guint32 hash = 0;
 
 	if (str == NULL)
@@ -194,9 +317,34 @@ wf_chars_get_hash_converted(const gchar *str)
 		return 0;
 	}
 
+	end = str + strlen(str);
+
 	for (p = str; *p != '\0'; p = g_utf8_next_char(p))
 	{
-		pos++; // Set position
+		// Hash runs of ASCII 8 characters at a time, without any lookups
+		while (end - p >= 8)
+		{
+			memcpy(&word, p, sizeof(word));
+
+			if (!wf_chars_word_is_ascii(word))
+			{
+				break;
+			}
+
+			word = wf_chars_word_to_lower(word);
+
+			for (x = 0; x < 8; x++)
+			{
+				hash = (hash << 5) + hash + ((const guchar *) &word)[x];
+			}
+
+			p += 8;
+		}
+
+		if (*p == '\0')
+		{
+			break;
+		}
 
 		ch = *p; // Dereference; take character
 		uchar = (guchar) ch; // Force use unsigned char
@@ -229,6 +377,103 @@ wf_chars_get_hash_converted(const gchar *str)
 	return hash;
 }
 
+/*
+ * Create a key of @str that can be compared using strcmp() to sort strings
+ * alphabetically.  The same conversion as wf_chars_get_hash_converted() is
+ * used, so ASCII is lowercased and special characters are replaced by their
+ * normal variant.  Other characters are kept, but lowercased.
+ */
+gchar *
+wf_chars_get_sort_key(const gchar *str)
+{
+	GString *key;
+	const gchar *p;
+	const gchar *end;
+	guchar uchar, normal;
+	gunichar unichar;
+	guint64 word;
+
+	if (str == NULL)
+	{
+		return NULL;
+	}
+
+	end = str + strlen(str);
+	key = g_string_sized_new(end - str);
+
+	for (p = str; *p != '\0'; p = g_utf8_next_char(p))
+	{
+		while (end - p >= 8)
+		{
+			memcpy(&word, p, sizeof(word));
+
+			if (!wf_chars_word_is_ascii(word))
+			{
+				break;
+			}
+
+			word = wf_chars_word_to_lower(word);
+			g_string_append_len(key, (const gchar *) &word, sizeof(word));
+
+			p += 8;
+		}
+
+		if (*p == '\0')
+		{
+			break;
+		}
+
+		uchar = (guchar) *p;
+
+		if (uchar >= 128 && wf_chars_is_start_of_multibyte(uchar))
+		{
+			unichar = g_utf8_get_char(p);
+			normal = wf_chars_lookup_normal(unichar);
+
+			if (normal != 0)
+			{
+				g_string_append_c(key, normal);
+			}
+			else
+			{
+				g_string_append_unichar(key, g_unichar_tolower(unichar));
+			}
+		}
+		else
+		{
+			g_string_append_c(key, g_ascii_tolower(uchar));
+		}
+	}
+
+	return g_string_free(key, FALSE);
+}
+
+/*
+ * Lowercase the ASCII letters in the first @length bytes of @str in place.
+ * Other bytes (like those of multibyte characters) are left untouched.
+ */
+void
+wf_chars_ascii_down(gchar *str, gsize length)
+{
+	gchar *p = str;
+	gchar *end = str + length;
+	guint64 word;
+
+	g_return_if_fail(str != NULL || length == 0);
+
+	for (; end - p >= 8; p += 8)
+	{
+		memcpy(&word, p, sizeof(word));
+		word = wf_chars_word_to_lower(word);
+		memcpy(p, &word, sizeof(word));
+	}
+
+	for (; p < end; p++)
+	{
+		*p = g_ascii_tolower(*p);
+	}
+}
+
 /* MODULE FUNCTIONS END */
 
 /* END OF FILE */
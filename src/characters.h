@@ -40,6 +40,10 @@ G_BEGIN_DECLS
 
 guint32 wf_chars_get_hash(const gchar *str);
 guint32 wf_chars_get_hash_converted(const gchar *str);
+guint64 wf_chars_get_hash64(const gchar *str);
+
+gchar * wf_chars_get_sort_key(const gchar *str);
+void wf_chars_ascii_down(gchar *str, gsize length);
 
 /* FUNCTION PROTOTYPES END */
 
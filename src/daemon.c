@@ -0,0 +1,738 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * daemon.c  This file is part of LibWoofer
+ * Copyright (C) 2023  Quico Augustijn
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this library.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <math.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+// Global includes
+#include <woofer/constants.h>
+
+// Module includes
+#include <woofer/daemon.h>
+
+// Dependency includes
+#include <woofer/app.h>
+#include <woofer/player.h>
+#include <woofer/song.h>
+#include <woofer/song_private.h>
+#include <woofer/utils.h>
+#include <woofer/memory.h>
+#include <woofer/metrics.h>
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * This module provides the control socket used when running as a daemon, for
+ * machines without a desktop session.  Instead of D-Bus, commands are sent as
+ * single lines of text over a Unix socket, each of which gets a single line as
+ * reply: "OK", optionally followed by a value, or "ERR" followed by the reason.
+ *
+ * The commands are the names of the playback actions (like "play-pause" or
+ * "next") and "quit", plus:
+ * - "status": replies with the playback state and the URI of the current song
+ * - "volume [percentage]": replies with the volume, after setting it if given
+ * - "queue <uri>": toggles the song with this URI in the queue
+ *
+ * The socket can only be used by the user owning it; it is created with a
+ * restrictive umask, so it is never accessible to others, not even briefly.
+ * Clients are handled from the main loop, one command at a time per
+ * connection.  Their data is read into a buffer of fixed size, a client that
+ * fills it without ending the command is disconnected.
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Longest command accepted, clients sending more are disconnected
+#define DAEMON_COMMAND_MAX 4096
+
+#define DAEMON_REPLY_OK "OK"
+#define DAEMON_REPLY_ERROR "ERR"
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef void (*WfFuncDaemonCommand) (void);
+
+typedef struct _WfDaemonCommand WfDaemonCommand;
+typedef struct _WfDaemonClient WfDaemonClient;
+typedef struct _WfDaemonDetails WfDaemonDetails;
+
+// Command without arguments that maps directly to the application API
+struct _WfDaemonCommand
+{
+	const gchar *name;
+	WfFuncDaemonCommand func;
+};
+
+// A connected client, freed once it disconnects
+struct _WfDaemonClient
+{
+	GSocketConnection *connection;
+	GInputStream *input;
+
+	gchar buffer[DAEMON_COMMAND_MAX]; // Received data that has not been handled yet
+	gsize length;
+};
+
+struct _WfDaemonDetails
+{
+	GSocketService *service;
+	GCancellable *cancellable; // Cancels the operations of all clients
+	gchar *socket_path;
+
+	guint sigint_id;
+	guint sigterm_id;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static gboolean wf_daemon_incoming_cb(GSocketService *service, GSocketConnection *connection, GObject *source, gpointer user_data);
+static void wf_daemon_read_cb(GObject *source, GAsyncResult *result, gpointer user_data);
+static void wf_daemon_write_reply_cb(GObject *source, GAsyncResult *result, gpointer user_data);
+static gboolean wf_daemon_signal_cb(gpointer user_data);
+
+static gboolean wf_daemon_remove_stale_socket(const gchar *socket_path, GError **error);
+static void wf_daemon_client_read(WfDaemonClient *client);
+static gchar * wf_daemon_client_take_line(WfDaemonClient *client);
+static void wf_daemon_client_reply(WfDaemonClient *client, const gchar *command);
+
+static const gchar * wf_daemon_get_status_name(WfPlayerStatus status);
+
+static void wf_daemon_client_free(WfDaemonClient *client);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+static const WfDaemonCommand DaemonCommands[] =
+{
+	{ "play-pause", wf_app_play_pause },
+	{ "play", wf_app_play },
+	{ "pause", wf_app_pause },
+	{ "stop", wf_app_stop },
+	{ "previous", wf_app_previous },
+	{ "next", wf_app_next },
+	{ "quit", wf_app_quit },
+
+	// Terminator
+	{ NULL, NULL }
+};
+
+static WfDaemonDetails DaemonData = { 0 };
+
+/* GLOBAL VARIABLES END */
+
+/* CONSTRUCTORS BEGIN */
+
+/*
+ * wf_daemon_init:
+ * @socket_path: (nullable): location of the control socket, or %NULL for the
+ *   default one (see wf_daemon_get_default_socket())
+ * @error: return location for an error
+ *
+ * Starts listening on the control socket, which only the current user can
+ * access.  A socket left behind by a daemon that is no longer running is
+ * replaced.  SIGINT and SIGTERM quit the application from now on.
+ *
+ * Returns: %TRUE if the socket is ready, %FALSE with @error set otherwise
+ */
+gboolean
+wf_daemon_init(const gchar *socket_path, GError **error)
+{
+	GSocketAddress *address;
+	gboolean result;
+	mode_t mask;
+
+	g_return_val_if_fail(DaemonData.service == NULL, FALSE);
+
+	DaemonData.socket_path = (socket_path != NULL) ? g_strdup(socket_path) : wf_daemon_get_default_socket();
+
+	if (!wf_daemon_remove_stale_socket(DaemonData.socket_path, error))
+	{
+		wf_memory_clear_str(&DaemonData.socket_path);
+
+		return FALSE;
+	}
+
+	DaemonData.service = g_socket_service_new();
+	DaemonData.cancellable = g_cancellable_new();
+
+	// Commands are only accepted from the user running the daemon, from the moment the socket exists
+	mask = umask(0077);
+
+	address = g_unix_socket_address_new(DaemonData.socket_path);
+	result = g_socket_listener_add_address(G_SOCKET_LISTENER(DaemonData.service), address,
+	                                       G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT,
+	                                       NULL /* source_object */, NULL /* effective_address */, error);
+	g_object_unref(address);
+
+	umask(mask);
+
+	if (!result)
+	{
+		wf_daemon_finalize();
+
+		return FALSE;
+	}
+
+	// Do not rely on the umask alone, the file system may not honour it
+	if (g_chmod(DaemonData.socket_path, 0600) != 0)
+	{
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED, "Could not restrict access to control socket %s", DaemonData.socket_path);
+		wf_daemon_finalize();
+
+		return FALSE;
+	}
+
+	g_signal_connect(DaemonData.service, "incoming", G_CALLBACK(wf_daemon_incoming_cb), NULL /* user_data */);
+	g_socket_service_start(DaemonData.service);
+
+	DaemonData.sigint_id = g_unix_signal_add(SIGINT, wf_daemon_signal_cb, NULL /* user_data */);
+	DaemonData.sigterm_id = g_unix_signal_add(SIGTERM, wf_daemon_signal_cb, NULL /* user_data */);
+
+	g_info("Listening for commands on %s", DaemonData.socket_path);
+
+	return TRUE;
+}
+
+/* CONSTRUCTORS END */
+
+/* GETTERS/SETTERS BEGIN */
+
+/*
+ * wf_daemon_get_default_socket:
+ *
+ * Gets the location of the control socket used when none is given, in the
+ * runtime directory of the user.
+ *
+ * Returns: (transfer full): the path of the default socket
+ */
+gchar *
+wf_daemon_get_default_socket(void)
+{
+	return g_build_filename(g_get_user_runtime_dir(), WF_DAEMON_SOCKET_NAME, NULL);
+}
+
+// %TRUE if the control socket is listening
+gboolean
+wf_daemon_is_active(void)
+{
+	return (DaemonData.service != NULL);
+}
+
+/* GETTERS/SETTERS END */
+
+/* CALLBACK FUNCTIONS BEGIN */
+
+// A client connected to the control socket
+static gboolean
+wf_daemon_incoming_cb(GSocketService *service, GSocketConnection *connection, GObject *source, gpointer user_data)
+{
+	WfDaemonClient *client;
+
+	client = g_new0(WfDaemonClient, 1);
+	client->connection = g_object_ref(connection);
+	client->input = g_object_ref(g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+
+	wf_daemon_client_read(client);
+
+	// Handled here, no other handlers are needed
+	return TRUE;
+}
+
+// More data of the client arrived, look for a complete command in it
+static void
+wf_daemon_read_cb(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	WfDaemonClient *client = user_data;
+	GError *error = NULL;
+	gssize read;
+
+	read = g_input_stream_read_finish(client->input, result, &error);
+
+	if (read <= 0)
+	{
+		if (error != NULL)
+		{
+			if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			{
+				g_debug("Could not read from control socket client: %s", error->message);
+			}
+
+			g_error_free(error);
+		}
+
+		// Disconnected or cancelled
+		wf_daemon_client_free(client);
+
+		return;
+	}
+
+	client->length += read;
+
+	wf_daemon_client_read(client);
+}
+
+// The reply has been sent, wait for the next command
+static void
+wf_daemon_write_reply_cb(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	WfDaemonClient *client = user_data;
+	GError *error = NULL;
+
+	g_output_stream_write_bytes_finish(G_OUTPUT_STREAM(source), result, &error);
+
+	if (error != NULL)
+	{
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		{
+			g_debug("Could not reply to control socket client: %s", error->message);
+		}
+
+		g_error_free(error);
+		wf_daemon_client_free(client);
+
+		return;
+	}
+
+	wf_daemon_client_read(client);
+}
+
+// Asked to terminate, quit like a client would
+static gboolean
+wf_daemon_signal_cb(gpointer user_data)
+{
+	g_info("Received termination signal");
+
+	wf_app_quit();
+
+	return G_SOURCE_CONTINUE;
+}
+
+/* CALLBACK FUNCTIONS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+/*
+ * wf_daemon_execute:
+ * @command: a single command, as sent over the control socket
+ *
+ * Executes @command.  This is also used for the playback options given when
+ * starting the daemon.
+ *
+ * Returns: (transfer full): the reply to send back, without line terminator
+ */
+gchar *
+wf_daemon_execute(const gchar *command)
+{
+	const WfDaemonCommand *entry;
+	gchar **args;
+	gchar *copy;
+	gchar *name;
+	gchar *reply;
+	WfSong *song;
+	gdouble volume;
+	gchar *end;
+	gchar *uri;
+	gint64 start;
+
+	g_return_val_if_fail(command != NULL, NULL);
+
+	start = wf_metrics_start();
+
+	// Name first, the rest of the line is a single argument
+	copy = g_strstrip(g_strdup(command));
+	args = g_strsplit(copy, " ", 2);
+	g_free(copy);
+
+	if (args[0] == NULL)
+	{
+		g_strfreev(args);
+
+		return g_strdup(DAEMON_REPLY_ERROR " No command");
+	}
+
+	name = wf_utils_str_to_lower(args[0]);
+
+	for (entry = DaemonCommands; entry->name != NULL; entry++)
+	{
+		if (wf_utils_str_is_equal(name, entry->name))
+		{
+			break;
+		}
+	}
+
+	if (entry->name != NULL)
+	{
+		entry->func();
+
+		reply = g_strdup(DAEMON_REPLY_OK);
+	}
+	else if (wf_utils_str_is_equal(name, "status"))
+	{
+		song = wf_player_get_current_song();
+		uri = (song != NULL) ? wf_song_get_uri(song) : NULL;
+
+		reply = g_strdup_printf(DAEMON_REPLY_OK " %s%s%s", wf_daemon_get_status_name(wf_player_get_status()),
+		                        (uri != NULL) ? " " : "", (uri != NULL) ? uri : "");
+
+		g_free(uri);
+	}
+	else if (wf_utils_str_is_equal(name, "volume"))
+	{
+		volume = (args[1] != NULL) ? g_ascii_strtod(g_strstrip(args[1]), &end) : 0.0;
+
+		if (args[1] != NULL && (end == args[1] || *end != '\0' || !isfinite(volume)))
+		{
+			reply = g_strdup_printf(DAEMON_REPLY_ERROR " Invalid volume <%s>", args[1]);
+		}
+		else
+		{
+			if (args[1] != NULL)
+			{
+				wf_app_set_volume_percentage(CLAMP(volume, 0.0, 100.0));
+			}
+
+			reply = g_strdup_printf(DAEMON_REPLY_OK " %.0f", wf_app_get_volume_percentage());
+		}
+	}
+	else if (wf_utils_str_is_equal(name, "queue"))
+	{
+		song = (args[1] != NULL) ? wf_song_get_by_uri(g_strstrip(args[1])) : NULL;
+
+		if (song != NULL)
+		{
+			wf_app_toggle_queue(song);
+
+			reply = g_strdup(DAEMON_REPLY_OK);
+		}
+		else
+		{
+			reply = g_strdup(DAEMON_REPLY_ERROR " No song with this URI in the library");
+		}
+	}
+	else
+	{
+		reply = g_strdup_printf(DAEMON_REPLY_ERROR " Unknown command <%s>", name);
+	}
+
+	g_strfreev(args);
+
+	wf_metrics_stop(WF_METRIC_DAEMON_COMMAND, start);
+
+	return reply;
+}
+
+/*
+ * wf_daemon_send:
+ * @socket_path: (nullable): location of the control socket, or %NULL for the
+ *   default one
+ * @command: the command to send
+ * @error: return location for an error
+ *
+ * Sends a single command to a running daemon and waits for its reply.
+ *
+ * Returns: (transfer full) (nullable): the reply without its line terminator,
+ *   or %NULL with @error set if the daemon could not be reached
+ */
+gchar *
+wf_daemon_send(const gchar *socket_path, const gchar *command, GError **error)
+{
+	GSocketConnection *connection;
+	GSocketAddress *address;
+	GSocketClient *client;
+	GDataInputStream *input;
+	GOutputStream *output;
+	gchar *default_path = NULL;
+	gchar *line;
+	gchar *reply = NULL;
+
+	g_return_val_if_fail(command != NULL, NULL);
+
+	if (socket_path == NULL)
+	{
+		default_path = wf_daemon_get_default_socket();
+		socket_path = default_path;
+	}
+
+	client = g_socket_client_new();
+	address = g_unix_socket_address_new(socket_path);
+	connection = g_socket_client_connect(client, G_SOCKET_CONNECTABLE(address), NULL /* cancellable */, error);
+
+	g_object_unref(address);
+	g_object_unref(client);
+	g_free(default_path);
+
+	if (connection == NULL)
+	{
+		return NULL;
+	}
+
+	line = g_strconcat(command, "\n", NULL);
+	output = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+
+	if (g_output_stream_write_all(output, line, strlen(line), NULL /* bytes_written */, NULL /* cancellable */, error))
+	{
+		input = g_data_input_stream_new(g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+		reply = g_data_input_stream_read_line(input, NULL /* length */, NULL /* cancellable */, error);
+		g_object_unref(input);
+
+		if (reply == NULL && error != NULL && *error == NULL)
+		{
+			g_set_error(error, G_IO_ERROR, G_IO_ERROR_CLOSED, "Connection closed without a reply");
+		}
+	}
+
+	g_free(line);
+	g_object_unref(connection);
+
+	return reply;
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+// Remove the socket left behind by a daemon that stopped without cleaning up
+static gboolean
+wf_daemon_remove_stale_socket(const gchar *socket_path, GError **error)
+{
+	GSocketConnection *connection;
+	GSocketAddress *address;
+	GSocketClient *client;
+	GStatBuf info;
+
+	if (g_lstat(socket_path, &info) != 0)
+	{
+		return TRUE;
+	}
+
+	// Never remove anything but a socket, whatever else is at this path
+	if (!S_ISSOCK(info.st_mode))
+	{
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_EXISTS, "Control socket path %s exists and is not a socket", socket_path);
+
+		return FALSE;
+	}
+
+	client = g_socket_client_new();
+	address = g_unix_socket_address_new(socket_path);
+	connection = g_socket_client_connect(client, G_SOCKET_CONNECTABLE(address), NULL /* cancellable */, NULL /* error */);
+
+	g_object_unref(address);
+	g_object_unref(client);
+
+	if (connection != NULL)
+	{
+		g_object_unref(connection);
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_ADDRESS_IN_USE, "Another daemon is already listening on %s", socket_path);
+
+		return FALSE;
+	}
+
+	g_debug("Removing stale control socket %s", socket_path);
+
+	if (g_unlink(socket_path) != 0)
+	{
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_EXISTS, "Could not remove stale control socket %s", socket_path);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+// Handle the next command of @client, once it has been received completely
+static void
+wf_daemon_client_read(WfDaemonClient *client)
+{
+	gchar *line;
+
+	line = wf_daemon_client_take_line(client);
+
+	if (line != NULL)
+	{
+		wf_daemon_client_reply(client, line);
+		g_free(line);
+
+		return;
+	}
+
+	if (client->length >= DAEMON_COMMAND_MAX)
+	{
+		g_debug("Disconnecting control socket client after a command of more than %d bytes", DAEMON_COMMAND_MAX);
+		wf_daemon_client_free(client);
+
+		return;
+	}
+
+	// Never more than fits in the buffer
+	g_input_stream_read_async(client->input, client->buffer + client->length, DAEMON_COMMAND_MAX - client->length,
+	                          G_PRIORITY_DEFAULT, DaemonData.cancellable, wf_daemon_read_cb, client);
+}
+
+// Remove the first complete line from the buffer of @client, or %NULL if there is none yet
+static gchar *
+wf_daemon_client_take_line(WfDaemonClient *client)
+{
+	const gchar *end;
+	gchar *line;
+	gsize taken;
+
+	end = memchr(client->buffer, '\n', client->length);
+
+	if (end == NULL)
+	{
+		return NULL;
+	}
+
+	// A carriage return before the newline is stripped along with the other whitespace
+	line = g_strndup(client->buffer, end - client->buffer);
+
+	taken = end - client->buffer + 1;
+	client->length -= taken;
+	memmove(client->buffer, client->buffer + taken, client->length);
+
+	return line;
+}
+
+// Execute @command and send back the reply
+static void
+wf_daemon_client_reply(WfDaemonClient *client, const gchar *command)
+{
+	GOutputStream *stream;
+	GBytes *bytes;
+	gchar *reply;
+	gchar *line;
+
+	reply = wf_daemon_execute(command);
+
+	// Written as a whole before reading the next command
+	line = g_strconcat(reply, "\n", NULL);
+	bytes = g_bytes_new_take(line, strlen(line));
+	g_free(reply);
+
+	stream = g_io_stream_get_output_stream(G_IO_STREAM(client->connection));
+	g_output_stream_write_bytes_async(stream, bytes, G_PRIORITY_DEFAULT, DaemonData.cancellable, wf_daemon_write_reply_cb, client);
+
+	g_bytes_unref(bytes);
+}
+
+static const gchar *
+wf_daemon_get_status_name(WfPlayerStatus status)
+{
+	switch (status)
+	{
+		case WF_PLAYER_NO_STATUS:
+			return "unknown";
+		case WF_PLAYER_INIT:
+			return "init";
+		case WF_PLAYER_READY:
+			return "ready";
+		case WF_PLAYER_PLAYING:
+			return "playing";
+		case WF_PLAYER_PAUSED:
+			return "paused";
+		case WF_PLAYER_STOPPED:
+			return "stopped";
+	}
+
+	g_warn_if_reached();
+
+	return "unknown";
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+
+static void
+wf_daemon_client_free(WfDaemonClient *client)
+{
+	if (client == NULL)
+	{
+		return;
+	}
+
+	g_io_stream_close(G_IO_STREAM(client->connection), NULL /* cancellable */, NULL /* error */);
+
+	g_object_unref(client->input);
+	g_object_unref(client->connection);
+
+	g_free(client);
+}
+
+void
+wf_daemon_finalize(void)
+{
+	if (DaemonData.sigint_id > 0)
+	{
+		g_source_remove(DaemonData.sigint_id);
+	}
+
+	if (DaemonData.sigterm_id > 0)
+	{
+		g_source_remove(DaemonData.sigterm_id);
+	}
+
+	// Connected clients are freed once their outstanding operation returns
+	if (DaemonData.cancellable != NULL)
+	{
+		g_cancellable_cancel(DaemonData.cancellable);
+		g_object_unref(DaemonData.cancellable);
+	}
+
+	if (DaemonData.service != NULL)
+	{
+		g_socket_service_stop(DaemonData.service);
+		g_socket_listener_close(G_SOCKET_LISTENER(DaemonData.service));
+		g_object_unref(DaemonData.service);
+
+		g_unlink(DaemonData.socket_path);
+	}
+
+	g_free(DaemonData.socket_path);
+
+	DaemonData = (WfDaemonDetails) { 0 };
+}
+
+/* DESTRUCTORS END */
+
+/* END OF FILE */
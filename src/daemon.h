@@ -0,0 +1,79 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * daemon.h  This file is part of LibWoofer
+ * Copyright (C) 2023  Quico Augustijn
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this library.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+#ifndef __WF_DAEMON__
+#define __WF_DAEMON__
+
+/* INCLUDES BEGIN */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <woofer/constants.h>
+
+/* INCLUDES END */
+
+G_BEGIN_DECLS
+
+/* DEFINES BEGIN */
+
+// Name of the control socket in the user runtime directory
+#define WF_DAEMON_SOCKET_NAME WF_TAG ".sock"
+
+/* DEFINES END */
+
+/* MODULE TYPES BEGIN */
+/* MODULE TYPES END */
+
+/* CONSTRUCTOR PROTOTYPES BEGIN */
+
+gboolean wf_daemon_init(const gchar *socket_path, GError **error);
+
+/* CONSTRUCTOR PROTOTYPES END */
+
+/* GETTER/SETTER PROTOTYPES BEGIN */
+
+gchar * wf_daemon_get_default_socket(void);
+gboolean wf_daemon_is_active(void);
+
+/* GETTER/SETTER PROTOTYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+gchar * wf_daemon_execute(const gchar *command);
+gchar * wf_daemon_send(const gchar *socket_path, const gchar *command, GError **error);
+
+/* FUNCTION PROTOTYPES END */
+
+/* UTILITY PROTOTYPES BEGIN */
+/* UTILITY PROTOTYPES END */
+
+/* DESTRUCTOR PROTOTYPES BEGIN */
+
+void wf_daemon_finalize(void);
+
+/* DESTRUCTOR PROTOTYPES END */
+
+G_END_DECLS
+
+#endif /* __WF_DAEMON__ */
+
+/* END OF FILE */
@@ -60,17 +60,58 @@
 /* DESCRIPTION END */
 
 /* DEFINES BEGIN */
+
+// Attributes the scanner needs of every file, so nothing has to be queried later
+#define SCAN_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+                        G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+                        G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
+                        G_FILE_ATTRIBUTE_ID_FILE
+
+// Amount of directories that are enumerated at the same time
+#define SCAN_PARALLEL_DIRECTORIES 8
+
+// Amount of files to request from an enumerator at once
+#define SCAN_BATCH_SIZE 100
+
 /* DEFINES END */
 
 /* CUSTOM TYPES BEGIN */
+
+typedef struct _WfFileScanner WfFileScanner;
+
+// State of a single wf_file_inspector_scan_async() call
+struct _WfFileScanner
+{
+	GCancellable *cancellable;
+	gboolean skip_dotfiles;
+
+	GQueue pending; // Directories (#GFile) waiting to be enumerated
+	guint active; // Operations in progress
+	GHashTable *visited; // File IDs of the directories seen, to break symlink loops
+
+	guint found;
+
+	WfFuncFileFound found_func;
+	WfFuncScanFinished finished_func;
+	gpointer user_data;
+};
+
 /* CUSTOM TYPES END */
 
 /* FUNCTION PROTOTYPES BEGIN */
 
 static gint wf_file_inspector_compare_alphabetic_cb(gconstpointer a, gconstpointer b);
 
+static void wf_file_inspector_scan_root_cb(GObject *source, GAsyncResult *result, gpointer user_data);
+static void wf_file_inspector_scan_enumerate_cb(GObject *source, GAsyncResult *result, gpointer user_data);
+static void wf_file_inspector_scan_next_files_cb(GObject *source, GAsyncResult *result, gpointer user_data);
+
 static const gchar * wf_file_inspector_mime_get(GFileInfo *file_info);
 
+static void wf_file_inspector_scan_add(WfFileScanner *scanner, GFile *file, GFileInfo *info);
+static void wf_file_inspector_scan_continue(WfFileScanner *scanner);
+static void wf_file_inspector_scan_free(WfFileScanner *scanner);
+
 static gboolean wf_file_inspector_mime_is_audio(const gchar *mime_type);
 static gboolean wf_file_inspector_mime_is_media(const gchar *mime_type);
 
@@ -111,6 +152,117 @@ wf_file_inspector_compare_alphabetic_cb(gconstpointer a, gconstpointer b)
 	return result;
 }
 
+static void
+wf_file_inspector_scan_root_cb(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	WfFileScanner *scanner = user_data;
+	GFile *file = G_FILE(source);
+	GFileInfo *info;
+	GError *err = NULL;
+
+	scanner->active--;
+
+	info = g_file_query_info_finish(file, result, &err);
+
+	if (info == NULL)
+	{
+		if (!g_error_matches(err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		{
+			g_warning("Failed to get file info: %s", err->message);
+		}
+
+		g_error_free(err);
+	}
+	else
+	{
+		wf_file_inspector_scan_add(scanner, file, info);
+		g_object_unref(info);
+	}
+
+	wf_file_inspector_scan_continue(scanner);
+}
+
+static void
+wf_file_inspector_scan_enumerate_cb(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	WfFileScanner *scanner = user_data;
+	GFileEnumerator *enumerator;
+	GError *err = NULL;
+	gchar *uri;
+
+	enumerator = g_file_enumerate_children_finish(G_FILE(source), result, &err);
+
+	if (enumerator == NULL)
+	{
+		if (!g_error_matches(err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		{
+			uri = g_file_get_uri(G_FILE(source));
+			g_warning("Could not open directory %s: %s", uri, err->message);
+			g_free(uri);
+		}
+
+		g_error_free(err);
+
+		scanner->active--;
+		wf_file_inspector_scan_continue(scanner);
+
+		return;
+	}
+
+	// Request the first batch; the enumerator stays active until it is drained
+	g_file_enumerator_next_files_async(enumerator, SCAN_BATCH_SIZE, G_PRIORITY_LOW, scanner->cancellable, wf_file_inspector_scan_next_files_cb, scanner);
+}
+
+static void
+wf_file_inspector_scan_next_files_cb(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	WfFileScanner *scanner = user_data;
+	GFileEnumerator *enumerator = G_FILE_ENUMERATOR(source);
+	GFileInfo *info;
+	GFile *child;
+	GList *files, *l;
+	GError *err = NULL;
+
+	files = g_file_enumerator_next_files_finish(enumerator, result, &err);
+
+	if (err != NULL)
+	{
+		if (!g_error_matches(err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		{
+			g_warning("Could not read directory: %s", err->message);
+		}
+
+		g_error_free(err);
+	}
+
+	for (l = files; l != NULL; l = l->next)
+	{
+		info = l->data;
+		child = g_file_enumerator_get_child(enumerator, info);
+
+		wf_file_inspector_scan_add(scanner, child, info);
+
+		g_object_unref(child);
+	}
+
+	if (files != NULL && !g_cancellable_is_cancelled(scanner->cancellable))
+	{
+		// Get the next batch of this directory
+		g_list_free_full(files, g_object_unref);
+		g_file_enumerator_next_files_async(enumerator, SCAN_BATCH_SIZE, G_PRIORITY_LOW, scanner->cancellable, wf_file_inspector_scan_next_files_cb, scanner);
+
+		return;
+	}
+
+	// This directory is done
+	g_list_free_full(files, g_object_unref);
+	g_file_enumerator_close_async(enumerator, G_PRIORITY_LOW, NULL /* cancellable */, NULL /* callback */, NULL /* user_data */);
+	g_object_unref(enumerator);
+
+	scanner->active--;
+	wf_file_inspector_scan_continue(scanner);
+}
+
 /* CALLBACK FUNCTIONS END */
 
 /* MODULE FUNCTIONS BEGIN */
@@ -127,10 +279,8 @@ WfFileInspectorType
 wf_file_inspector_get_file_type(GFile *file, const gchar **mime_rv)
 {
 	const gchar *attributes = G_FILE_ATTRIBUTE_STANDARD_TYPE "," G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE;
-	const gchar *mime_info;
 	WfFileInspectorType type_info;
 	GFileInfo *info;
-	GFileType type;
 	GError *err = NULL;
 
 	g_return_val_if_fail(G_IS_FILE(file), WF_FILE_INSPECTOR_TYPE_ERROR);
@@ -150,10 +300,34 @@ wf_file_inspector_get_file_type(GFile *file, const gchar **mime_rv)
 
 		return WF_FILE_INSPECTOR_TYPE_ERROR;
 	}
-	else
-	{
-		type = g_file_info_get_file_type(info);
-	}
+
+	type_info = wf_file_inspector_get_info_type(info, mime_rv);
+
+	g_object_unref(info);
+
+	return type_info;
+}
+
+/*
+ * wf_file_inspector_get_info_type:
+ * @info: file info with at least the standard type and content type
+ * @mime_rv: (out) (optional): return location for the mime type, owned by @info
+ *
+ * Same as wf_file_inspector_get_file_type(), but for file info that is already
+ * available, like the info from a directory enumeration.
+ *
+ * Returns: the type of the file
+ */
+WfFileInspectorType
+wf_file_inspector_get_info_type(GFileInfo *info, const gchar **mime_rv)
+{
+	const gchar *mime_info;
+	WfFileInspectorType type_info;
+	GFileType type;
+
+	g_return_val_if_fail(G_IS_FILE_INFO(info), WF_FILE_INSPECTOR_TYPE_ERROR);
+
+	type = g_file_info_get_file_type(info);
 
 	if (type == G_FILE_TYPE_REGULAR)
 	{
@@ -191,8 +365,6 @@ wf_file_inspector_get_file_type(GFile *file, const gchar **mime_rv)
 		type_info = WF_FILE_INSPECTOR_TYPE_UNKNOWN;
 	}
 
-	g_object_unref(info);
-
 	return type_info;
 }
 
@@ -228,12 +400,13 @@ wf_file_inspector_get_directory_files(GFile *file)
 			file_path = g_build_filename(dir_path, name, NULL /* terminator */);
 
 			child = g_file_new_for_path(file_path);
-			list = g_slist_append(list, child);
+			list = g_slist_prepend(list, child);
 
 			g_free(file_path);
 		}
 	} while (name != NULL);
 
+	// Prepended for speed, the order is determined by sorting anyway
 	list = g_slist_sort(list, wf_file_inspector_compare_alphabetic_cb);
 
 	g_dir_close(dir);
@@ -242,6 +415,135 @@ wf_file_inspector_get_directory_files(GFile *file)
 	return list;
 }
 
+/*
+ * wf_file_inspector_scan_async:
+ * @root: the file or directory to scan
+ * @skip_dotfiles: whether to leave out files and directories starting with a dot
+ * @cancellable: (nullable): optional #GCancellable to stop the scan
+ * @found_func: called for every file and directory that is found
+ * @finished_func: (nullable): called when the scan is done
+ * @user_data: data to pass to @found_func and @finished_func
+ *
+ * Recursively scan @root without blocking.  Directories are enumerated with
+ * the GIO asynchronous API, several of them at the same time, and their
+ * children are requested in batches together with all attributes that are
+ * needed to determine their type.  Every file and directory is reported to
+ * @found_func on the thread-default main context of the caller as soon as its
+ * batch comes in, directories just before they are scanned themselves.  Files
+ * are reported in the order they are found, which is not necessarily
+ * alphabetical.  The amount passed to @finished_func only counts files.
+ */
+void
+wf_file_inspector_scan_async(GFile *root,
+                             gboolean skip_dotfiles,
+                             GCancellable *cancellable,
+                             WfFuncFileFound found_func,
+                             WfFuncScanFinished finished_func,
+                             gpointer user_data)
+{
+	WfFileScanner *scanner;
+
+	g_return_if_fail(G_IS_FILE(root));
+	g_return_if_fail(found_func != NULL);
+
+	scanner = g_slice_new0(WfFileScanner);
+	scanner->cancellable = (cancellable != NULL) ? g_object_ref(cancellable) : g_cancellable_new();
+	scanner->skip_dotfiles = skip_dotfiles;
+	scanner->visited = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	scanner->found_func = found_func;
+	scanner->finished_func = finished_func;
+	scanner->user_data = user_data;
+	g_queue_init(&scanner->pending);
+
+	// Find out what the root is first; it may be a single file as well
+	scanner->active++;
+	g_file_query_info_async(root, SCAN_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, G_PRIORITY_LOW, scanner->cancellable, wf_file_inspector_scan_root_cb, scanner);
+}
+
+// Handle a single file or directory found by the scanner
+static void
+wf_file_inspector_scan_add(WfFileScanner *scanner, GFile *file, GFileInfo *info)
+{
+	const gchar *name;
+	const gchar *mime = NULL;
+	const gchar *id;
+	WfFileInspectorType type;
+
+	if (g_cancellable_is_cancelled(scanner->cancellable))
+	{
+		return;
+	}
+
+	name = g_file_info_get_name(info);
+
+	if (scanner->skip_dotfiles && name != NULL && name[0] == '.')
+	{
+		g_info("File %s is a dotfile, not adding", name);
+
+		return;
+	}
+
+	type = wf_file_inspector_get_info_type(info, &mime);
+
+	if (type == WF_FILE_INSPECTOR_TYPE_DIRECTORY)
+	{
+		id = g_file_info_get_attribute_string(info, G_FILE_ATTRIBUTE_ID_FILE);
+
+		if (id != NULL)
+		{
+			if (g_hash_table_contains(scanner->visited, id))
+			{
+				// Already scanned, probably through a symbolic link
+				return;
+			}
+
+			g_hash_table_add(scanner->visited, g_strdup(id));
+		}
+
+		g_queue_push_tail(&scanner->pending, g_object_ref(file));
+
+		scanner->found_func(file, type, NULL /* mime */, scanner->user_data);
+	}
+	else if (type != WF_FILE_INSPECTOR_TYPE_UNKNOWN && type != WF_FILE_INSPECTOR_TYPE_ERROR)
+	{
+		scanner->found++;
+		scanner->found_func(file, type, mime, scanner->user_data);
+	}
+}
+
+// Start enumerating pending directories, or finish if all is done
+static void
+wf_file_inspector_scan_continue(WfFileScanner *scanner)
+{
+	GFile *directory;
+	gboolean cancelled;
+
+	cancelled = g_cancellable_is_cancelled(scanner->cancellable);
+
+	while (!cancelled && scanner->active < SCAN_PARALLEL_DIRECTORIES && !g_queue_is_empty(&scanner->pending))
+	{
+		directory = g_queue_pop_head(&scanner->pending);
+
+		scanner->active++;
+		g_file_enumerate_children_async(directory, SCAN_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, G_PRIORITY_LOW, scanner->cancellable, wf_file_inspector_scan_enumerate_cb, scanner);
+
+		g_object_unref(directory);
+	}
+
+	if (scanner->active > 0)
+	{
+		// Still waiting for operations to finish
+		return;
+	}
+
+	if (scanner->finished_func != NULL)
+	{
+		scanner->finished_func(scanner->found, cancelled, scanner->user_data);
+	}
+
+	wf_file_inspector_scan_free(scanner);
+}
+
 /* MODULE FUNCTIONS END */
 
 /* MODULE UTILITIES BEGIN */
@@ -271,6 +573,17 @@ wf_file_inspector_mime_is_media(const gchar *mime_type)
 /* MODULE UTILITIES END */
 
 /* DESTRUCTORS BEGIN */
+
+static void
+wf_file_inspector_scan_free(WfFileScanner *scanner)
+{
+	g_queue_clear_full(&scanner->pending, g_object_unref);
+	g_hash_table_unref(scanner->visited);
+	g_object_unref(scanner->cancellable);
+
+	g_slice_free(WfFileScanner, scanner);
+}
+
 /* DESTRUCTORS END */
 
 /* END OF FILE */
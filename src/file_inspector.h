@@ -49,6 +49,9 @@ enum _WfFileInspectorType
 	WF_FILE_INSPECTOR_TYPE_MIME_IRRELEVANT
 };
 
+typedef void (*WfFuncFileFound) (GFile *file, WfFileInspectorType type, const gchar *mime, gpointer user_data);
+typedef void (*WfFuncScanFinished) (guint found, gboolean cancelled, gpointer user_data);
+
 /* MODULE TYPES END */
 
 /* CONSTRUCTOR PROTOTYPES BEGIN */
@@ -60,9 +63,17 @@ enum _WfFileInspectorType
 /* FUNCTION PROTOTYPES BEGIN */
 
 WfFileInspectorType wf_file_inspector_get_file_type(GFile *file, const gchar **mime_rv);
+WfFileInspectorType wf_file_inspector_get_info_type(GFileInfo *info, const gchar **mime_rv);
 
 GSList * wf_file_inspector_get_directory_files(GFile *file);
 
+void wf_file_inspector_scan_async(GFile *root,
+                                  gboolean skip_dotfiles,
+                                  GCancellable *cancellable,
+                                  WfFuncFileFound found_func,
+                                  WfFuncScanFinished finished_func,
+                                  gpointer user_data);
+
 /* FUNCTION PROTOTYPES END */
 
 /* UTILITY PROTOTYPES BEGIN */
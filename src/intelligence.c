@@ -23,6 +23,7 @@
 
 // Library includes
 #include <math.h>
+#include <string.h>
 #include <glib.h>
 
 // Global includes
@@ -36,7 +37,8 @@
 #include <woofer/song.h>
 #include <woofer/statistics.h>
 #include <woofer/utils.h>
-#include <woofer/dlist.h>
+#include <woofer/sampler.h>
+#include <woofer/metrics.h>
 
 // Resource includes
 /*< none >*/
@@ -74,6 +76,22 @@
 #define MIN_SONG_ENTRIES 0
 #define MAX_SONG_ENTRIES 100
 
+/*
+ * The candidate pool is rebuilt entirely after this many seconds, so filters
+ * and entries that depend on the current time (last played) do not drift.
+ */
+#define POOL_REFRESH_INTERVAL (10 * 60)
+
+// Seconds a song plays in a simulation if its duration is not known
+#define SIMULATION_SONG_DURATION (3 * 60)
+
+/*
+ * From this amount of songs on, filters and entries are calculated by worker
+ * threads, each taking a chunk of the songs.  Below it, starting the threads
+ * takes longer than the calculation itself.
+ */
+#define PARALLEL_THRESHOLD (64 * 1024)
+
 // Define a separate log domain so logging can easily be disabled
 #undef G_LOG_DOMAIN
 #define G_LOG_DOMAIN WF_TAG "-intelligence"
@@ -87,7 +105,7 @@ typedef struct _WfIntelligenceContainer WfIntelligenceContainer;
 // Container used for functions part of the song picker.
 struct _WfIntelligenceContainer
 {
-	gint total_entries;
+	guint64 total_entries;
 
 	gint default_rating;
 
@@ -107,20 +125,183 @@ struct _WfIntelligenceContainer
 	gint lastplayed_factor;
 };
 
+typedef struct _WfIntelligenceColumns WfIntelligenceColumns;
+typedef struct _WfIntelligenceRandom WfIntelligenceRandom;
+typedef struct _WfIntelligenceCandidate WfIntelligenceCandidate;
+typedef struct _WfIntelligencePool WfIntelligencePool;
+
+/*
+ * Structure of arrays with the statistics that entries are calculated from,
+ * one element per song.  Values are stored the way the modifiers of the
+ * container use them (ratings and scores are already inverted if requested)
+ * and -1 means invalid or not used.  Keeping the values next to each other
+ * instead of behind the song objects lets the entries of many songs be
+ * calculated with tight loops over plain arrays.
+ */
+struct _WfIntelligenceColumns
+{
+	guint size;
+	guint capacity;
+
+	gint *rating;
+	gdouble *score;
+	gint *playcount;
+	gint *skipcount;
+	gint64 *lastplayed;
+
+	// Result of wf_intelligence_calculate_entries_batch()
+	gint *entries;
+};
+
+/*
+ * State of the xoshiro256** generator used to draw winners.  It is cheap to
+ * use and can be seeded, so picks can be reproduced.
+ */
+struct _WfIntelligenceRandom
+{
+	gboolean seeded;
+	guint64 state[4];
+};
+
+// State of a single library song as known by the candidate pool.
+struct _WfIntelligenceCandidate
+{
+	WfSong *song;
+
+	guint index; // Slot in the sampler
+	gboolean eligible; // Whether the song passes the statistics filter
+	guint64 weight; // Entries, 0 if not eligible or disqualified
+
+	// Copies of the values used for the lookup structures below
+	guint32 artist;
+	gint64 last_played;
+	GSequenceIter *played;
+};
+
+/*
+ * Persistent song picker state.  It keeps the statistics-filtered candidates
+ * and their entries up-to-date as songs change, so choosing a song only has to
+ * deal with the (small) set of songs that are excluded for this specific pick,
+ * instead of filtering and weighing the whole library again.
+ */
+struct _WfIntelligencePool
+{
+	gboolean valid;
+	gint64 built;
+
+	guint settings_version; // Version of the settings snapshot used
+	WfSongFilter filter;
+	WfIntelligenceContainer container;
+	WfIntelligenceColumns columns; // Indexed like the sampler
+
+	WfSampler *sampler;
+	GHashTable *candidates; // WfSong -> WfIntelligenceCandidate
+	GHashTable *artists; // Artist hash -> GList of eligible candidates
+	GSequence *played; // Eligible played candidates, most recently played first
+	gint eligible;
+};
+
+typedef struct _WfIntelligenceScratch WfIntelligenceScratch;
+
+/*
+ * Buffers used to calculate the entries when picking without the pool.  They
+ * are kept between picks and only grow, so picking does not allocate anything
+ * once they are large enough.
+ */
+struct _WfIntelligenceScratch
+{
+	WfIntelligenceColumns columns;
+	WfSong **keys;
+	guint keys_capacity;
+	WfSampler *sampler;
+};
+
+typedef struct _WfIntelligenceModifiers WfIntelligenceModifiers;
+typedef struct _WfIntelligenceWorkers WfIntelligenceWorkers;
+typedef struct _WfIntelligenceChunk WfIntelligenceChunk;
+typedef void (*WfFuncChunk)(WfIntelligenceChunk *chunk);
+
+/*
+ * Modifiers determined from a settings snapshot.  Unlike the pool, these only
+ * have to be determined again when the settings change.
+ */
+struct _WfIntelligenceModifiers
+{
+	guint settings_version;
+	WfIntelligenceContainer container;
+};
+
+// Threads shared by all parallel calculations, created on first use
+struct _WfIntelligenceWorkers
+{
+	GThreadPool *pool;
+	guint threads;
+	gboolean failed;
+
+	// Amount of chunks of the current calculation that are not done yet
+	GMutex mutex;
+	GCond cond;
+	guint pending;
+};
+
+// Part of a calculation that is done by a single worker
+struct _WfIntelligenceChunk
+{
+	WfFuncChunk func;
+	guint first;
+	guint count;
+	gint64 time;
+
+	// Entries: the modifiers and the columns to calculate the entries in
+	const WfIntelligenceContainer *container;
+	WfIntelligenceColumns *columns;
+
+	// Statistics filter: the songs to check and where to store the results
+	const WfSongFilter *filter;
+	WfSong **songs;
+	gboolean *passes;
+};
+
 /* CUSTOM TYPES END */
 
 /* FUNCTION PROTOTYPES BEGIN */
 
 static GList * wf_intelligence_remove_invalid_songs(GList *library);
 static GList * wf_intelligence_filter_by_stats(GList *library, WfSongFilter *filter);
+static gboolean wf_intelligence_filter_by_stats_parallel(GList **library, const WfSongFilter *filter, gint64 time);
+static gboolean wf_intelligence_song_passes_stats_filter(WfSong *song, WfSongFilter *filter, gint64 time);
 static GList * wf_intelligence_remove_songs_with_artists(GList *library, GList *artists, gint amount);
 static GList * wf_intelligence_remove_recents(GList *library, GList *list_prev, GList *list_next, gint amount);
-static gboolean wf_intelligence_determine_modifiers(WfIntelligenceContainer *container, WfSongEntries *preferences);
-static WfDList * wf_intelligence_calculate_song_entries(WfIntelligenceContainer *container, GList *songs);
-static WfSong * wf_intelligence_pick_winner(WfIntelligenceContainer *container, WfDList *list);
-
-static guint wf_intelligence_random(gint lower, gint upper);
+static gboolean wf_intelligence_determine_modifiers(WfIntelligenceContainer *container, const WfSongEntries *preferences);
+static WfSampler * wf_intelligence_calculate_song_entries(WfIntelligenceContainer *container, GList *songs);
+static void wf_intelligence_calculate_entries_batch(const WfIntelligenceContainer *container, WfIntelligenceColumns *columns, guint first, guint count, gint64 current_time);
+static WfSong * wf_intelligence_pick_winner(WfIntelligenceContainer *container, WfSampler *sampler);
+
+static void wf_intelligence_calculate_entries(const WfIntelligenceContainer *container, WfIntelligenceColumns *columns, guint first, guint count, gint64 current_time);
+static void wf_intelligence_calculate_entries_chunk(WfIntelligenceChunk *chunk);
+static void wf_intelligence_filter_chunk(WfIntelligenceChunk *chunk);
+static gboolean wf_intelligence_run_parallel(const WfIntelligenceChunk *chunk, guint count);
+static void wf_intelligence_worker_cb(gpointer data, gpointer user_data);
+
+static gboolean wf_intelligence_pool_ensure(const WfSettingsSnapshot *settings);
+static void wf_intelligence_pool_rebuild(const WfSettingsSnapshot *settings);
+static void wf_intelligence_pool_insert(WfSong *song, gint64 time, gboolean calculate);
+static WfIntelligenceCandidate * wf_intelligence_pool_get_candidate(WfSong *song);
+static void wf_intelligence_pool_refresh_candidate(WfIntelligenceCandidate *candidate, gboolean eligible, gint64 time, gboolean calculate);
+static void wf_intelligence_pool_filter(WfIntelligenceCandidate **candidates, guint count, gint64 time, gboolean *passes);
+static guint64 wf_intelligence_pool_get_weight(const WfIntelligenceCandidate *candidate);
+static void wf_intelligence_pool_detach_candidate(WfIntelligenceCandidate *candidate);
+static gboolean wf_intelligence_pool_exclude(GHashTable *excluded, WfSong *song);
+static void wf_intelligence_pool_exclude_artist(GHashTable *excluded, guint32 artist);
+static void wf_intelligence_pool_restore(GHashTable *excluded);
+static WfSong * wf_intelligence_pool_draw(GHashTable *excluded);
+
+static void wf_intelligence_random_seed(WfIntelligenceRandom *random, guint64 seed);
+static guint64 wf_intelligence_random(WfIntelligenceRandom *random, guint64 lower, guint64 upper);
+static guint64 wf_intelligence_random_next(WfIntelligenceRandom *random);
+static guint64 wf_intelligence_splitmix64(guint64 *x);
 static gint wf_intelligence_get_percentage_of_list(GList *list, gdouble percentage);
+static gint wf_intelligence_get_percentage_of_count(gint total, gdouble percentage);
 
 static gboolean wf_intelligence_use_rating_filter(gboolean use, gint rating_min, gint rating_max);
 static gboolean wf_intelligence_use_score_filter(gboolean use, gdouble score_min, gdouble score_max);
@@ -128,7 +309,13 @@ static gboolean wf_intelligence_use_playcount_filter(gboolean use, gint playcoun
 static gboolean wf_intelligence_use_skipcount_filter(gboolean use, gint skipcount_th);
 static gboolean wf_intelligence_use_lastplayed_filter(gboolean use, gint64 lastplayed_th);
 
+static void wf_intelligence_columns_init(WfIntelligenceColumns *columns, guint capacity);
+static void wf_intelligence_columns_reserve(WfIntelligenceColumns *columns, guint size);
+static void wf_intelligence_columns_store(WfIntelligenceColumns *columns, guint index, const WfIntelligenceContainer *container, WfSong *song);
+static void wf_intelligence_columns_clear(WfIntelligenceColumns *columns);
+
 static gint wf_intelligence_sort_compare(gconstpointer a, gconstpointer b);
+static gint wf_intelligence_played_compare(gconstpointer a, gconstpointer b, gpointer user_data);
 
 static gint wf_intelligence_calculate_entries_with_fraction(const gint x, const gint a, const gint r, const gboolean invert);
 static gint wf_intelligence_calculate_entries_with_sqrt(const gint x, const gint a, const gint r, const gboolean invert);
@@ -141,15 +328,59 @@ static gint wf_intelligence_get_entries_time_since_inverted(gint64 time_since);
 /* FUNCTION PROTOTYPES END */
 
 /* GLOBAL VARIABLES BEGIN */
+
+static WfIntelligenceRandom RandomData = { 0 };
+static WfIntelligencePool PoolData = { 0 };
+static WfIntelligenceModifiers ModifiersData = { 0 };
+static WfIntelligenceScratch ScratchData = { 0 };
+static WfIntelligenceWorkers WorkersData = { 0 };
+
 /* GLOBAL VARIABLES END */
 
 /* CONSTRUCTORS BEGIN */
 /* CONSTRUCTORS END */
 
 /* GETTERS/SETTERS BEGIN */
+
+/**
+ * wf_intelligence_set_seed:
+ * @seed: the seed to use
+ *
+ * Seeds the random number generator of the song picker.  With the same seed,
+ * library and settings, the same songs will be chosen, which makes simulations
+ * and benchmarks reproducible.  If this is never called, a random seed is used.
+ *
+ * Since: 0.3
+ **/
+void
+wf_intelligence_set_seed(guint64 seed)
+{
+	wf_intelligence_random_seed(&RandomData, seed);
+}
+
 /* GETTERS/SETTERS END */
 
 /* CALLBACK FUNCTIONS BEGIN */
+
+// Run a chunk of a parallel calculation in a worker thread
+static void
+wf_intelligence_worker_cb(gpointer data, gpointer user_data)
+{
+	WfIntelligenceChunk *chunk = data;
+	WfIntelligenceWorkers *workers = user_data;
+
+	chunk->func(chunk);
+
+	g_mutex_lock(&workers->mutex);
+
+	if (--workers->pending == 0)
+	{
+		g_cond_signal(&workers->cond);
+	}
+
+	g_mutex_unlock(&workers->mutex);
+}
+
 /* CALLBACK FUNCTIONS END */
 
 /* MODULE FUNCTIONS BEGIN */
@@ -227,7 +458,7 @@ wf_intelligence_filter(GList *available_songs,
 	remove_recent += filter->remove_recents_amount;
 	filtered_songs = wf_intelligence_remove_recents(filtered_songs, previous_songs, play_next, remove_recent);
 
-	if (g_list_length(filtered_songs) == 0)
+	if (filtered_songs == NULL)
 	{
 		g_info("All songs are filtered out");
 
@@ -250,11 +481,8 @@ wf_intelligence_remove_invalid_songs(GList *library)
 		return NULL;
 	}
 
-	// Set list node pointer to use
-	list = library;
-
 	// Go through the whole library
-	while (list != NULL)
+	for (list = library; list != NULL; list = next)
 	{
 		next = list->next;
 		song = list->data;
@@ -270,10 +498,8 @@ wf_intelligence_remove_invalid_songs(GList *library)
 		if (status != WF_SONG_AVAILABLE)
 		{
 			g_debug("Filtered out %s because it is not available", wf_song_get_name_not_empty(song));
-			library = g_list_remove(library, song);
+			library = g_list_delete_link(library, list);
 		}
-
-		list = next;
 	}
 
 	return library;
@@ -282,12 +508,112 @@ wf_intelligence_remove_invalid_songs(GList *library)
 static GList *
 wf_intelligence_filter_by_stats(GList *library, WfSongFilter *filter)
 {
-	const gchar *name;
-	WfSong *song;
 	GList *item;
 	GList *next;
-	gboolean filtered;
 	gint64 time;
+
+	g_return_val_if_fail(filter != NULL, library);
+
+	if (library == NULL)
+	{
+		// Nothing to filter
+		return NULL;
+	}
+
+	item = library;
+
+	// Set the time here, so all songs have the same probability to be filtered by last_played
+	time = wf_utils_time_now();
+
+	if (wf_intelligence_filter_by_stats_parallel(&library, filter, time))
+	{
+		return library;
+	}
+
+	while (item != NULL)
+	{
+		next = item->next;
+
+		if (item->data != NULL && !wf_intelligence_song_passes_stats_filter(item->data, filter, time))
+		{
+			// Remove list node respective library node and only free the node
+			library = g_list_remove_link(library, item);
+			g_list_free(item);
+		}
+
+		// Set next item
+		item = next;
+	}
+
+	return library;
+}
+
+/*
+ * Same as wf_intelligence_filter_by_stats(), but with the songs checked by
+ * worker threads.  Only unlinking the nodes is left to the calling thread.
+ *
+ * Returns: %FALSE if the list is too short or no workers are available, in
+ * which case @library is left alone
+ */
+static gboolean
+wf_intelligence_filter_by_stats_parallel(GList **library, const WfSongFilter *filter, gint64 time)
+{
+	WfIntelligenceChunk chunk = { 0 };
+	GList *item;
+	GList *next;
+	guint count, x;
+	gboolean done;
+
+	count = g_list_length(*library);
+
+	if (count < PARALLEL_THRESHOLD)
+	{
+		return FALSE;
+	}
+
+	chunk.func = wf_intelligence_filter_chunk;
+	chunk.time = time;
+	chunk.filter = filter;
+	chunk.songs = g_new(WfSong *, count);
+	chunk.passes = g_new(gboolean, count);
+
+	for (item = *library, x = 0; item != NULL; item = item->next, x++)
+	{
+		chunk.songs[x] = item->data;
+	}
+
+	done = wf_intelligence_run_parallel(&chunk, count);
+
+	if (done)
+	{
+		for (item = *library, x = 0; item != NULL; item = next, x++)
+		{
+			next = item->next;
+
+			if (!chunk.passes[x])
+			{
+				*library = g_list_remove_link(*library, item);
+				g_list_free(item);
+			}
+		}
+	}
+
+	g_free(chunk.songs);
+	g_free(chunk.passes);
+
+	return done;
+}
+
+/*
+ * Check a single song against the statistics part of @filter, with @time as
+ * the moment to compare last played values against.
+ *
+ * Returns: %TRUE if the song may stay, %FALSE if it gets filtered out
+ */
+static gboolean
+wf_intelligence_song_passes_stats_filter(WfSong *song, WfSongFilter *filter, gint64 time)
+{
+	const gchar *name;
 	gint64 time_since_last_played;
 
 	gboolean rating_on;
@@ -312,13 +638,8 @@ wf_intelligence_filter_by_stats(GList *library, WfSongFilter *filter)
 	gint64 lastplayed_v;
 	gint64 lastplayed_th;
 
-	g_return_val_if_fail(filter != NULL, library);
-
-	if (library == NULL)
-	{
-		// Nothing to filter
-		return NULL;
-	}
+	g_return_val_if_fail(filter != NULL, TRUE);
+	g_return_val_if_fail(song != NULL, FALSE);
 
 	// Get stat ranges
 	rating_min = filter->rating_min;
@@ -329,7 +650,6 @@ wf_intelligence_filter_by_stats(GList *library, WfSongFilter *filter)
 	playcount_th = filter->playcount_th;
 	playcount_invert = filter->playcount_invert;
 	skipcount_th = filter->skipcount_th;
-	skipcount_th = filter->skipcount_th;
 	skipcount_invert = filter->skipcount_invert;
 	lastplayed_th = filter->lastplayed_th;
 	lastplayed_invert = filter->lastplayed_invert;
@@ -341,156 +661,125 @@ wf_intelligence_filter_by_stats(GList *library, WfSongFilter *filter)
 	skipcount_on = wf_intelligence_use_skipcount_filter(filter->use_skipcount, skipcount_th);
 	lastplayed_on = wf_intelligence_use_lastplayed_filter(filter->use_lastplayed, lastplayed_th);
 
-	item = library;
+	// Set name pointer so it can be easily used in debug messages
+	name = wf_song_get_name_not_empty(song);
 
-	// Set the time here, so all songs have the same probability to be filtered by last_played
-	time = wf_utils_time_now();
+	/*
+	 * Filtering @song starts here
+	 *
+	 * First get the value and check if it is valid
+	 * Then, take parameters as "invert" or "include zero" into account
+	 * After that, determine if the value is within the specified
+	 * range value.
+	 * If that is not the case, the song is filtered out and the other
+	 * values do not need to be checked anymore.
+	 */
 
-	while (item != NULL)
+	// Check rating
+	if (rating_on)
 	{
-		next = item->next;
-		song = item->data;
-		filtered = FALSE;
+		rating_v = wf_song_get_rating(song);
 
-		if (song == NULL)
+		if (!wf_stats_rating_is_valid(rating_v) ||
+		    (!(rating_inc_zero && rating_v == 0) &&
+		     (rating_v < rating_min || rating_v > rating_max)))
 		{
-			item = next;
-			continue;
-		}
+			g_debug("Song %s filtered out by rating %d", name, rating_v);
 
-		// Set name pointer so it can be easily used in debug messages
-		name = wf_song_get_name_not_empty(song);
+			return FALSE;
+		}
+	}
 
-		/*
-		 * Filtering @item starts here
-		 *
-		 * First get the value and check if it is valid
-		 * Then, take parameters as "invert" or "include zero" into account
-		 * After that, determine if the value is within the specified
-		 * range value.
-		 * If that is not the case, remove the list node of that song from
-		 * the filtered list.
-		 * If filtered, do not check the other values but carry on
-		 * the next song (to run more efficiently and prevent any more
-		 * removements).  Only remove the node from the list and free
-		 * it at the end, just in case it gets accessed anywhere.
-		 */
+	// Check score
+	if (score_on)
+	{
+		score_v = wf_song_get_score(song);
 
-		// Check rating
-		if (rating_on && !filtered)
+		if (!wf_stats_score_is_valid(score_v) ||
+		    (score_v < score_min || score_v > score_max))
 		{
-			rating_v = wf_song_get_rating(song);
+			g_debug("Song %s filtered out by score %f", name, (float) score_v);
 
-			if (!wf_stats_rating_is_valid(rating_v) ||
-			    (!(rating_inc_zero && rating_v == 0) &&
-			     (rating_v < rating_min || rating_v > rating_max)))
-			{
-				// Remove list node respective library node
-				library = g_list_remove_link(library, item);
-				g_debug("Song %s filtered out by rating %d", name, rating_v);
-				filtered = TRUE;
-			}
+			return FALSE;
 		}
+	}
 
-		// Check score
-		if (score_on && !filtered)
-		{
-			score_v = wf_song_get_score(song);
-
-			if (!wf_stats_score_is_valid(score_v) ||
-			    (score_v < score_min || score_v > score_max))
-			{
-				// Remove list node respective library node
-				library = g_list_remove_link(library, item);
-				g_debug("Song %s filtered out by score %f", name, (float) score_v);
-				filtered = TRUE;
-			}
-		}
+	// Check play count
+	if (playcount_on)
+	{
+		playcount_v = wf_song_get_play_count(song);
 
-		// Check play count
-		if (playcount_on && !filtered)
+		if (!wf_stats_playcount_is_valid(playcount_v) ||
+		    (playcount_invert && playcount_v > playcount_th) ||
+		    (!playcount_invert && playcount_v < playcount_th))
 		{
-			playcount_v = wf_song_get_play_count(song);
+			g_debug("Song %s filtered out by play count %d", name, playcount_v);
 
-			if (!wf_stats_playcount_is_valid(playcount_v) ||
-			    (playcount_invert && playcount_v > playcount_th) ||
-			    (!playcount_invert && playcount_v < playcount_th))
-			{
-				// Remove list node respective library node
-				library = g_list_remove_link(library, item);
-				g_debug("Song %s filtered out by play count %d", name, playcount_v);
-				filtered = TRUE;
-			}
+			return FALSE;
 		}
+	}
 
-		// Check skip count
-		if (skipcount_on && !filtered)
-		{
-			skipcount_v = wf_song_get_skip_count(song);
-
-			if (!wf_stats_skipcount_is_valid(skipcount_v) ||
-			    (skipcount_invert && skipcount_v > skipcount_th) ||
-			    (!skipcount_invert && skipcount_v < skipcount_th))
-			{
-				// Remove list node respective library node
-				library = g_list_remove_link(library, item);
-				g_debug("Song %s filtered out by skip count %d", name, skipcount_v);
-				filtered = TRUE;
-			}
-		}
+	// Check skip count
+	if (skipcount_on)
+	{
+		skipcount_v = wf_song_get_skip_count(song);
 
-		// Check last played
-		if (lastplayed_on && !filtered)
+		if (!wf_stats_skipcount_is_valid(skipcount_v) ||
+		    (skipcount_invert && skipcount_v > skipcount_th) ||
+		    (!skipcount_invert && skipcount_v < skipcount_th))
 		{
-			lastplayed_v = wf_song_get_last_played(song);
-			time_since_last_played = wf_utils_time_compare(lastplayed_v, time);
+			g_debug("Song %s filtered out by skip count %d", name, skipcount_v);
 
-			if (!wf_stats_lastplayed_is_valid(lastplayed_v) ||
-			    (lastplayed_invert && time_since_last_played > lastplayed_th) ||
-			    (!lastplayed_invert && time_since_last_played < lastplayed_th))
-			{
-				// Remove list node respective library node
-				library = g_list_remove_link(library, item);
-				g_debug("Song %s filtered out by last played %ld", name, (long int) lastplayed_v);
-				filtered = TRUE;
-			}
+			return FALSE;
 		}
+	}
+
+	// Check last played
+	if (lastplayed_on)
+	{
+		lastplayed_v = wf_song_get_last_played(song);
+		time_since_last_played = wf_utils_time_compare(lastplayed_v, time);
 
-		if (filtered)
+		if (!wf_stats_lastplayed_is_valid(lastplayed_v) ||
+		    (lastplayed_invert && time_since_last_played > lastplayed_th) ||
+		    (!lastplayed_invert && time_since_last_played < lastplayed_th))
 		{
-			// Only free node
-			g_list_free(item);
-		}
+			g_debug("Song %s filtered out by last played %ld", name, (long int) lastplayed_v);
 
-		// Set next item
-		item = next;
+			return FALSE;
+		}
 	}
 
-	return library;
+	return TRUE;
 }
 
 static GList *
 wf_intelligence_remove_songs_with_artists(GList *library, GList *artists, gint amount)
 {
 	WfSong *song;
+	GHashTable *hashes;
 	GList *list;
 	GList *next;
-	guint32 hash;
 	guint32 artist;
 	gint x;
 
-	if (library == NULL || artists == NULL)
+	if (library == NULL || artists == NULL || amount <= 0)
 	{
 		g_info("No songs to remove that match any recent artist");
 
 		return library;
 	}
 
-	// Set list node pointer to use
-	list = library;
+	// Collect the artists to match, so every song only needs a single lookup
+	hashes = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	for (list = artists, x = 0; list != NULL && x < amount; list = list->next, x++)
+	{
+		g_hash_table_add(hashes, list->data);
+	}
 
 	// Go through the whole library, only once
-	while (list != NULL)
+	for (list = library; list != NULL; list = next)
 	{
 		next = list->next;
 		song = list->data;
@@ -502,37 +791,15 @@ wf_intelligence_remove_songs_with_artists(GList *library, GList *artists, gint a
 
 		artist = wf_song_get_artist_hash(song);
 
-		if (artist != 0)
+		if (artist != 0 && g_hash_table_contains(hashes, GUINT_TO_POINTER(artist)))
 		{
-			x = 0;
-
-			// Get matching artist
-			for (list = artists; list != NULL; list = list->next)
-			{
-				if (x >= amount)
-				{
-					// Already checked enough artists
-					break;
-				}
-
-				x++;
-
-				// Get the hash from the list node
-				hash = GPOINTER_TO_UINT(list->data);
-
-				if (artist == hash)
-				{
-					g_debug("Filtered out %s by artist %s", wf_song_get_name_not_empty(song), wf_song_get_artist(song));
-					library = g_list_remove(library, song);
-
-					break;
-				}
-			}
+			g_debug("Filtered out %s by artist %s", wf_song_get_name_not_empty(song), wf_song_get_artist(song));
+			library = g_list_delete_link(library, list);
 		}
-
-		list = next;
 	}
 
+	g_hash_table_unref(hashes);
+
 	return library;
 }
 
@@ -540,7 +807,8 @@ static GList *
 wf_intelligence_remove_recents(GList *library, GList *list_prev, GList *list_next, gint amount)
 {
 	WfSong *song;
-	GList *list, *new_list;
+	GHashTable *songs;
+	GList *list, *next, *played;
 	gint x = 0;
 
 	if (library == NULL || amount <= 0)
@@ -554,48 +822,37 @@ wf_intelligence_remove_recents(GList *library, GList *list_prev, GList *list_nex
 		g_info("Removing %d recently played songs", amount);
 	}
 
+	/*
+	 * First collect all songs to remove in a set and only then go through
+	 * the library once to remove them, instead of searching the library for
+	 * every single song.
+	 */
+	songs = g_hash_table_new(g_direct_hash, g_direct_equal);
+
 	// Check if already chosen songs need to be removed
-	if (list_next != NULL && x < amount)
+	for (list = list_next; list != NULL && x < amount; list = list->next)
 	{
-		for (list = list_next; list != NULL && x < amount; list = list->next)
-		{
-			song = list->data;
-
-			if (song == NULL)
-			{
-				x--;
-				continue;
-			}
-			else
-			{
-				g_debug("Filtered out previously selected %s", wf_song_get_name_not_empty(song));
-			}
+		song = list->data;
 
+		if (song != NULL)
+		{
 			// If non-existing, library is unchanged anyway
-			library = g_list_remove(library, song);
+			g_debug("Filtered out previously selected %s", wf_song_get_name_not_empty(song));
+			g_hash_table_add(songs, song);
 			x++;
 		}
 	}
 
 	// Check for songs that have been added to list_prev
-	if (list_prev != NULL && x < amount)
+	for (list = list_prev; list != NULL && x < amount; list = list->next)
 	{
-		for (list = list_prev; list != NULL && x < amount; list = list->next)
-		{
-			song = list->data;
-
-			if (song == NULL)
-			{
-				x--;
-				continue;
-			}
-			else
-			{
-				g_debug("Filtered out recently played %s", wf_song_get_name_not_empty(song));
-			}
+		song = list->data;
 
+		if (song != NULL)
+		{
 			// If non-existing, library is unchanged anyway
-			library = g_list_remove(library, song);
+			g_debug("Filtered out recently played %s", wf_song_get_name_not_empty(song));
+			g_hash_table_add(songs, song);
 			x++;
 		}
 	}
@@ -603,34 +860,46 @@ wf_intelligence_remove_recents(GList *library, GList *list_prev, GList *list_nex
 	// Remove based on last_played if not enough have been removed
 	if (x < amount)
 	{
-		// First, copy the list to sort, so the original remains its order
-		new_list = g_list_copy(library);
-
-		// Sort the list so most recently played songs are at the top
-		new_list = g_list_sort(new_list, wf_intelligence_sort_compare);
+		played = NULL;
 
-		// Loop @amount times and remove the respective item
-		for (list = new_list; list != NULL && x < amount; x++)
+		// Only songs that have been played and are not removed yet can be of use
+		for (list = library; list != NULL; list = list->next)
 		{
 			song = list->data;
-			list = list->next;
 
-			// If invalid or never played, skip to the next one, but keep track of how many have already been removed
-			if (song == NULL || wf_song_get_last_played(song) <= 0)
+			if (song != NULL && wf_song_get_last_played(song) > 0 && !g_hash_table_contains(songs, song))
 			{
-				x--;
-				continue;
+				played = g_list_prepend(played, song);
 			}
+		}
 
-			g_debug("Filtered out %s by last_played %ld", wf_song_get_name_not_empty(song), (long int) wf_song_get_last_played(song));
+		// Sort the list so most recently played songs are at the top
+		played = g_list_sort(played, wf_intelligence_sort_compare);
+
+		for (list = played; list != NULL && x < amount; list = list->next, x++)
+		{
+			song = list->data;
 
-			// Remove song from intelligence library
-			library = g_list_remove(library, song);
+			g_debug("Filtered out %s by last_played %ld", wf_song_get_name_not_empty(song), (long int) wf_song_get_last_played(song));
+			g_hash_table_add(songs, song);
 		}
 
-		g_list_free(new_list);
+		g_list_free(played);
+	}
+
+	// Now remove them all in a single sweep
+	for (list = library; list != NULL; list = next)
+	{
+		next = list->next;
+
+		if (list->data != NULL && g_hash_table_contains(songs, list->data))
+		{
+			library = g_list_delete_link(library, list);
+		}
 	}
 
+	g_hash_table_unref(songs);
+
 	if (x == 0)
 	{
 		g_info("Did not remove any recently played songs");
@@ -658,7 +927,7 @@ wf_intelligence_get_song(GList *filtered_songs, WfSongEntries *preferences)
 {
 	WfSong *winner = NULL;
 	WfIntelligenceContainer container;
-	WfDList *list;
+	WfSampler *sampler;
 
 	// If any songs are present, determine what modifiers to use
 	if (filtered_songs == NULL ||
@@ -668,18 +937,16 @@ wf_intelligence_get_song(GList *filtered_songs, WfSongEntries *preferences)
 	}
 
 	// Now calculate the amount of entries for each individual song
-	list = wf_intelligence_calculate_song_entries(&container, filtered_songs);
+	sampler = wf_intelligence_calculate_song_entries(&container, filtered_songs);
 
-	// At last, pick a winner
-	winner = wf_intelligence_pick_winner(&container, list);
-
-	wf_d_list_free(list);
+	// At last, pick a winner (the sampler is kept for the next pick)
+	winner = wf_intelligence_pick_winner(&container, sampler);
 
 	return winner;
 }
 
 static gboolean
-wf_intelligence_determine_modifiers(WfIntelligenceContainer *container, WfSongEntries *preferences)
+wf_intelligence_determine_modifiers(WfIntelligenceContainer *container, const WfSongEntries *preferences)
 {
 	g_return_val_if_fail(container != NULL, FALSE);
 
@@ -751,359 +1018,1390 @@ wf_intelligence_determine_modifiers(WfIntelligenceContainer *container, WfSongEn
 	return TRUE;
 }
 
-static WfDList *
+static WfSampler *
 wf_intelligence_calculate_song_entries(WfIntelligenceContainer *container, GList *songs)
 {
-	const gchar *name;
-	const gint64 one_year = (365 * 24 * 60 * 60);
 	const gint64 current_time = wf_utils_time_now();
-	WfSong *song;
+	WfIntelligenceColumns *columns = &ScratchData.columns;
+	WfSong **keys;
 	GList *list;
-	WfDList *dlist = NULL;
-	gint x, entries, full_sum = 0;
-
-	gint rating;
-	gdouble score;
-	gint playcount;
-	gint skipcount;
-	gint64 lastplayed;
-	gint64 time_since_last_played;
-	gboolean use_rating = FALSE;
-	gboolean use_score = FALSE;
-	gboolean use_playcount = FALSE;
-	gboolean use_skipcount = FALSE;
-	gboolean use_lastplayed = FALSE;
+	WfSampler *sampler;
+	guint x, count = 0;
+	guint64 full_sum = 0;
 
 	g_return_val_if_fail(container != NULL, NULL);
 	g_return_val_if_fail(songs != NULL, NULL);
 
-	// Determine what to use
-	use_rating = (container->rating_factor != 0);
-	use_score = (container->score_factor != 0);
-	use_playcount = (container->playcount_factor != 0);
-	use_skipcount = (container->skipcount_factor != 0);
-	use_lastplayed = (container->lastplayed_factor != 0);
+	x = g_list_length(songs);
+
+	// Reuse the buffers of the previous pick, growing them if needed
+	if (ScratchData.sampler == NULL)
+	{
+		wf_intelligence_columns_init(columns, x);
+		ScratchData.sampler = wf_sampler_new(x);
+	}
+
+	if (x > ScratchData.keys_capacity)
+	{
+		ScratchData.keys_capacity = MAX(x, ScratchData.keys_capacity * 2);
+		ScratchData.keys = g_renew(WfSong *, ScratchData.keys, ScratchData.keys_capacity);
+	}
+
+	keys = ScratchData.keys;
+	sampler = ScratchData.sampler;
+
+	wf_intelligence_columns_reserve(columns, x);
+	wf_sampler_clear(sampler);
+	wf_sampler_reserve(sampler, x);
+
+	// Gather the statistics first, so the calculation itself only runs over plain arrays
+	for (list = songs; list != NULL; list = list->next)
+	{
+		if (list->data != NULL)
+		{
+			keys[count] = list->data;
+			wf_intelligence_columns_store(columns, count, container, list->data);
+			count++;
+		}
+	}
+
+	wf_intelligence_calculate_entries(container, columns, 0, count, current_time);
+
+	for (x = 0; x < count; x++)
+	{
+		// Disqualified songs are left out
+		if (columns->entries[x] > 0)
+		{
+			wf_sampler_add(sampler, keys[x], columns->entries[x]);
+			full_sum += columns->entries[x];
+		}
+	}
+
+	g_debug("%u of %u songs got entries", wf_sampler_get_size(sampler), count);
+
+	if (full_sum <= 0)
+	{
+		g_message("No qualified songs");
+
+		return NULL;
+	}
+	else
+	{
+		container->total_entries = full_sum;
+
+		return sampler;
+	}
+}
+
+/*
+ * Calculate the entries of @count songs in @columns, starting at @first, with
+ * @current_time as the moment to compare last played values against.  Every
+ * modifier is applied in its own loop over the columns, without any calls or
+ * lookups that would prevent the compiler from vectorizing it.  The result is
+ * stored in the entries column: at least 1, or -1 if the song got disqualified.
+ */
+static void
+wf_intelligence_calculate_entries_batch(const WfIntelligenceContainer *container,
+                                        WfIntelligenceColumns *columns,
+                                        guint first,
+                                        guint count,
+                                        gint64 current_time)
+{
+	const gint64 one_year = (365 * 24 * 60 * 60);
+	const gint *rating = columns->rating + first;
+	const gdouble *score = columns->score + first;
+	const gint *playcount = columns->playcount + first;
+	const gint *skipcount = columns->skipcount + first;
+	const gint64 *lastplayed = columns->lastplayed + first;
+	gint *entries = columns->entries + first;
+	gint64 time_since;
+	gboolean invert;
+	gint factor, x;
+	guint i;
+
+	g_return_if_fail(container != NULL);
+	g_return_if_fail(first + count <= columns->size);
+
+	for (i = 0; i < count; i++)
+	{
+		entries[i] = 0;
+	}
+
+	if (container->rating_factor != 0)
+	{
+		factor = container->rating_factor;
+
+		for (i = 0; i < count; i++)
+		{
+			entries[i] += (rating[i] >= 0) * rating[i] * factor;
+		}
+	}
+
+	if (container->score_factor != 0)
+	{
+		factor = container->score_factor;
+
+		for (i = 0; i < count; i++)
+		{
+			entries[i] = (score[i] >= 0.0) ? (gint) (entries[i] + score[i] * factor) : entries[i];
+		}
+	}
+
+	if (container->playcount_factor != 0)
+	{
+		factor = container->playcount_factor;
+
+		if (container->favor_low_playcount)
+		{
+			for (i = 0; i < count; i++)
+			{
+				entries[i] += (playcount[i] >= 0) * wf_intelligence_get_entries_count_inverted(MAX(playcount[i], 0)) * factor;
+			}
+		}
+		else
+		{
+			for (i = 0; i < count; i++)
+			{
+				entries[i] += (playcount[i] >= 0) * wf_intelligence_get_entries_count(MAX(playcount[i], 0)) * factor;
+			}
+		}
+	}
+
+	if (container->skipcount_factor != 0)
+	{
+		factor = container->skipcount_factor;
+
+		if (container->favor_low_skipcount)
+		{
+			for (i = 0; i < count; i++)
+			{
+				entries[i] += (skipcount[i] >= 0) * wf_intelligence_get_entries_count_inverted(MAX(skipcount[i], 0)) * factor;
+			}
+		}
+		else
+		{
+			for (i = 0; i < count; i++)
+			{
+				entries[i] += (skipcount[i] >= 0) * wf_intelligence_get_entries_count(MAX(skipcount[i], 0)) * factor;
+			}
+		}
+	}
+
+	if (container->lastplayed_factor != 0)
+	{
+		factor = container->lastplayed_factor;
+		invert = container->favor_low_lastplayed;
+
+		// Issue a warning is the current time could not be fetched
+		g_warn_if_fail(current_time > 0);
+
+		for (i = 0; i < count; i++)
+		{
+			time_since = ABS(current_time - lastplayed[i]);
+
+			// After a year, just use the maximum
+			x = (time_since > one_year) ? MAX_SONG_ENTRIES :
+			    (invert ? wf_intelligence_get_entries_time_since_inverted(time_since) : wf_intelligence_get_entries_time_since(time_since));
+
+			entries[i] += (lastplayed[i] >= 0) * x * factor;
+		}
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		/*
+		 * If many entries got subtracted, disqualify the song and if it
+		 * got no entries from modifiers, give it at least one.
+		 */
+		entries[i] = (entries[i] < 0) ? -1 : MAX(entries[i], 1);
+	}
+}
+
+/*
+ * Same as wf_intelligence_calculate_entries_batch(), but large amounts of
+ * songs are split into chunks that are calculated by worker threads.  The
+ * entries of a song only depend on its own statistics, so the chunks are
+ * independent of each other.
+ */
+static void
+wf_intelligence_calculate_entries(const WfIntelligenceContainer *container,
+                                  WfIntelligenceColumns *columns,
+                                  guint first,
+                                  guint count,
+                                  gint64 current_time)
+{
+	WfIntelligenceChunk chunk = { 0 };
+
+	if (count >= PARALLEL_THRESHOLD)
+	{
+		chunk.func = wf_intelligence_calculate_entries_chunk;
+		chunk.first = first;
+		chunk.time = current_time;
+		chunk.container = container;
+		chunk.columns = columns;
+
+		if (wf_intelligence_run_parallel(&chunk, count))
+		{
+			return;
+		}
+	}
+
+	wf_intelligence_calculate_entries_batch(container, columns, first, count, current_time);
+}
+
+static void
+wf_intelligence_calculate_entries_chunk(WfIntelligenceChunk *chunk)
+{
+	wf_intelligence_calculate_entries_batch(chunk->container, chunk->columns, chunk->first, chunk->count, chunk->time);
+}
+
+static void
+wf_intelligence_filter_chunk(WfIntelligenceChunk *chunk)
+{
+	guint x;
+
+	for (x = chunk->first; x < chunk->first + chunk->count; x++)
+	{
+		chunk->passes[x] = (chunk->songs[x] == NULL) ||
+		                   wf_intelligence_song_passes_stats_filter(chunk->songs[x], (WfSongFilter *) chunk->filter, chunk->time);
+	}
+}
+
+/*
+ * Split @count items, starting at the first item of @chunk, into a chunk per
+ * worker thread and wait until all of them are done.  The calling thread takes
+ * the last chunk itself.
+ *
+ * Returns: %FALSE if no workers are available, in which case nothing is done
+ */
+static gboolean
+wf_intelligence_run_parallel(const WfIntelligenceChunk *chunk, guint count)
+{
+	WfIntelligenceChunk *chunks;
+	GError *err = NULL;
+	guint size, n, x;
+
+	if (WorkersData.pool == NULL && !WorkersData.failed)
+	{
+		WorkersData.threads = g_get_num_processors();
+		WorkersData.pool = (WorkersData.threads < 2) ? NULL : g_thread_pool_new(wf_intelligence_worker_cb, &WorkersData, (gint) WorkersData.threads - 1, FALSE /* exclusive */, &err);
+
+		if (WorkersData.pool == NULL)
+		{
+			if (err != NULL)
+			{
+				g_info("Could not create worker threads: %s", err->message);
+				g_clear_error(&err);
+			}
+
+			WorkersData.failed = TRUE;
+		}
+	}
+
+	if (WorkersData.pool == NULL)
+	{
+		return FALSE;
+	}
+
+	if (count == 0)
+	{
+		return FALSE;
+	}
+
+	/*
+	 * Rounding the size up can leave fewer chunks than threads (5 songs over
+	 * 4 threads are only chunks of 2, 2 and 1), so count them again;
+	 * otherwise the last chunks would start past the end.
+	 */
+	n = MIN(WorkersData.threads, count);
+	size = (count + n - 1) / n;
+	n = (count + size - 1) / size;
+	chunks = g_new(WfIntelligenceChunk, n);
+
+	for (x = 0; x < n; x++)
+	{
+		chunks[x] = *chunk;
+		chunks[x].first = chunk->first + (x * size);
+		chunks[x].count = MIN(size, count - (x * size));
+	}
+
+	g_mutex_lock(&WorkersData.mutex);
+	WorkersData.pending = n - 1;
+	g_mutex_unlock(&WorkersData.mutex);
+
+	for (x = 0; x + 1 < n; x++)
+	{
+		g_thread_pool_push(WorkersData.pool, &chunks[x], NULL /* error */);
+	}
+
+	chunks[n - 1].func(&chunks[n - 1]);
+
+	g_mutex_lock(&WorkersData.mutex);
+
+	while (WorkersData.pending > 0)
+	{
+		g_cond_wait(&WorkersData.cond, &WorkersData.mutex);
+	}
+
+	g_mutex_unlock(&WorkersData.mutex);
+
+	g_free(chunks);
+
+	return TRUE;
+}
+
+static WfSong *
+wf_intelligence_pick_winner(WfIntelligenceContainer *container, WfSampler *sampler)
+{
+	WfSong *winner;
+	guint64 total;
+	guint64 rand;
+	gint index;
+
+	g_return_val_if_fail(container != NULL, NULL);
+
+	if (sampler == NULL)
+	{
+		// No songs available
+		return NULL;
+	}
+
+	total = wf_sampler_get_total(sampler);
+
+	g_return_val_if_fail(total > 0, NULL);
+
+	// Pick a winner; the sampler finds the matching song in O(log n)
+	rand = wf_intelligence_random(&RandomData, 1, total);
+	index = wf_sampler_find(sampler, rand - 1);
+	winner = (index < 0) ? NULL : wf_sampler_get_key(sampler, index);
+
+	if (winner == NULL)
+	{
+		g_warning("Failed to draw a winner (entry %" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT ")", rand, total);
+
+		return NULL;
+	}
+	else
+	{
+		g_info("Winner (entry %" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT "): %s", rand, total, wf_song_get_name_not_empty(winner));
+
+		return winner;
+	}
+}
+
+/*
+ * wf_intelligence_choose_new_song:
+ * @library: (element-type WfSong): pointer to the full list with songs to filter
+ * @previous_songs: (element-type WfSong): list of previously played songs
+ * @play_next: (element-type WfSong): list of songs selected to play next
+ * @recent_artists: (element-type guint32): list of recent artists
+ * @filer: filter parameters to use
+ * @entries: probability parameters to use
+ *
+ * Walk through the complete algorithm to choose a new song.
+ *
+ * Please note that @library is a pointer to the pointer of the first list
+ * node.  Because the list may be filtered and as such the first item may also
+ * be removed, changing the pointer to the first list node.  When the caller
+ * tries to free the list, this would, without any ownership transfers, cause a
+ * free on an already freed node.  By providing the pointer to the pointer of
+ * the first node, the pointer of the first node can be changed and safely
+ * freed later.
+ *
+ * Returns: a chosen song
+ */
+WfSong *
+wf_intelligence_choose_new_song(GList **library,
+                                GList *previous_songs,
+                                GList *play_next,
+                                GList *recent_artists,
+                                WfSongFilter *filter,
+                                WfSongEntries *entries)
+{
+	WfSong *new_song = NULL;
+	gint64 start;
+
+	g_return_val_if_fail(library != NULL, NULL);
+
+	if (*library == NULL)
+	{
+		// No song to choose
+		return NULL;
+	}
+
+	start = wf_metrics_start();
+
+	if (filter != NULL)
+	{
+		*library = wf_intelligence_filter(*library, previous_songs, play_next, recent_artists, filter);
+	}
+
+	if (entries != NULL)
+	{
+		new_song = wf_intelligence_get_song(*library, entries);
+	}
+
+	wf_metrics_stop(WF_METRIC_PICK, start);
+
+	return new_song;
+}
+
+/*
+ * wf_intelligence_pool_choose_new_song:
+ * @current: (nullable): the current song, which can never be chosen
+ * @previous_songs: previously played songs, most recent first
+ * @play_next: songs selected to play next
+ * @recent_artists: hashes of the recent artists, most recent first
+ * @settings: snapshot of the filter and probability settings to use
+ *
+ * Same as wf_intelligence_choose_new_song(), but using the persistent
+ * candidate pool instead of filtering and weighing a copy of the full library.
+ * The artist of @current counts as the most recent artist.
+ * Songs that are excluded for this pick only (the current song, recent artists
+ * and recently played songs) temporarily get their entries removed from the
+ * pool and are restored afterwards.
+ *
+ * Returns: a chosen song
+ */
+WfSong *
+wf_intelligence_pool_choose_new_song(WfSong *current,
+                                     const WfRing *previous_songs,
+                                     const WfRing *play_next,
+                                     const WfRing *recent_artists,
+                                     const WfSettingsSnapshot *settings)
+{
+	WfSong *winner = NULL;
+
+	wf_intelligence_pool_choose_new_songs(current, previous_songs, play_next, recent_artists, settings, &winner, 1);
+
+	return winner;
+}
+
+/*
+ * wf_intelligence_pool_choose_new_songs:
+ * @current: (nullable): the current song, which can never be chosen
+ * @previous_songs: previously played songs, most recent first
+ * @play_next: songs selected to play next
+ * @recent_artists: hashes of the recent artists, most recent first
+ * @settings: snapshot of the filter and probability settings to use
+ * @songs_rv: (out): array to store the chosen songs in
+ * @amount: the amount of songs to choose, the size of @songs_rv
+ *
+ * Choose up to @amount songs that play after each other, in a single pass.  The
+ * exclusions are determined once, just like for
+ * wf_intelligence_pool_choose_new_song(), and every chosen song is added to
+ * them: it can not be chosen again and, if the artist filter is enabled, its
+ * artist counts as a recent artist for the songs that follow.  Unlike choosing
+ * the songs one at a time, the oldest recent artists are not let go of during
+ * the pass.
+ *
+ * Returns: the amount of songs stored in @songs_rv
+ */
+guint
+wf_intelligence_pool_choose_new_songs(WfSong *current,
+                                      const WfRing *previous_songs,
+                                      const WfRing *play_next,
+                                      const WfRing *recent_artists,
+                                      const WfSettingsSnapshot *settings,
+                                      WfSong **songs_rv,
+                                      guint amount)
+{
+	const WfSongFilter *filter;
+	WfIntelligenceCandidate *candidate;
+	WfSong *winner;
+	WfSong *song;
+	GHashTable *excluded;
+	GSequenceIter *iter;
+	gint remove_recent;
+	guint32 artist;
+	guint chosen = 0;
+	guint n;
+	gint x;
+	gint64 start;
+
+	g_return_val_if_fail(songs_rv != NULL, 0);
+
+	if (amount == 0)
+	{
+		return 0;
+	}
+
+	// Includes (re)building the pool when needed
+	start = wf_metrics_start();
+
+	if (!wf_intelligence_pool_ensure(settings))
+	{
+		// No song to choose
+		wf_metrics_stop(WF_METRIC_PICK, start);
+
+		return 0;
+	}
+
+	filter = &settings->filter;
+	excluded = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	// The current song can never be chosen
+	wf_intelligence_pool_exclude(excluded, current);
+
+	// Artist filtering: only look at the songs of the recent artists
+	artist = (current == NULL) ? 0 : wf_song_get_artist_hash(current);
+	x = 0;
+
+	if (artist != 0 && x < filter->recent_artists)
+	{
+		wf_intelligence_pool_exclude_artist(excluded, artist);
+		x++;
+	}
+
+	for (n = 0; n < wf_ring_get_length(recent_artists) && x < filter->recent_artists; n++, x++)
+	{
+		wf_intelligence_pool_exclude_artist(excluded, GPOINTER_TO_UINT(wf_ring_get(recent_artists, n)));
+	}
+
+	// Filter by recently played, counted the same way as wf_intelligence_remove_recents()
+	remove_recent = wf_intelligence_get_percentage_of_count(PoolData.eligible - (gint) g_hash_table_size(excluded), filter->remove_recents_percentage);
+	remove_recent += filter->remove_recents_amount;
+	x = 0;
+
+	for (n = 0; n < wf_ring_get_length(play_next) && x < remove_recent; n++)
+	{
+		song = wf_ring_get(play_next, n);
+
+		if (song != NULL)
+		{
+			wf_intelligence_pool_exclude(excluded, song);
+			x++;
+		}
+	}
+
+	for (n = 0; n < wf_ring_get_length(previous_songs) && x < remove_recent; n++)
+	{
+		song = wf_ring_get(previous_songs, n);
+
+		if (song != NULL)
+		{
+			wf_intelligence_pool_exclude(excluded, song);
+			x++;
+		}
+	}
+
+	// Remove the most recently played songs that are still left
+	for (iter = g_sequence_get_begin_iter(PoolData.played);
+	     !g_sequence_iter_is_end(iter) && x < remove_recent;
+	     iter = g_sequence_iter_next(iter))
+	{
+		candidate = g_sequence_get(iter);
+
+		if (wf_intelligence_pool_exclude(excluded, candidate->song))
+		{
+			g_debug("Filtered out %s by last_played %ld", wf_song_get_name_not_empty(candidate->song), (long int) candidate->last_played);
+			x++;
+		}
+	}
+
+	if (remove_recent > 0)
+	{
+		g_info("Removed %d of %d recently played songs", x, remove_recent);
+	}
+
+	while (chosen < amount)
+	{
+		winner = wf_intelligence_pool_draw(excluded);
+
+		if (winner == NULL)
+		{
+			g_info("All songs are filtered out");
+
+			break;
+		}
+
+		songs_rv[chosen++] = winner;
+
+		// The songs that follow are chosen as if the winner has been played
+		wf_intelligence_pool_exclude(excluded, winner);
+		artist = wf_song_get_artist_hash(winner);
+
+		if (artist != 0 && filter->recent_artists > 0)
+		{
+			wf_intelligence_pool_exclude_artist(excluded, artist);
+		}
+	}
+
+	// Give the excluded songs their entries back
+	wf_intelligence_pool_restore(excluded);
+	g_hash_table_unref(excluded);
+
+	wf_metrics_stop(WF_METRIC_PICK, start);
+
+	return chosen;
+}
+
+/*
+ * wf_intelligence_pool_song_is_eligible:
+ * @song: the song to check
+ * @settings: snapshot of the filter and probability settings to use
+ *
+ * Check whether @song can still be chosen with @settings, not counting the
+ * exclusions that only apply to a single pick.  This can be used to find out
+ * whether songs that were chosen earlier are still valid after the settings or
+ * their statistics have changed.
+ *
+ * Returns: %TRUE if @song is an eligible candidate with entries
+ */
+gboolean
+wf_intelligence_pool_song_is_eligible(WfSong *song, const WfSettingsSnapshot *settings)
+{
+	WfIntelligenceCandidate *candidate;
+
+	g_return_val_if_fail(WF_IS_SONG(song), FALSE);
+
+	if (!wf_intelligence_pool_ensure(settings))
+	{
+		return FALSE;
+	}
+
+	candidate = g_hash_table_lookup(PoolData.candidates, song);
+
+	return (candidate != NULL && candidate->eligible && candidate->weight > 0);
+}
+
+/*
+ * wf_intelligence_pool_update_song:
+ * @song: the song that has been added or changed
+ *
+ * Let the candidate pool know that @song has been added to the library or that
+ * its statistics or metadata have changed, so its eligibility and entries are
+ * calculated again.  A song that is no longer part of the library is removed.
+ * Does nothing if the pool has not been built yet.
+ */
+void
+wf_intelligence_pool_update_song(WfSong *song)
+{
+	g_return_if_fail(WF_IS_SONG(song));
+
+	if (!PoolData.valid)
+	{
+		// Will be picked up when the pool gets built
+		return;
+	}
+
+	if (wf_song_is_in_list(song))
+	{
+		wf_intelligence_pool_insert(song, wf_utils_time_now(), TRUE /* calculate */);
+	}
+	else
+	{
+		wf_intelligence_pool_remove_song(song);
+	}
+}
+
+/*
+ * wf_intelligence_pool_remove_song:
+ * @song: the song that is being removed from the library
+ *
+ * Remove @song from the candidate pool.
+ */
+void
+wf_intelligence_pool_remove_song(WfSong *song)
+{
+	WfIntelligenceCandidate *candidate;
+
+	g_return_if_fail(WF_IS_SONG(song));
+
+	if (!PoolData.valid)
+	{
+		return;
+	}
+
+	candidate = g_hash_table_lookup(PoolData.candidates, song);
+
+	if (candidate == NULL)
+	{
+		return;
+	}
+
+	wf_intelligence_pool_detach_candidate(candidate);
+
+	// The sampler slot stays, but can never be drawn anymore
+	wf_sampler_set_weight(PoolData.sampler, candidate->index, 0);
+
+	// Frees the candidate and drops the reference to the song
+	g_hash_table_remove(PoolData.candidates, song);
+}
+
+/*
+ * wf_intelligence_pool_invalidate:
+ *
+ * Throw away the candidate pool, so it gets built again for the next song
+ * that is chosen.  Use this when the settings or large parts of the library
+ * have changed.
+ */
+void
+wf_intelligence_pool_invalidate(void)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	if (PoolData.artists != NULL)
+	{
+		g_hash_table_iter_init(&iter, PoolData.artists);
+
+		while (g_hash_table_iter_next(&iter, NULL, &value))
+		{
+			g_list_free(value);
+		}
+
+		g_hash_table_unref(PoolData.artists);
+	}
+
+	if (PoolData.played != NULL)
+	{
+		g_sequence_free(PoolData.played);
+	}
+
+	if (PoolData.candidates != NULL)
+	{
+		g_hash_table_unref(PoolData.candidates);
+	}
+
+	if (PoolData.sampler != NULL)
+	{
+		wf_sampler_free(PoolData.sampler);
+	}
+
+	wf_intelligence_columns_clear(&PoolData.columns);
+
+	PoolData = (WfIntelligencePool) { 0 };
+}
+
+static gboolean
+wf_intelligence_pool_ensure(const WfSettingsSnapshot *settings)
+{
+	guint candidates;
+	gboolean outdated;
+
+	if (settings == NULL)
+	{
+		// Without probability parameters no song can be chosen
+		return FALSE;
+	}
+
+	if (PoolData.valid)
+	{
+		candidates = g_hash_table_size(PoolData.candidates);
+
+		/*
+		 * Rebuild if the parameters changed, the time based values may have
+		 * drifted, songs got added or removed behind the pool's back or if
+		 * too many sampler slots of removed songs have piled up.
+		 */
+		outdated = (PoolData.settings_version != settings->version) ||
+		           (wf_utils_time_compare(PoolData.built, wf_utils_time_now()) > POOL_REFRESH_INTERVAL) ||
+		           (candidates != (guint) wf_song_get_count()) ||
+		           (wf_sampler_get_size(PoolData.sampler) > (2 * candidates) + 64);
+	}
+	else
+	{
+		outdated = TRUE;
+	}
+
+	if (outdated)
+	{
+		wf_intelligence_pool_rebuild(settings);
+	}
+
+	return (PoolData.eligible > 0);
+}
+
+static void
+wf_intelligence_pool_rebuild(const WfSettingsSnapshot *settings)
+{
+	WfIntelligenceCandidate **candidates;
+	WfIntelligenceCandidate *candidate;
+	WfSong *song;
+	GHashTableIter iter;
+	gpointer value;
+	gboolean *passes;
+	guint64 *weights;
+	guint count = 0;
+	guint size;
+	guint x;
+	gint64 time;
+
+	wf_intelligence_pool_invalidate();
+
+	// Remember the version, so changes can be detected
+	PoolData.settings_version = settings->version;
+	PoolData.filter = settings->filter;
+
+	// The modifiers only depend on the settings, so keep them across rebuilds
+	if (ModifiersData.settings_version != settings->version)
+	{
+		wf_intelligence_determine_modifiers(&ModifiersData.container, &settings->entries);
+		ModifiersData.settings_version = settings->version;
+	}
+
+	PoolData.container = ModifiersData.container;
+
+	PoolData.sampler = wf_sampler_new(wf_song_get_count());
+	wf_intelligence_columns_init(&PoolData.columns, wf_song_get_count());
+	PoolData.candidates = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, g_free);
+	PoolData.artists = g_hash_table_new(g_direct_hash, g_direct_equal);
+	PoolData.played = g_sequence_new(NULL /* data_destroy */);
+
+	// Use the same time for all songs, just like a single filter pass would
+	time = wf_utils_time_now();
+	PoolData.built = time;
+	PoolData.valid = TRUE;
+
+	candidates = g_new(WfIntelligenceCandidate *, wf_song_get_count());
+	passes = g_new(gboolean, wf_song_get_count());
+
+	for (song = wf_song_get_first(); song != NULL && count < (guint) wf_song_get_count(); song = wf_song_get_next(song))
+	{
+		candidates[count++] = wf_intelligence_pool_get_candidate(song);
+	}
+
+	// Check the statistics filter of all songs at once, by worker threads for large libraries
+	wf_intelligence_pool_filter(candidates, count, time, passes);
+
+	for (x = 0; x < count; x++)
+	{
+		wf_intelligence_pool_refresh_candidate(candidates[x], passes[x], time, FALSE /* calculate */);
+	}
+
+	g_free(candidates);
+	g_free(passes);
+
+	// Now calculate the entries of all songs at once and fill the sampler with them
+	size = wf_sampler_get_size(PoolData.sampler);
+	wf_intelligence_calculate_entries(&PoolData.container, &PoolData.columns, 0, size, time);
+
+	weights = g_new0(guint64, size);
+	g_hash_table_iter_init(&iter, PoolData.candidates);
+
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		candidate = value;
+		candidate->weight = wf_intelligence_pool_get_weight(candidate);
+		weights[candidate->index] = candidate->weight;
+	}
+
+	wf_sampler_set_weights(PoolData.sampler, weights);
+	g_free(weights);
+
+	g_info("Built candidate pool: %d of %d songs are eligible", PoolData.eligible, wf_song_get_count());
+}
+
+static void
+wf_intelligence_pool_insert(WfSong *song, gint64 time, gboolean calculate)
+{
+	WfIntelligenceCandidate *candidate;
+	gboolean eligible;
+
+	candidate = wf_intelligence_pool_get_candidate(song);
+	eligible = wf_intelligence_song_passes_stats_filter(song, &PoolData.filter, time);
+
+	wf_intelligence_pool_refresh_candidate(candidate, eligible, time, calculate);
+}
+
+// Get the candidate of @song, adding a new one if the pool does not know it yet
+static WfIntelligenceCandidate *
+wf_intelligence_pool_get_candidate(WfSong *song)
+{
+	WfIntelligenceCandidate *candidate;
+
+	candidate = g_hash_table_lookup(PoolData.candidates, song);
+
+	if (candidate == NULL)
+	{
+		candidate = g_new0(WfIntelligenceCandidate, 1);
+		candidate->song = song;
+		candidate->index = wf_sampler_add(PoolData.sampler, song, 0);
+		wf_intelligence_columns_reserve(&PoolData.columns, wf_sampler_get_size(PoolData.sampler));
+
+		// Keep a reference, so the pool never points to a freed song
+		g_hash_table_insert(PoolData.candidates, g_object_ref(song), candidate);
+	}
+
+	return candidate;
+}
+
+/*
+ * Store whether the song of @candidate is @eligible, as determined by the
+ * statistics filter, and its statistics.  With @calculate, its entries are
+ * calculated and applied right away; otherwise the caller has to do so for
+ * all songs at once.
+ */
+static void
+wf_intelligence_pool_refresh_candidate(WfIntelligenceCandidate *candidate, gboolean eligible, gint64 time, gboolean calculate)
+{
+	WfSong *song = candidate->song;
+	GList *list;
+
+	// Take it out of the lookup structures, its values may have changed
+	wf_intelligence_pool_detach_candidate(candidate);
+
+	candidate->eligible = eligible;
+	candidate->artist = wf_song_get_artist_hash(song);
+	candidate->last_played = wf_song_get_last_played(song);
+
+	wf_intelligence_columns_store(&PoolData.columns, candidate->index, &PoolData.container, song);
+
+	if (calculate)
+	{
+		wf_intelligence_calculate_entries_batch(&PoolData.container, &PoolData.columns, candidate->index, 1, time);
+		candidate->weight = wf_intelligence_pool_get_weight(candidate);
+		wf_sampler_set_weight(PoolData.sampler, candidate->index, candidate->weight);
+	}
+
+	if (!candidate->eligible)
+	{
+		return;
+	}
+
+	PoolData.eligible++;
+
+	if (candidate->artist != 0)
+	{
+		list = g_hash_table_lookup(PoolData.artists, GUINT_TO_POINTER(candidate->artist));
+		list = g_list_prepend(list, candidate);
+		g_hash_table_insert(PoolData.artists, GUINT_TO_POINTER(candidate->artist), list);
+	}
+
+	if (candidate->last_played > 0)
+	{
+		candidate->played = g_sequence_insert_sorted(PoolData.played, candidate, wf_intelligence_played_compare, NULL);
+	}
+}
+
+/*
+ * Check the songs of @count @candidates against the statistics filter of the
+ * pool and store the results in @passes.  Large amounts of songs are split
+ * into chunks that are checked by worker threads.
+ */
+static void
+wf_intelligence_pool_filter(WfIntelligenceCandidate **candidates, guint count, gint64 time, gboolean *passes)
+{
+	WfIntelligenceChunk chunk = { 0 };
+	guint x;
+
+	chunk.func = wf_intelligence_filter_chunk;
+	chunk.time = time;
+	chunk.filter = &PoolData.filter;
+	chunk.songs = g_new(WfSong *, MAX(count, 1));
+	chunk.passes = passes;
+
+	for (x = 0; x < count; x++)
+	{
+		chunk.songs[x] = candidates[x]->song;
+	}
+
+	if (count < PARALLEL_THRESHOLD || !wf_intelligence_run_parallel(&chunk, count))
+	{
+		chunk.count = count;
+		wf_intelligence_filter_chunk(&chunk);
+	}
+
+	g_free(chunk.songs);
+}
+
+// Weight to use in the sampler, from the calculated entries of @candidate
+static guint64
+wf_intelligence_pool_get_weight(const WfIntelligenceCandidate *candidate)
+{
+	gint entries = PoolData.columns.entries[candidate->index];
+
+	return (candidate->eligible && entries > 0) ? (guint64) entries : 0;
+}
+
+static void
+wf_intelligence_pool_detach_candidate(WfIntelligenceCandidate *candidate)
+{
+	GList *list;
+
+	if (!candidate->eligible)
+	{
+		// Not part of any lookup structure
+		return;
+	}
+
+	candidate->eligible = FALSE;
+	PoolData.eligible--;
+
+	if (candidate->artist != 0)
+	{
+		list = g_hash_table_lookup(PoolData.artists, GUINT_TO_POINTER(candidate->artist));
+		list = g_list_remove(list, candidate);
+
+		if (list == NULL)
+		{
+			g_hash_table_remove(PoolData.artists, GUINT_TO_POINTER(candidate->artist));
+		}
+		else
+		{
+			g_hash_table_insert(PoolData.artists, GUINT_TO_POINTER(candidate->artist), list);
+		}
+	}
+
+	if (candidate->played != NULL)
+	{
+		g_sequence_remove(candidate->played);
+		candidate->played = NULL;
+	}
+}
+
+// Temporarily take away all entries of @song; returns TRUE if it was not excluded yet
+static gboolean
+wf_intelligence_pool_exclude(GHashTable *excluded, WfSong *song)
+{
+	WfIntelligenceCandidate *candidate;
+
+	if (song == NULL)
+	{
+		return FALSE;
+	}
+
+	candidate = g_hash_table_lookup(PoolData.candidates, song);
+
+	if (candidate == NULL || !candidate->eligible || g_hash_table_contains(excluded, candidate))
+	{
+		return FALSE;
+	}
+
+	g_hash_table_add(excluded, candidate);
+	wf_sampler_set_weight(PoolData.sampler, candidate->index, 0);
+
+	return TRUE;
+}
+
+// Temporarily take away the entries of all songs by @artist
+static void
+wf_intelligence_pool_exclude_artist(GHashTable *excluded, guint32 artist)
+{
+	WfIntelligenceCandidate *candidate;
+	GList *node;
+
+	node = g_hash_table_lookup(PoolData.artists, GUINT_TO_POINTER(artist));
 
-	for (list = songs; list != NULL; list = list->next)
+	for (; node != NULL; node = node->next)
 	{
-		song = list->data;
+		candidate = node->data;
 
-		if (song == NULL)
+		if (wf_intelligence_pool_exclude(excluded, candidate->song))
 		{
-			continue;
+			g_debug("Filtered out %s by artist %s", wf_song_get_name_not_empty(candidate->song), wf_song_get_artist(candidate->song));
 		}
+	}
+}
 
-		name = wf_song_get_name_not_empty(song);
-		entries = 0;
+static void
+wf_intelligence_pool_restore(GHashTable *excluded)
+{
+	WfIntelligenceCandidate *candidate;
+	GHashTableIter iter;
+	gpointer key;
 
-		if (use_rating)
-		{
-			rating = wf_song_get_rating(song);
+	g_hash_table_iter_init(&iter, excluded);
 
-			if (wf_stats_rating_is_valid(rating))
-			{
-				if (container->favor_low_ratings)
-				{
-					rating = wf_stats_rating_invert(rating);
-				}
-				else if (rating == 0)
-				{
-					rating = container->default_rating;
-				}
-
-				entries += rating * container->rating_factor;
-			}
-		}
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+	{
+		candidate = key;
+		wf_sampler_set_weight(PoolData.sampler, candidate->index, candidate->weight);
+	}
+}
+
+// Draw until the winner is a song that can actually be played right now
+static WfSong *
+wf_intelligence_pool_draw(GHashTable *excluded)
+{
+	WfSong *winner;
+
+	while (wf_sampler_get_total(PoolData.sampler) > 0)
+	{
+		winner = wf_intelligence_pick_winner(&PoolData.container, PoolData.sampler);
 
-		if (use_score)
+		if (winner == NULL ||
+		    (wf_song_is_in_list(winner) && wf_song_get_status(winner) == WF_SONG_AVAILABLE))
 		{
-			score = wf_song_get_score(song);
+			return winner;
+		}
 
-			if (wf_stats_score_is_valid(score))
-			{
-				if (container->favor_low_scores)
-				{
-					score = wf_stats_score_invert(score);
-				}
+		g_debug("Filtered out %s because it is not available", wf_song_get_name_not_empty(winner));
 
-				entries += score * container->score_factor;
-			}
+		if (!wf_intelligence_pool_exclude(excluded, winner))
+		{
+			// Should not happen: the winner has to be an eligible candidate
+			return NULL;
 		}
+	}
+
+	return NULL;
+}
+
+/**
+ * wf_intelligence_simulate:
+ * @entries: the probability parameters to simulate
+ * @picks: the amount of songs to pick
+ * @seed: seed of the random number generator, so runs can be compared
+ * @length_rv: (out): return location for the amount of songs
+ *
+ * Simulates picking @picks songs after each other from the current library,
+ * to see how @entries would turn out without having to listen to them for
+ * weeks.  Every chosen song is considered played completely: its play count
+ * goes up, it is marked as last played and the simulated time moves on by its
+ * duration.  These changes are only made to copies of the statistics; the
+ * songs themselves and the generator of the real picker are not touched.
+ *
+ * Just like the real picker, a song is never chosen twice in a row and the
+ * time based entries are calculated again every ten minutes of simulated
+ * time.  The filter settings, such as the recent artist filter, are not
+ * simulated.
+ *
+ * Returns: (transfer full) (array length=length_rv) (nullable): the amount of
+ * times each song is picked, in library order (see wf_song_get_next()), or
+ * %NULL if the library is empty.  Free it with g_free().
+ *
+ * Since: 0.3
+ **/
+guint *
+wf_intelligence_simulate(const WfSongEntries *entries, guint picks, guint64 seed, guint *length_rv)
+{
+	WfIntelligenceContainer container;
+	WfIntelligenceColumns columns;
+	WfIntelligenceRandom random;
+	WfSampler *sampler;
+	WfSong *song;
+	guint64 *weights;
+	guint64 total;
+	guint *counts;
+	gint *durations;
+	gint64 time, refreshed = 0;
+	guint count, n, x;
+	gint index, previous = -1;
+
+	g_return_val_if_fail(entries != NULL, NULL);
+	g_return_val_if_fail(length_rv != NULL, NULL);
+
+	count = (guint) wf_song_get_count();
+	*length_rv = count;
+
+	if (count == 0)
+	{
+		return NULL;
+	}
+
+	counts = g_new0(guint, count);
+	wf_intelligence_determine_modifiers(&container, entries);
+
+	// The sampler slots and the columns are indexed like the library
+	sampler = wf_sampler_new(count);
+	wf_intelligence_columns_init(&columns, count);
+	durations = g_new(gint, count);
+	weights = g_new(guint64, count);
+
+	for (song = wf_song_get_first(), x = 0; song != NULL && x < count; song = wf_song_get_next(song), x++)
+	{
+		wf_sampler_add(sampler, song, 0);
+		wf_intelligence_columns_store(&columns, x, &container, song);
+		durations[x] = wf_song_get_duration(song);
+	}
+
+	wf_intelligence_random_seed(&random, seed);
+	time = wf_utils_time_now();
 
-		if (use_playcount)
+	for (n = 0; n < picks; n++)
+	{
+		if (n == 0 || (time - refreshed) > POOL_REFRESH_INTERVAL)
 		{
-			playcount = wf_song_get_play_count(song);
+			// Time based entries drift, so calculate all of them again
+			wf_intelligence_calculate_entries(&container, &columns, 0, count, time);
 
-			if (wf_stats_playcount_is_valid(playcount))
+			for (x = 0; x < count; x++)
 			{
-				if (container->favor_low_playcount)
-				{
-					x = wf_intelligence_get_entries_count_inverted(playcount);
-				}
-				else
-				{
-					x = wf_intelligence_get_entries_count(playcount);
-				}
-
-				entries += x * container->playcount_factor;
+				weights[x] = (columns.entries[x] > 0) ? (guint64) columns.entries[x] : 0;
 			}
-		}
-
-		if (use_skipcount)
-		{
-			skipcount = wf_song_get_skip_count(song);
 
-			if (wf_stats_skipcount_is_valid(skipcount))
+			if (previous >= 0)
 			{
-				if (container->favor_low_skipcount)
-				{
-					x = wf_intelligence_get_entries_count_inverted(skipcount);
-				}
-				else
-				{
-					x = wf_intelligence_get_entries_count(skipcount);
-				}
-
-				entries += x * container->skipcount_factor;
+				weights[previous] = 0;
 			}
-		}
 
-		if (use_lastplayed)
+			wf_sampler_set_weights(sampler, weights);
+			refreshed = time;
+		}
+		else if (previous >= 0)
 		{
-			lastplayed = wf_song_get_last_played(song);
+			// Only the statistics of the song that just played have changed
+			wf_intelligence_calculate_entries_batch(&container, &columns, previous, 1, time);
+		}
 
-			if (wf_stats_lastplayed_is_valid(lastplayed))
-			{
-				// Issue a warning is the current time could not be fetched
-				g_warn_if_fail(current_time > 0);
-
-				lastplayed = wf_song_get_last_played(song);
-				time_since_last_played = wf_utils_time_compare(lastplayed, current_time);
-
-				if (time_since_last_played > one_year)
-				{
-					// Just use maximum
-					x = 100;
-				}
-				else
-				{
-					if (container->favor_low_lastplayed)
-					{
-						x = wf_intelligence_get_entries_time_since_inverted(time_since_last_played);
-					}
-					else
-					{
-						x = wf_intelligence_get_entries_time_since(time_since_last_played);
-					}
-				}
-
-				entries += x * container->lastplayed_factor;
-			}
+		total = wf_sampler_get_total(sampler);
+
+		if (total == 0)
+		{
+			// Only the previous song, or nothing at all, can be chosen
+			break;
 		}
 
-		// If many entries got subtracted, disqualify the song
-		if (entries < 0)
+		index = wf_sampler_find(sampler, wf_intelligence_random(&random, 0, total - 1));
+
+		if (index < 0)
 		{
-			g_debug("%s disqualified", name);
-			continue;
+			break;
 		}
 
-		// If this song got no entries from modifiers, give it at least one
-		if (entries == 0)
+		counts[index]++;
+
+		// The previous song may be chosen again, the new one may not
+		if (previous >= 0)
 		{
-			entries = 1;
+			wf_sampler_set_weight(sampler, previous, (columns.entries[previous] > 0) ? (guint64) columns.entries[previous] : 0);
 		}
 
-		dlist = wf_d_list_add(dlist, song, GINT_TO_POINTER(entries));
+		wf_sampler_set_weight(sampler, index, 0);
+		previous = index;
+
+		// Play it, changing only the copies of its statistics
+		if (container.playcount_factor != 0)
+		{
+			columns.playcount[index] = MAX(columns.playcount[index], 0) + 1;
+		}
 
-		full_sum += entries;
+		if (container.lastplayed_factor != 0)
+		{
+			columns.lastplayed[index] = time;
+		}
 
-		g_debug("Song <%s> has %d %s", name, entries, wf_utils_string_to_single_multiple(entries, "entry", "entries"));
+		time += (durations[index] > 0) ? durations[index] : SIMULATION_SONG_DURATION;
 	}
 
-	if (full_sum <= 0)
-	{
-		g_message("No qualified songs");
-		wf_d_list_free(dlist);
+	g_info("Simulated %u of %u picks from %u songs", n, picks, count);
 
-		return NULL;
-	}
-	else
-	{
-		container->total_entries = full_sum;
+	g_free(weights);
+	g_free(durations);
+	wf_intelligence_columns_clear(&columns);
+	wf_sampler_free(sampler);
 
-		return dlist;
-	}
+	return counts;
 }
 
-static WfSong *
-wf_intelligence_pick_winner(WfIntelligenceContainer *container, WfDList *list)
-{
-	WfSong *song, *winner = NULL;
-	WfDList *item;
-	gint entries, total;
-	guint rand;
-	guint64 sum = 0;
+/* MODULE FUNCTIONS END */
 
-	g_return_val_if_fail(container != NULL, NULL);
+/* MODULE UTILITIES BEGIN */
 
-	if (list == NULL)
+// Expand @seed into the full state of @random, as recommended for xoshiro
+static void
+wf_intelligence_random_seed(WfIntelligenceRandom *random, guint64 seed)
+{
+	gint i;
+
+	for (i = 0; i < 4; i++)
 	{
-		// No songs available
-		return NULL;
+		random->state[i] = wf_intelligence_splitmix64(&seed);
 	}
 
-	total = container->total_entries;
-
-	g_return_val_if_fail(total > 0, NULL);
+	random->seeded = TRUE;
+}
 
-	// Pick a winner
-	rand = wf_intelligence_random(1, total);
+static guint64
+wf_intelligence_random(WfIntelligenceRandom *random, guint64 lower, guint64 upper)
+{
+	/*
+	 * Returns a value in the range [lower; upper].
+	 *
+	 * Simply taking the remainder of a random value would favor the lower
+	 * values whenever the range does not divide 2^64.  To prevent that, the
+	 * values below 2^64 % range (the incomplete last "round") are rejected
+	 * and drawn again.  That is never more than half of all values and
+	 * usually only a tiny fraction, so this hardly ever loops.
+	 */
 
-	for (item = list; item != NULL; item = item->next)
-	{
-		entries = GPOINTER_TO_INT(item->value);
+	guint64 range, threshold, value;
 
-		if (entries <= 0)
-		{
-			g_debug("Invalid entry count %d/%d", entries, total);
-			continue;
-		}
-		else
-		{
-			sum += entries;
-		}
+	g_return_val_if_fail(upper >= lower, lower);
 
-		if (sum >= rand)
-		{
-			// Now find the item
-			song = item->key;
+	range = upper - lower + 1;
 
-			if (song == NULL)
-			{
-				// Try next item
-				g_debug("Invalid song while choosing one");
-				continue;
-			}
-			else
-			{
-				// Found the winner
-				winner = song;
-				break;
-			}
-		}
+	if (range == 0)
+	{
+		// The full 64-bit range has been requested
+		return wf_intelligence_random_next(random);
 	}
 
-	if (winner == NULL)
-	{
-		g_warning("Failed to draw a winner (entry %d/%d)", rand, total);
+	// Same as (2^64 - range) % range, so 2^64 % range
+	threshold = (0 - range) % range;
 
-		return NULL;
-	}
-	else
+	do
 	{
-		g_info("Winner (entry %d/%d): %s", rand, total, wf_song_get_name_not_empty(winner));
-
-		return winner;
+		value = wf_intelligence_random_next(random);
 	}
+	while (value < threshold);
+
+	return (value % range) + lower;
 }
 
-/*
- * wf_intelligence_choose_new_song:
- * @library: (element-type WfSong): pointer to the full list with songs to filter
- * @previous_songs: (element-type WfSong): list of previously played songs
- * @play_next: (element-type WfSong): list of songs selected to play next
- * @recent_artists: (element-type guint32): list of recent artists
- * @filer: filter parameters to use
- * @entries: probability parameters to use
- *
- * Walk through the complete algorithm to choose a new song.
- *
- * Please note that @library is a pointer to the pointer of the first list
- * node.  Because the list may be filtered and as such the first item may also
- * be removed, changing the pointer to the first list node.  When the caller
- * tries to free the list, this would, without any ownership transfers, cause a
- * free on an already freed node.  By providing the pointer to the pointer of
- * the first node, the pointer of the first node can be changed and safely
- * freed later.
- *
- * Returns: a chosen song
- */
-WfSong *
-wf_intelligence_choose_new_song(GList **library,
-                                GList *previous_songs,
-                                GList *play_next,
-                                GList *recent_artists,
-                                WfSongFilter *filter,
-                                WfSongEntries *entries)
+static guint64
+wf_intelligence_random_next(WfIntelligenceRandom *random)
 {
-	WfSong *new_song = NULL;
+	// xoshiro256** by David Blackman and Sebastiano Vigna (public domain)
+	guint64 *s = random->state;
+	guint64 result, t;
 
-	g_return_val_if_fail(library != NULL, NULL);
-
-	if (*library == NULL)
-	{
-		// No song to choose
-		return NULL;
-	}
-
-	if (filter != NULL)
+	if (!random->seeded)
 	{
-		*library = wf_intelligence_filter(*library, previous_songs, play_next, recent_artists, filter);
+		// Seed once from the global GLib generator
+		wf_intelligence_random_seed(random, ((guint64) g_random_int() << 32) | g_random_int());
 	}
 
-	if (entries != NULL)
-	{
-		new_song = wf_intelligence_get_song(*library, entries);
-	}
+	result = s[1] * 5;
+	result = ((result << 7) | (result >> 57)) * 9;
+	t = s[1] << 17;
 
-	return new_song;
-}
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
 
-/* MODULE FUNCTIONS END */
+	s[2] ^= t;
+	s[3] = (s[3] << 45) | (s[3] >> 19);
 
-/* MODULE UTILITIES BEGIN */
+	return result;
+}
 
-static guint
-wf_intelligence_random(gint lower, gint upper)
+static guint64
+wf_intelligence_splitmix64(guint64 *x)
 {
-	/*
-	 * Formula:
-	 * f(x) = (random_value % (entries - lowest_value + 1)) + lowest_value
-	 *
-	 * First, determine range:
-	 * 	Subtract the lowest possible value (usually 0) from the total
-	 * entries and add 1 (to include lower value in the range)
-	 * Then, get the random value in the specified range:
-	 * 	Divide range_value by the calculated range and take the remainder
-	 * (remainder from division is calculated using the % operator).
-	 * At last, calibrate the value so it fits within the given range:
-	 * 	Add the lowest value (from the input) to the calculated remainder.
-	 */
+	guint64 z;
 
-	GRand *rand = g_rand_new();
-	guint32 value = g_rand_int(rand);
+	z = (*x += G_GUINT64_CONSTANT(0x9E3779B97F4A7C15));
+	z = (z ^ (z >> 30)) * G_GUINT64_CONSTANT(0xBF58476D1CE4E5B9);
+	z = (z ^ (z >> 27)) * G_GUINT64_CONSTANT(0x94D049BB133111EB);
 
-	guint random = (value % (upper - lower + 1)) + lower;
+	return z ^ (z >> 31);
+}
 
-	g_rand_free(rand);
+static gint
+wf_intelligence_get_percentage_of_list(GList *list, gdouble percentage)
+{
+	if (list == NULL)
+	{
+		return 0;
+	}
 
-	return random;
+	return wf_intelligence_get_percentage_of_count(g_list_length(list), percentage);
 }
 
 static gint
-wf_intelligence_get_percentage_of_list(GList *list, gdouble percentage)
+wf_intelligence_get_percentage_of_count(gint total, gdouble percentage)
 {
 	const gdouble range_min = 0.0, range_max = 100.0;
-	gint total;
 
-	if (list == NULL || percentage <= range_min)
+	if (total <= 0 || percentage <= range_min)
 	{
 		return 0;
 	}
 
-	total = g_list_length(list);
-
 	if (percentage >= range_max)
 	{
 		return total;
@@ -1177,6 +2475,122 @@ wf_intelligence_use_lastplayed_filter(gboolean use, gint64 lastplayed_th)
 	}
 }
 
+static void
+wf_intelligence_columns_init(WfIntelligenceColumns *columns, guint capacity)
+{
+	*columns = (WfIntelligenceColumns) { 0 };
+	columns->capacity = MAX(capacity, 1);
+
+	columns->rating = g_new(gint, columns->capacity);
+	columns->score = g_new(gdouble, columns->capacity);
+	columns->playcount = g_new(gint, columns->capacity);
+	columns->skipcount = g_new(gint, columns->capacity);
+	columns->lastplayed = g_new(gint64, columns->capacity);
+	columns->entries = g_new(gint, columns->capacity);
+}
+
+// Make sure the columns hold at least @size elements
+static void
+wf_intelligence_columns_reserve(WfIntelligenceColumns *columns, guint size)
+{
+	if (size > columns->capacity)
+	{
+		columns->capacity = MAX(size, columns->capacity * 2);
+
+		columns->rating = g_renew(gint, columns->rating, columns->capacity);
+		columns->score = g_renew(gdouble, columns->score, columns->capacity);
+		columns->playcount = g_renew(gint, columns->playcount, columns->capacity);
+		columns->skipcount = g_renew(gint, columns->skipcount, columns->capacity);
+		columns->lastplayed = g_renew(gint64, columns->lastplayed, columns->capacity);
+		columns->entries = g_renew(gint, columns->entries, columns->capacity);
+	}
+
+	columns->size = MAX(size, columns->size);
+}
+
+// Copy the statistics of @song that @container uses into element @index
+static void
+wf_intelligence_columns_store(WfIntelligenceColumns *columns, guint index, const WfIntelligenceContainer *container, WfSong *song)
+{
+	gint rating = -1;
+	gdouble score = -1.0;
+	gint playcount = -1;
+	gint skipcount = -1;
+	gint64 lastplayed = -1;
+
+	wf_intelligence_columns_reserve(columns, index + 1);
+
+	if (container->rating_factor != 0)
+	{
+		rating = wf_song_get_rating(song);
+
+		if (!wf_stats_rating_is_valid(rating))
+		{
+			rating = -1;
+		}
+		else if (container->favor_low_ratings)
+		{
+			rating = wf_stats_rating_invert(rating);
+		}
+		else if (rating == 0)
+		{
+			rating = container->default_rating;
+		}
+	}
+
+	if (container->score_factor != 0)
+	{
+		score = wf_song_get_score(song);
+
+		if (!wf_stats_score_is_valid(score))
+		{
+			score = -1.0;
+		}
+		else if (container->favor_low_scores)
+		{
+			score = wf_stats_score_invert(score);
+		}
+	}
+
+	if (container->playcount_factor != 0)
+	{
+		playcount = wf_song_get_play_count(song);
+		playcount = wf_stats_playcount_is_valid(playcount) ? playcount : -1;
+	}
+
+	if (container->skipcount_factor != 0)
+	{
+		skipcount = wf_song_get_skip_count(song);
+		skipcount = wf_stats_skipcount_is_valid(skipcount) ? skipcount : -1;
+	}
+
+	if (container->lastplayed_factor != 0)
+	{
+		lastplayed = wf_song_get_last_played(song);
+		lastplayed = wf_stats_lastplayed_is_valid(lastplayed) ? lastplayed : -1;
+	}
+
+	columns->rating[index] = rating;
+	columns->score[index] = score;
+	columns->playcount[index] = playcount;
+	columns->skipcount[index] = skipcount;
+	columns->lastplayed[index] = lastplayed;
+	columns->entries[index] = -1;
+}
+
+static void
+wf_intelligence_columns_clear(WfIntelligenceColumns *columns)
+{
+	g_free(columns->rating);
+	g_free(columns->score);
+	g_free(columns->playcount);
+	g_free(columns->skipcount);
+	g_free(columns->lastplayed);
+	g_free(columns->entries);
+
+	*columns = (WfIntelligenceColumns) { 0 };
+}
+
 static gint
 wf_intelligence_sort_compare(gconstpointer a, gconstpointer b)
 {
@@ -1227,6 +2641,26 @@ wf_intelligence_sort_compare(gconstpointer a, gconstpointer b)
 	}
 }
 
+static gint
+wf_intelligence_played_compare(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	const WfIntelligenceCandidate *candidate_a = a, *candidate_b = b;
+
+	// Most recently played first
+	if (candidate_a->last_played > candidate_b->last_played)
+	{
+		return -1;
+	}
+	else if (candidate_a->last_played < candidate_b->last_played)
+	{
+		return 1;
+	}
+	else
+	{
+		return 0;
+	}
+}
+
 static gint
 wf_intelligence_calculate_entries_with_fraction(const gint x, const gint a, const gint r, const gboolean invert)
 {
@@ -1247,10 +2681,11 @@ wf_intelligence_calculate_entries_with_fraction(const gint x, const gint a, cons
 	gdouble numerator, denominator;
 	gint result;
 
-	// Preconditions
-	g_return_val_if_fail(a > 0, 0);
-	g_return_val_if_fail(r > 0, 0);
-	g_return_val_if_fail(x >= 0, 0);
+	/*
+	 * Preconditions: @a > 0, @r > 0 and @x >= 0.  These are guaranteed by
+	 * the callers and not checked here, as this runs inside the loops of
+	 * wf_intelligence_calculate_entries_batch().
+	 */
 
 	// Calculate
 	if (invert)
@@ -1266,9 +2701,6 @@ wf_intelligence_calculate_entries_with_fraction(const gint x, const gint a, cons
 		result = (gint) (numerator / denominator) + r;
 	}
 
-	// Check if valid and return
-	g_return_val_if_fail(result >= 0 && result <= r, result);
-
 	return result;
 }
 
@@ -1292,10 +2724,7 @@ wf_intelligence_calculate_entries_with_sqrt(const gint x, const gint a, const gi
 	gdouble numerator, denominator;
 	gint result;
 
-	// Preconditions
-	g_return_val_if_fail(a > 0, 0);
-	g_return_val_if_fail(r > 0, 0);
-	g_return_val_if_fail(x >= 0, 0);
+	// Preconditions: same as wf_intelligence_calculate_entries_with_fraction()
 
 	// Calculate
 	if (invert)
@@ -1311,9 +2740,6 @@ wf_intelligence_calculate_entries_with_sqrt(const gint x, const gint a, const gi
 		result = (gint) (numerator / denominator);
 	}
 
-	// Check if valid and return
-	g_return_val_if_fail(result >= 0 && result <= r, result);
-
 	return result;
 }
 
@@ -1368,6 +2794,39 @@ wf_intelligence_get_entries_time_since_inverted(gint64 time_since)
 /* MODULE UTILITIES END */
 
 /* DESTRUCTORS BEGIN */
+
+/*
+ * wf_intelligence_finalize:
+ *
+ * Free the candidate pool, the buffers kept between picks and the worker
+ * threads.  All of these are created again when a song is chosen.
+ */
+void
+wf_intelligence_finalize(void)
+{
+	wf_intelligence_pool_invalidate();
+
+	wf_intelligence_columns_clear(&ScratchData.columns);
+	g_free(ScratchData.keys);
+
+	if (ScratchData.sampler != NULL)
+	{
+		wf_sampler_free(ScratchData.sampler);
+	}
+
+	ScratchData = (WfIntelligenceScratch) { 0 };
+
+	if (WorkersData.pool != NULL)
+	{
+		// No calculation is running, as these are done before returning
+		g_thread_pool_free(WorkersData.pool, FALSE /* immediate */, TRUE /* wait */);
+		WorkersData.pool = NULL;
+	}
+
+	WorkersData.threads = 0;
+	WorkersData.failed = FALSE;
+}
+
 /* DESTRUCTORS END */
 
 /* END OF FILE */
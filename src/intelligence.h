@@ -151,6 +151,12 @@ struct _WfSongEntries
 
 /* MODULE TYPES END */
 
+/* GETTER/SETTER PROTOTYPES BEGIN */
+
+void wf_intelligence_set_seed(guint64 seed);
+
+/* GETTER/SETTER PROTOTYPES END */
+
 /* FUNCTION PROTOTYPES BEGIN */
 
 GList *
@@ -160,6 +166,8 @@ wf_intelligence_filter(GList *available_songs,
                        GList *recent_artists,
                        WfSongFilter *filter);
 
+guint * wf_intelligence_simulate(const WfSongEntries *entries, guint picks, guint64 seed, guint *length_rv);
+
 /* FUNCTION PROTOTYPES END */
 
 G_END_DECLS
@@ -28,6 +28,8 @@
 
 #include <woofer/song.h>
 #include <woofer/intelligence.h>
+#include <woofer/settings_private.h>
+#include <woofer/ring.h>
 
 /* INCLUDES END */
 
@@ -57,12 +59,37 @@ wf_intelligence_choose_new_song(GList **library,
                                 WfSongFilter *filter,
                                 WfSongEntries *entries);
 
+WfSong *
+wf_intelligence_pool_choose_new_song(WfSong *current,
+                                     const WfRing *previous_songs,
+                                     const WfRing *play_next,
+                                     const WfRing *recent_artists,
+                                     const WfSettingsSnapshot *settings);
+
+guint
+wf_intelligence_pool_choose_new_songs(WfSong *current,
+                                      const WfRing *previous_songs,
+                                      const WfRing *play_next,
+                                      const WfRing *recent_artists,
+                                      const WfSettingsSnapshot *settings,
+                                      WfSong **songs_rv,
+                                      guint amount);
+
+gboolean wf_intelligence_pool_song_is_eligible(WfSong *song, const WfSettingsSnapshot *settings);
+
+void wf_intelligence_pool_update_song(WfSong *song);
+void wf_intelligence_pool_remove_song(WfSong *song);
+void wf_intelligence_pool_invalidate(void);
+
 /* FUNCTION PROTOTYPES END */
 
 /* UTILITY PROTOTYPES BEGIN */
 /* UTILITY PROTOTYPES END */
 
 /* DESTRUCTOR PROTOTYPES BEGIN */
+
+void wf_intelligence_finalize(void);
+
 /* DESTRUCTOR PROTOTYPES END */
 
 G_END_DECLS
@@ -28,8 +28,10 @@
 /* INCLUDES BEGIN */
 
 // Library includes
+#include <string.h>
 #include <glib.h>
 #include <glib-object.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 
 // Global includes
@@ -38,14 +40,20 @@
 // Module includes
 #include <woofer/library.h>
 #include <woofer/library_private.h>
+#include <woofer/library_cache.h>
 
 // Dependency includes
 #include <woofer/song.h>
 #include <woofer/song_private.h>
+#include <woofer/song_metadata.h>
 #include <woofer/file_inspector.h>
+#include <woofer/library_monitor.h>
+#include <woofer/library_search.h>
+#include <woofer/intelligence_private.h>
+#include <woofer/settings.h>
 #include <woofer/utils.h>
 #include <woofer/utils_private.h>
-#include <woofer/memory.h>
+#include <woofer/metrics.h>
 
 // Resource includes
 /*< none >*/
@@ -87,11 +95,23 @@
  * the case when the file was written with a newer version and then opened with
  * an older version.
  */
-#define FILE_VERSION 20221201
+#define FILE_VERSION WF_LIBRARY_FILE_VERSION
 
 // If %TRUE, do not inspect dot files on add directory
 #define SKIP_DOT_FILES TRUE
 
+// Size of the read buffer used when parsing the library file
+#define STREAM_BUFFER_SIZE 65536
+
+// Amount of found files an asynchronous add turns into songs at once
+#define ADD_BATCH_SIZE 64
+
+// Songs waiting for metadata at which an asynchronous add is held back
+#define ADD_METADATA_BACKLOG 512
+
+// Time to wait before checking the metadata backlog again (milliseconds)
+#define ADD_BACKOFF_INTERVAL 100
+
 // Define static names used in the key_file.
 #define GROUP_PROPERTIES "Properties"
 #define NAME_VERSION "FileVersion"
@@ -110,41 +130,262 @@
 #define NAME_SKIPCOUNT "SkipCount"
 #define NAME_LASTPLAYED "LastPlayed"
 
+// Interval in which parsed metadata is applied on the main thread (ms)
+#define METADATA_BATCH_INTERVAL 100
+
+// Maximum amount of parsed results to apply on each interval
+#define METADATA_BATCH_SIZE 64
+
+// File attributes needed to check whether songs are up-to-date
+#define VERIFY_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+                          G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+                          G_FILE_ATTRIBUTE_TIME_MODIFIED
+
+// Amount of directories to check at the same time
+#define VERIFY_PARALLEL_DIRECTORIES 8
+
+// Amount of files to request from a directory at once
+#define VERIFY_BATCH_SIZE 200
+
+// Suffix of the journal file the changes of individual songs are appended to
+#define JOURNAL_SUFFIX ".journal"
+
+// Amount of journal records after which the library file is rewritten
+#define JOURNAL_COMPACT_LIMIT 1000
+
+// Default time to collect changes before writing them to disk (ms)
+#define WRITE_DELAY_DEFAULT 2000
+
+// Longest time to wait before trying again after failed writes (ms)
+#define WRITE_RETRY_DELAY_MAX (10 * 60 * 1000)
+
 /* DEFINES END */
 
 /* CUSTOM TYPES BEGIN */
 
 typedef struct _WfLibraryEvents WfLibraryEvents;
+typedef struct _WfLibraryChangeSet WfLibraryChangeSet;
 typedef struct _WfLibraryDetails WfLibraryDetails;
+typedef struct _WfLibraryMetadataJob WfLibraryMetadataJob;
+typedef struct _WfLibraryMetadataPool WfLibraryMetadataPool;
+typedef struct _WfLibraryWriteJob WfLibraryWriteJob;
+typedef struct _WfLibraryScan WfLibraryScan;
+typedef struct _WfLibraryVerify WfLibraryVerify;
+typedef struct _WfLibraryVerifyDir WfLibraryVerifyDir;
+typedef struct _WfLibrarySortItem WfLibrarySortItem;
+typedef struct _WfLibraryKey WfLibraryKey;
+typedef union _WfLibraryKeyValue WfLibraryKeyValue;
+typedef enum _WfLibraryKeyField WfLibraryKeyField;
+typedef enum _WfLibraryKeyType WfLibraryKeyType;
+typedef enum _WfLibraryChange WfLibraryChange;
+
+// Fields of a song group in the library file
+enum _WfLibraryKeyField
+{
+	WF_LIBRARY_KEY_URI,
+	WF_LIBRARY_KEY_LOCATION,
+	WF_LIBRARY_KEY_UPDATED,
+	WF_LIBRARY_KEY_TRACK_NUMBER,
+	WF_LIBRARY_KEY_TITLE,
+	WF_LIBRARY_KEY_ARTIST,
+	WF_LIBRARY_KEY_ALBUM_ARTIST,
+	WF_LIBRARY_KEY_ALBUM,
+	WF_LIBRARY_KEY_DURATION,
+	WF_LIBRARY_KEY_RATING,
+	WF_LIBRARY_KEY_SCORE,
+	WF_LIBRARY_KEY_PLAYCOUNT,
+	WF_LIBRARY_KEY_SKIPCOUNT,
+	WF_LIBRARY_KEY_LASTPLAYED,
+
+	WF_LIBRARY_KEY_COUNT
+};
+
+// How the value of a field is read
+enum _WfLibraryKeyType
+{
+	WF_LIBRARY_KEY_TYPE_STRING,
+	WF_LIBRARY_KEY_TYPE_INT, // Non-negative and within the range of #gint
+	WF_LIBRARY_KEY_TYPE_INT64, // Non-negative
+	WF_LIBRARY_KEY_TYPE_DOUBLE // Non-negative
+};
+
+struct _WfLibraryKey
+{
+	const gchar *name;
+	gsize length;
+
+	WfLibraryKeyField field;
+	WfLibraryKeyType type;
+};
+
+union _WfLibraryKeyValue
+{
+	gchar *string;
+	gint64 number;
+	gdouble real;
+};
 
 struct _WfLibraryEvents
 {
 	WfFuncStatsUpdated stats_updated;
+	WfFuncLoaded loaded;
+	WfFuncChanged changed;
+};
+
+// Kinds of changes to a single song, collected as flags (see wf_library_change_song())
+enum _WfLibraryChange
+{
+	WF_LIBRARY_CHANGE_NONE = 0,
+	WF_LIBRARY_CHANGE_UPDATED = 1 << 0,
+	WF_LIBRARY_CHANGE_MOVED = 1 << 1,
+	WF_LIBRARY_CHANGE_ADDED = 1 << 2,
+	WF_LIBRARY_CHANGE_REMOVED = 1 << 3
+};
+
+// Changes collected until the main loop is idle again
+struct _WfLibraryChangeSet
+{
+	GHashTable *songs; // #WfSong (reference owned) to #WfLibraryChange
+	GQueue order; // Songs in order of their first change, references held by @songs
+
+	gboolean reset;
+	guint source_id;
+};
+
+// Position of a song in the library with the value to sort it by
+struct _WfLibrarySortItem
+{
+	guint index;
+	const gchar *key; // Interned sort key for text columns, %NULL if empty
+	gint value; // Value for numeric columns
+};
+
+// A single song to fetch the metadata for, passed between threads
+struct _WfLibraryMetadataJob
+{
+	WfSong *song; // Reference owned by the job
+	gchar *uri;
+	gboolean query_info; // Refresh the file information in the worker as well
+
+	GFileInfo *info; // Result of the query, %NULL if not queried or failed
+	gboolean missing; // The query found no file
+	WfSongMetadata *metadata; // Result, %NULL if parsing failed
+};
+
+// State of an asynchronous metadata update
+struct _WfLibraryMetadataPool
+{
+	GThreadPool *pool;
+	GAsyncQueue *results;
+	GCancellable *cancellable;
+	guint source_id;
+
+	gint total;
+	gint done;
+	gint updated;
+
+	WfFuncMetadataProgress progress_func;
+	WfFuncMetadataFinished finished_func;
+	gpointer user_data;
+};
+
+// Snapshot of changes to write to disk, safe to hand to another thread
+struct _WfLibraryWriteJob
+{
+	gchar *file_path;
+
+	// Full write: the complete library file and its cache
+	GKeyFile *key_file;
+	GByteArray *cache;
+	gboolean compress;
+
+	// Journal write: the records to append
+	gchar *journal;
+	gsize journal_length;
+	guint journal_records;
+
+	gboolean success;
+	gint64 started; // For the metrics, from taking the snapshot until finished
+};
+
+// State of the freshness check that precedes an asynchronous metadata update
+struct _WfLibraryVerify
+{
+	GCancellable *cancellable;
+	GQueue pending; // Directories (#WfLibraryVerifyDir) waiting to be checked
+	guint active; // Directories being checked
+
+	gint directories;
+	gint songs;
+
+	gint threads;
+	WfFuncMetadataProgress progress_func;
+	WfFuncMetadataFinished finished_func;
+	gpointer user_data;
+};
+
+// The songs of a single directory to check
+struct _WfLibraryVerifyDir
+{
+	WfLibraryVerify *verify;
+
+	GFile *directory;
+	GHashTable *songs; // Basename -> #WfSong, removed once seen
+};
+
+// State of an asynchronous add, like wf_library_add_files_async()
+struct _WfLibraryScan
+{
+	GTask *task;
+	GCancellable *cancellable;
+
+	WfLibraryFileChecks checks;
+	gboolean skip_metadata;
+
+	GQueue roots; // Files and directories (#GFile) that still have to be scanned
+	GQueue found; // Files (#GFile) that passed the checks, waiting to be added
+	gboolean scanning;
+	guint source_id;
+
+	gint added;
+
+	WfFuncItemAdded func;
+	WfFuncAddFinished finished_func;
+	gpointer user_data;
 };
 
 struct _WfLibraryDetails
 {
 	WfLibraryEvents events;
+	WfLibraryChangeSet changes;
+
+	WfLibraryMetadataPool *metadata_pool;
+	WfLibraryVerify *metadata_verify;
+
+	// Songs waiting for a metadata update of their own (used as a set)
+	GHashTable *metadata_queue;
+	guint metadata_queue_id;
 
 	gboolean active;
+	gboolean lazy;
+	gboolean verify_pending; // Check for modified files once the lazy load is complete
 	gchar *default_path;
 	gchar *file_path;
 
-	GKeyFile *key_file;
-
 	gboolean write_queued;
 
-	gboolean track_number_column_empty;
-	gboolean title_column_empty;
-	gboolean artist_column_empty;
-	gboolean album_column_empty;
-	gboolean duration_column_empty;
-
-	gboolean track_number_column_full;
-	gboolean title_column_full;
-	gboolean artist_column_full;
-	gboolean album_column_full;
-	gboolean duration_column_full;
+	// Songs with changes that have not been written yet (used as a set)
+	GHashTable *dirty_songs;
+	gint journal_records;
+
+	// Background writer
+	guint write_delay;
+	guint write_source_id;
+	guint write_failures; // Failed writes in a row, for backing off
+	GCancellable *write_cancellable; // Cancelled when the module is finalized
+	gboolean write_busy;
+	GMutex write_mutex;
+	GCond write_cond;
 };
 
 /* CUSTOM TYPES END */
@@ -152,26 +393,103 @@ struct _WfLibraryDetails
 /* FUNCTION PROTOTYPES BEGIN */
 
 static void wf_library_emit_stats_updated(WfLibraryEvents *events);
-
-static GKeyFile * wf_library_new_key_file(void);
-static gboolean wf_library_add_song_from_key_group(GKeyFile *key_file, const gchar *group);
+static void wf_library_emit_loaded(WfLibraryEvents *events);
+static void wf_library_emit_changed(WfLibraryEvents *events, const WfLibraryChanges *changes);
+static void wf_library_change_song(WfSong *song, WfLibraryChange change);
+static void wf_library_change_reset(void);
+static void wf_library_change_schedule(void);
+static gboolean wf_library_changes_cb(gpointer user_data);
+static void wf_library_change_set_clear(WfLibraryChangeSet *set);
+
+static gboolean wf_library_add_song_from_key_group(GKeyFile *key_file, const gchar *group, WfSong *existing);
+static const WfLibraryKey * wf_library_get_key(const gchar *key);
+static gboolean wf_library_read_key(GKeyFile *key_file, const gchar *group, const gchar *key, WfLibraryKeyType type, WfLibraryKeyValue *value_rv);
 static gint wf_library_update_metadata_internal(gboolean force);
-static void wf_library_parse_key_file(GKeyFile *key_file, gint *added_rv);
+static void wf_library_metadata_worker(gpointer data, gpointer user_data);
+static gboolean wf_library_metadata_batch_cb(gpointer user_data);
+static gboolean wf_library_metadata_queue_cb(gpointer user_data);
+static gboolean wf_library_metadata_pool_start(GSList *jobs, gint total, gint threads, WfFuncMetadataProgress progress_func, WfFuncMetadataFinished finished_func, gpointer user_data);
+static void wf_library_metadata_queue_start(void);
+static void wf_library_verify_start(gint threads, WfFuncMetadataProgress progress_func, WfFuncMetadataFinished finished_func, gpointer user_data);
+static void wf_library_verify_continue(WfLibraryVerify *verify);
+static void wf_library_verify_enumerate_cb(GObject *source, GAsyncResult *result, gpointer user_data);
+static void wf_library_verify_next_files_cb(GObject *source, GAsyncResult *result, gpointer user_data);
+static void wf_library_verify_dir_done(WfLibraryVerifyDir *dir, gboolean complete);
+static void wf_library_verify_finish(WfLibraryVerify *verify);
+static gboolean wf_library_parse_stream(const gchar *file_path, gint *added_rv);
+static gboolean wf_library_probe_stream(const gchar *file_path);
+static gboolean wf_library_parse_record(const GString *record, const gchar *file_path, gint *added);
 static GKeyFile * wf_library_parse_list(void);
 static gboolean wf_library_file_open(GKeyFile *key_file, const gchar *filename, GError **error);
 
+static WfSong * wf_library_add_song_internal(GFile *file, WfFuncItemAdded func, gboolean skip_metadata);
+static WfLibraryScan * wf_library_scan_new(WfFuncItemAdded func, WfLibraryFileChecks checks, gboolean skip_metadata, GCancellable *cancellable, WfFuncAddFinished finished_func, gpointer user_data);
+static void wf_library_scan_found_cb(GFile *file, WfFileInspectorType type, const gchar *mime, gpointer user_data);
+static void wf_library_scan_finished_cb(guint found, gboolean cancelled, gpointer user_data);
+static gboolean wf_library_scan_add_cb(gpointer user_data);
+static void wf_library_scan_done_cb(GObject *source_object, GAsyncResult *res, gpointer user_data);
+static void wf_library_scan_continue(WfLibraryScan *scan);
+static gint wf_library_metadata_get_backlog(void);
 static gint wf_library_add_uris_internal(GSList *files, gint *amount_rv, WfFuncItemAdded func, WfLibraryFileChecks checks, gboolean skip_metadata);
 static gint wf_library_add_files_internal(GSList *files, gint *amount_rv, WfFuncItemAdded func, WfLibraryFileChecks checks, gboolean skip_metadata);
 
+static gint wf_library_sort_compare_cb(gconstpointer a, gconstpointer b, gpointer user_data);
+static void wf_library_cache_loaded_cb(void);
+
 static void wf_library_update_key_file_item(GKeyFile *key_file, WfSong *song);
 static gboolean wf_library_check_file_compatible(GKeyFile *key_file, const gchar *file_path);
 
+static void wf_library_schedule_write(void);
+static gboolean wf_library_write_cb(gpointer user_data);
+static void wf_library_write_thread_cb(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable);
+static void wf_library_write_done_cb(GObject *source_object, GAsyncResult *res, gpointer user_data);
+static WfLibraryWriteJob * wf_library_write_job_new(gboolean force);
+static void wf_library_write_job_run(WfLibraryWriteJob *job);
+static gboolean wf_library_write_job_finish(WfLibraryWriteJob *job);
+static void wf_library_write_wait(void);
+
+static gchar * wf_library_get_journal_path(const gchar *file_path);
+static gchar * wf_library_journal_build(gsize *length_rv, guint *records_rv);
+static gboolean wf_library_journal_append(const gchar *file_path, const gchar *data, gsize length);
+static gint wf_library_journal_replay(const gchar *file_path);
+static gboolean wf_library_journal_clear(const gchar *file_path);
+
+static void wf_library_write_job_free(WfLibraryWriteJob *job);
+
+static void wf_library_metadata_job_free(WfLibraryMetadataJob *job);
+static void wf_library_metadata_pool_free(WfLibraryMetadataPool *pool);
+static void wf_library_verify_dir_free(WfLibraryVerifyDir *dir);
+static void wf_library_verify_free(WfLibraryVerify *verify);
+static void wf_library_scan_free(WfLibraryScan *scan);
+
 /* FUNCTION PROTOTYPES END */
 
 /* GLOBAL VARIABLES BEGIN */
 
 static WfLibraryDetails LibraryData = { 0 };
 
+// The keys of a song group, in the order they are applied
+#define LIBRARY_KEY(name, field, type) { name, sizeof(name) - 1, field, type }
+static const WfLibraryKey LibraryKeys[] =
+{
+	LIBRARY_KEY(NAME_URI, WF_LIBRARY_KEY_URI, WF_LIBRARY_KEY_TYPE_STRING),
+	LIBRARY_KEY(NAME_LOCATION, WF_LIBRARY_KEY_LOCATION, WF_LIBRARY_KEY_TYPE_STRING),
+	LIBRARY_KEY(NAME_UPDATED, WF_LIBRARY_KEY_UPDATED, WF_LIBRARY_KEY_TYPE_INT64),
+	LIBRARY_KEY(NAME_TRACK_NUMBER, WF_LIBRARY_KEY_TRACK_NUMBER, WF_LIBRARY_KEY_TYPE_INT),
+	LIBRARY_KEY(NAME_TITLE, WF_LIBRARY_KEY_TITLE, WF_LIBRARY_KEY_TYPE_STRING),
+	LIBRARY_KEY(NAME_ARTIST, WF_LIBRARY_KEY_ARTIST, WF_LIBRARY_KEY_TYPE_STRING),
+	LIBRARY_KEY(NAME_ALBUM_ARTIST, WF_LIBRARY_KEY_ALBUM_ARTIST, WF_LIBRARY_KEY_TYPE_STRING),
+	LIBRARY_KEY(NAME_ALBUM, WF_LIBRARY_KEY_ALBUM, WF_LIBRARY_KEY_TYPE_STRING),
+	LIBRARY_KEY(NAME_DURATION, WF_LIBRARY_KEY_DURATION, WF_LIBRARY_KEY_TYPE_INT),
+	LIBRARY_KEY(NAME_RATING, WF_LIBRARY_KEY_RATING, WF_LIBRARY_KEY_TYPE_INT),
+	LIBRARY_KEY(NAME_SCORE, WF_LIBRARY_KEY_SCORE, WF_LIBRARY_KEY_TYPE_DOUBLE),
+	LIBRARY_KEY(NAME_PLAYCOUNT, WF_LIBRARY_KEY_PLAYCOUNT, WF_LIBRARY_KEY_TYPE_INT),
+	LIBRARY_KEY(NAME_SKIPCOUNT, WF_LIBRARY_KEY_SKIPCOUNT, WF_LIBRARY_KEY_TYPE_INT),
+	LIBRARY_KEY(NAME_LASTPLAYED, WF_LIBRARY_KEY_LASTPLAYED, WF_LIBRARY_KEY_TYPE_INT64),
+	{ NULL }
+};
+#undef LIBRARY_KEY
+
 /* GLOBAL VARIABLES END */
 
 /* CONSTRUCTORS BEGIN */
@@ -187,10 +505,39 @@ wf_library_init(void)
 	}
 
 	LibraryData.default_path = wf_utils_get_config_filepath(WF_LIBRARY_FILENAME, WF_TAG);
+	LibraryData.write_delay = WRITE_DELAY_DEFAULT;
+
+	g_mutex_init(&LibraryData.write_mutex);
+	g_cond_init(&LibraryData.write_cond);
+	LibraryData.write_cancellable = g_cancellable_new();
 
 	LibraryData.active = TRUE;
 }
 
+static WfLibraryScan *
+wf_library_scan_new(WfFuncItemAdded func, WfLibraryFileChecks checks, gboolean skip_metadata, GCancellable *cancellable, WfFuncAddFinished finished_func, gpointer user_data)
+{
+	WfLibraryScan *scan;
+
+	scan = g_slice_new0(WfLibraryScan);
+	scan->cancellable = (cancellable != NULL) ? g_object_ref(cancellable) : g_cancellable_new();
+	scan->checks = ((checks <= 0) ? WF_LIBRARY_CHECK_DEFAULT : checks);
+	scan->skip_metadata = skip_metadata;
+	scan->func = func;
+	scan->finished_func = finished_func;
+	scan->user_data = user_data;
+	g_queue_init(&scan->roots);
+	g_queue_init(&scan->found);
+
+	scan->task = g_task_new(NULL /* source_object */, scan->cancellable, wf_library_scan_done_cb, NULL /* user_data */);
+	g_task_set_task_data(scan->task, scan, (GDestroyNotify) wf_library_scan_free);
+
+	// Report what has been added before the cancellation as well
+	g_task_set_check_cancellable(scan->task, FALSE);
+
+	return scan;
+}
+
 /* CONSTRUCTORS END */
 
 /* GETTERS/SETTERS BEGIN */
@@ -201,6 +548,33 @@ wf_library_connect_event_stats_updated(WfFuncStatsUpdated cb_func)
 	LibraryData.events.stats_updated = cb_func;
 }
 
+void
+wf_library_connect_event_loaded(WfFuncLoaded cb_func)
+{
+	LibraryData.events.loaded = cb_func;
+}
+
+/*
+ * wf_library_connect_event_changed:
+ * @cb_func: (nullable): function to call with the collected changes
+ *
+ * Connects a function to call with all songs that have been added, moved,
+ * updated or removed, collected until the main loop is idle again.  This
+ * event is emitted at most once per main loop iteration, so a front-end can
+ * update its view of the library in one go instead of once per song.  Changes
+ * are only collected while a function is connected.
+ */
+void
+wf_library_connect_event_changed(WfFuncChanged cb_func)
+{
+	LibraryData.events.changed = cb_func;
+
+	if (cb_func == NULL)
+	{
+		wf_library_change_set_clear(&LibraryData.changes);
+	}
+}
+
 /**
  * wf_library_set_file:
  * @file_path: (transfer none) (nullable): path to the library file to use
@@ -238,58 +612,116 @@ wf_library_get_file(void)
 	return (file_path != NULL) ? file_path : default_path;
 }
 
+/**
+ * wf_library_set_write_delay:
+ * @milliseconds: time to collect changes before writing them
+ *
+ * Sets the time changes to the library are collected before they are written
+ * to disk in the background.  All changes made within this window are written
+ * at once.  Use 0 to write changes as soon as the main loop is idle.
+ *
+ * Since: 0.3
+ **/
+void
+wf_library_set_write_delay(guint milliseconds)
+{
+	LibraryData.write_delay = milliseconds;
+}
+
+/**
+ * wf_library_set_lazy_loading:
+ * @lazy: %TRUE to load the library lazily
+ *
+ * Sets whether the library is loaded lazily the next time it is read.  If
+ * so, and the binary cache of the library file can be used, only what is
+ * needed to choose and play songs is read right away.  The other information
+ * of the songs, like their titles and albums, is filled in while the main
+ * loop is idle; the loaded event is emitted once that is done.  Files that
+ * have been modified since their last update are then looked for in the
+ * background as well.  This makes the startup with very large libraries a lot
+ * faster.
+ *
+ * Songs that are about to be played are completed right away, as is the whole
+ * library when it is searched, sorted or written.  Interfaces that show the
+ * whole library should wait for the loaded event, or check
+ * wf_library_is_loading(), before relying on the song information.
+ *
+ * Since: 0.3
+ **/
+void
+wf_library_set_lazy_loading(gboolean lazy)
+{
+	LibraryData.lazy = lazy;
+}
+
+/**
+ * wf_library_is_loading:
+ *
+ * Gets whether songs of a lazily loaded library are still incomplete.  See
+ * wf_library_set_lazy_loading().
+ *
+ * Returns: %TRUE if the library is still being loaded
+ *
+ * Since: 0.3
+ **/
+gboolean
+wf_library_is_loading(void)
+{
+	return wf_library_cache_is_loading();
+}
+
 gboolean
 wf_library_track_number_column_is_empty(void)
 {
-	return LibraryData.track_number_column_empty;
+	return (wf_song_get_column_counts()->track_number == 0);
 }
 
 gboolean
 wf_library_title_column_is_empty(void)
 {
-	return LibraryData.title_column_empty;
+	return (wf_song_get_column_counts()->title == 0);
 }
 
 gboolean
 wf_library_artist_column_is_empty(void)
 {
-	return LibraryData.artist_column_empty;
+	return (wf_song_get_column_counts()->artist == 0);
 }
 
 gboolean
 wf_library_album_column_is_empty(void)
 {
-	return LibraryData.album_column_empty;
+	return (wf_song_get_column_counts()->album == 0);
 }
 
 gboolean
 wf_library_duration_column_is_empty(void)
 {
-	return LibraryData.duration_column_empty;
+	return (wf_song_get_column_counts()->duration == 0);
 }
 
 gboolean
 wf_library_track_number_column_is_full(void)
 {
-	return LibraryData.track_number_column_full;
+	return (wf_song_get_column_counts()->track_number == wf_song_get_count());
 }
 
 gboolean
 wf_library_title_column_is_full(void)
 {
-	return LibraryData.title_column_full;
+	return (wf_song_get_column_counts()->title == wf_song_get_count());
 }
 
 gboolean
 wf_library_artist_column_is_full(void)
 {
-	return LibraryData.artist_column_full;
+	return (wf_song_get_column_counts()->artist == wf_song_get_count());
 }
 
 gboolean
 wf_library_album_column_is_full(void)
 {
-	return LibraryData.album_column_full;
+	return (wf_song_get_column_counts()->album == wf_song_get_count());
 }
 
 GList *
@@ -301,654 +733,2126 @@ wf_library_get(void)
 	// Create a new #GList that can be freely used by the caller
 	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
 	{
-		list = g_list_append(list, song);
+		list = g_list_prepend(list, song);
 	}
 
-	return list;
+	// Prepended for speed, so restore the library order
+	return g_list_reverse(list);
 }
 
-/* GETTERS/SETTERS END */
+/**
+ * wf_library_get_sorted_index:
+ * @column: the column to sort by
+ * @descending: %TRUE to sort from high to low
+ * @length_rv: (out): return location for the number of items
+ *
+ * Sorts the library by @column, without changing the library itself.  Text
+ * columns are sorted by keys that are created when the metadata is set, so
+ * no string conversions have to be done while sorting.  Songs without a
+ * value for @column are always placed last.  The sort is stable, so songs
+ * with equal values keep their order in the library.
+ *
+ * Returns: (transfer full) (array length=length_rv) (nullable): the
+ * positions of the songs as returned by wf_library_get(), in sorted order;
+ * or %NULL if the library is empty
+ *
+ * Since: 0.3
+ **/
+guint *
+wf_library_get_sorted_index(WfLibrarySortColumn column, gboolean descending, gsize *length_rv)
+{
+	WfLibrarySortItem *items;
+	WfSong *song;
+	guint *index;
+	guint amount, n = 0;
 
-/* CALLBACK FUNCTIONS BEGIN */
-/* CALLBACK FUNCTIONS END */
+	g_return_val_if_fail(length_rv != NULL, NULL);
 
-/* MODULE FUNCTIONS BEGIN */
+	*length_rv = 0;
+	amount = wf_song_get_count();
 
-static void
-wf_library_emit_stats_updated(WfLibraryEvents *events)
-{
-	g_return_if_fail(events != NULL);
+	// The sort keys have to be there
+	wf_library_cache_load_all();
 
-	if (events->stats_updated != NULL)
+	if (amount == 0)
 	{
-		events->stats_updated();
+		return NULL;
 	}
-}
 
-static GKeyFile *
-wf_library_new_key_file(void)
-{
-	// Free the old key_file, because we create a new one and overwrite the pointer anyway.
-	if (LibraryData.key_file != NULL)
+	items = g_new(WfLibrarySortItem, amount);
+
+	for (song = wf_song_get_first(); song != NULL && n < amount; song = wf_song_get_next(song), n++)
+	{
+		items[n].index = n;
+		items[n].key = NULL;
+		items[n].value = 0;
+
+		switch (column)
+		{
+			case WF_LIBRARY_SORT_TITLE:
+				items[n].key = wf_song_get_title_key(song);
+				break;
+			case WF_LIBRARY_SORT_ARTIST:
+				items[n].key = wf_song_get_artist_key(song);
+				break;
+			case WF_LIBRARY_SORT_ALBUM:
+				items[n].key = wf_song_get_album_key(song);
+				break;
+			case WF_LIBRARY_SORT_TRACK_NUMBER:
+				items[n].value = wf_song_get_track_number(song);
+				break;
+			case WF_LIBRARY_SORT_DURATION:
+				items[n].value = wf_song_get_duration(song);
+				break;
+		}
+	}
+
+	g_qsort_with_data(items, n, sizeof(WfLibrarySortItem), wf_library_sort_compare_cb, GINT_TO_POINTER(descending));
+
+	index = g_new(guint, n);
+
+	for (amount = 0; amount < n; amount++)
 	{
-		g_key_file_free(LibraryData.key_file);
+		index[amount] = items[amount].index;
 	}
 
-	LibraryData.key_file = g_key_file_new();
+	g_free(items);
+
+	*length_rv = n;
 
-	return LibraryData.key_file;
+	return index;
 }
 
-static gboolean
-wf_library_add_song_from_key_group(GKeyFile *key_file, const gchar *group)
+/**
+ * wf_library_search:
+ * @query: the text to search for
+ *
+ * Searches the library for songs matching @query.  Every word in @query has
+ * to be the start of a word in the title, artist, album artist, album or
+ * filename of a song.  Case and accents are ignored.  The library keeps an
+ * index of these words, so this does not need to go through all songs.
+ *
+ * Returns: (transfer container) (element-type WfSong) (nullable): the
+ * matching songs in no particular order, or %NULL if none match
+ *
+ * Since: 0.3
+ **/
+GList *
+wf_library_search(const gchar *query)
 {
-	WfSong *song = NULL;
-	GError *err = NULL;
-	gboolean uri_set;
-	gchar *uri;
-	gchar *key;
-	gchar **keyArray;
-	gsize keyLength;
-	guint x;
+	g_return_val_if_fail(query != NULL, NULL);
 
-	gint intValue;
-	gdouble doubleValue;
-	gint64 int64Value;
-	gchar *gcharValue;
+	// Only complete songs are in the index
+	wf_library_cache_load_all();
 
-	g_return_val_if_fail(group != NULL, FALSE);
+	return wf_library_search_query(query);
+}
 
-	keyArray = g_key_file_get_keys(key_file, group, &keyLength, &err);
+/* GETTERS/SETTERS END */
 
-	if (err != NULL)
-	{
-		g_warning("Error occurred while getting keys from file: %s", err->message);
-		g_error_free(err);
+/* CALLBACK FUNCTIONS BEGIN */
 
-		return FALSE;
-	}
+// All songs of a lazily loaded library are complete
+static void
+wf_library_cache_loaded_cb(void)
+{
+	g_info("All songs of the library are complete");
 
-	// Go through all keys of this particular song
-	for (x = 0; x < keyLength; x++)
+	if (LibraryData.verify_pending)
 	{
-		key = keyArray[x];
-		uri_set = FALSE;
+		LibraryData.verify_pending = FALSE;
+		wf_library_update_metadata_async(FALSE /* force */, 0 /* threads */, NULL /* progress_func */, NULL /* finished_func */, NULL /* user_data */);
+	}
+
+	wf_library_emit_loaded(&LibraryData.events);
+}
+
+// Compare two #WfLibrarySortItem for g_qsort_with_data(), which is stable
+static gint
+wf_library_sort_compare_cb(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	const WfLibrarySortItem *item_a = a;
+	const WfLibrarySortItem *item_b = b;
+	gboolean descending = GPOINTER_TO_INT(user_data);
+	gint result;
 
-		if (key == NULL)
+	// Keys are interned, so equal keys are also the same pointer
+	if (item_a->key != item_b->key)
+	{
+		// Empty values go last, regardless of the direction
+		if (item_a->key == NULL)
 		{
-			// End of key array
-			break;
+			return 1;
 		}
-		else if (g_strcmp0(g_utf8_strdown(key, -1), g_utf8_strdown(GROUP_PROPERTIES, -1)) == 0)
+		else if (item_b->key == NULL)
 		{
-			// Not a song
-			return FALSE;
+			return -1;
 		}
 
-		// Vars starting with a capital letter are defined statically
-		if (g_strcmp0(g_utf8_strdown(key, -1), g_utf8_strdown(NAME_URI, -1)) == 0)
+		result = strcmp(item_a->key, item_b->key);
+	}
+	else if (item_a->value != item_b->value)
+	{
+		// Same goes for numeric columns without a value
+		if (item_a->value <= 0)
+		{
+			return 1;
+		}
+		else if (item_b->value <= 0)
 		{
-			gcharValue = g_key_file_get_string(key_file, group, key, &err);
+			return -1;
+		}
 
-			if (err != NULL)
-			{
-				g_warning("No file location for item %s due to: %s. This item will not be added.", group, err->message);
-				g_clear_error(&err);
-				break; // Stop handling keys
-			}
-			else if (gcharValue == NULL)
-			{
-				g_warning("No uri for item %s. This item will not be added.", group);
-				break;
-			}
-			else
-			{
-				song = wf_song_append_by_uri(gcharValue);
+		result = (item_a->value > item_b->value) ? 1 : -1;
+	}
+	else
+	{
+		result = 0;
+	}
 
-				uri_set = TRUE;
-			}
+	return descending ? -result : result;
+}
 
-			continue;
+/*
+ * Runs in one of the worker threads: parse the metadata of a single file and
+ * hand the result back to the main thread.  Nothing of the song object itself
+ * is touched here.
+ */
+static void
+wf_library_metadata_worker(gpointer data, gpointer user_data)
+{
+	WfLibraryMetadataJob *job = data;
+	WfLibraryMetadataPool *pool = user_data;
+	WfSongMetadata *metadata;
+	GError *err = NULL;
+	GFile *file;
+
+	if (job->query_info && !g_cancellable_is_cancelled(pool->cancellable))
+	{
+		file = g_file_new_for_uri(job->uri);
+		job->info = g_file_query_info(file, VERIFY_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, pool->cancellable, &err);
+		g_object_unref(file);
+
+		if (err != NULL)
+		{
+			job->missing = g_error_matches(err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+			g_clear_error(&err);
 		}
-		else if (g_strcmp0(g_utf8_strdown(key, -1), g_utf8_strdown(NAME_LOCATION, -1)) == 0)
+	}
+
+	if (!job->missing && !g_cancellable_is_cancelled(pool->cancellable))
+	{
+		metadata = wf_song_metadata_get_for_uri(job->uri);
+
+		if (metadata != NULL && !wf_song_metadata_parse(metadata))
 		{
-			// URI takes priority: If already set, skip this one
-			if (uri_set)
-			{
-				continue;
-			}
+			wf_song_metadata_free(metadata);
+			metadata = NULL;
+		}
 
-			gcharValue = g_key_file_get_string(key_file, group, key, &err);
+		job->metadata = metadata;
+	}
 
-			if (err != NULL)
-			{
-				g_message("Failed to read field %s (%s): %s", key, group, err->message);
-				g_clear_error(&err);
-			}
-			else if (gcharValue == NULL)
-			{
-				g_message("No value to for field %s", key);
-			}
-			else
-			{
-				uri = g_filename_to_uri(gcharValue, NULL /* hostname */, NULL /* GError */);
+	// Always push the job back, so the main thread can keep count
+	g_async_queue_push(pool->results, job);
+}
 
-				if (uri == NULL)
-				{
-					g_warning("Failed to get URI for location %s", gcharValue);
-				}
-				else
-				{
-					song = wf_song_append_by_uri(uri);
+// Apply a batch of parsed results on the main thread
+static gboolean
+wf_library_metadata_batch_cb(gpointer user_data)
+{
+	WfLibraryMetadataPool *pool = user_data;
+	WfLibraryMetadataJob *job;
+	gboolean cancelled;
+	gint n;
 
-					// Filename is converted to URI; save when done
-					LibraryData.write_queued = TRUE;
-				}
-			}
+	cancelled = g_cancellable_is_cancelled(pool->cancellable);
 
-			continue;
-		}
-		else if (g_strcmp0(g_utf8_strdown(key, -1), g_utf8_strdown(NAME_UPDATED, -1)) == 0)
+	for (n = 0; n < METADATA_BATCH_SIZE; n++)
+	{
+		job = g_async_queue_try_pop(pool->results);
+
+		if (job == NULL)
 		{
-			int64Value = g_key_file_get_int64(key_file, group, key, &err);
+			break;
+		}
 
-			if (err != NULL)
-			{
-				g_message("Failed to read field %s (%s): %s", key, group, err->message);
-				g_clear_error(&err);
-			}
-			else if (int64Value < 0)
+		// Songs may have been removed in the meantime
+		if (!cancelled && wf_song_is_in_list(job->song))
+		{
+			if (job->info != NULL)
 			{
-				g_debug("Invalid %s: %ld", key, (long int) int64Value);
+				wf_song_set_fs_info(job->song, job->info);
 			}
-			else if (int64Value != 0)
+			else if (job->missing)
 			{
-				wf_song_set_metadata_updated(song, int64Value);
+				wf_song_set_file_missing(job->song);
 			}
+		}
 
-			continue;
-		}
-		else if (g_strcmp0(g_utf8_strdown(key, -1), g_utf8_strdown(NAME_TRACK_NUMBER, -1)) == 0)
+		if (job->metadata != NULL && !cancelled && wf_song_is_in_list(job->song))
 		{
-			intValue = g_key_file_get_integer(key_file, group, key, &err);
+			wf_song_apply_metadata(job->song, job->metadata);
+			wf_library_mark_song_dirty(job->song);
+			pool->updated++;
+		}
 
-			if (err != NULL)
-			{
-				g_message("Failed to read field %s (%s): %s", key, group, err->message);
-				g_clear_error(&err);
-			}
-			else
-			{
-				wf_song_set_track_number(song, intValue);
-			}
+		pool->done++;
 
-			continue;
-		}
-		else if (g_strcmp0(g_utf8_strdown(key, -1), g_utf8_strdown(NAME_TITLE, -1)) == 0)
-		{
-			gcharValue = g_key_file_get_string(key_file, group, key, &err);
+		wf_library_metadata_job_free(job);
+	}
 
-			if (err != NULL)
-			{
-				g_message("Failed to read field %s (%s): %s", key, group, err->message);
-				g_clear_error(&err);
-			}
-			else
-			{
-				wf_song_set_title(song, gcharValue);
-			}
+	if (n > 0 && pool->progress_func != NULL)
+	{
+		pool->progress_func(pool->done, pool->total, pool->user_data);
+	}
 
-			continue;
-		}
-		else if (g_strcmp0(g_utf8_strdown(key, -1), g_utf8_strdown(NAME_ARTIST, -1)) == 0)
-		{
-			gcharValue = g_key_file_get_string(key_file, group, key, &err);
+	if (pool->done < pool->total)
+	{
+		// Wait for more results to come in
+		return G_SOURCE_CONTINUE;
+	}
 
-			if (err != NULL)
-			{
-				g_message("Failed to read field %s (%s): %s", key, group, err->message);
-				g_clear_error(&err);
-			}
-			else
-			{
-				wf_song_set_artist(song, gcharValue);
-			}
+	g_info("Metadata update finished: %d of %d songs updated%s", pool->updated, pool->total, cancelled ? " (cancelled)" : "");
 
-			continue;
-		}
-		else if (g_strcmp0(g_utf8_strdown(key, -1), g_utf8_strdown(NAME_ALBUM_ARTIST, -1)) == 0)
-		{
-			gcharValue = g_key_file_get_string(key_file, group, key, &err);
+	// The source is removed by returning, so do not remove it twice
+	pool->source_id = 0;
 
-			if (err != NULL)
-			{
-				g_message("Failed to read field %s (%s): %s", key, group, err->message);
-				g_clear_error(&err);
-			}
-			else
-			{
-				wf_song_set_album_artist(song, gcharValue);
-			}
+	// Detach before notifying, so a new update may be started from the callback
+	LibraryData.metadata_pool = NULL;
 
-			continue;
-		}
-		else if (g_strcmp0(g_utf8_strdown(key, -1), g_utf8_strdown(NAME_ALBUM, -1)) == 0)
-		{
-			gcharValue = g_key_file_get_string(key_file, group, key, &err);
+	if (pool->finished_func != NULL)
+	{
+		pool->finished_func(pool->updated, cancelled, pool->user_data);
+	}
 
-			if (err != NULL)
-			{
-				g_message("Failed to read field %s (%s): %s", key, group, err->message);
-				g_clear_error(&err);
-			}
-			else
-			{
-				wf_song_set_album(song, gcharValue);
-			}
+	wf_library_metadata_pool_free(pool);
 
-			continue;
-		}
-		else if (g_strcmp0(g_utf8_strdown(key, -1), g_utf8_strdown(NAME_DURATION, -1)) == 0)
-		{
-			intValue = g_key_file_get_integer(key_file, group, key, &err);
+	// Handle songs that were queued while this update was running
+	wf_library_metadata_queue_start();
 
-			if (err != NULL)
-			{
-				g_message("Failed to read field %s (%s): %s", key, group, err->message);
-				g_clear_error(&err);
-			}
-			else if (intValue < 0)
-			{
-				g_debug("Invalid %s: %d", key, intValue);
-			}
-			else
-			{
-				wf_song_set_duration_seconds(song, intValue);
-			}
+	return G_SOURCE_REMOVE;
+}
 
-			continue;
-		}
-		else if (g_strcmp0(g_utf8_strdown(key, -1), g_utf8_strdown(NAME_RATING, -1)) == 0)
-		{
-			intValue = g_key_file_get_integer(key_file, group, key, &err);
+static void
+wf_library_verify_enumerate_cb(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	WfLibraryVerifyDir *dir = user_data;
+	GFileEnumerator *enumerator;
+	GError *err = NULL;
+	gchar *uri;
 
-			if (err != NULL)
-			{
-				g_warning("Error occurred while getting rating (int) for %s: %s", group, err->message);
-				g_clear_error(&err);
-			}
-			else if (intValue < 0)
-			{
-				g_debug("Invalid %s: %d", key, intValue);
-			}
-			else
-			{
-				wf_song_set_rating(song, intValue);
-			}
+	enumerator = g_file_enumerate_children_finish(G_FILE(source), result, &err);
 
-			continue;
+	if (enumerator == NULL)
+	{
+		if (g_error_matches(err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+		{
+			// The whole directory is gone, so are its songs
+			wf_library_verify_dir_done(dir, TRUE);
 		}
-		else if (g_strcmp0(g_utf8_strdown(key, -1), g_utf8_strdown(NAME_SCORE, -1)) == 0)
+		else
 		{
-			doubleValue = g_key_file_get_double(key_file, group, key, &err);
-
-			if (err != NULL)
-			{
-				g_warning("Error occurred while getting score (double) for %s: %s", group, err->message);
-				g_clear_error(&err);
-			}
-			else if (doubleValue < 0)
-			{
-				g_debug("Invalid %s: %f", key, doubleValue);
-			}
-			else
+			if (!g_error_matches(err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
 			{
-				wf_song_set_score(song, doubleValue);
+				uri = g_file_get_uri(dir->directory);
+				g_message("Could not check directory %s: %s", uri, err->message);
+				g_free(uri);
 			}
 
-			continue;
+			wf_library_verify_dir_done(dir, FALSE);
 		}
-		else if (g_strcmp0(g_utf8_strdown(key, -1), g_utf8_strdown(NAME_PLAYCOUNT, -1)) == 0)
-		{
-			intValue = g_key_file_get_integer(key_file, group, key, &err);
 
-			if (err != NULL)
-			{
-				g_warning("Error occurred while getting play count (int) for %s: %s", group, err->message);
-				g_clear_error(&err);
-			}
-			else if (intValue < 0)
-			{
-				g_debug("Invalid %s: %d", key, intValue);
-			}
-			else
-			{
-				wf_song_set_play_count(song, intValue);
-			}
+		g_error_free(err);
 
-			continue;
-		}
-		else if (g_strcmp0(g_utf8_strdown(key, -1), g_utf8_strdown(NAME_SKIPCOUNT, -1)) == 0)
+		return;
+	}
+
+	g_file_enumerator_next_files_async(enumerator, VERIFY_BATCH_SIZE, G_PRIORITY_LOW, dir->verify->cancellable, wf_library_verify_next_files_cb, dir);
+}
+
+static void
+wf_library_verify_next_files_cb(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	WfLibraryVerifyDir *dir = user_data;
+	GFileEnumerator *enumerator = G_FILE_ENUMERATOR(source);
+	GFileInfo *info;
+	GList *files, *l;
+	GError *err = NULL;
+	const gchar *name;
+	gchar *uri;
+	WfSong *song;
+	gboolean cancelled;
+
+	files = g_file_enumerator_next_files_finish(enumerator, result, &err);
+	cancelled = g_cancellable_is_cancelled(dir->verify->cancellable);
+
+	for (l = files; l != NULL && !cancelled; l = l->next)
+	{
+		info = l->data;
+		name = g_file_info_get_name(info);
+		song = g_hash_table_lookup(dir->songs, name);
+
+		if (song != NULL)
 		{
-			intValue = g_key_file_get_integer(key_file, group, key, &err);
+			wf_song_set_fs_info(song, info);
+			g_hash_table_remove(dir->songs, name);
+		}
+	}
 
-			if (err != NULL)
-			{
-				g_warning("Error occurred while getting skip count (int) for %s: %s", group, err->message);
-				g_clear_error(&err);
-			}
-			else if (intValue < 0)
-			{
-				g_debug("Invalid %s: %d", key, intValue);
-			}
-			else
-			{
-				wf_song_set_skip_count(song, intValue);
-			}
+	if (files != NULL && !cancelled && g_hash_table_size(dir->songs) > 0)
+	{
+		// Continue with the next batch
+		g_list_free_full(files, g_object_unref);
+		g_file_enumerator_next_files_async(enumerator, VERIFY_BATCH_SIZE, G_PRIORITY_LOW, dir->verify->cancellable, wf_library_verify_next_files_cb, dir);
+
+		return;
+	}
+
+	g_list_free_full(files, g_object_unref);
+	g_file_enumerator_close_async(enumerator, G_PRIORITY_LOW, NULL /* cancellable */, NULL /* callback */, NULL /* user_data */);
+	g_object_unref(enumerator);
+
+	if (err != NULL)
+	{
+		uri = g_file_get_uri(dir->directory);
+		g_message("Could not check directory %s: %s", uri, err->message);
+		g_free(uri);
+		g_error_free(err);
+
+		wf_library_verify_dir_done(dir, FALSE);
+	}
+	else
+	{
+		wf_library_verify_dir_done(dir, !cancelled);
+	}
+}
+
+static gboolean
+wf_library_metadata_queue_cb(gpointer user_data)
+{
+	LibraryData.metadata_queue_id = 0;
+
+	wf_library_metadata_queue_start();
+
+	return G_SOURCE_REMOVE;
+}
+
+// The main loop is idle; report everything collected so far at once
+static gboolean
+wf_library_changes_cb(gpointer user_data)
+{
+	WfLibraryChangeSet *set = &LibraryData.changes;
+	WfLibraryChanges changes = { 0 };
+	WfLibraryChange change;
+	GHashTable *songs;
+	WfSong *song;
+
+	set->source_id = 0;
+
+	// Take the set, so changes made by the event itself are collected anew
+	songs = set->songs;
+	set->songs = NULL;
 
+	changes.reset = set->reset;
+	set->reset = FALSE;
+
+	changes.added = g_ptr_array_new();
+	changes.moved = g_ptr_array_new();
+	changes.updated = g_ptr_array_new();
+	changes.removed = g_ptr_array_new();
+
+	while ((song = g_queue_pop_head(&set->order)) != NULL)
+	{
+		change = GPOINTER_TO_INT(g_hash_table_lookup(songs, song));
+
+		// Skip songs that were added and removed again in the meantime
+		if (!(change & WF_LIBRARY_CHANGE_REMOVED) && !wf_song_is_in_list(song))
+		{
 			continue;
 		}
-		else if (g_strcmp0(g_utf8_strdown(key, -1), g_utf8_strdown(NAME_LASTPLAYED, -1)) == 0)
-		{
-			int64Value = g_key_file_get_int64(key_file, group, key, &err);
 
-			if (err != NULL)
-			{
-				g_warning("Error occurred while getting last played (int64) for %s: %s", group, err->message);
-				g_clear_error(&err);
-			}
-			else if (int64Value < 0)
+		// A new or removed song is reported as such only, anything else as all that happened
+		if (change & WF_LIBRARY_CHANGE_ADDED)
+		{
+			g_ptr_array_add(changes.added, song);
+		}
+		else if (change & WF_LIBRARY_CHANGE_REMOVED)
+		{
+			g_ptr_array_add(changes.removed, song);
+		}
+		else
+		{
+			if (change & WF_LIBRARY_CHANGE_MOVED)
 			{
-				g_debug("Invalid %s: %ld", key, (long int) int64Value);
+				g_ptr_array_add(changes.moved, song);
 			}
-			else
+
+			if (change & WF_LIBRARY_CHANGE_UPDATED)
 			{
-				wf_song_set_last_played(song, int64Value);
+				g_ptr_array_add(changes.updated, song);
 			}
-
-			continue;
 		}
 	}
 
-	if (song != NULL)
+	wf_library_emit_changed(&LibraryData.events, &changes);
+
+	g_ptr_array_unref(changes.added);
+	g_ptr_array_unref(changes.moved);
+	g_ptr_array_unref(changes.updated);
+	g_ptr_array_unref(changes.removed);
+
+	// Only now drop the references of removed songs
+	if (songs != NULL)
 	{
-		// Set the tag found in the file
-		wf_song_set_tag(song, group);
+		g_hash_table_unref(songs);
 	}
 
-	g_strfreev(keyArray);
-
-	return TRUE;
+	return G_SOURCE_REMOVE;
 }
 
-static gint
-wf_library_update_metadata_internal(gboolean force)
+// The write delay has passed; write everything collected so far
+static gboolean
+wf_library_write_cb(gpointer user_data)
 {
-	WfSong *song;
-	gint n = 0;
+	WfLibraryWriteJob *job;
+	GTask *task;
 
-	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	LibraryData.write_source_id = 0;
+
+	if (LibraryData.write_busy)
 	{
-		if (wf_song_update_metadata(song, force))
-		{
-			n++;
-		}
+		// Another write is still running; try again when that one is done
+		return G_SOURCE_REMOVE;
 	}
 
-	if (n > 0)
+	job = wf_library_write_job_new(FALSE /* force */);
+
+	if (job == NULL)
 	{
-		// Write library to disk which include the newly fetched metadata
-		LibraryData.write_queued = TRUE;
+		return G_SOURCE_REMOVE;
 	}
 
-	return n;
+	g_mutex_lock(&LibraryData.write_mutex);
+	LibraryData.write_busy = TRUE;
+	g_mutex_unlock(&LibraryData.write_mutex);
+
+	task = g_task_new(NULL /* source_object */, LibraryData.write_cancellable, wf_library_write_done_cb, NULL /* user_data */);
+	g_task_set_task_data(task, job, (GDestroyNotify) wf_library_write_job_free);
+	g_task_run_in_thread(task, wf_library_write_thread_cb);
+	g_object_unref(task);
+
+	return G_SOURCE_REMOVE;
 }
 
-void
-wf_library_move_before(WfSong *song, WfSong *other_song)
+// Runs in a worker thread: only disk I/O happens here
+static void
+wf_library_write_thread_cb(GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
 {
-	wf_song_move_before(song, other_song);
+	WfLibraryWriteJob *job = task_data;
 
-	wf_library_queue_write();
+	wf_library_write_job_run(job);
+
+	// Let anyone waiting for this write (see wf_library_write()) continue
+	g_mutex_lock(&LibraryData.write_mutex);
+	LibraryData.write_busy = FALSE;
+	g_cond_broadcast(&LibraryData.write_cond);
+	g_mutex_unlock(&LibraryData.write_mutex);
+
+	g_task_return_boolean(task, job->success);
 }
 
-void
-wf_library_move_after(WfSong *song, WfSong *other_song)
+// Back on the main thread after a background write
+static void
+wf_library_write_done_cb(GObject *source_object, GAsyncResult *res, gpointer user_data)
 {
-	wf_song_move_after(song, other_song);
+	WfLibraryWriteJob *job = g_task_get_task_data(G_TASK(res));
 
-	wf_library_queue_write();
+	// The module has been finalized in the meantime
+	if (g_cancellable_is_cancelled(g_task_get_cancellable(G_TASK(res))))
+	{
+		return;
+	}
+
+	wf_library_write_job_finish(job);
+
+	// Changes may have been made in the meantime
+	if (LibraryData.write_queued ||
+	    (LibraryData.dirty_songs != NULL && g_hash_table_size(LibraryData.dirty_songs) > 0))
+	{
+		wf_library_schedule_write();
+	}
 }
 
-// Get GList from GKeyFile
 static void
-wf_library_parse_key_file(GKeyFile *key_file, gint *added_rv)
+wf_library_scan_found_cb(GFile *file, WfFileInspectorType type, const gchar *mime, gpointer user_data)
 {
-	gchar **groupArray, *group;
-	gsize groupLength = 0;
-	gint amount = 0;
-	guint x;
+	WfLibraryScan *scan = user_data;
+	gchar *uri;
+	gboolean do_add = FALSE;
 
-	g_return_if_fail(key_file != NULL);
+	// Files found after cancelling are not added anymore
+	if (g_cancellable_is_cancelled(scan->cancellable))
+	{
+		return;
+	}
 
-	groupArray = g_key_file_get_groups(key_file, &groupLength);
+	uri = g_file_get_uri(file);
 
-	if (groupLength > 0)
+	if (!wf_song_is_unique_uri(uri))
+	{
+		g_info("File %s already exists in library", uri);
+	}
+	else if (scan->checks == WF_LIBRARY_CHECK_NONE)
 	{
-		// Go through all songs (one group == one song)
-		for (x = 0; x < groupLength; x++)
+		do_add = TRUE;
+	}
+	else
+	{
+		switch (type)
 		{
-			group = groupArray[x];
-
-			if (group == NULL)
-			{
-				// End of string array
+			case WF_FILE_INSPECTOR_TYPE_MIME_UNKNOWN:
+				g_message("Could not get mime type of %s. This file will not be added to the library", uri);
+				break;
+			case WF_FILE_INSPECTOR_TYPE_MIME_AUDIO:
+				do_add = (scan->checks == WF_LIBRARY_CHECK_AUDIO || scan->checks == WF_LIBRARY_CHECK_MEDIA);
+				break;
+			case WF_FILE_INSPECTOR_TYPE_MIME_MEDIA:
+				do_add = (scan->checks == WF_LIBRARY_CHECK_MEDIA);
+				break;
+			case WF_FILE_INSPECTOR_TYPE_MIME_IRRELEVANT:
+				g_info("Found file %s with non-audio mime type <%s>. "
+					   "This file will not be added to the library", uri, mime);
+				break;
+			default:
+				// Directories are only of interest to the scanner
 				break;
-			}
-			else if (wf_library_add_song_from_key_group(key_file, group))
-			{
-				amount++;
-			}
 		}
+	}
+
+	if (do_add)
+	{
+		g_info("Found song %s", uri);
 
-		if (amount > 0)
+		// Added in batches, so a large directory does not hold up the main loop
+		g_queue_push_tail(&scan->found, g_object_ref(file));
+
+		if (scan->source_id == 0)
 		{
-			g_info("Found %d songs in song library file", amount);
+			scan->source_id = g_idle_add_full(G_PRIORITY_LOW, wf_library_scan_add_cb, scan, NULL /* notify */);
 		}
 	}
 
-	g_strfreev(groupArray);
-
-	// Update the provided value with the amount of added items
-	if (added_rv != NULL)
-	{
-		*added_rv = amount;
-	}
+	g_free(uri);
 }
 
-// Get GKeyFile from GList
-static GKeyFile *
-wf_library_parse_list(void)
+static void
+wf_library_scan_finished_cb(guint found, gboolean cancelled, gpointer user_data)
 {
-	WfSong *song;
-	GKeyFile *key_file;
+	WfLibraryScan *scan = user_data;
+
+	g_info("Scan finished, found %u files", found);
+
+	scan->scanning = FALSE;
+	wf_library_scan_continue(scan);
+}
+
+// Turn the next batch of found files into songs
+static gboolean
+wf_library_scan_add_cb(gpointer user_data)
+{
+	WfLibraryScan *scan = user_data;
+	WfSong *song;
+	GFile *file;
+	gchar *uri;
+	gint x;
+
+	if (g_cancellable_is_cancelled(scan->cancellable))
+	{
+		g_queue_clear_full(&scan->found, g_object_unref);
+	}
+	else if (!scan->skip_metadata && wf_library_metadata_get_backlog() >= ADD_METADATA_BACKLOG)
+	{
+		// Let the metadata workers catch up first
+		scan->source_id = g_timeout_add(ADD_BACKOFF_INTERVAL, wf_library_scan_add_cb, scan);
+
+		return G_SOURCE_REMOVE;
+	}
+
+	for (x = 0; x < ADD_BATCH_SIZE && !g_queue_is_empty(&scan->found); x++)
+	{
+		file = g_queue_pop_head(&scan->found);
+		uri = g_file_get_uri(file);
+
+		// It may have been found twice, or added in the meantime
+		if (wf_song_is_unique_uri(uri))
+		{
+			song = wf_library_add_song_internal(file, NULL /* func */, TRUE /* skip_metadata */);
+			scan->added++;
+
+			if (!scan->skip_metadata)
+			{
+				// Fetched by worker threads instead
+				wf_library_queue_metadata_update(song);
+			}
+
+			if (scan->func != NULL)
+			{
+				// The total includes the files found so far that are still waiting
+				scan->func(song, scan->added, scan->added + (gint) g_queue_get_length(&scan->found));
+			}
+		}
+
+		g_free(uri);
+		g_object_unref(file);
+	}
+
+	if (!g_queue_is_empty(&scan->found))
+	{
+		return G_SOURCE_CONTINUE;
+	}
+
+	scan->source_id = 0;
+	wf_library_scan_continue(scan);
+
+	return G_SOURCE_REMOVE;
+}
+
+// Report the end of an asynchronous add from the main context it started in
+static void
+wf_library_scan_done_cb(GObject *source_object, GAsyncResult *res, gpointer user_data)
+{
+	WfLibraryScan *scan = g_task_get_task_data(G_TASK(res));
+	gint added;
+
+	added = (gint) g_task_propagate_int(G_TASK(res), NULL /* error */);
+
+	g_info("Adding files finished, added %d songs", added);
+
+	if (scan->finished_func != NULL)
+	{
+		scan->finished_func(added, g_cancellable_is_cancelled(scan->cancellable), scan->user_data);
+	}
+}
+
+/* CALLBACK FUNCTIONS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+static void
+wf_library_emit_loaded(WfLibraryEvents *events)
+{
+	g_return_if_fail(events != NULL);
+
+	if (events->loaded != NULL)
+	{
+		events->loaded();
+	}
+}
+
+static void
+wf_library_emit_changed(WfLibraryEvents *events, const WfLibraryChanges *changes)
+{
+	g_return_if_fail(events != NULL);
+
+	if (events->changed != NULL)
+	{
+		events->changed(changes);
+	}
+}
+
+static void
+wf_library_emit_stats_updated(WfLibraryEvents *events)
+{
+	g_return_if_fail(events != NULL);
+
+	if (events->stats_updated != NULL)
+	{
+		events->stats_updated();
+	}
+}
+
+static gboolean
+wf_library_add_song_from_key_group(GKeyFile *key_file, const gchar *group, WfSong *existing)
+{
+	const WfLibraryKey *entry;
+	const gchar *keys[WF_LIBRARY_KEY_COUNT] = { NULL };
+	WfLibraryKeyValue value;
+	WfSong *song = existing;
+	GError *err = NULL;
+	gchar **keyArray;
+	gchar *uri;
+	gsize keyLength;
+	guint x;
+
+	g_return_val_if_fail(group != NULL, FALSE);
+
+	if (g_ascii_strcasecmp(group, GROUP_PROPERTIES) == 0)
+	{
+		// Not a song
+		return FALSE;
+	}
+
+	keyArray = g_key_file_get_keys(key_file, group, &keyLength, &err);
+
+	if (err != NULL)
+	{
+		g_warning("Error occurred while getting keys from file: %s", err->message);
+		g_error_free(err);
+
+		return FALSE;
+	}
+
+	// Find out which fields are present first (keys are case-insensitive)
+	for (x = 0; x < keyLength && keyArray[x] != NULL; x++)
+	{
+		entry = wf_library_get_key(keyArray[x]);
+
+		if (entry != NULL)
+		{
+			keys[entry->field] = keyArray[x];
+		}
+	}
+
+	// The song has to exist before anything else can be set
+	if (song == NULL && keys[WF_LIBRARY_KEY_URI] != NULL)
+	{
+		if (wf_library_read_key(key_file, group, keys[WF_LIBRARY_KEY_URI], WF_LIBRARY_KEY_TYPE_STRING, &value))
+		{
+			song = wf_song_append_by_uri(value.string);
+			g_free(value.string);
+		}
+	}
+	else if (song == NULL && keys[WF_LIBRARY_KEY_LOCATION] != NULL)
+	{
+		if (wf_library_read_key(key_file, group, keys[WF_LIBRARY_KEY_LOCATION], WF_LIBRARY_KEY_TYPE_STRING, &value))
+		{
+			uri = g_filename_to_uri(value.string, NULL /* hostname */, NULL /* GError */);
+
+			if (uri == NULL)
+			{
+				g_warning("Failed to get URI for location %s", value.string);
+			}
+			else
+			{
+				song = wf_song_append_by_uri(uri);
+
+				// Filename is converted to URI; save when done
+				wf_library_queue_write();
+			}
+
+			g_free(uri);
+			g_free(value.string);
+		}
+	}
+
+	if (song == NULL)
+	{
+		if (existing == NULL)
+		{
+			g_warning("No usable location for item %s. This item will not be added.", group);
+		}
+
+		g_strfreev(keyArray);
+
+		return FALSE;
+	}
+
+	for (entry = LibraryKeys; entry->name != NULL; entry++)
+	{
+		if (keys[entry->field] == NULL || entry->field == WF_LIBRARY_KEY_URI || entry->field == WF_LIBRARY_KEY_LOCATION)
+		{
+			continue;
+		}
+
+		if (!wf_library_read_key(key_file, group, keys[entry->field], entry->type, &value))
+		{
+			continue;
+		}
+
+		if ((entry->type == WF_LIBRARY_KEY_TYPE_INT && (value.number < 0 || value.number > G_MAXINT)) ||
+		    (entry->type == WF_LIBRARY_KEY_TYPE_INT64 && value.number < 0) ||
+		    (entry->type == WF_LIBRARY_KEY_TYPE_DOUBLE && value.real < 0))
+		{
+			g_debug("Invalid %s for %s", entry->name, group);
+
+			continue;
+		}
+
+		switch (entry->field)
+		{
+			case WF_LIBRARY_KEY_UPDATED:
+				if (value.number != 0)
+				{
+					wf_song_set_metadata_updated(song, value.number);
+				}
+				break;
+			case WF_LIBRARY_KEY_TRACK_NUMBER:
+				wf_song_set_track_number(song, (gint) value.number);
+				break;
+			case WF_LIBRARY_KEY_TITLE:
+				wf_song_set_title(song, value.string);
+				break;
+			case WF_LIBRARY_KEY_ARTIST:
+				wf_song_set_artist(song, value.string);
+				break;
+			case WF_LIBRARY_KEY_ALBUM_ARTIST:
+				wf_song_set_album_artist(song, value.string);
+				break;
+			case WF_LIBRARY_KEY_ALBUM:
+				wf_song_set_album(song, value.string);
+				break;
+			case WF_LIBRARY_KEY_DURATION:
+				wf_song_set_duration_seconds(song, (gint) value.number);
+				break;
+			case WF_LIBRARY_KEY_RATING:
+				wf_song_set_rating(song, (gint) value.number);
+				break;
+			case WF_LIBRARY_KEY_SCORE:
+				wf_song_set_score(song, value.real);
+				break;
+			case WF_LIBRARY_KEY_PLAYCOUNT:
+				wf_song_set_play_count(song, (gint) value.number);
+				break;
+			case WF_LIBRARY_KEY_SKIPCOUNT:
+				wf_song_set_skip_count(song, (gint) value.number);
+				break;
+			case WF_LIBRARY_KEY_LASTPLAYED:
+				wf_song_set_last_played(song, value.number);
+				break;
+			default:
+				break;
+		}
+
+		if (entry->type == WF_LIBRARY_KEY_TYPE_STRING)
+		{
+			// The setters intern their own copy
+			g_free(value.string);
+		}
+	}
+
+	if (existing == NULL)
+	{
+		// Set the tag found in the file
+		wf_song_set_tag(song, group);
+	}
+
+	g_strfreev(keyArray);
+
+	return TRUE;
+}
+
+// Find the field belonging to a key of a song group, ignoring case
+static const WfLibraryKey *
+wf_library_get_key(const gchar *key)
+{
+	const WfLibraryKey *entry;
+	gsize length = strlen(key);
+
+	for (entry = LibraryKeys; entry->name != NULL; entry++)
+	{
+		// Comparing the lengths first rules out nearly all keys for free
+		if (entry->length == length && g_ascii_strcasecmp(entry->name, key) == 0)
+		{
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+// Read the value of a key as @type; strings returned in @value_rv are owned by the caller
+static gboolean
+wf_library_read_key(GKeyFile *key_file, const gchar *group, const gchar *key, WfLibraryKeyType type, WfLibraryKeyValue *value_rv)
+{
+	GError *err = NULL;
+
+	switch (type)
+	{
+		case WF_LIBRARY_KEY_TYPE_STRING:
+			value_rv->string = g_key_file_get_string(key_file, group, key, &err);
+			break;
+		case WF_LIBRARY_KEY_TYPE_INT:
+		case WF_LIBRARY_KEY_TYPE_INT64:
+			value_rv->number = g_key_file_get_int64(key_file, group, key, &err);
+			break;
+		case WF_LIBRARY_KEY_TYPE_DOUBLE:
+			value_rv->real = g_key_file_get_double(key_file, group, key, &err);
+			break;
+	}
+
+	if (err != NULL)
+	{
+		g_message("Failed to read field %s (%s): %s", key, group, err->message);
+		g_error_free(err);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gint
+wf_library_update_metadata_internal(gboolean force)
+{
+	WfSong *song;
+	gint n = 0;
+
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	{
+		if (wf_song_update_metadata(song, force))
+		{
+			// Write the newly fetched metadata to disk
+			wf_library_mark_song_dirty(song);
+			n++;
+		}
+	}
+
+	return n;
+}
+
+void
+wf_library_move_before(WfSong *song, WfSong *other_song)
+{
+	wf_song_move_before(song, other_song);
+	wf_library_change_song(song, WF_LIBRARY_CHANGE_MOVED);
+
+	wf_library_queue_write();
+}
+
+void
+wf_library_move_after(WfSong *song, WfSong *other_song)
+{
+	wf_song_move_after(song, other_song);
+	wf_library_change_song(song, WF_LIBRARY_CHANGE_MOVED);
+
+	wf_library_queue_write();
+}
+
+/*
+ * Read the library file as a stream, one group (one song) at a time, instead
+ * of loading all of it into a #GKeyFile first.  The lines of a group are
+ * collected until the next group starts and are then parsed on their own, so
+ * only a single record is held in memory and songs are added while reading.
+ * Compressed library files are decompressed on the fly.
+ * Returns %FALSE if the file could not be read or is not compatible; the
+ * songs that have already been added are left for the caller to drop.
+ */
+static gboolean
+wf_library_parse_stream(const gchar *file_path, gint *added_rv)
+{
+	GInputStream *file_stream;
+	GDataInputStream *stream;
+	GString *record;
+	GError *err = NULL;
+	const gchar *start;
+	gchar *line;
+	gsize length;
+	gint amount = 0;
+	gboolean result = TRUE;
+
+	g_return_val_if_fail(file_path != NULL, FALSE);
+
+	file_stream = wf_utils_open_file_stream(file_path, &err);
+
+	if (file_stream == NULL)
+	{
+		g_info("Could not open library file %s: %s", file_path, err->message);
+		g_error_free(err);
+
+		return FALSE;
+	}
+
+	stream = g_data_input_stream_new(file_stream);
+	g_buffered_input_stream_set_buffer_size(G_BUFFERED_INPUT_STREAM(stream), STREAM_BUFFER_SIZE);
+	record = g_string_new(NULL);
+
+	while (result && (line = g_data_input_stream_read_line(stream, &length, NULL /* GCancellable */, &err)) != NULL)
+	{
+		start = line;
+
+		while (g_ascii_isspace(*start))
+		{
+			start++;
+		}
+
+		// A new group starts, so the one before is complete
+		if (*start == '[' && record->len > 0)
+		{
+			result = wf_library_parse_record(record, file_path, &amount);
+			g_string_truncate(record, 0);
+		}
+
+		g_string_append_len(record, line, length);
+		g_string_append_c(record, '\n');
+
+		g_free(line);
+	}
+
+	if (err != NULL)
+	{
+		g_warning("Failed to read library file %s: %s", file_path, err->message);
+		g_error_free(err);
+
+		result = FALSE;
+	}
+	else if (result && record->len > 0)
+	{
+		result = wf_library_parse_record(record, file_path, &amount);
+	}
+
+	g_string_free(record, TRUE);
+	g_object_unref(stream);
+	g_object_unref(file_stream);
+
+	if (!result)
+	{
+		amount = 0;
+	}
+	else if (amount > 0)
+	{
+		g_info("Found %d songs in song library file", amount);
+	}
+
+	// Update the provided value with the amount of added items
+	if (added_rv != NULL)
+	{
+		*added_rv = amount;
+	}
+
+	return result;
+}
+
+/*
+ * Check that the library file can be read and is compatible, by reading it up
+ * to the end of its first group (the properties, which are written first).
+ * Nothing is added to the library.
+ */
+static gboolean
+wf_library_probe_stream(const gchar *file_path)
+{
+	GInputStream *file_stream;
+	GDataInputStream *stream;
+	GKeyFile *key_file;
+	GString *record;
+	GError *err = NULL;
+	const gchar *start;
+	gchar *group;
+	gchar *line;
+	gsize length;
+	guint groups = 0;
+	gboolean result = TRUE;
+
+	g_return_val_if_fail(file_path != NULL, FALSE);
+
+	file_stream = wf_utils_open_file_stream(file_path, &err);
+
+	if (file_stream == NULL)
+	{
+		g_info("Could not open library file %s: %s", file_path, err->message);
+		g_error_free(err);
+
+		return FALSE;
+	}
+
+	stream = g_data_input_stream_new(file_stream);
+	record = g_string_new(NULL);
+
+	while ((line = g_data_input_stream_read_line(stream, &length, NULL /* GCancellable */, &err)) != NULL)
+	{
+		start = line;
+
+		while (g_ascii_isspace(*start))
+		{
+			start++;
+		}
+
+		// Stop once the second group starts
+		if (*start == '[' && ++groups > 1)
+		{
+			g_free(line);
+
+			break;
+		}
+
+		g_string_append_len(record, line, length);
+		g_string_append_c(record, '\n');
+
+		g_free(line);
+	}
+
+	if (err != NULL)
+	{
+		g_warning("Failed to read library file %s: %s", file_path, err->message);
+		g_error_free(err);
+
+		result = FALSE;
+	}
+	else
+	{
+		key_file = g_key_file_new();
+
+		// An invalid group is skipped when reading, so only the properties can rule the file out
+		if (g_key_file_load_from_data(key_file, record->str, record->len, G_KEY_FILE_NONE, NULL /* GError */))
+		{
+			group = g_key_file_get_start_group(key_file);
+
+			if (g_strcmp0(group, GROUP_PROPERTIES) == 0)
+			{
+				result = wf_library_check_file_compatible(key_file, file_path);
+			}
+
+			g_free(group);
+		}
+
+		g_key_file_free(key_file);
+	}
+
+	g_string_free(record, TRUE);
+	g_object_unref(stream);
+	g_object_unref(file_stream);
+
+	return result;
+}
+
+// Parse a single group of the library file; returns %FALSE to stop reading
+static gboolean
+wf_library_parse_record(const GString *record, const gchar *file_path, gint *added)
+{
+	GKeyFile *key_file;
+	GError *err = NULL;
+	gchar *group;
+	gboolean result = TRUE;
+
+	key_file = g_key_file_new();
+
+	if (!g_key_file_load_from_data(key_file, record->str, record->len, G_KEY_FILE_NONE, &err))
+	{
+		g_message("Skipping invalid part of library file %s: %s", file_path, err->message);
+		g_error_free(err);
+		g_key_file_free(key_file);
+
+		return TRUE;
+	}
+
+	// Comments before the first group do not have a group
+	group = g_key_file_get_start_group(key_file);
+
+	if (group == NULL)
+	{
+		result = TRUE;
+	}
+	else if (g_strcmp0(group, GROUP_PROPERTIES) == 0)
+	{
+		result = wf_library_check_file_compatible(key_file, file_path);
+	}
+	else if (wf_library_add_song_from_key_group(key_file, group, NULL /* existing */))
+	{
+		(*added)++;
+	}
+
+	g_free(group);
+	g_key_file_free(key_file);
+
+	return result;
+}
+
+// Get GKeyFile from GList
+static GKeyFile *
+wf_library_parse_list(void)
+{
+	WfSong *song;
+	GKeyFile *key_file;
 
 	g_debug("Generating library file...");
-	key_file = wf_library_new_key_file();
+	key_file = g_key_file_new();
+
+	g_key_file_set_comment(key_file, NULL /* group */, NULL /* key */,
+	                       "Note that any comment written to this file will "
+	                       "not be preserved when the software rewrites this "
+	                       "file.", NULL /* GError */);
+
+	// Set file version
+	g_key_file_set_integer(key_file, GROUP_PROPERTIES, NAME_VERSION, FILE_VERSION);
+
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	{
+		wf_library_update_key_file_item(key_file, song);
+	}
+
+	return key_file;
+}
+
+static gboolean
+wf_library_file_open(GKeyFile *key_file, const gchar *filename, GError **error)
+{
+	GError **file_error, *g_error = NULL;
+	gboolean result = FALSE;
+
+	g_return_val_if_fail(filename != NULL, FALSE);
+	g_return_val_if_fail(key_file != NULL, FALSE);
+
+	// If given, use the input GError; otherwise use the local pointer to printed the messages at the very least
+	if (error == NULL)
+	{
+		file_error = &g_error;
+	}
+	else
+	{
+		file_error = error;
+	}
+
+	if (!g_key_file_load_from_file(key_file, filename, G_KEY_FILE_KEEP_COMMENTS, file_error))
+	{
+		if (*file_error == NULL)
+		{
+			g_warning("Could not open file %s due to a unknown error", filename);
+		}
+		else
+		{
+			g_info("Could not open library file %s: %s", filename, (*file_error)->message);
+		}
+
+		result = FALSE;
+	}
+	else if (*file_error != NULL)
+	{
+		g_info("Successfully opened library file, but received an error: %s", (*file_error)->message);
+
+		result = TRUE;
+	}
+	else
+	{
+		result = TRUE;
+	}
+
+	// Only free if local GError was used
+	if (error == NULL && g_error != NULL)
+	{
+		g_error_free(g_error);
+	}
+
+	return result;
+}
+
+gboolean
+wf_library_read(void)
+{
+	const gchar *file = wf_library_get_file();
+	WfSongStash *stash;
+	gint added = 0;
+	gint64 start;
+
+	g_return_val_if_fail(file != NULL, FALSE);
+
+	start = wf_metrics_start();
+
+	// A missing, unreadable or incompatible file leaves the current library as it is
+	if (!wf_library_probe_stream(file))
+	{
+		wf_metrics_stop(WF_METRIC_LIBRARY_READ, start);
+
+		return FALSE;
+	}
+
+	// The current songs are complete when they have to be put back
+	wf_library_cache_load_all();
+
+	// Read into an empty library; the current songs are only replaced once that succeeded
+	stash = wf_song_stash_all();
+
+	// Use the binary snapshot if it still matches the library file
+	if (!wf_library_cache_read(file, FILE_VERSION, LibraryData.lazy ? wf_library_cache_loaded_cb : NULL, &added))
+	{
+		// Collect all songs from the file while reading it
+		if (!wf_library_parse_stream(file, &added))
+		{
+			wf_song_stash_restore(stash);
+			wf_metrics_stop(WF_METRIC_LIBRARY_READ, start);
+
+			return FALSE;
+		}
+
+		// Create a snapshot for the next time
+		wf_library_cache_write(file, FILE_VERSION, wf_settings_static_get_bool(WF_SETTING_COMPRESS_LIBRARY));
+	}
+
+	// Only now the current songs are gone
+	wf_intelligence_pool_invalidate();
+	wf_library_change_reset();
+	wf_song_stash_drop(stash);
+	LibraryData.verify_pending = FALSE;
+
+	// Apply the changes written after the library file
+	LibraryData.journal_records = wf_library_journal_replay(file);
+
+	if (!LibraryData.lazy)
+	{
+		// Check for any needed metadata updates (written in the background)
+		wf_library_update_metadata_internal(FALSE /* force */);
+	}
+	else if (wf_library_cache_is_loading())
+	{
+		// Looking at every file would hold up the startup, so wait until all songs are complete
+		LibraryData.verify_pending = TRUE;
+	}
+	else
+	{
+		// Find the modified files in the background, one directory listing at a time
+		wf_library_update_metadata_async(FALSE /* force */, 0 /* threads */, NULL /* progress_func */, NULL /* finished_func */, NULL /* user_data */);
+	}
+
+	wf_metrics_stop(WF_METRIC_LIBRARY_READ, start);
+
+	return (added > 0);
+}
+
+/**
+ * wf_library_write:
+ * @force: write the whole library file, even if nothing changed
+ *
+ * Write all pending changes to disk right away and wait for it to finish,
+ * including any write that is already running in the background.  Normally
+ * changes are written in the background after the write delay (see
+ * wf_library_set_write_delay()), so this is mostly useful to flush everything
+ * before shutting down.
+ *
+ * Returns: %TRUE if all changes have been written successfully
+ *
+ * Since: 0.1
+ **/
+gboolean
+wf_library_write(gboolean force)
+{
+	WfLibraryWriteJob *job;
+	gboolean res;
+
+	if (LibraryData.write_source_id > 0)
+	{
+		g_source_remove(LibraryData.write_source_id);
+		LibraryData.write_source_id = 0;
+	}
+
+	// Writes must happen in order
+	wf_library_write_wait();
+
+	job = wf_library_write_job_new(force);
+
+	if (job == NULL)
+	{
+		// Nothing to write
+		return TRUE;
+	}
 
-	g_key_file_set_comment(key_file, NULL /* group */, NULL /* key */,
-	                       "Note that any comment written to this file will "
-	                       "not be preserved when the software rewrites this "
-	                       "file.", NULL /* GError */);
+	wf_library_write_job_run(job);
+	res = wf_library_write_job_finish(job);
+	wf_library_write_job_free(job);
 
-	// Set file version
-	g_key_file_set_integer(key_file, GROUP_PROPERTIES, NAME_VERSION, FILE_VERSION);
+	return res;
+}
+
+void
+wf_library_updated_stats(void)
+{
+	wf_library_emit_stats_updated(&LibraryData.events);
+}
+
+void
+wf_library_queue_write(void)
+{
+	LibraryData.write_queued = TRUE;
+
+	wf_library_schedule_write();
+}
+
+// Make sure the pending changes get written after the write delay
+static void
+wf_library_schedule_write(void)
+{
+	guint64 delay;
+
+	// Coalesce with the write that is already scheduled
+	if (LibraryData.write_source_id > 0)
+	{
+		return;
+	}
+
+	// Wait twice as long after each failed write, so a lasting error does not keep the disk busy
+	if (LibraryData.write_failures > 0)
+	{
+		delay = (guint64) MAX(LibraryData.write_delay, WRITE_DELAY_DEFAULT) << MIN(LibraryData.write_failures, 16);
+		delay = MIN(delay, MAX(LibraryData.write_delay, WRITE_RETRY_DELAY_MAX));
+	}
+	else
+	{
+		delay = LibraryData.write_delay;
+	}
+
+	LibraryData.write_source_id = g_timeout_add((guint) delay, wf_library_write_cb, NULL /* data */);
+}
+
+/*
+ * Take a snapshot of everything that needs to be written, so it can be written
+ * without touching the songs anymore.  Returns %NULL if there is nothing to
+ * write.
+ */
+static WfLibraryWriteJob *
+wf_library_write_job_new(gboolean force)
+{
+	WfLibraryWriteJob *job;
+	gchar *journal;
+	gsize length = 0;
+	guint records = 0;
+	gint64 start;
+
+	// Too many records in the journal; compact by rewriting the whole file
+	if (LibraryData.journal_records >= JOURNAL_COMPACT_LIMIT)
+	{
+		LibraryData.write_queued = TRUE;
+	}
+
+	start = wf_metrics_start();
+
+	// Everything written has to be complete
+	wf_library_cache_load_all();
+
+	if (LibraryData.write_queued || force)
+	{
+		job = g_slice_alloc0(sizeof(WfLibraryWriteJob));
+		job->key_file = wf_library_parse_list();
+		job->cache = wf_library_cache_build(FILE_VERSION);
+		job->compress = wf_settings_static_get_bool(WF_SETTING_COMPRESS_LIBRARY);
+
+		// The snapshot contains everything now
+		LibraryData.write_queued = FALSE;
+	}
+	else if (LibraryData.dirty_songs != NULL && g_hash_table_size(LibraryData.dirty_songs) > 0)
+	{
+		// Only changes to individual songs; add these to the journal
+		journal = wf_library_journal_build(&length, &records);
+
+		job = g_slice_alloc0(sizeof(WfLibraryWriteJob));
+		job->journal = journal;
+		job->journal_length = length;
+		job->journal_records = records;
+	}
+	else
+	{
+		return NULL;
+	}
+
+	if (LibraryData.dirty_songs != NULL)
+	{
+		g_hash_table_remove_all(LibraryData.dirty_songs);
+	}
+
+	job->file_path = g_strdup(wf_library_get_file());
+	job->started = start;
+
+	return job;
+}
+
+// Write the snapshot to disk; this may run in any thread
+static void
+wf_library_write_job_run(WfLibraryWriteJob *job)
+{
+	GError *err = NULL;
+	gchar *data;
+	gsize length = 0;
+
+	if (job->key_file != NULL && job->compress)
+	{
+		data = g_key_file_to_data(job->key_file, &length, NULL /* GError */);
+
+		// Read back transparently, see wf_library_parse_stream()
+		job->success = wf_utils_save_data_to_disk(job->file_path, data, length, TRUE /* compress */, &err);
+
+		g_free(data);
+	}
+	else if (job->key_file != NULL)
+	{
+		// Saved to a temporary file first, then renamed over the original
+		job->success = wf_utils_save_file_to_disk(job->key_file, job->file_path, &err);
+	}
+
+	if (job->key_file != NULL)
+	{
+		if (job->success)
+		{
+			// The file contains everything now
+			wf_library_journal_clear(job->file_path);
+
+			// Keep the snapshot in sync with the file just written
+			wf_library_cache_save(job->cache, job->file_path, job->compress);
+		}
+		else
+		{
+			g_warning("Failed to write library file to disk: %s", (err != NULL) ? err->message : "unknown error");
+		}
+
+		g_clear_error(&err);
+	}
+	else
+	{
+		job->success = wf_library_journal_append(job->file_path, job->journal, job->journal_length);
+	}
+}
+
+// Process the result of a write on the main thread
+static gboolean
+wf_library_write_job_finish(WfLibraryWriteJob *job)
+{
+	wf_metrics_stop(WF_METRIC_LIBRARY_WRITE, job->started);
+
+	if (!job->success)
+	{
+		// Write everything again next time, which includes the lost changes
+		LibraryData.write_queued = TRUE;
+		LibraryData.write_failures++;
+
+		return FALSE;
+	}
+
+	LibraryData.write_failures = 0;
+
+	if (job->key_file != NULL)
+	{
+		g_info("Successfully written library file to disk");
+		LibraryData.journal_records = 0;
+	}
+	else
+	{
+		g_debug("Appended %u songs to the library journal", job->journal_records);
+		LibraryData.journal_records += job->journal_records;
+	}
+
+	return job->success;
+}
+
+// Block until the background write (if any) is done
+static void
+wf_library_write_wait(void)
+{
+	g_mutex_lock(&LibraryData.write_mutex);
+
+	while (LibraryData.write_busy)
+	{
+		g_cond_wait(&LibraryData.write_cond, &LibraryData.write_mutex);
+	}
+
+	g_mutex_unlock(&LibraryData.write_mutex);
+}
+
+/*
+ * wf_library_mark_song_dirty:
+ * @song: the song that has been changed
+ *
+ * Mark a single song as changed, so that only this song is written on the next
+ * call to wf_library_write() instead of the whole library.  Use this for
+ * changes to the statistics or metadata of a song; for changes that affect the
+ * library as a whole, like adding or moving songs, use
+ * wf_library_queue_write() instead.
+ */
+void
+wf_library_mark_song_dirty(WfSong *song)
+{
+	g_return_if_fail(WF_IS_SONG(song));
+
+	if (LibraryData.dirty_songs == NULL)
+	{
+		LibraryData.dirty_songs = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, NULL /* value_destroy_func */);
+	}
+
+	if (!g_hash_table_contains(LibraryData.dirty_songs, song))
+	{
+		g_hash_table_add(LibraryData.dirty_songs, g_object_ref(song));
+	}
+
+	// Its chance of being picked may have changed as well
+	wf_intelligence_pool_update_song(song);
+
+	wf_library_change_song(song, WF_LIBRARY_CHANGE_UPDATED);
+
+	wf_library_schedule_write();
+}
+
+/*
+ * wf_library_load_song:
+ * @song: the song that is needed
+ *
+ * Make sure all information of @song is there, as it may still be incomplete
+ * if the library is loaded lazily.  Use this before showing or playing a song.
+ */
+void
+wf_library_load_song(WfSong *song)
+{
+	g_return_if_fail(WF_IS_SONG(song));
+
+	wf_library_cache_load_song(song);
+}
+
+gint
+wf_library_update_metadata(void)
+{
+	gint result;
+
+	// Request a forced metadata update (changes are written in the background)
+	result = wf_library_update_metadata_internal(TRUE /* force */);
+
+	// Return the amount of updated songs
+	return result;
+}
+
+/**
+ * wf_library_update_metadata_async:
+ * @force: if %TRUE, update all songs; otherwise only those modified on disk
+ * @threads: the amount of worker threads to use, or 0 to use one per core
+ * @progress_func: (nullable): function to call after every applied batch
+ * @finished_func: (nullable): function to call when done or cancelled
+ * @user_data: data to pass to @progress_func and @finished_func
+ *
+ * Update the metadata of the songs in the library using a pool of worker
+ * threads.  The files are parsed concurrently and the results are applied to
+ * the songs in batches on the main context, which keeps running in the
+ * meantime.  Unless @force is %TRUE, the modification times of the files are
+ * first fetched asynchronously, one directory listing at a time, and only
+ * the songs whose file has changed since their last update are parsed.  The
+ * update can be stopped using wf_library_update_metadata_cancel(), in which
+ * case @finished_func is called with cancelled set to %TRUE.  Only one update
+ * can run at a time.
+ *
+ * Returns: %TRUE if the update has been started, %FALSE if one is already
+ * running
+ *
+ * Since: 0.3
+ **/
+gboolean
+wf_library_update_metadata_async(gboolean force, gint threads, WfFuncMetadataProgress progress_func, WfFuncMetadataFinished finished_func, gpointer user_data)
+{
+	WfLibraryMetadataJob *job;
+	GSList *jobs = NULL;
+	WfSong *song;
+	gint total = 0;
+
+	if (LibraryData.metadata_pool != NULL || LibraryData.metadata_verify != NULL)
+	{
+		g_info("A metadata update is already running");
+
+		return FALSE;
+	}
+
+	if (!force)
+	{
+		// Find the songs modified on disk without blocking
+		wf_library_verify_start(threads, progress_func, finished_func, user_data);
+
+		return TRUE;
+	}
 
+	// Every song is updated; the workers refresh the file information as well
 	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
 	{
-		wf_library_update_key_file_item(key_file, song);
+		job = g_slice_alloc0(sizeof(WfLibraryMetadataJob));
+		job->song = g_object_ref(song);
+		job->uri = wf_song_get_uri(song);
+		job->query_info = TRUE;
+
+		jobs = g_slist_prepend(jobs, job);
+		total++;
+	}
+
+	if (total == 0)
+	{
+		g_info("All songs have up-to-date metadata");
+
+		if (finished_func != NULL)
+		{
+			finished_func(0, FALSE, user_data);
+		}
+
+		return TRUE;
+	}
+
+	// Queue in library order
+	jobs = g_slist_reverse(jobs);
+
+	return wf_library_metadata_pool_start(jobs, total, threads, progress_func, finished_func, user_data);
+}
+
+/*
+ * wf_library_queue_metadata_update:
+ * @song: the song to update
+ *
+ * Fetch the metadata of @song in the background, without looking at the
+ * other songs in the library.  Songs queued in quick succession are handled
+ * by the same worker pool.  If a full update is running, the songs are
+ * handled after it is done.
+ */
+void
+wf_library_queue_metadata_update(WfSong *song)
+{
+	g_return_if_fail(WF_IS_SONG(song));
+
+	if (LibraryData.metadata_queue == NULL)
+	{
+		LibraryData.metadata_queue = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, NULL);
+	}
+
+	if (!g_hash_table_contains(LibraryData.metadata_queue, song))
+	{
+		g_hash_table_add(LibraryData.metadata_queue, g_object_ref(song));
+	}
+
+	if (LibraryData.metadata_pool == NULL && LibraryData.metadata_verify == NULL && LibraryData.metadata_queue_id == 0)
+	{
+		LibraryData.metadata_queue_id = g_idle_add(wf_library_metadata_queue_cb, NULL);
+	}
+}
+
+// Amount of songs that are waiting for their metadata to be fetched
+static gint
+wf_library_metadata_get_backlog(void)
+{
+	WfLibraryMetadataPool *pool = LibraryData.metadata_pool;
+	gint backlog = 0;
+
+	if (LibraryData.metadata_queue != NULL)
+	{
+		backlog += (gint) g_hash_table_size(LibraryData.metadata_queue);
+	}
+
+	if (pool != NULL)
+	{
+		backlog += pool->total - pool->done;
+	}
+
+	return backlog;
+}
+
+// Start a metadata update for the queued songs, if possible
+static void
+wf_library_metadata_queue_start(void)
+{
+	WfLibraryMetadataJob *job;
+	GHashTableIter iter;
+	GSList *jobs = NULL;
+	gpointer key;
+	WfSong *song;
+	gint total = 0;
+
+	if (LibraryData.metadata_pool != NULL || LibraryData.metadata_verify != NULL || LibraryData.metadata_queue == NULL)
+	{
+		// The queue is handled when the running update is done
+		return;
+	}
+
+	g_hash_table_iter_init(&iter, LibraryData.metadata_queue);
+
+	while (g_hash_table_iter_next(&iter, &key, NULL /* value */))
+	{
+		song = key;
+
+		if (wf_song_is_in_list(song))
+		{
+			job = g_slice_alloc0(sizeof(WfLibraryMetadataJob));
+			job->song = g_object_ref(song);
+			job->uri = wf_song_get_uri(song);
+
+			jobs = g_slist_prepend(jobs, job);
+			total++;
+		}
+	}
+
+	g_hash_table_remove_all(LibraryData.metadata_queue);
+
+	if (total > 0)
+	{
+		wf_library_metadata_pool_start(jobs, total, 0 /* threads */, NULL /* progress_func */, NULL /* finished_func */, NULL /* user_data */);
+	}
+}
+
+// Hand a list of jobs to a new pool of worker threads
+static gboolean
+wf_library_metadata_pool_start(GSList *jobs, gint total, gint threads, WfFuncMetadataProgress progress_func, WfFuncMetadataFinished finished_func, gpointer user_data)
+{
+	WfLibraryMetadataPool *pool;
+	GError *err = NULL;
+	GSList *item;
+
+	if (threads <= 0)
+	{
+		threads = (gint) g_get_num_processors();
+	}
+
+	// There is no use in having more threads than songs
+	threads = MIN(threads, total);
+
+	pool = g_slice_alloc0(sizeof(WfLibraryMetadataPool));
+	pool->results = g_async_queue_new();
+	pool->cancellable = g_cancellable_new();
+	pool->total = total;
+	pool->progress_func = progress_func;
+	pool->finished_func = finished_func;
+	pool->user_data = user_data;
+
+	pool->pool = g_thread_pool_new(wf_library_metadata_worker, pool, threads, FALSE /* exclusive */, &err);
+
+	if (pool->pool == NULL)
+	{
+		g_warning("Failed to create metadata worker threads: %s", err->message);
+		g_clear_error(&err);
+
+		g_slist_free_full(jobs, (GDestroyNotify) wf_library_metadata_job_free);
+		wf_library_metadata_pool_free(pool);
+
+		return FALSE;
+	}
+
+	g_info("Updating metadata of %d songs using %d threads", pool->total, threads);
+
+	for (item = jobs; item != NULL; item = item->next)
+	{
+		g_thread_pool_push(pool->pool, item->data, NULL /* error */);
 	}
 
-	return key_file;
+	g_slist_free(jobs);
+
+	pool->source_id = g_timeout_add(METADATA_BATCH_INTERVAL, wf_library_metadata_batch_cb, pool);
+
+	LibraryData.metadata_pool = pool;
+
+	return TRUE;
 }
 
-static gboolean
-wf_library_file_open(GKeyFile *key_file, const gchar *filename, GError **error)
+// Group the songs by directory and start checking their files
+static void
+wf_library_verify_start(gint threads, WfFuncMetadataProgress progress_func, WfFuncMetadataFinished finished_func, gpointer user_data)
 {
-	GError **file_error, *g_error = NULL;
-	gboolean result = FALSE;
+	WfLibraryVerify *verify;
+	WfLibraryVerifyDir *dir;
+	GHashTable *directories;
+	GFile *file, *parent;
+	WfSong *song;
+	gchar *uri;
 
-	g_return_val_if_fail(filename != NULL, FALSE);
-	g_return_val_if_fail(key_file != NULL, FALSE);
+	verify = g_slice_new0(WfLibraryVerify);
+	verify->cancellable = g_cancellable_new();
+	verify->threads = threads;
+	verify->progress_func = progress_func;
+	verify->finished_func = finished_func;
+	verify->user_data = user_data;
+	g_queue_init(&verify->pending);
 
-	// If given, use the input GError; otherwise use the local pointer to printed the messages at the very least
-	if (error == NULL)
-	{
-		file_error = &g_error;
-	}
-	else
-	{
-		file_error = error;
-	}
+	// Only used for grouping, the directories are owned by the queue
+	directories = g_hash_table_new(g_file_hash, (GEqualFunc) g_file_equal);
 
-	if (!g_key_file_load_from_file(key_file, filename, G_KEY_FILE_KEEP_COMMENTS, file_error))
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
 	{
-		if (*file_error == NULL)
+		uri = wf_song_get_uri(song);
+		file = g_file_new_for_uri(uri);
+		parent = g_file_get_parent(file);
+		g_free(uri);
+
+		if (parent == NULL)
 		{
-			g_warning("Could not open file %s due to a unknown error", filename);
+			g_object_unref(file);
+
+			continue;
+		}
+
+		dir = g_hash_table_lookup(directories, parent);
+
+		if (dir == NULL)
+		{
+			dir = g_slice_new0(WfLibraryVerifyDir);
+			dir->verify = verify;
+			dir->directory = parent;
+			dir->songs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
+
+			g_hash_table_insert(directories, dir->directory, dir);
+			g_queue_push_tail(&verify->pending, dir);
 		}
 		else
 		{
-			g_info("Could not open library file %s: %s", filename, (*file_error)->message);
+			g_object_unref(parent);
 		}
 
-		result = FALSE;
-	}
-	else if (*file_error != NULL)
-	{
-		g_info("Successfully opened library file, but received an error: %s", (*file_error)->message);
+		g_hash_table_insert(dir->songs, g_file_get_basename(file), g_object_ref(song));
+		verify->songs++;
 
-		result = TRUE;
-	}
-	else
-	{
-		result = TRUE;
+		g_object_unref(file);
 	}
 
-	// Only free if local GError was used
-	if (error == NULL && g_error != NULL)
-	{
-		g_error_free(g_error);
-	}
+	verify->directories = g_hash_table_size(directories);
+	g_hash_table_unref(directories);
 
-	return result;
+	g_info("Checking %d songs in %d directories for changes", verify->songs, verify->directories);
+
+	LibraryData.metadata_verify = verify;
+
+	wf_library_verify_continue(verify);
 }
 
-gboolean
-wf_library_read(void)
+// Start checking more directories, or finish if all have been checked
+static void
+wf_library_verify_continue(WfLibraryVerify *verify)
 {
-	const gchar *file = wf_library_get_file();
-	gboolean added = 0;
-	GKeyFile *key_file;
+	WfLibraryVerifyDir *dir;
 
-	g_return_val_if_fail(file != NULL, FALSE);
+	while (verify->active < VERIFY_PARALLEL_DIRECTORIES && !g_cancellable_is_cancelled(verify->cancellable))
+	{
+		dir = g_queue_pop_head(&verify->pending);
+
+		if (dir == NULL)
+		{
+			break;
+		}
 
-	key_file = wf_library_new_key_file();
+		verify->active++;
+		g_file_enumerate_children_async(dir->directory, VERIFY_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, G_PRIORITY_LOW, verify->cancellable, wf_library_verify_enumerate_cb, dir);
+	}
 
-	if (!wf_library_file_open(key_file, file, NULL /* GError */) ||
-	    !wf_library_check_file_compatible(key_file, file))
+	if (verify->active == 0)
 	{
-		return FALSE;
+		wf_library_verify_finish(verify);
 	}
+}
 
-	// Clear first before overwriting
-	wf_song_remove_all();
+/*
+ * Called when a directory has been checked.  If the listing is @complete, any
+ * song that has not been seen in it no longer exists.
+ */
+static void
+wf_library_verify_dir_done(WfLibraryVerifyDir *dir, gboolean complete)
+{
+	WfLibraryVerify *verify = dir->verify;
+	GHashTableIter iter;
+	gpointer value;
 
-	// Now collect all songs from the file
-	wf_library_parse_key_file(key_file, &added);
+	if (complete && !g_cancellable_is_cancelled(verify->cancellable))
+	{
+		g_hash_table_iter_init(&iter, dir->songs);
 
-	// Check for any needed metadata updates
-	wf_library_update_metadata_internal(FALSE /* force */);
+		while (g_hash_table_iter_next(&iter, NULL /* key */, &value))
+		{
+			wf_song_set_file_missing(value);
+		}
+	}
 
-	// Write changes (if any) to disk
-	wf_library_write(FALSE);
+	wf_library_verify_dir_free(dir);
 
-	return (added > 0);
+	verify->active--;
+	wf_library_verify_continue(verify);
 }
 
-gboolean
-wf_library_write(gboolean force)
+// Hand the songs that have been modified to the metadata workers
+static void
+wf_library_verify_finish(WfLibraryVerify *verify)
 {
-	const gchar *file = wf_library_get_file();
-	GKeyFile *key_file;
-	GError *err = NULL;
-	gboolean res = FALSE;
+	WfLibraryMetadataJob *job;
+	GSList *jobs = NULL;
+	WfSong *song;
+	gint total = 0;
 
-	// Only write if queued or forced
-	if (!LibraryData.write_queued && !force)
+	if (LibraryData.metadata_verify != verify)
 	{
-		return TRUE;
+		// The library has been finalized in the meantime
+		wf_library_verify_free(verify);
+
+		return;
 	}
 
-	key_file = wf_library_parse_list();
+	LibraryData.metadata_verify = NULL;
 
-	if (key_file == NULL)
+	if (g_cancellable_is_cancelled(verify->cancellable))
 	{
-		g_info("Library file is empty; not writing to disk");
-		LibraryData.write_queued = FALSE;
+		g_info("Metadata update cancelled while checking files");
 
-		return FALSE;
+		if (verify->finished_func != NULL)
+		{
+			verify->finished_func(0, TRUE, verify->user_data);
+		}
+
+		wf_library_verify_free(verify);
+		wf_library_metadata_queue_start();
+
+		return;
 	}
 
-	if (wf_utils_save_file_to_disk(key_file, file, &err))
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
 	{
-		g_info("Successfully written library file to disk");
-		LibraryData.write_queued = FALSE;
+		if (wf_song_metadata_is_outdated(song))
+		{
+			job = g_slice_alloc0(sizeof(WfLibraryMetadataJob));
+			job->song = g_object_ref(song);
+			job->uri = wf_song_get_uri(song);
+
+			jobs = g_slist_prepend(jobs, job);
+			total++;
+		}
+	}
+
+	g_info("Found %d of %d songs modified on disk", total, verify->songs);
 
-		res = TRUE;
+	if (total == 0)
+	{
+		if (verify->finished_func != NULL)
+		{
+			verify->finished_func(0, FALSE, verify->user_data);
+		}
 	}
 	else
 	{
-		g_warning("Failed to write library file to disk: %s", err->message);
+		jobs = g_slist_reverse(jobs);
+
+		wf_library_metadata_pool_start(jobs, total, verify->threads, verify->progress_func, verify->finished_func, verify->user_data);
 	}
 
-	g_clear_error(&err);
+	wf_library_verify_free(verify);
 
-	return res;
+	// Does nothing if the pool has been started; it picks up the queue when done
+	wf_library_metadata_queue_start();
 }
 
+/**
+ * wf_library_update_metadata_cancel:
+ *
+ * Cancel a running asynchronous metadata update.  Files that are already being
+ * parsed are finished, but their results are discarded.
+ *
+ * Since: 0.3
+ **/
 void
-wf_library_updated_stats(void)
+wf_library_update_metadata_cancel(void)
 {
-	wf_library_emit_stats_updated(&LibraryData.events);
-}
+	if (LibraryData.metadata_verify != NULL)
+	{
+		g_cancellable_cancel(LibraryData.metadata_verify->cancellable);
+	}
 
-void
-wf_library_queue_write(void)
-{
-	LibraryData.write_queued = TRUE;
+	if (LibraryData.metadata_pool != NULL)
+	{
+		g_cancellable_cancel(LibraryData.metadata_pool->cancellable);
+	}
 }
 
-gint
-wf_library_update_metadata(void)
+/**
+ * wf_library_update_metadata_is_running:
+ *
+ * Returns: %TRUE if an asynchronous metadata update is in progress
+ *
+ * Since: 0.3
+ **/
+gboolean
+wf_library_update_metadata_is_running(void)
 {
-	gint result;
-
-	// Request a forced metadata update
-	result = wf_library_update_metadata_internal(TRUE /* force */);
-
-	// Save any changes
-	wf_library_write(FALSE);
-
-	// Return the amount of updated songs
-	return result;
+	return (LibraryData.metadata_pool != NULL || LibraryData.metadata_verify != NULL);
 }
 
 gint
 wf_library_add_by_file(GFile *file, WfFuncItemAdded func, WfLibraryFileChecks checks, gboolean skip_metadata)
 {
 	const gchar *mime = NULL;
-	WfSong *song = NULL;
 	WfLibraryFileChecks file_check = ((checks <= 0) ? WF_LIBRARY_CHECK_DEFAULT : checks);
 	WfFileInspectorType type;
 	GSList *dirs;
@@ -1013,22 +2917,8 @@ wf_library_add_by_file(GFile *file, WfFuncItemAdded func, WfLibraryFileChecks ch
 	{
 		g_info("Found song %s", uri);
 
-		song = wf_song_append_by_file(file);
-		wf_song_set_status(song, WF_SONG_AVAILABLE);
-
-		if (!skip_metadata)
-		{
-			wf_song_update_metadata(song, FALSE /* force */);
-		}
-
-		LibraryData.write_queued = TRUE;
+		wf_library_add_song_internal(file, func, skip_metadata);
 		amount = 1;
-
-		if (func != NULL)
-		{
-			// Update caller (report 0 as the total items are unknown)
-			func(song, 0 /* item */, 0 /* total */);
-		}
 	}
 
 	g_free(uri);
@@ -1037,6 +2927,75 @@ wf_library_add_by_file(GFile *file, WfFuncItemAdded func, WfLibraryFileChecks ch
 	return amount;
 }
 
+/**
+ * wf_library_add_by_file_async:
+ * @file: the file or directory to add
+ * @func: (nullable): function to call for every song that is added
+ * @checks: the checks a file has to pass to be added
+ * @skip_metadata: whether to leave the metadata of the new songs alone
+ * @cancellable: (nullable): optional #GCancellable to stop the scan
+ * @finished_func: (nullable): function to call when the scan is done
+ * @user_data: data to pass to @finished_func
+ *
+ * Add a file to the library, or all files in a directory and its
+ * subdirectories, without blocking the main context.  Directories are
+ * scanned in parallel and the files found are added as songs in batches on a
+ * low-priority idle source, after which their metadata is fetched by worker
+ * threads unless @skip_metadata is %TRUE.  If these threads fall behind, no
+ * new songs are added until they catch up, which keeps the amount of work in
+ * progress limited.  @func is called for every added song in the batch it is
+ * added in, with the amount added so far and the amount of songs known so far
+ * (which grows while scanning).  Unlike wf_library_add_by_file(), this
+ * function does not take ownership of @file.
+ *
+ * Since: 0.3
+ **/
+void
+wf_library_add_by_file_async(GFile *file,
+                             WfFuncItemAdded func,
+                             WfLibraryFileChecks checks,
+                             gboolean skip_metadata,
+                             GCancellable *cancellable,
+                             WfFuncAddFinished finished_func,
+                             gpointer user_data)
+{
+	WfLibraryScan *scan;
+
+	g_return_if_fail(G_IS_FILE(file));
+
+	scan = wf_library_scan_new(func, checks, skip_metadata, cancellable, finished_func, user_data);
+	g_queue_push_tail(&scan->roots, g_object_ref(file));
+
+	wf_library_scan_continue(scan);
+}
+
+// Add a file that has passed all checks as a new song
+static WfSong *
+wf_library_add_song_internal(GFile *file, WfFuncItemAdded func, gboolean skip_metadata)
+{
+	WfSong *song;
+
+	song = wf_song_append_by_file(file);
+	wf_song_set_status(song, WF_SONG_AVAILABLE);
+	wf_intelligence_pool_update_song(song);
+	wf_library_change_song(song, WF_LIBRARY_CHANGE_ADDED);
+
+	if (!skip_metadata)
+	{
+		wf_song_update_metadata(song, FALSE /* force */);
+	}
+
+	wf_library_queue_write();
+
+	if (func != NULL)
+	{
+		// Update caller (report 0 as the total items are unknown)
+		func(song, 0 /* item */, 0 /* total */);
+	}
+
+	return song;
+}
+
 gint
 wf_library_add_by_uri(const gchar *uri, WfFuncItemAdded func, WfLibraryFileChecks checks, gboolean skip_metadata)
 {
@@ -1113,8 +3072,6 @@ wf_library_add_uris(GSList *files, WfFuncItemAdded func, WfLibraryFileChecks che
 
 	wf_library_add_uris_internal(files, &amount, func, checks, skip_metadata);
 
-	wf_library_write(FALSE);
-
 	return amount;
 }
 
@@ -1146,116 +3103,317 @@ wf_library_add_files_internal(GSList *files, gint *amount_rv, WfFuncItemAdded fu
 		added += x;
 	}
 
-	*amount_rv = added;
+	*amount_rv = added;
+
+	return added;
+}
+
+// Add a #GSList with #GFile items to check and add
+gint
+wf_library_add_files(GSList *files, WfFuncItemAdded func, WfLibraryFileChecks checks, gboolean skip_metadata)
+{
+	gint amount = 0;
+
+	g_return_val_if_fail(files != NULL, 0);
+
+	wf_library_add_files_internal(files, &amount, func, checks, skip_metadata);
+
+	return amount;
+}
+
+/**
+ * wf_library_add_strv_async:
+ * @files: (array zero-terminated=1): the URIs of the files and directories to add
+ * @func: (nullable): function to call for every song that is added
+ * @checks: the checks a file has to pass to be added
+ * @skip_metadata: whether to leave the metadata of the new songs alone
+ * @cancellable: (nullable): optional #GCancellable to stop adding
+ * @finished_func: (nullable): function to call when all files are done
+ * @user_data: data to pass to @finished_func
+ *
+ * Same as wf_library_add_strv(), but without blocking the main context.  The
+ * items are handled one after another as described for
+ * wf_library_add_by_file_async().  @finished_func is called once, with the
+ * amount of songs added from all items together.
+ *
+ * Since: 0.3
+ **/
+void
+wf_library_add_strv_async(gchar *files[],
+                          WfFuncItemAdded func,
+                          WfLibraryFileChecks checks,
+                          gboolean skip_metadata,
+                          GCancellable *cancellable,
+                          WfFuncAddFinished finished_func,
+                          gpointer user_data)
+{
+	WfLibraryScan *scan;
+	gchar **strings;
+
+	g_return_if_fail(files != NULL);
+
+	scan = wf_library_scan_new(func, checks, skip_metadata, cancellable, finished_func, user_data);
+
+	for (strings = files; *strings != NULL; strings++)
+	{
+		g_queue_push_tail(&scan->roots, g_file_new_for_uri(*strings));
+	}
+
+	wf_library_scan_continue(scan);
+}
+
+/**
+ * wf_library_add_uris_async:
+ * @files: (element-type utf8): the URIs of the files and directories to add
+ * @func: (nullable): function to call for every song that is added
+ * @checks: the checks a file has to pass to be added
+ * @skip_metadata: whether to leave the metadata of the new songs alone
+ * @cancellable: (nullable): optional #GCancellable to stop adding
+ * @finished_func: (nullable): function to call when all files are done
+ * @user_data: data to pass to @finished_func
+ *
+ * Same as wf_library_add_uris(), but without blocking the main context.  See
+ * wf_library_add_strv_async().
+ *
+ * Since: 0.3
+ **/
+void
+wf_library_add_uris_async(GSList *files,
+                          WfFuncItemAdded func,
+                          WfLibraryFileChecks checks,
+                          gboolean skip_metadata,
+                          GCancellable *cancellable,
+                          WfFuncAddFinished finished_func,
+                          gpointer user_data)
+{
+	WfLibraryScan *scan;
+	GSList *l;
+
+	scan = wf_library_scan_new(func, checks, skip_metadata, cancellable, finished_func, user_data);
+
+	for (l = files; l != NULL; l = l->next)
+	{
+		if (l->data != NULL)
+		{
+			g_queue_push_tail(&scan->roots, g_file_new_for_uri(l->data));
+		}
+	}
+
+	wf_library_scan_continue(scan);
+}
+
+/**
+ * wf_library_add_files_async:
+ * @files: (element-type GFile): the files and directories to add
+ * @func: (nullable): function to call for every song that is added
+ * @checks: the checks a file has to pass to be added
+ * @skip_metadata: whether to leave the metadata of the new songs alone
+ * @cancellable: (nullable): optional #GCancellable to stop adding
+ * @finished_func: (nullable): function to call when all files are done
+ * @user_data: data to pass to @finished_func
+ *
+ * Same as wf_library_add_files(), but without blocking the main context.  See
+ * wf_library_add_strv_async().  Unlike wf_library_add_files(), this function
+ * does not take ownership of the files in @files.
+ *
+ * Since: 0.3
+ **/
+void
+wf_library_add_files_async(GSList *files,
+                           WfFuncItemAdded func,
+                           WfLibraryFileChecks checks,
+                           gboolean skip_metadata,
+                           GCancellable *cancellable,
+                           WfFuncAddFinished finished_func,
+                           gpointer user_data)
+{
+	WfLibraryScan *scan;
+	GSList *l;
+
+	scan = wf_library_scan_new(func, checks, skip_metadata, cancellable, finished_func, user_data);
+
+	for (l = files; l != NULL; l = l->next)
+	{
+		if (G_IS_FILE(l->data))
+		{
+			g_queue_push_tail(&scan->roots, g_object_ref(l->data));
+		}
+	}
+
+	wf_library_scan_continue(scan);
+}
+
+// Scan the next item of an asynchronous add, or finish if all are done
+static void
+wf_library_scan_continue(WfLibraryScan *scan)
+{
+	GFile *root;
+
+	if (scan->scanning || scan->source_id > 0)
+	{
+		// Called again once the scan or the batches are done
+		return;
+	}
+
+	if (g_cancellable_is_cancelled(scan->cancellable) || g_queue_is_empty(&scan->roots))
+	{
+		// Takes care of the scan as well
+		g_task_return_int(scan->task, scan->added);
+		g_object_unref(scan->task);
+
+		return;
+	}
+
+	root = g_queue_pop_head(&scan->roots);
+	scan->scanning = TRUE;
 
-	return added;
+	wf_file_inspector_scan_async(root, SKIP_DOT_FILES, scan->cancellable, wf_library_scan_found_cb, wf_library_scan_finished_cb, scan);
+
+	g_object_unref(root);
 }
 
-// Add a #GSList with #GFile items to check and add
-gint
-wf_library_add_files(GSList *files, WfFuncItemAdded func, WfLibraryFileChecks checks, gboolean skip_metadata)
+/*
+ * The column information is kept up to date by the song module whenever songs
+ * are added, removed or updated, so there is nothing to do here anymore.
+ */
+void
+wf_library_update_column_info(void)
 {
-	gint amount = 0;
+}
 
-	g_return_val_if_fail(files != NULL, 0);
+/**
+ * wf_library_watch_directory:
+ * @directory: the directory to watch
+ *
+ * Keep the library in sync with @directory and its subdirectories.  Files
+ * created in them are added to the library, changed songs get their metadata
+ * updated and deleted songs are removed.  Songs that are renamed or moved
+ * within the watched directories keep their statistics.  The directory is
+ * only watched for changes; use wf_library_add_by_file_async() to add the
+ * files already in it.
+ *
+ * Since: 0.3
+ **/
+void
+wf_library_watch_directory(GFile *directory)
+{
+	g_return_if_fail(G_IS_FILE(directory));
 
-	wf_library_add_files_internal(files, &amount, func, checks, skip_metadata);
+	wf_library_monitor_add(directory);
+}
 
-	wf_library_write(FALSE);
+/**
+ * wf_library_unwatch_directory:
+ * @directory: a directory passed to wf_library_watch_directory()
+ *
+ * Stop watching @directory for changes.  The songs in it stay in the library.
+ *
+ * Since: 0.3
+ **/
+void
+wf_library_unwatch_directory(GFile *directory)
+{
+	g_return_if_fail(G_IS_FILE(directory));
 
-	return amount;
+	wf_library_monitor_remove(directory);
 }
 
 void
-wf_library_update_column_info(void)
+wf_library_remove_song(WfSong *song)
 {
-	WfSong *song;
-	gint amount = 0, has_track_number = 0, has_title = 0, has_artist = 0, has_album = 0, has_duration = 0;
-
-	// Set to %TRUE and unset if a value is found that can be used in the respective column
-	LibraryData.track_number_column_empty = TRUE;
-	LibraryData.title_column_empty = TRUE;
-	LibraryData.artist_column_empty = TRUE;
-	LibraryData.album_column_empty = TRUE;
-	LibraryData.duration_column_empty = TRUE;
-	LibraryData.track_number_column_full = FALSE;
-	LibraryData.title_column_full = FALSE;
-	LibraryData.artist_column_full = FALSE;
-	LibraryData.album_column_full = FALSE;
-	LibraryData.duration_column_full = FALSE;
-
-	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	if (song == NULL)
 	{
-		if (wf_song_get_track_number(song) > 0)
-		{
-			has_track_number++;
-			LibraryData.track_number_column_empty = FALSE;
-		}
-
-		if (wf_song_get_title(song) != NULL)
-		{
-			has_title++;
-			LibraryData.title_column_empty = FALSE;
-		}
+		return;
+	}
 
-		if (wf_song_get_artist(song) != NULL)
-		{
-			has_artist++;
-			LibraryData.artist_column_empty = FALSE;
-		}
+	wf_intelligence_pool_remove_song(song);
+	wf_library_change_song(song, WF_LIBRARY_CHANGE_REMOVED);
+	wf_song_remove(song);
 
-		if (wf_song_get_album(song) != NULL)
-		{
-			has_album++;
-			LibraryData.album_column_empty = FALSE;
-		}
+	wf_library_queue_write();
+}
 
-		if (wf_song_get_duration(song) > 1)
-		{
-			has_duration++;
-			LibraryData.duration_column_empty = FALSE;
-		}
+// Remember a change to @song for the next changed event
+static void
+wf_library_change_song(WfSong *song, WfLibraryChange change)
+{
+	WfLibraryChangeSet *set = &LibraryData.changes;
+	WfLibraryChange current = WF_LIBRARY_CHANGE_NONE;
+	gpointer value;
 
-		amount++;
+	// Nobody to tell, or the whole library is reported anyway
+	if (LibraryData.events.changed == NULL || set->reset)
+	{
+		return;
 	}
 
-	if (has_track_number == amount)
+	if (set->songs == NULL)
 	{
-		LibraryData.track_number_column_full = TRUE;
+		set->songs = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, NULL /* value_destroy_func */);
 	}
 
-	if (has_title == amount)
+	if (g_hash_table_lookup_extended(set->songs, song, NULL, &value))
 	{
-		LibraryData.title_column_full = TRUE;
+		current = GPOINTER_TO_INT(value);
 	}
-
-	if (has_artist == amount)
+	else
 	{
-		LibraryData.artist_column_full = TRUE;
+		g_queue_push_tail(&set->order, song);
 	}
 
-	if (has_album == amount)
+	if (change == WF_LIBRARY_CHANGE_REMOVED)
 	{
-		LibraryData.album_column_full = TRUE;
+		// Never reported if it was new, so to the front-end nothing happened
+		change = (current & WF_LIBRARY_CHANGE_ADDED) ? WF_LIBRARY_CHANGE_NONE : WF_LIBRARY_CHANGE_REMOVED;
 	}
-
-	if (has_duration == amount)
+	else if (change == WF_LIBRARY_CHANGE_ADDED && (current & WF_LIBRARY_CHANGE_REMOVED))
+	{
+		// Back again, so the front-end still knows it, but its details may differ
+		change = WF_LIBRARY_CHANGE_UPDATED;
+	}
+	else
 	{
-		LibraryData.duration_column_full = TRUE;
+		// Updated and moved in the meantime is both
+		change = current | change;
 	}
+
+	// An existing key is kept and the new reference is dropped
+	g_hash_table_insert(set->songs, g_object_ref(song), GINT_TO_POINTER(change));
+
+	wf_library_change_schedule();
 }
 
-void
-wf_library_remove_song(WfSong *song)
+// The library has been replaced as a whole, drop the changes to single songs
+static void
+wf_library_change_reset(void)
 {
-	if (song == NULL)
+	WfLibraryChangeSet *set = &LibraryData.changes;
+
+	if (LibraryData.events.changed == NULL)
 	{
 		return;
 	}
 
-	wf_song_remove(song);
+	g_queue_clear(&set->order);
 
-	LibraryData.write_queued = TRUE;
+	if (set->songs != NULL)
+	{
+		g_hash_table_remove_all(set->songs);
+	}
+
+	set->reset = TRUE;
+
+	wf_library_change_schedule();
+}
+
+// Emit the changed event the next time the main loop is idle
+static void
+wf_library_change_schedule(void)
+{
+	if (LibraryData.changes.source_id == 0)
+	{
+		LibraryData.changes.source_id = g_idle_add(wf_library_changes_cb, NULL);
+	}
 }
 
 /* MODULE FUNCTIONS END */
@@ -1375,23 +3533,351 @@ wf_library_check_file_compatible(GKeyFile *key_file, const gchar *file_path)
 	}
 }
 
+static gchar *
+wf_library_get_journal_path(const gchar *file_path)
+{
+	return g_strconcat(file_path, JOURNAL_SUFFIX, NULL /* terminator */);
+}
+
+/*
+ * Create the journal records of all dirty songs.  The journal consists of key
+ * file groups just like the library file itself; a group may occur multiple
+ * times, in which case the values that were appended last are used.
+ */
+static gchar *
+wf_library_journal_build(gsize *length_rv, guint *records_rv)
+{
+	GHashTableIter iter;
+	GKeyFile *key_file;
+	gpointer song;
+	gchar *data;
+	guint n = 0;
+
+	key_file = g_key_file_new();
+
+	g_hash_table_iter_init(&iter, LibraryData.dirty_songs);
+
+	while (g_hash_table_iter_next(&iter, &song, NULL /* value */))
+	{
+		// Songs that have been removed are left to the next full write
+		if (!wf_song_is_unique(song))
+		{
+			wf_library_update_key_file_item(key_file, song);
+			n++;
+		}
+	}
+
+	data = g_key_file_to_data(key_file, length_rv, NULL /* GError */);
+	g_key_file_free(key_file);
+
+	*records_rv = n;
+
+	return data;
+}
+
+// Append journal records to the journal file; this may run in any thread
+static gboolean
+wf_library_journal_append(const gchar *file_path, const gchar *data, gsize length)
+{
+	GFileOutputStream *stream;
+	GError *err = NULL;
+	GFile *file;
+	gchar *path;
+	gboolean res;
+
+	path = wf_library_get_journal_path(file_path);
+	file = g_file_new_for_path(path);
+	stream = g_file_append_to(file, G_FILE_CREATE_NONE, NULL /* GCancellable */, &err);
+
+	if (stream == NULL)
+	{
+		res = FALSE;
+	}
+	else
+	{
+		res = g_output_stream_write_all(G_OUTPUT_STREAM(stream), data, length, NULL /* bytes_written */, NULL /* GCancellable */, &err) &&
+		      g_output_stream_close(G_OUTPUT_STREAM(stream), NULL /* GCancellable */, &err);
+
+		g_object_unref(stream);
+	}
+
+	if (!res)
+	{
+		g_warning("Failed to write library journal: %s", err->message);
+	}
+
+	g_clear_error(&err);
+	g_object_unref(file);
+	g_free(path);
+
+	return res;
+}
+
+// Apply the journal to the songs in the library and return the amount of records applied
+static gint
+wf_library_journal_replay(const gchar *file_path)
+{
+	GHashTable *tags;
+	GKeyFile *key_file;
+	WfSong *song;
+	gchar *path, **groups;
+	gsize length = 0, x;
+	gint applied = 0;
+
+	path = wf_library_get_journal_path(file_path);
+
+	if (!g_file_test(path, G_FILE_TEST_EXISTS))
+	{
+		g_free(path);
+
+		return 0;
+	}
+
+	key_file = g_key_file_new();
+
+	if (!wf_library_file_open(key_file, path, NULL /* GError */))
+	{
+		g_key_file_free(key_file);
+		g_free(path);
+
+		return 0;
+	}
+
+	// Songs are identified by their tag, which is the group name
+	tags = g_hash_table_new(g_str_hash, g_str_equal);
+
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	{
+		g_hash_table_insert(tags, (gpointer) wf_song_get_tag(song), song);
+	}
+
+	groups = g_key_file_get_groups(key_file, &length);
+
+	for (x = 0; x < length; x++)
+	{
+		song = g_hash_table_lookup(tags, groups[x]);
+
+		if (song != NULL && wf_library_add_song_from_key_group(key_file, groups[x], song))
+		{
+			applied++;
+		}
+	}
+
+	g_info("Applied %d records from library journal", applied);
+
+	g_strfreev(groups);
+	g_hash_table_unref(tags);
+	g_key_file_free(key_file);
+	g_free(path);
+
+	return applied;
+}
+
+// Remove the journal, as its content is now part of the library file
+static gboolean
+wf_library_journal_clear(const gchar *file_path)
+{
+	gchar *path = wf_library_get_journal_path(file_path);
+	gboolean res = TRUE;
+
+	if (g_file_test(path, G_FILE_TEST_EXISTS) && g_unlink(path) != 0)
+	{
+		g_warning("Failed to remove library journal %s", path);
+		res = FALSE;
+	}
+
+	g_free(path);
+
+	return res;
+}
+
 /* MODULE UTILITIES END */
 
 /* DESTRUCTORS BEGIN */
 
+static void
+wf_library_write_job_free(WfLibraryWriteJob *job)
+{
+	if (job == NULL)
+	{
+		return;
+	}
+
+	if (job->key_file != NULL)
+	{
+		g_key_file_free(job->key_file);
+	}
+
+	if (job->cache != NULL)
+	{
+		g_byte_array_unref(job->cache);
+	}
+
+	g_free(job->journal);
+	g_free(job->file_path);
+
+	g_slice_free1(sizeof(WfLibraryWriteJob), job);
+}
+
+static void
+wf_library_metadata_job_free(WfLibraryMetadataJob *job)
+{
+	if (job == NULL)
+	{
+		return;
+	}
+
+	if (job->metadata != NULL)
+	{
+		wf_song_metadata_free(job->metadata);
+	}
+
+	g_clear_object(&job->info);
+	g_object_unref(job->song);
+	g_free(job->uri);
+
+	g_slice_free1(sizeof(WfLibraryMetadataJob), job);
+}
+
+static void
+wf_library_verify_dir_free(WfLibraryVerifyDir *dir)
+{
+	g_object_unref(dir->directory);
+	g_hash_table_unref(dir->songs);
+
+	g_slice_free(WfLibraryVerifyDir, dir);
+}
+
+static void
+wf_library_verify_free(WfLibraryVerify *verify)
+{
+	g_queue_clear_full(&verify->pending, (GDestroyNotify) wf_library_verify_dir_free);
+	g_object_unref(verify->cancellable);
+
+	g_slice_free(WfLibraryVerify, verify);
+}
+
+static void
+wf_library_scan_free(WfLibraryScan *scan)
+{
+	g_queue_clear_full(&scan->roots, g_object_unref);
+	g_queue_clear_full(&scan->found, g_object_unref);
+	g_object_unref(scan->cancellable);
+
+	g_slice_free(WfLibraryScan, scan);
+}
+
+static void
+wf_library_metadata_pool_free(WfLibraryMetadataPool *pool)
+{
+	WfLibraryMetadataJob *job;
+
+	if (pool == NULL)
+	{
+		return;
+	}
+
+	if (pool->source_id > 0)
+	{
+		g_source_remove(pool->source_id);
+	}
+
+	if (pool->pool != NULL)
+	{
+		/*
+		 * Let the workers run through the remaining jobs; these are
+		 * cancelled, so they are pushed back without being parsed.
+		 */
+		g_cancellable_cancel(pool->cancellable);
+		g_thread_pool_free(pool->pool, FALSE /* immediate */, TRUE /* wait */);
+	}
+
+	// Free whatever has not been applied
+	while ((job = g_async_queue_try_pop(pool->results)) != NULL)
+	{
+		wf_library_metadata_job_free(job);
+	}
+
+	g_async_queue_unref(pool->results);
+	g_object_unref(pool->cancellable);
+
+	g_slice_free1(sizeof(WfLibraryMetadataPool), pool);
+}
+
+// Drop all collected changes without reporting them
+static void
+wf_library_change_set_clear(WfLibraryChangeSet *set)
+{
+	if (set->source_id > 0)
+	{
+		g_source_remove(set->source_id);
+	}
+
+	g_queue_clear(&set->order);
+
+	if (set->songs != NULL)
+	{
+		g_hash_table_unref(set->songs);
+	}
+
+	*set = (WfLibraryChangeSet) { 0 };
+}
+
 void
 wf_library_finalize(void)
 {
+	// Stop watching the file system
+	wf_library_monitor_finalize();
+	wf_library_search_finalize();
+
+	// Songs that are still incomplete remain so
+	wf_library_cache_cancel();
+
+	// Stop any running metadata update
+	if (LibraryData.metadata_verify != NULL)
+	{
+		// Freed once its outstanding operations return
+		g_cancellable_cancel(LibraryData.metadata_verify->cancellable);
+		LibraryData.metadata_verify = NULL;
+	}
+
+	wf_library_metadata_pool_free(LibraryData.metadata_pool);
+	LibraryData.metadata_pool = NULL;
+
+	if (LibraryData.metadata_queue_id > 0)
+	{
+		g_source_remove(LibraryData.metadata_queue_id);
+	}
+
+	if (LibraryData.metadata_queue != NULL)
+	{
+		g_hash_table_unref(LibraryData.metadata_queue);
+	}
+
 	// Write any made changes to disk
 	wf_library_write(FALSE);
 
+	// A background write that finished is not reported back anymore
+	g_cancellable_cancel(LibraryData.write_cancellable);
+	g_clear_object(&LibraryData.write_cancellable);
+
 	// Free file data
 	g_free(LibraryData.file_path);
 	g_free(LibraryData.default_path);
-	wf_memory_clear_key_file(&LibraryData.key_file);
+
+	if (LibraryData.dirty_songs != NULL)
+	{
+		g_hash_table_unref(LibraryData.dirty_songs);
+	}
+
+	g_mutex_clear(&LibraryData.write_mutex);
+	g_cond_clear(&LibraryData.write_cond);
+
+	wf_library_change_set_clear(&LibraryData.changes);
 
 	LibraryData = (WfLibraryDetails) { 0 };
 
+	wf_intelligence_pool_invalidate();
 	wf_song_remove_all();
 }
 
@@ -44,9 +44,16 @@ G_BEGIN_DECLS
 /* MODULE TYPES BEGIN */
 
 typedef enum _WfLibraryFileChecks WfLibraryFileChecks;
+typedef enum _WfLibrarySortColumn WfLibrarySortColumn;
+typedef struct _WfLibraryChanges WfLibraryChanges;
 
 typedef void (*WfFuncItemAdded) (WfSong *song, gint item, gint total);
 typedef void (*WfFuncStatsUpdated) (void);
+typedef void (*WfFuncLoaded) (void);
+typedef void (*WfFuncChanged) (const WfLibraryChanges *changes);
+typedef void (*WfFuncMetadataProgress) (gint done, gint total, gpointer user_data);
+typedef void (*WfFuncMetadataFinished) (gint updated, gboolean cancelled, gpointer user_data);
+typedef void (*WfFuncAddFinished) (gint added, gboolean cancelled, gpointer user_data);
 
 enum _WfLibraryFileChecks
 {
@@ -55,6 +62,26 @@ enum _WfLibraryFileChecks
 	WF_LIBRARY_CHECK_MEDIA = 3
 };
 
+enum _WfLibrarySortColumn
+{
+	WF_LIBRARY_SORT_TITLE,
+	WF_LIBRARY_SORT_ARTIST,
+	WF_LIBRARY_SORT_ALBUM,
+	WF_LIBRARY_SORT_TRACK_NUMBER,
+	WF_LIBRARY_SORT_DURATION
+};
+
+// Changes to the library since the previous changed event
+struct _WfLibraryChanges
+{
+	gboolean reset; // The whole library has been replaced, the arrays are empty
+
+	GPtrArray *added; // Songs new to the library, in list order of adding
+	GPtrArray *moved; // Songs at another position in the list (may be updated as well)
+	GPtrArray *updated; // Songs with changed metadata or statistics (may be moved as well)
+	GPtrArray *removed; // Songs no longer in the library (kept alive during the event)
+};
+
 /* MODULE TYPES END */
 
 /* CONSTRUCTOR PROTOTYPES BEGIN */
@@ -63,10 +90,17 @@ enum _WfLibraryFileChecks
 /* GETTER/SETTER PROTOTYPES BEGIN */
 
 void wf_library_connect_event_stats_updated(WfFuncStatsUpdated cb_func);
+void wf_library_connect_event_loaded(WfFuncLoaded cb_func);
+void wf_library_connect_event_changed(WfFuncChanged cb_func);
 
 void wf_library_set_file(const gchar *file_path);
 const gchar * wf_library_get_file(void);
 
+void wf_library_set_write_delay(guint milliseconds);
+
+void wf_library_set_lazy_loading(gboolean lazy);
+gboolean wf_library_is_loading(void);
+
 gboolean wf_library_track_number_column_is_empty(void);
 gboolean wf_library_title_column_is_empty(void);
 gboolean wf_library_artist_column_is_empty(void);
@@ -79,6 +113,8 @@ gboolean wf_library_artist_column_is_full(void);
 gboolean wf_library_album_column_is_full(void);
 
 GList * wf_library_get(void);
+guint * wf_library_get_sorted_index(WfLibrarySortColumn column, gboolean descending, gsize *length_rv);
+GList * wf_library_search(const gchar *query);
 
 /* GETTER/SETTER PROTOTYPES END */
 
@@ -90,15 +126,49 @@ void wf_library_move_after(WfSong *song, WfSong *other_song);
 gboolean wf_library_write(gboolean force);
 
 gint wf_library_update_metadata(void);
+gboolean wf_library_update_metadata_async(gboolean force, gint threads, WfFuncMetadataProgress progress_func, WfFuncMetadataFinished finished_func, gpointer user_data);
+void wf_library_update_metadata_cancel(void);
+gboolean wf_library_update_metadata_is_running(void);
 
 gint wf_library_add_by_file(GFile *file, WfFuncItemAdded func, WfLibraryFileChecks checks, gboolean skip_metadata);
+void wf_library_add_by_file_async(GFile *file,
+                                  WfFuncItemAdded func,
+                                  WfLibraryFileChecks checks,
+                                  gboolean skip_metadata,
+                                  GCancellable *cancellable,
+                                  WfFuncAddFinished finished_func,
+                                  gpointer user_data);
 gint wf_library_add_by_uri(const gchar *uri, WfFuncItemAdded func, WfLibraryFileChecks checks, gboolean skip_metadata);
 gint wf_library_add_strv(gchar *files[], WfFuncItemAdded func, WfLibraryFileChecks checks, gboolean skip_metadata);
 gint wf_library_add_uris(GSList *files, WfFuncItemAdded func, WfLibraryFileChecks checks, gboolean skip_metadata);
 gint wf_library_add_files(GSList *files, WfFuncItemAdded func, WfLibraryFileChecks checks, gboolean skip_metadata);
+void wf_library_add_strv_async(gchar *files[],
+                               WfFuncItemAdded func,
+                               WfLibraryFileChecks checks,
+                               gboolean skip_metadata,
+                               GCancellable *cancellable,
+                               WfFuncAddFinished finished_func,
+                               gpointer user_data);
+void wf_library_add_uris_async(GSList *files,
+                               WfFuncItemAdded func,
+                               WfLibraryFileChecks checks,
+                               gboolean skip_metadata,
+                               GCancellable *cancellable,
+                               WfFuncAddFinished finished_func,
+                               gpointer user_data);
+void wf_library_add_files_async(GSList *files,
+                                WfFuncItemAdded func,
+                                WfLibraryFileChecks checks,
+                                gboolean skip_metadata,
+                                GCancellable *cancellable,
+                                WfFuncAddFinished finished_func,
+                                gpointer user_data);
 
 void wf_library_update_column_info(void);
 
+void wf_library_watch_directory(GFile *directory);
+void wf_library_unwatch_directory(GFile *directory);
+
 void wf_library_remove_song(WfSong *song);
 
 /* FUNCTION PROTOTYPES END */
@@ -0,0 +1,798 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * library_cache.c  This file is part of LibWoofer
+ * Copyright (C) 2023  Quico Augustijn
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this library.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/*
+ * Notes:
+ * - For all return value pointers, the suffix '_rv' is used to indicate the
+ *   value of the pointer can be changed by the respective function.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <string.h>
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+// Global includes
+/*< none >*/
+
+// Module includes
+#include <woofer/library_cache.h>
+
+// Dependency includes
+#include <woofer/song.h>
+#include <woofer/song_private.h>
+#include <woofer/utils_private.h>
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * This module keeps a binary snapshot of the song library next to the library
+ * file.  The library file (a #GKeyFile) remains the format to exchange and fall
+ * back on, but parsing it is slow for large libraries.  The snapshot consists
+ * of a header, an array of fixed-size records (one for each song) and a pool of
+ * NUL-terminated strings the records refer to by offset.  On startup the file
+ * is memory-mapped and the songs are created directly from the records.
+ *
+ * The snapshot is only used when it was written for the current library file:
+ * the header stores the modification time and size of the library file at the
+ * moment the snapshot was written, as well as the version numbers of both
+ * formats.  If anything does not match, the snapshot is ignored and the library
+ * file is parsed instead.  The values are stored in native byte order; a
+ * snapshot from a machine with a different byte order fails the magic check.
+ *
+ * If the library is stored compressed, so is the snapshot.  A compressed
+ * snapshot can not be mapped; it is decompressed into memory instead.
+ *
+ * The snapshot can also be read lazily, to get going quickly with very large
+ * libraries.  Then only what choosing songs and the journal need is read right
+ * away: the location, tag, statistics, duration and artist hash of every song.
+ * The file stays mapped and the other strings (title, album, etc.) are filled in
+ * by a low-priority idle source, a few hundred songs per run.  Songs that are
+ * about to be shown or played, and everything before the library is written,
+ * can be completed on demand using wf_library_cache_load_song() and
+ * wf_library_cache_load_all().  Songs of which the metadata has been updated in
+ * the meantime are left alone.
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Identifies the file ("WfLC" in native byte order)
+#define CACHE_MAGIC 0x434C6657
+
+// Version of the layout below; bump on any change to it
+#define CACHE_VERSION 3
+
+// Offset used for strings that are not set
+#define CACHE_NO_STRING G_MAXUINT32
+
+// Amount of songs completed by every run of the lazy loader
+#define CACHE_LOAD_BATCH 256
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef struct _WfLibraryCacheHeader WfLibraryCacheHeader;
+typedef struct _WfLibraryCacheRecord WfLibraryCacheRecord;
+typedef struct _WfLibraryCacheLazy WfLibraryCacheLazy;
+
+struct _WfLibraryCacheHeader
+{
+	guint32 magic;
+	guint32 version;
+	gint32 file_version;
+	guint32 n_records;
+
+	// Library file the snapshot belongs to (modification time in microseconds)
+	gint64 source_mtime;
+	guint64 source_size;
+
+	// Size of the string pool following the records
+	guint64 pool_size;
+};
+
+struct _WfLibraryCacheRecord
+{
+	gint64 last_played;
+	gint64 updated;
+	gdouble score;
+
+	guint32 hash;
+	guint32 artist_hash;
+	gint32 rating;
+	gint32 play_count;
+	gint32 skip_count;
+	gint32 duration;
+	gint32 track_number;
+
+	// Offsets into the string pool
+	guint32 tag;
+	guint32 uri;
+	guint32 title;
+	guint32 artist;
+	guint32 album_artist;
+	guint32 album;
+};
+
+// State of a lazily read cache
+struct _WfLibraryCacheLazy
+{
+	GBytes *data; // Keeps the records and the pool below alive
+	const WfLibraryCacheRecord *records;
+	const gchar *pool;
+
+	GHashTable *songs; // Referenced WfSong -> index of its record
+	guint source_id;
+
+	WfFuncCacheLoaded loaded_func;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static gboolean wf_library_cache_get_source_info(const gchar *source_path, gint64 *mtime_rv, guint64 *size_rv);
+static gboolean wf_library_cache_validate(const gchar *contents, gsize length, const gchar *source_path, gint file_version);
+static gboolean wf_library_cache_offset_is_valid(guint32 offset, guint64 pool_size, gboolean nullable);
+static const gchar * wf_library_cache_get_string(const gchar *pool, guint32 offset);
+static guint32 wf_library_cache_add_string(GByteArray *pool, const gchar *str);
+
+static gboolean wf_library_cache_load_cb(gpointer user_data);
+static void wf_library_cache_complete_song(WfSong *song, const WfLibraryCacheRecord *rec, const gchar *pool);
+static void wf_library_cache_loaded(void);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+static WfLibraryCacheLazy LazyData = { 0 };
+
+/* GLOBAL VARIABLES END */
+
+/* CONSTRUCTORS BEGIN */
+/* CONSTRUCTORS END */
+
+/* GETTERS/SETTERS BEGIN */
+
+/*
+ * wf_library_cache_get_path:
+ * @source_path: path of the library file
+ *
+ * Returns: (transfer full): the path of the cache belonging to @source_path
+ */
+gchar *
+wf_library_cache_get_path(const gchar *source_path)
+{
+	g_return_val_if_fail(source_path != NULL, NULL);
+
+	return g_strconcat(source_path, WF_LIBRARY_CACHE_SUFFIX, NULL /* terminator */);
+}
+
+/* GETTERS/SETTERS END */
+
+/* CALLBACK FUNCTIONS BEGIN */
+
+// Complete the next batch of songs of a lazily read cache
+static gboolean
+wf_library_cache_load_cb(gpointer user_data)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	guint x = 0;
+
+	g_hash_table_iter_init(&iter, LazyData.songs);
+
+	while (x < CACHE_LOAD_BATCH && g_hash_table_iter_next(&iter, &key, &value))
+	{
+		wf_library_cache_complete_song(key, &LazyData.records[GPOINTER_TO_UINT(value)], LazyData.pool);
+		g_hash_table_iter_remove(&iter);
+		x++;
+	}
+
+	if (g_hash_table_size(LazyData.songs) > 0)
+	{
+		return G_SOURCE_CONTINUE;
+	}
+
+	LazyData.source_id = 0;
+	wf_library_cache_loaded();
+
+	return G_SOURCE_REMOVE;
+}
+
+/* CALLBACK FUNCTIONS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+/*
+ * wf_library_cache_read:
+ * @source_path: path of the library file
+ * @file_version: version of the library file format in use
+ * @loaded_func: (nullable): function to read lazily with, or %NULL
+ * @added_rv: (out) (optional): return location for the amount of added songs
+ *
+ * Add all songs found in the cache of @source_path to the library.  The cache
+ * is checked before any song is added, so on failure the library is left
+ * untouched and the library file should be parsed instead.
+ *
+ * If @loaded_func is set, the songs are only partially read and completed in
+ * the background; @loaded_func is called once all of them are complete.  It is
+ * not called if the lazy read is cancelled by wf_library_cache_cancel().
+ *
+ * Returns: %TRUE if the cache was valid and has been used
+ */
+gboolean
+wf_library_cache_read(const gchar *source_path, gint file_version, WfFuncCacheLoaded loaded_func, gint *added_rv)
+{
+	const WfLibraryCacheHeader *header;
+	const WfLibraryCacheRecord *records, *rec;
+	const gchar *contents, *pool;
+	GMappedFile *mapped;
+	GBytes *data;
+	GError *err = NULL;
+	WfSong *song;
+	gchar *path;
+	gsize length;
+	guint32 x;
+	gint added = 0;
+
+	g_return_val_if_fail(source_path != NULL, FALSE);
+
+	// A previous lazy read refers to songs that are about to be replaced
+	wf_library_cache_cancel();
+
+	path = wf_library_cache_get_path(source_path);
+	mapped = g_mapped_file_new(path, FALSE /* writable */, &err);
+
+	if (mapped == NULL)
+	{
+		g_debug("No library cache at %s: %s", path, err->message);
+		g_clear_error(&err);
+		g_free(path);
+
+		return FALSE;
+	}
+
+	data = g_mapped_file_get_bytes(mapped);
+	g_mapped_file_unref(mapped);
+
+	contents = g_bytes_get_data(data, &length);
+
+	if (wf_utils_data_is_compressed(contents, length))
+	{
+		g_bytes_unref(data);
+		data = wf_utils_decompress(contents, length, &err);
+
+		if (data == NULL)
+		{
+			g_info("Could not decompress library cache %s: %s", path, err->message);
+			g_clear_error(&err);
+			g_free(path);
+
+			return FALSE;
+		}
+
+		contents = g_bytes_get_data(data, &length);
+	}
+
+	if (!wf_library_cache_validate(contents, length, source_path, file_version))
+	{
+		g_info("Library cache %s is outdated or invalid; using library file", path);
+		g_bytes_unref(data);
+		g_free(path);
+
+		return FALSE;
+	}
+
+	header = (const WfLibraryCacheHeader *) contents;
+	records = (const WfLibraryCacheRecord *) (contents + sizeof(WfLibraryCacheHeader));
+	pool = (const gchar *) (records + header->n_records);
+
+	if (loaded_func != NULL)
+	{
+		LazyData.data = g_bytes_ref(data);
+		LazyData.records = records;
+		LazyData.pool = pool;
+		LazyData.songs = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, NULL /* value_destroy_func */);
+		LazyData.loaded_func = loaded_func;
+	}
+
+	for (x = 0; x < header->n_records; x++)
+	{
+		rec = &records[x];
+
+		song = wf_song_append_by_uri(wf_library_cache_get_string(pool, rec->uri));
+
+		if (song == NULL)
+		{
+			continue;
+		}
+
+		if (wf_song_get_hash(song) != rec->hash)
+		{
+			g_debug("Hash of cached song %s changed", wf_library_cache_get_string(pool, rec->uri));
+		}
+
+		// Everything needed to choose songs and to apply the journal
+		wf_song_set_tag(song, wf_library_cache_get_string(pool, rec->tag));
+		wf_song_set_metadata_updated(song, rec->updated);
+		wf_song_set_duration_seconds(song, rec->duration);
+		wf_song_set_rating(song, rec->rating);
+		wf_song_set_score(song, rec->score);
+		wf_song_set_play_count(song, rec->play_count);
+		wf_song_set_skip_count(song, rec->skip_count);
+		wf_song_set_last_played(song, rec->last_played);
+
+		if (loaded_func != NULL)
+		{
+			wf_song_set_artist_hash(song, rec->artist_hash);
+			g_hash_table_insert(LazyData.songs, g_object_ref(song), GUINT_TO_POINTER(x));
+		}
+		else
+		{
+			wf_library_cache_complete_song(song, rec, pool);
+		}
+
+		added++;
+	}
+
+	g_info("Found %d songs in song library cache", added);
+
+	if (loaded_func != NULL)
+	{
+		LazyData.source_id = g_idle_add_full(G_PRIORITY_LOW, wf_library_cache_load_cb, NULL /* data */, NULL /* notify */);
+	}
+
+	g_bytes_unref(data);
+	g_free(path);
+
+	if (added_rv != NULL)
+	{
+		*added_rv = added;
+	}
+
+	return TRUE;
+}
+
+/*
+ * wf_library_cache_build:
+ * @file_version: version of the library file format in use
+ *
+ * Create a snapshot of the current song library in the cache format.  This has
+ * to be done on the main thread; the result can then be written from any
+ * thread using wf_library_cache_save().  Songs that are still incomplete from a
+ * lazy read are completed first.
+ *
+ * Returns: (transfer full): the cache content
+ */
+GByteArray *
+wf_library_cache_build(gint file_version)
+{
+	WfLibraryCacheHeader header = { 0 };
+	WfLibraryCacheRecord rec;
+	GByteArray *data, *pool;
+	WfSong *song;
+	gchar *uri;
+
+	wf_library_cache_load_all();
+
+	data = g_byte_array_new();
+	pool = g_byte_array_new();
+
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
+	{
+		rec = (WfLibraryCacheRecord) { 0 };
+
+		// Use the same (resolved) URI as the library file does
+		uri = wf_song_get_uri(song);
+
+		rec.last_played = wf_song_get_last_played(song);
+		rec.updated = wf_song_get_metadata_updated(song);
+		rec.score = wf_song_get_score(song);
+		rec.hash = wf_song_get_hash(song);
+		rec.artist_hash = wf_song_get_artist_hash(song);
+		rec.rating = wf_song_get_rating(song);
+		rec.play_count = wf_song_get_play_count(song);
+		rec.skip_count = wf_song_get_skip_count(song);
+		rec.duration = wf_song_get_duration(song);
+		rec.track_number = wf_song_get_track_number(song);
+		rec.tag = wf_library_cache_add_string(pool, wf_song_get_tag(song));
+		rec.uri = wf_library_cache_add_string(pool, uri);
+		rec.title = wf_library_cache_add_string(pool, wf_song_get_title(song));
+		rec.artist = wf_library_cache_add_string(pool, wf_song_get_artist(song));
+		rec.album_artist = wf_library_cache_add_string(pool, wf_song_get_album_artist(song));
+		rec.album = wf_library_cache_add_string(pool, wf_song_get_album(song));
+
+		g_byte_array_append(data, (const guint8 *) &rec, sizeof(rec));
+		header.n_records++;
+
+		g_free(uri);
+	}
+
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.file_version = file_version;
+	header.pool_size = pool->len;
+
+	// The information of the library file is filled in when saving
+	g_byte_array_prepend(data, (const guint8 *) &header, sizeof(header));
+	g_byte_array_append(data, pool->data, pool->len);
+
+	g_byte_array_unref(pool);
+
+	return data;
+}
+
+/*
+ * wf_library_cache_save:
+ * @data: cache content created by wf_library_cache_build()
+ * @source_path: path of the library file
+ * @compress: %TRUE to write the cache compressed
+ *
+ * Write @data to the cache of @source_path.  This should be done right after
+ * the library file itself has been written, as the cache records the current
+ * modification time of the library file.  This function does not touch any
+ * songs and may be called from any thread.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+wf_library_cache_save(GByteArray *data, const gchar *source_path, gboolean compress)
+{
+	WfLibraryCacheHeader *header;
+	GError *err = NULL;
+	gchar *path;
+	gboolean result;
+
+	g_return_val_if_fail(data != NULL, FALSE);
+	g_return_val_if_fail(data->len >= sizeof(WfLibraryCacheHeader), FALSE);
+	g_return_val_if_fail(source_path != NULL, FALSE);
+
+	header = (WfLibraryCacheHeader *) data->data;
+
+	if (!wf_library_cache_get_source_info(source_path, &header->source_mtime, &header->source_size))
+	{
+		return FALSE;
+	}
+
+	path = wf_library_cache_get_path(source_path);
+	result = wf_utils_save_data_to_disk(path, (const gchar *) data->data, data->len, compress, &err);
+
+	if (result)
+	{
+		g_debug("Written library cache with %u songs", header->n_records);
+	}
+	else
+	{
+		g_warning("Failed to write library cache: %s", (err != NULL) ? err->message : "unknown error");
+		g_clear_error(&err);
+	}
+
+	g_free(path);
+
+	return result;
+}
+
+/*
+ * wf_library_cache_write:
+ * @source_path: path of the library file
+ * @file_version: version of the library file format in use
+ * @compress: %TRUE to write the cache compressed
+ *
+ * Build and save the cache of @source_path in one go.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+wf_library_cache_write(const gchar *source_path, gint file_version, gboolean compress)
+{
+	GByteArray *data;
+	gboolean result;
+
+	g_return_val_if_fail(source_path != NULL, FALSE);
+
+	data = wf_library_cache_build(file_version);
+	result = wf_library_cache_save(data, source_path, compress);
+	g_byte_array_unref(data);
+
+	return result;
+}
+
+/*
+ * wf_library_cache_is_loading:
+ *
+ * Returns: %TRUE if songs of a lazy read are still incomplete
+ */
+gboolean
+wf_library_cache_is_loading(void)
+{
+	return (LazyData.songs != NULL);
+}
+
+/*
+ * wf_library_cache_load_song:
+ * @song: the song to complete
+ *
+ * Complete @song right away if it is still incomplete from a lazy read, for
+ * example because it is about to be shown or played.
+ */
+void
+wf_library_cache_load_song(WfSong *song)
+{
+	gpointer value;
+
+	g_return_if_fail(WF_IS_SONG(song));
+
+	if (LazyData.songs == NULL || !g_hash_table_lookup_extended(LazyData.songs, song, NULL /* orig_key */, &value))
+	{
+		return;
+	}
+
+	wf_library_cache_complete_song(song, &LazyData.records[GPOINTER_TO_UINT(value)], LazyData.pool);
+	g_hash_table_remove(LazyData.songs, song);
+}
+
+/*
+ * wf_library_cache_load_all:
+ *
+ * Complete all songs that are still incomplete from a lazy read right away.
+ * This must be done before anything depends on the whole library, like
+ * writing it.
+ */
+void
+wf_library_cache_load_all(void)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+
+	if (LazyData.songs == NULL)
+	{
+		return;
+	}
+
+	g_hash_table_iter_init(&iter, LazyData.songs);
+
+	while (g_hash_table_iter_next(&iter, &key, &value))
+	{
+		wf_library_cache_complete_song(key, &LazyData.records[GPOINTER_TO_UINT(value)], LazyData.pool);
+	}
+
+	wf_library_cache_loaded();
+}
+
+/*
+ * wf_library_cache_cancel:
+ *
+ * Stop completing the songs of a lazy read, leaving them as they are.  Only
+ * useful if all songs are about to be removed anyway.
+ */
+void
+wf_library_cache_cancel(void)
+{
+	if (LazyData.source_id > 0)
+	{
+		g_source_remove(LazyData.source_id);
+	}
+
+	if (LazyData.songs != NULL)
+	{
+		g_hash_table_unref(LazyData.songs);
+	}
+
+	if (LazyData.data != NULL)
+	{
+		g_bytes_unref(LazyData.data);
+	}
+
+	LazyData = (WfLibraryCacheLazy) { 0 };
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+/*
+ * Get the modification time in microseconds and the size of the library file.
+ * Whole seconds are not enough: the file may be written again within the same
+ * second with the same size.
+ */
+static gboolean
+wf_library_cache_get_source_info(const gchar *source_path, gint64 *mtime_rv, guint64 *size_rv)
+{
+	GFile *file;
+	GFileInfo *info;
+
+	file = g_file_new_for_path(source_path);
+	info = g_file_query_info(file,
+	                         G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC "," G_FILE_ATTRIBUTE_STANDARD_SIZE,
+	                         G_FILE_QUERY_INFO_NONE, NULL /* GCancellable */, NULL /* error */);
+	g_object_unref(file);
+
+	if (info == NULL)
+	{
+		return FALSE;
+	}
+
+	*mtime_rv = (gint64) g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+	            g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	*size_rv = (guint64) g_file_info_get_size(info);
+
+	g_object_unref(info);
+
+	return TRUE;
+}
+
+// Check the whole cache before using any of it
+static gboolean
+wf_library_cache_validate(const gchar *contents, gsize length, const gchar *source_path, gint file_version)
+{
+	const WfLibraryCacheHeader *header;
+	const WfLibraryCacheRecord *records, *rec;
+	const gchar *pool;
+	guint64 expected;
+	gint64 mtime;
+	guint64 size;
+	guint32 x;
+
+	if (contents == NULL || length < sizeof(WfLibraryCacheHeader))
+	{
+		return FALSE;
+	}
+
+	header = (const WfLibraryCacheHeader *) contents;
+
+	if (header->magic != CACHE_MAGIC ||
+	    header->version != CACHE_VERSION ||
+	    header->file_version != file_version)
+	{
+		return FALSE;
+	}
+
+	// The library file must not have changed since the cache was written
+	if (!wf_library_cache_get_source_info(source_path, &mtime, &size) ||
+	    header->source_mtime != mtime ||
+	    header->source_size != size)
+	{
+		return FALSE;
+	}
+
+	expected = sizeof(WfLibraryCacheHeader) + (guint64) header->n_records * sizeof(WfLibraryCacheRecord) + header->pool_size;
+
+	if (expected != length)
+	{
+		return FALSE;
+	}
+
+	records = (const WfLibraryCacheRecord *) (contents + sizeof(WfLibraryCacheHeader));
+	pool = (const gchar *) (records + header->n_records);
+
+	// Every string must be terminated within the pool
+	if (header->pool_size > 0 && pool[header->pool_size - 1] != '\0')
+	{
+		return FALSE;
+	}
+
+	for (x = 0; x < header->n_records; x++)
+	{
+		rec = &records[x];
+
+		if (!wf_library_cache_offset_is_valid(rec->uri, header->pool_size, FALSE) ||
+		    !wf_library_cache_offset_is_valid(rec->tag, header->pool_size, FALSE) ||
+		    !wf_library_cache_offset_is_valid(rec->title, header->pool_size, TRUE) ||
+		    !wf_library_cache_offset_is_valid(rec->artist, header->pool_size, TRUE) ||
+		    !wf_library_cache_offset_is_valid(rec->album_artist, header->pool_size, TRUE) ||
+		    !wf_library_cache_offset_is_valid(rec->album, header->pool_size, TRUE))
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static gboolean
+wf_library_cache_offset_is_valid(guint32 offset, guint64 pool_size, gboolean nullable)
+{
+	if (offset == CACHE_NO_STRING)
+	{
+		return nullable;
+	}
+
+	return (offset < pool_size);
+}
+
+static const gchar *
+wf_library_cache_get_string(const gchar *pool, guint32 offset)
+{
+	return (offset == CACHE_NO_STRING) ? NULL : pool + offset;
+}
+
+// Set the strings of @song that a lazy read left out
+static void
+wf_library_cache_complete_song(WfSong *song, const WfLibraryCacheRecord *rec, const gchar *pool)
+{
+	// Removed or updated since, so this record is no longer the right one
+	if (!wf_song_is_in_list(song) || wf_song_get_metadata_updated(song) != rec->updated)
+	{
+		return;
+	}
+
+	wf_song_set_track_number(song, rec->track_number);
+	wf_song_set_title(song, wf_library_cache_get_string(pool, rec->title));
+	wf_song_set_artist(song, wf_library_cache_get_string(pool, rec->artist));
+	wf_song_set_album_artist(song, wf_library_cache_get_string(pool, rec->album_artist));
+	wf_song_set_album(song, wf_library_cache_get_string(pool, rec->album));
+}
+
+// All songs of a lazy read are complete
+static void
+wf_library_cache_loaded(void)
+{
+	WfFuncCacheLoaded func = LazyData.loaded_func;
+
+	if (LazyData.songs == NULL)
+	{
+		return;
+	}
+
+	g_info("Completed all songs from the song library cache");
+
+	wf_library_cache_cancel();
+
+	if (func != NULL)
+	{
+		func();
+	}
+}
+
+// Append a string (including its terminator) to the pool and return its offset
+static guint32
+wf_library_cache_add_string(GByteArray *pool, const gchar *str)
+{
+	guint32 offset;
+
+	if (str == NULL)
+	{
+		return CACHE_NO_STRING;
+	}
+
+	offset = pool->len;
+	g_byte_array_append(pool, (const guint8 *) str, strlen(str) + 1);
+
+	return offset;
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+/* DESTRUCTORS END */
+
+/* END OF FILE */
@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * library_cache.h  This file is part of LibWoofer
+ * Copyright (C) 2023  Quico Augustijn
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this library.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+#ifndef __WF_LIBRARY_CACHE__
+#define __WF_LIBRARY_CACHE__
+
+/* INCLUDES BEGIN */
+
+#include <glib.h>
+
+#include <woofer/song.h>
+
+/* INCLUDES END */
+
+G_BEGIN_DECLS
+
+/* DEFINES BEGIN */
+
+// Suffix appended to the library file path to get the cache file path
+#define WF_LIBRARY_CACHE_SUFFIX ".cache"
+
+/* DEFINES END */
+
+/* MODULE TYPES BEGIN */
+
+// All songs of a lazy read are complete
+typedef void (*WfFuncCacheLoaded) (void);
+
+/* MODULE TYPES END */
+
+/* CONSTRUCTOR PROTOTYPES BEGIN */
+/* CONSTRUCTOR PROTOTYPES END */
+
+/* GETTER/SETTER PROTOTYPES BEGIN */
+
+gchar * wf_library_cache_get_path(const gchar *source_path);
+
+/* GETTER/SETTER PROTOTYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+gboolean wf_library_cache_read(const gchar *source_path, gint file_version, WfFuncCacheLoaded loaded_func, gint *added_rv);
+GByteArray * wf_library_cache_build(gint file_version);
+gboolean wf_library_cache_save(GByteArray *data, const gchar *source_path, gboolean compress);
+gboolean wf_library_cache_write(const gchar *source_path, gint file_version, gboolean compress);
+
+gboolean wf_library_cache_is_loading(void);
+void wf_library_cache_load_song(WfSong *song);
+void wf_library_cache_load_all(void);
+void wf_library_cache_cancel(void);
+
+/* FUNCTION PROTOTYPES END */
+
+/* UTILITY PROTOTYPES BEGIN */
+/* UTILITY PROTOTYPES END */
+
+/* DESTRUCTOR PROTOTYPES BEGIN */
+/* DESTRUCTOR PROTOTYPES END */
+
+G_END_DECLS
+
+#endif /* __WF_LIBRARY_CACHE__ */
+
+/* END OF FILE */
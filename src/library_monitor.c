@@ -0,0 +1,775 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * library_monitor.c  This file is part of LibWoofer
+ * Copyright (C) 2023  Quico Augustijn
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this library.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/*
+ * Notes:
+ * - For all return value pointers, the suffix '_rv' is used to indicate the
+ *   value of the pointer can be changed by the respective function.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+// Global includes
+/*< none >*/
+
+// Module includes
+#include <woofer/library_monitor.h>
+
+// Dependency includes
+#include <woofer/library.h>
+#include <woofer/library_private.h>
+#include <woofer/song.h>
+#include <woofer/song_private.h>
+#include <woofer/file_inspector.h>
+#include <woofer/utils.h>
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * This module keeps the library in sync with the file system.  Every
+ * directory below a watched root gets a #GFileMonitor, which reports the files
+ * that are created, changed, moved and deleted.  The changes are collected for
+ * a short while, so a burst of events for the same file (like a file being
+ * written) is handled only once, and are then applied to the library: new
+ * files are added, changed songs get their metadata updated and deleted songs
+ * are removed.  Renamed and moved songs keep their statistics.  Only the songs
+ * that actually changed are touched, regardless of the size of the library.
+ *
+ * Note that on Linux each monitor uses an inotify watch, of which there is a
+ * limited amount per user (see /proc/sys/fs/inotify/max_user_watches).
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Time to collect changes before applying them, in milliseconds
+#define FLUSH_DELAY 1000
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef enum _WfLibraryMonitorAction WfLibraryMonitorAction;
+
+typedef struct _WfLibraryMonitorChange WfLibraryMonitorChange;
+typedef struct _WfLibraryMonitorDetails WfLibraryMonitorDetails;
+
+enum _WfLibraryMonitorAction
+{
+	WF_LIBRARY_MONITOR_ADDED,
+	WF_LIBRARY_MONITOR_CHANGED,
+	WF_LIBRARY_MONITOR_DELETED,
+	WF_LIBRARY_MONITOR_MOVED
+};
+
+// A change that has not been applied yet
+struct _WfLibraryMonitorChange
+{
+	WfLibraryMonitorAction action;
+
+	gchar *uri;
+	GFile *file;
+	GFile *other; // New location if moved
+	gchar *other_uri; // Key in the pending changes if moved, as later events are about the new location
+	gboolean refresh; // Changed as well, so its metadata has to be fetched again
+};
+
+struct _WfLibraryMonitorDetails
+{
+	GHashTable *roots; // URIs of the watched roots (used as a set)
+	GHashTable *monitors; // Directory URI -> #GFileMonitor
+	GCancellable *cancellable;
+
+	GQueue changes; // In order of arrival
+	GHashTable *pending; // URI of the current location -> link in changes
+
+	guint flush_id;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static void wf_library_monitor_scan_found_cb(GFile *file, WfFileInspectorType type, const gchar *mime, gpointer user_data);
+static void wf_library_monitor_changed_cb(GFileMonitor *monitor, GFile *file, GFile *other, GFileMonitorEvent event, gpointer user_data);
+static gboolean wf_library_monitor_flush_cb(gpointer user_data);
+
+static void wf_library_monitor_watch(GFile *directory);
+static void wf_library_monitor_unwatch(const gchar *uri);
+static void wf_library_monitor_queue(WfLibraryMonitorAction action, GFile *file, GFile *other);
+static void wf_library_monitor_queue_after_move(GList *link, WfLibraryMonitorAction action, GFile *other);
+static void wf_library_monitor_apply(WfLibraryMonitorChange *change);
+static void wf_library_monitor_apply_added(GFile *file);
+static void wf_library_monitor_apply_deleted(GFile *file, const gchar *uri);
+static void wf_library_monitor_apply_moved(GFile *file, GFile *other, const gchar *uri);
+
+static gboolean wf_library_monitor_is_watched(GFile *file);
+static gchar * wf_library_monitor_get_song_prefix(const gchar *uri);
+
+static void wf_library_monitor_change_free(WfLibraryMonitorChange *change);
+static void wf_library_monitor_file_monitor_free(GFileMonitor *monitor);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+static WfLibraryMonitorDetails MonitorData = { 0 };
+
+/* GLOBAL VARIABLES END */
+
+/* CONSTRUCTORS BEGIN */
+
+static void
+wf_library_monitor_init(void)
+{
+	if (MonitorData.roots != NULL)
+	{
+		// Already initialized
+		return;
+	}
+
+	MonitorData.roots = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	MonitorData.monitors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) wf_library_monitor_file_monitor_free);
+	MonitorData.pending = g_hash_table_new(g_str_hash, g_str_equal);
+	MonitorData.cancellable = g_cancellable_new();
+	g_queue_init(&MonitorData.changes);
+}
+
+/* CONSTRUCTORS END */
+
+/* GETTERS/SETTERS BEGIN */
+/* GETTERS/SETTERS END */
+
+/* CALLBACK FUNCTIONS BEGIN */
+
+static void
+wf_library_monitor_scan_found_cb(GFile *file, WfFileInspectorType type, const gchar *mime, gpointer user_data)
+{
+	if (MonitorData.roots == NULL)
+	{
+		// Finalized while scanning
+		return;
+	}
+
+	// The root might have been removed while scanning
+	if (type == WF_FILE_INSPECTOR_TYPE_DIRECTORY && wf_library_monitor_is_watched(file))
+	{
+		wf_library_monitor_watch(file);
+	}
+}
+
+static void
+wf_library_monitor_changed_cb(GFileMonitor *monitor, GFile *file, GFile *other, GFileMonitorEvent event, gpointer user_data)
+{
+	switch (event)
+	{
+		case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+			// Wait for this one instead of reacting to every write
+			wf_library_monitor_queue(WF_LIBRARY_MONITOR_CHANGED, file, NULL);
+			break;
+		case G_FILE_MONITOR_EVENT_CREATED:
+		case G_FILE_MONITOR_EVENT_MOVED_IN:
+			wf_library_monitor_queue(WF_LIBRARY_MONITOR_ADDED, file, NULL);
+			break;
+		case G_FILE_MONITOR_EVENT_DELETED:
+		case G_FILE_MONITOR_EVENT_MOVED_OUT:
+			wf_library_monitor_queue(WF_LIBRARY_MONITOR_DELETED, file, NULL);
+			break;
+		case G_FILE_MONITOR_EVENT_RENAMED:
+			wf_library_monitor_queue(WF_LIBRARY_MONITOR_MOVED, file, other);
+			break;
+		default:
+			// Not of interest to the library
+			break;
+	}
+}
+
+static gboolean
+wf_library_monitor_flush_cb(gpointer user_data)
+{
+	WfLibraryMonitorChange *change;
+	guint amount = 0;
+
+	MonitorData.flush_id = 0;
+
+	// The keys belong to the changes, which are freed below
+	g_hash_table_remove_all(MonitorData.pending);
+
+	while ((change = g_queue_pop_head(&MonitorData.changes)) != NULL)
+	{
+		wf_library_monitor_apply(change);
+		wf_library_monitor_change_free(change);
+
+		amount++;
+	}
+
+	g_debug("Applied %u file system changes to the library", amount);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* CALLBACK FUNCTIONS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+/*
+ * wf_library_monitor_add:
+ * @directory: the directory to watch
+ *
+ * Start watching @directory and all of its subdirectories for changes.  The
+ * directories are found in the background, so changes made right after this
+ * call might be missed.
+ */
+void
+wf_library_monitor_add(GFile *directory)
+{
+	gchar *uri;
+
+	g_return_if_fail(G_IS_FILE(directory));
+
+	wf_library_monitor_init();
+
+	uri = g_file_get_uri(directory);
+
+	if (g_hash_table_contains(MonitorData.roots, uri))
+	{
+		g_info("Directory %s is already being watched", uri);
+		g_free(uri);
+
+		return;
+	}
+
+	g_info("Watching directory %s for changes", uri);
+
+	// The table takes ownership of the string
+	g_hash_table_add(MonitorData.roots, uri);
+
+	// Find all directories below it; the root itself is reported as well
+	wf_file_inspector_scan_async(directory, TRUE /* skip_dotfiles */, MonitorData.cancellable, wf_library_monitor_scan_found_cb, NULL, NULL);
+}
+
+/*
+ * wf_library_monitor_remove:
+ * @directory: the directory to stop watching
+ *
+ * Stop watching a directory that has been added using
+ * wf_library_monitor_add().  The songs in it are left alone.
+ */
+void
+wf_library_monitor_remove(GFile *directory)
+{
+	gchar *uri;
+
+	g_return_if_fail(G_IS_FILE(directory));
+
+	if (MonitorData.roots == NULL)
+	{
+		return;
+	}
+
+	uri = g_file_get_uri(directory);
+
+	if (g_hash_table_remove(MonitorData.roots, uri))
+	{
+		wf_library_monitor_unwatch(uri);
+	}
+
+	g_free(uri);
+}
+
+// Start monitoring a single directory
+static void
+wf_library_monitor_watch(GFile *directory)
+{
+	GFileMonitor *monitor;
+	GError *err = NULL;
+	gchar *uri;
+
+	uri = g_file_get_uri(directory);
+
+	if (g_hash_table_contains(MonitorData.monitors, uri))
+	{
+		g_free(uri);
+
+		return;
+	}
+
+	monitor = g_file_monitor_directory(directory, G_FILE_MONITOR_WATCH_MOVES, MonitorData.cancellable, &err);
+
+	if (monitor == NULL)
+	{
+		g_warning("Could not watch directory %s: %s", uri, err->message);
+		g_error_free(err);
+		g_free(uri);
+
+		return;
+	}
+
+	g_signal_connect(monitor, "changed", G_CALLBACK(wf_library_monitor_changed_cb), NULL);
+
+	// The table takes ownership of both
+	g_hash_table_insert(MonitorData.monitors, uri, monitor);
+}
+
+// Stop monitoring a directory and everything below it
+static void
+wf_library_monitor_unwatch(const gchar *uri)
+{
+	GHashTableIter iter;
+	gpointer key;
+	gchar *prefix;
+
+	prefix = g_strconcat(uri, "/", NULL);
+
+	g_hash_table_iter_init(&iter, MonitorData.monitors);
+
+	while (g_hash_table_iter_next(&iter, &key, NULL /* value */))
+	{
+		if (g_str_equal(key, uri) || g_str_has_prefix(key, prefix))
+		{
+			g_hash_table_iter_remove(&iter);
+		}
+	}
+
+	g_free(prefix);
+}
+
+// Remember a change, merging it with an earlier change of the same file
+static void
+wf_library_monitor_queue(WfLibraryMonitorAction action, GFile *file, GFile *other)
+{
+	WfLibraryMonitorChange *change;
+	gboolean refresh = FALSE;
+	GList *link;
+	gchar *uri;
+
+	// Temporary files are usually renamed once complete
+	if (action == WF_LIBRARY_MONITOR_MOVED && other != NULL)
+	{
+		if (wf_utils_file_is_dotfile(file))
+		{
+			wf_library_monitor_queue(WF_LIBRARY_MONITOR_ADDED, other, NULL);
+
+			return;
+		}
+		else if (wf_utils_file_is_dotfile(other))
+		{
+			action = WF_LIBRARY_MONITOR_DELETED;
+			other = NULL;
+		}
+	}
+	else if (action == WF_LIBRARY_MONITOR_MOVED)
+	{
+		// Moved to somewhere unknown
+		action = WF_LIBRARY_MONITOR_DELETED;
+	}
+
+	if (wf_utils_file_is_dotfile(file))
+	{
+		return;
+	}
+
+	uri = g_file_get_uri(file);
+	link = g_hash_table_lookup(MonitorData.pending, uri);
+
+	if (link != NULL && ((WfLibraryMonitorChange *) link->data)->action == WF_LIBRARY_MONITOR_MOVED)
+	{
+		// The file at @uri arrived there by the pending move, which has to be kept
+		wf_library_monitor_queue_after_move(link, action, other);
+		g_free(uri);
+
+		return;
+	}
+
+	if (link != NULL)
+	{
+		change = link->data;
+
+		if (change->action == WF_LIBRARY_MONITOR_ADDED && action == WF_LIBRARY_MONITOR_CHANGED)
+		{
+			// Adding a file fetches its metadata already
+			g_free(uri);
+
+			return;
+		}
+
+		// Take the old change out; the new one replaces it
+		g_hash_table_remove(MonitorData.pending, uri);
+		g_queue_delete_link(&MonitorData.changes, link);
+
+		if (change->action == WF_LIBRARY_MONITOR_ADDED && action == WF_LIBRARY_MONITOR_DELETED)
+		{
+			// The file has come and gone already
+			wf_library_monitor_change_free(change);
+			g_free(uri);
+
+			return;
+		}
+		else if (change->action == WF_LIBRARY_MONITOR_ADDED && action == WF_LIBRARY_MONITOR_MOVED)
+		{
+			// The file was never added in the first place
+			wf_library_monitor_change_free(change);
+			g_free(uri);
+
+			wf_library_monitor_queue(WF_LIBRARY_MONITOR_ADDED, other, NULL);
+
+			return;
+		}
+
+		// A change made before moving the file still has to be applied
+		refresh = (change->action == WF_LIBRARY_MONITOR_CHANGED || change->refresh) && action == WF_LIBRARY_MONITOR_MOVED;
+
+		wf_library_monitor_change_free(change);
+	}
+
+	change = g_slice_new0(WfLibraryMonitorChange);
+	change->action = action;
+	change->uri = uri;
+	change->file = g_object_ref(file);
+	change->other = (other != NULL) ? g_object_ref(other) : NULL;
+	change->other_uri = (other != NULL) ? g_file_get_uri(other) : NULL;
+	change->refresh = refresh;
+
+	g_queue_push_tail(&MonitorData.changes, change);
+	g_hash_table_insert(MonitorData.pending, (change->other_uri != NULL) ? change->other_uri : change->uri, g_queue_peek_tail_link(&MonitorData.changes));
+
+	if (MonitorData.flush_id == 0)
+	{
+		MonitorData.flush_id = g_timeout_add(FLUSH_DELAY, wf_library_monitor_flush_cb, NULL);
+	}
+}
+
+/*
+ * Merge a change of a file with the pending move (at @link) that brought it
+ * to its current location.  The move itself is never dropped, or the song
+ * would be lost at its old location.
+ */
+static void
+wf_library_monitor_queue_after_move(GList *link, WfLibraryMonitorAction action, GFile *other)
+{
+	WfLibraryMonitorChange *change = link->data;
+
+	g_hash_table_remove(MonitorData.pending, change->other_uri);
+
+	switch (action)
+	{
+		case WF_LIBRARY_MONITOR_ADDED:
+		case WF_LIBRARY_MONITOR_CHANGED:
+			// Written to after the move
+			change->refresh = TRUE;
+			break;
+		case WF_LIBRARY_MONITOR_DELETED:
+			// Moved and then deleted is just deleted at the old location
+			change->action = WF_LIBRARY_MONITOR_DELETED;
+			g_clear_object(&change->other);
+			g_clear_pointer(&change->other_uri, g_free);
+			change->refresh = FALSE;
+			break;
+		case WF_LIBRARY_MONITOR_MOVED:
+			// Moved on again, so only the final destination counts
+			g_object_unref(change->other);
+			g_free(change->other_uri);
+			change->other = g_object_ref(other);
+			change->other_uri = g_file_get_uri(other);
+			break;
+	}
+
+	if (change->other_uri != NULL)
+	{
+		g_hash_table_insert(MonitorData.pending, change->other_uri, link);
+	}
+	else if (!g_hash_table_contains(MonitorData.pending, change->uri))
+	{
+		// Something new may have appeared at the old location in the meantime, which comes later
+		g_hash_table_insert(MonitorData.pending, change->uri, link);
+	}
+}
+
+static void
+wf_library_monitor_apply(WfLibraryMonitorChange *change)
+{
+	WfSong *song;
+
+	switch (change->action)
+	{
+		case WF_LIBRARY_MONITOR_ADDED:
+			wf_library_monitor_apply_added(change->file);
+			break;
+		case WF_LIBRARY_MONITOR_CHANGED:
+			song = wf_song_get_by_uri(change->uri);
+
+			if (song != NULL)
+			{
+				wf_library_queue_metadata_update(song);
+			}
+
+			break;
+		case WF_LIBRARY_MONITOR_DELETED:
+			wf_library_monitor_apply_deleted(change->file, change->uri);
+			break;
+		case WF_LIBRARY_MONITOR_MOVED:
+			wf_library_monitor_apply_moved(change->file, change->other, change->uri);
+
+			song = change->refresh ? wf_song_get_by_uri(change->other_uri) : NULL;
+
+			if (song != NULL)
+			{
+				wf_library_queue_metadata_update(song);
+			}
+
+			break;
+	}
+}
+
+// A file or directory has appeared
+static void
+wf_library_monitor_apply_added(GFile *file)
+{
+	WfSong *song;
+	gchar *uri;
+
+	uri = g_file_get_uri(file);
+	song = wf_song_get_by_uri(uri);
+	g_free(uri);
+
+	if (song != NULL)
+	{
+		// Replaced by a new file
+		wf_library_queue_metadata_update(song);
+
+		return;
+	}
+
+	// Add it, or whatever is in it if it is a directory
+	wf_library_add_by_file_async(file, NULL, WF_LIBRARY_CHECK_DEFAULT, FALSE /* skip_metadata */, MonitorData.cancellable, NULL, NULL);
+
+	// Watch it if it is a directory
+	wf_file_inspector_scan_async(file, TRUE /* skip_dotfiles */, MonitorData.cancellable, wf_library_monitor_scan_found_cb, NULL, NULL);
+}
+
+// A file or directory has disappeared
+static void
+wf_library_monitor_apply_deleted(GFile *file, const gchar *uri)
+{
+	WfSong *song;
+	GList *songs, *link;
+
+	song = wf_song_get_by_uri(uri);
+
+	if (song != NULL)
+	{
+		g_info("Song %s has been deleted, removing it", uri);
+		wf_library_remove_song(song);
+
+		return;
+	}
+
+	if (!g_hash_table_contains(MonitorData.monitors, uri))
+	{
+		// Not something the library knows about
+		return;
+	}
+
+	// A whole directory is gone
+	wf_library_monitor_unwatch(uri);
+
+	songs = wf_song_get_in_directory(uri);
+
+	for (link = songs; link != NULL; link = link->next)
+	{
+		wf_library_remove_song(link->data);
+	}
+
+	g_list_free(songs);
+}
+
+// A file or directory has been renamed, or moved within the watched tree
+static void
+wf_library_monitor_apply_moved(GFile *file, GFile *other, const gchar *uri)
+{
+	WfSong *song, *existing;
+	GList *songs, *link;
+	GFile *new_file;
+	gchar *other_uri;
+	gchar *prefix;
+	gchar *song_uri;
+
+	other_uri = g_file_get_uri(other);
+	existing = wf_song_get_by_uri(other_uri);
+	g_free(other_uri);
+
+	song = wf_song_get_by_uri(uri);
+
+	if (song != NULL)
+	{
+		if (existing != NULL)
+		{
+			// Moved over another song, which now has different contents
+			wf_library_remove_song(song);
+			wf_library_queue_metadata_update(existing);
+		}
+		else
+		{
+			wf_song_move_to_file(song, other);
+			wf_library_mark_song_dirty(song);
+		}
+
+		return;
+	}
+
+	if (g_hash_table_contains(MonitorData.monitors, uri))
+	{
+		// Take the songs in the directory along
+		wf_library_monitor_unwatch(uri);
+
+		prefix = wf_library_monitor_get_song_prefix(uri);
+		songs = wf_song_get_in_directory(uri);
+
+		for (link = songs; link != NULL; link = link->next)
+		{
+			song = link->data;
+			song_uri = wf_song_get_uri(song);
+
+			if (g_str_has_prefix(song_uri, prefix))
+			{
+				new_file = g_file_resolve_relative_path(other, song_uri + strlen(prefix));
+
+				wf_song_move_to_file(song, new_file);
+				wf_library_mark_song_dirty(song);
+
+				g_object_unref(new_file);
+			}
+
+			g_free(song_uri);
+		}
+
+		g_list_free(songs);
+		g_free(prefix);
+	}
+
+	// Pick up anything that was not part of the library yet
+	wf_library_monitor_apply_added(other);
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+// Check if a file is inside one of the watched roots
+static gboolean
+wf_library_monitor_is_watched(GFile *file)
+{
+	GHashTableIter iter;
+	gpointer key;
+	GFile *root;
+	gboolean watched = FALSE;
+
+	g_hash_table_iter_init(&iter, MonitorData.roots);
+
+	while (!watched && g_hash_table_iter_next(&iter, &key, NULL /* value */))
+	{
+		root = g_file_new_for_uri(key);
+		watched = (g_file_equal(root, file) || g_file_has_prefix(file, root));
+		g_object_unref(root);
+	}
+
+	return watched;
+}
+
+// Song URIs are unescaped, so compare against the unescaped directory URI
+static gchar *
+wf_library_monitor_get_song_prefix(const gchar *uri)
+{
+	gchar *unescaped;
+	gchar *prefix;
+
+	unescaped = g_uri_unescape_string(uri, NULL /* illegal_characters */);
+	prefix = g_strconcat(unescaped, "/", NULL);
+	g_free(unescaped);
+
+	return prefix;
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+
+static void
+wf_library_monitor_change_free(WfLibraryMonitorChange *change)
+{
+	g_free(change->uri);
+	g_free(change->other_uri);
+	g_object_unref(change->file);
+
+	if (change->other != NULL)
+	{
+		g_object_unref(change->other);
+	}
+
+	g_slice_free(WfLibraryMonitorChange, change);
+}
+
+static void
+wf_library_monitor_file_monitor_free(GFileMonitor *monitor)
+{
+	g_file_monitor_cancel(monitor);
+	g_object_unref(monitor);
+}
+
+void
+wf_library_monitor_finalize(void)
+{
+	if (MonitorData.roots == NULL)
+	{
+		return;
+	}
+
+	// Stop scans and additions in progress
+	g_cancellable_cancel(MonitorData.cancellable);
+	g_object_unref(MonitorData.cancellable);
+
+	if (MonitorData.flush_id > 0)
+	{
+		g_source_remove(MonitorData.flush_id);
+	}
+
+	g_queue_clear_full(&MonitorData.changes, (GDestroyNotify) wf_library_monitor_change_free);
+	g_hash_table_unref(MonitorData.pending);
+	g_hash_table_unref(MonitorData.monitors);
+	g_hash_table_unref(MonitorData.roots);
+
+	MonitorData = (WfLibraryMonitorDetails) { 0 };
+}
+
+/* DESTRUCTORS END */
+
+/* END OF FILE */
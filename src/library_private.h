@@ -34,6 +34,10 @@
 G_BEGIN_DECLS
 
 /* DEFINES BEGIN */
+
+// Version of the library file format, shared with the benchmarks that write such files
+#define WF_LIBRARY_FILE_VERSION 20221201
+
 /* DEFINES END */
 
 /* MODULE TYPES BEGIN */
@@ -54,6 +58,9 @@ gboolean wf_library_read(void);
 
 void wf_library_updated_stats(void);
 void wf_library_queue_write(void);
+void wf_library_mark_song_dirty(WfSong *song);
+void wf_library_load_song(WfSong *song);
+void wf_library_queue_metadata_update(WfSong *song);
 
 /* FUNCTION PROTOTYPES END */
 
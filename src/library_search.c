@@ -0,0 +1,553 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * library_search.c  This file is part of LibWoofer
+ * Copyright (C) 2023  Quico Augustijn
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this library.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/*
+ * Notes:
+ * - For all return value pointers, the suffix '_rv' is used to indicate the
+ *   value of the pointer can be changed by the respective function.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <string.h>
+#include <glib.h>
+
+// Global includes
+/*< none >*/
+
+// Module includes
+#include <woofer/library_search.h>
+
+// Dependency includes
+#include <woofer/song.h>
+#include <woofer/song_private.h>
+#include <woofer/characters.h>
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * This module keeps an index of the words in the metadata of the songs in the
+ * library, so the library can be searched without going through every song.
+ * The words are normalized in the same way as the sort keys of the songs (see
+ * wf_chars_get_sort_key()), so "Beyoncé" is also found by "beyonce".
+ *
+ * Songs that change are only marked; they are (re)indexed just before the
+ * next search.  This way reading a library or updating metadata does not pay
+ * for the index until it is actually used.  The words are also kept in a
+ * sorted array, so all words starting with a searched prefix can be found
+ * using a binary search.
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Amount of changed songs after which the sorted words are rebuilt at once
+#define SEARCH_REBUILD_THRESHOLD 1024
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef struct _WfSearchWord WfSearchWord;
+typedef struct _WfSearchDetails WfSearchDetails;
+
+// A single word with the songs it is used in
+struct _WfSearchWord
+{
+	gchar *text;
+	GHashTable *songs; // Set of #WfSong
+};
+
+struct _WfSearchDetails
+{
+	GHashTable *words; // Text -> #WfSearchWord
+	GHashTable *song_words; // #WfSong -> #GPtrArray of its #WfSearchWord
+	GHashTable *pending; // Set of #WfSong that need to be (re)indexed
+
+	GPtrArray *sorted; // All #WfSearchWord sorted by their text
+	gboolean sorted_dirty; // %TRUE if sorted has to be rebuilt
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static gint wf_library_search_word_compare_cb(gconstpointer a, gconstpointer b);
+
+static void wf_library_search_init(void);
+static void wf_library_search_flush(void);
+static void wf_library_search_index(WfSong *song);
+static void wf_library_search_index_text(WfSong *song, GPtrArray *words, const gchar *text);
+static void wf_library_search_unindex(WfSong *song);
+static void wf_library_search_ensure_sorted(void);
+static guint wf_library_search_find_position(const gchar *text);
+static GHashTable * wf_library_search_find_prefix(const gchar *prefix);
+
+static gchar ** wf_library_search_split(const gchar *text);
+
+static void wf_library_search_word_free(WfSearchWord *word);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+static WfSearchDetails SearchData = { 0 };
+
+/* GLOBAL VARIABLES END */
+
+/* CALLBACK FUNCTIONS BEGIN */
+
+static gint
+wf_library_search_word_compare_cb(gconstpointer a, gconstpointer b)
+{
+	const WfSearchWord *word_a = *((const WfSearchWord **) a);
+	const WfSearchWord *word_b = *((const WfSearchWord **) b);
+
+	return strcmp(word_a->text, word_b->text);
+}
+
+/* CALLBACK FUNCTIONS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+static void
+wf_library_search_init(void)
+{
+	if (SearchData.words != NULL)
+	{
+		return;
+	}
+
+	SearchData.words = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) wf_library_search_word_free);
+	SearchData.song_words = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_ptr_array_unref);
+	SearchData.pending = g_hash_table_new(g_direct_hash, g_direct_equal);
+	SearchData.sorted = g_ptr_array_new();
+	SearchData.sorted_dirty = FALSE;
+}
+
+// Mark @song to be (re)indexed before the next search
+void
+wf_library_search_song_changed(WfSong *song)
+{
+	g_return_if_fail(WF_IS_SONG(song));
+
+	if (!wf_song_is_in_list(song))
+	{
+		return;
+	}
+
+	wf_library_search_init();
+
+	g_hash_table_add(SearchData.pending, song);
+}
+
+// Take @song out of the index, this has to be done before it is freed
+void
+wf_library_search_song_removed(WfSong *song)
+{
+	g_return_if_fail(WF_IS_SONG(song));
+
+	if (SearchData.words == NULL)
+	{
+		return;
+	}
+
+	g_hash_table_remove(SearchData.pending, song);
+	wf_library_search_unindex(song);
+}
+
+// Empty the whole index, for when the library is cleared
+void
+wf_library_search_clear(void)
+{
+	if (SearchData.words == NULL)
+	{
+		return;
+	}
+
+	g_hash_table_remove_all(SearchData.pending);
+	g_hash_table_remove_all(SearchData.song_words);
+	g_ptr_array_set_size(SearchData.sorted, 0);
+	g_hash_table_remove_all(SearchData.words);
+	SearchData.sorted_dirty = FALSE;
+}
+
+/*
+ * Find the songs in the library matching @query.  Every word in @query has
+ * to be the start of a word in the title, artist, album artist, album or
+ * filename of a song.  The order of the returned songs is undefined.
+ */
+GList *
+wf_library_search_query(const gchar *query)
+{
+	GHashTable *result = NULL;
+	GHashTable *matches;
+	GHashTableIter iter;
+	gpointer song;
+	GList *list;
+	gchar *key;
+	gchar **prefixes;
+	guint x;
+
+	if (query == NULL || SearchData.words == NULL)
+	{
+		return NULL;
+	}
+
+	wf_library_search_flush();
+	wf_library_search_ensure_sorted();
+
+	key = wf_chars_get_sort_key(query);
+	prefixes = wf_library_search_split(key);
+	g_free(key);
+
+	for (x = 0; prefixes[x] != NULL; x++)
+	{
+		matches = wf_library_search_find_prefix(prefixes[x]);
+
+		if (result == NULL)
+		{
+			result = matches;
+		}
+		else
+		{
+			// Only keep the songs that also match this prefix
+			g_hash_table_iter_init(&iter, result);
+
+			while (g_hash_table_iter_next(&iter, &song, NULL))
+			{
+				if (!g_hash_table_contains(matches, song))
+				{
+					g_hash_table_iter_remove(&iter);
+				}
+			}
+
+			g_hash_table_unref(matches);
+		}
+
+		if (g_hash_table_size(result) == 0)
+		{
+			break;
+		}
+	}
+
+	g_strfreev(prefixes);
+
+	if (result == NULL)
+	{
+		return NULL;
+	}
+
+	list = g_hash_table_get_keys(result);
+	g_hash_table_unref(result);
+
+	return list;
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+// Index all songs that changed since the last search
+static void
+wf_library_search_flush(void)
+{
+	GHashTableIter iter;
+	gpointer song;
+
+	if (g_hash_table_size(SearchData.pending) == 0)
+	{
+		return;
+	}
+
+	// Inserting many words one by one is slower than sorting them all again
+	if (g_hash_table_size(SearchData.pending) > SEARCH_REBUILD_THRESHOLD)
+	{
+		SearchData.sorted_dirty = TRUE;
+	}
+
+	g_hash_table_iter_init(&iter, SearchData.pending);
+
+	while (g_hash_table_iter_next(&iter, &song, NULL))
+	{
+		wf_library_search_index(song);
+	}
+
+	g_hash_table_remove_all(SearchData.pending);
+}
+
+static void
+wf_library_search_index(WfSong *song)
+{
+	GPtrArray *words;
+
+	wf_library_search_unindex(song);
+
+	words = g_ptr_array_new();
+
+	wf_library_search_index_text(song, words, wf_song_get_title(song));
+	wf_library_search_index_text(song, words, wf_song_get_artist(song));
+	wf_library_search_index_text(song, words, wf_song_get_album_artist(song));
+	wf_library_search_index_text(song, words, wf_song_get_album(song));
+	wf_library_search_index_text(song, words, wf_song_get_name(song));
+
+	g_hash_table_insert(SearchData.song_words, song, words);
+}
+
+// Add @song to all words in @text and keep track of them in @words
+static void
+wf_library_search_index_text(WfSong *song, GPtrArray *words, const gchar *text)
+{
+	WfSearchWord *word;
+	gchar **split;
+	gchar *key;
+	guint pos, x;
+
+	if (text == NULL)
+	{
+		return;
+	}
+
+	key = wf_chars_get_sort_key(text);
+	split = wf_library_search_split(key);
+	g_free(key);
+
+	for (x = 0; split[x] != NULL; x++)
+	{
+		word = g_hash_table_lookup(SearchData.words, split[x]);
+
+		if (word == NULL)
+		{
+			word = g_slice_new(WfSearchWord);
+			word->text = g_strdup(split[x]);
+			word->songs = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+			g_hash_table_insert(SearchData.words, word->text, word);
+
+			if (!SearchData.sorted_dirty)
+			{
+				pos = wf_library_search_find_position(word->text);
+				g_ptr_array_insert(SearchData.sorted, pos, word);
+			}
+		}
+
+		// The same word may be used in multiple fields of a song
+		if (g_hash_table_add(word->songs, song))
+		{
+			g_ptr_array_add(words, word);
+		}
+	}
+
+	g_strfreev(split);
+}
+
+static void
+wf_library_search_unindex(WfSong *song)
+{
+	WfSearchWord *word;
+	GPtrArray *words;
+	guint pos, x;
+
+	words = g_hash_table_lookup(SearchData.song_words, song);
+
+	if (words == NULL)
+	{
+		return;
+	}
+
+	for (x = 0; x < words->len; x++)
+	{
+		word = g_ptr_array_index(words, x);
+
+		g_hash_table_remove(word->songs, song);
+
+		// Drop words that are no longer used by any song
+		if (g_hash_table_size(word->songs) == 0)
+		{
+			if (!SearchData.sorted_dirty)
+			{
+				pos = wf_library_search_find_position(word->text);
+				g_ptr_array_remove_index(SearchData.sorted, pos);
+			}
+
+			g_hash_table_remove(SearchData.words, word->text);
+		}
+	}
+
+	g_hash_table_remove(SearchData.song_words, song);
+}
+
+static void
+wf_library_search_ensure_sorted(void)
+{
+	GHashTableIter iter;
+	gpointer word;
+
+	if (!SearchData.sorted_dirty)
+	{
+		return;
+	}
+
+	g_ptr_array_set_size(SearchData.sorted, 0);
+	g_hash_table_iter_init(&iter, SearchData.words);
+
+	while (g_hash_table_iter_next(&iter, NULL, &word))
+	{
+		g_ptr_array_add(SearchData.sorted, word);
+	}
+
+	g_ptr_array_sort(SearchData.sorted, wf_library_search_word_compare_cb);
+	SearchData.sorted_dirty = FALSE;
+}
+
+// Get the position of the first word in the sorted array that is >= @text
+static guint
+wf_library_search_find_position(const gchar *text)
+{
+	WfSearchWord *word;
+	guint low = 0, high = SearchData.sorted->len, mid;
+
+	while (low < high)
+	{
+		mid = low + ((high - low) / 2);
+		word = g_ptr_array_index(SearchData.sorted, mid);
+
+		if (strcmp(word->text, text) < 0)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+// Collect the songs of all words starting with @prefix into a new set
+static GHashTable *
+wf_library_search_find_prefix(const gchar *prefix)
+{
+	GHashTable *songs = g_hash_table_new(g_direct_hash, g_direct_equal);
+	GHashTableIter iter;
+	WfSearchWord *word;
+	gpointer song;
+	guint pos;
+
+	for (pos = wf_library_search_find_position(prefix); pos < SearchData.sorted->len; pos++)
+	{
+		word = g_ptr_array_index(SearchData.sorted, pos);
+
+		if (!g_str_has_prefix(word->text, prefix))
+		{
+			break;
+		}
+
+		g_hash_table_iter_init(&iter, word->songs);
+
+		while (g_hash_table_iter_next(&iter, &song, NULL))
+		{
+			g_hash_table_add(songs, song);
+		}
+	}
+
+	return songs;
+}
+
+/*
+ * Split a normalized string into words.  Any ASCII character that is not a
+ * letter or digit separates words; other characters are kept as they are.
+ */
+static gchar **
+wf_library_search_split(const gchar *text)
+{
+	GPtrArray *split = g_ptr_array_new();
+	const gchar *p, *start = NULL;
+
+	for (p = text; p != NULL; p++)
+	{
+		if (*p != '\0' && ((guchar) *p >= 128 || g_ascii_isalnum(*p)))
+		{
+			if (start == NULL)
+			{
+				start = p;
+			}
+
+			continue;
+		}
+
+		if (start != NULL)
+		{
+			g_ptr_array_add(split, g_strndup(start, p - start));
+			start = NULL;
+		}
+
+		if (*p == '\0')
+		{
+			break;
+		}
+	}
+
+	g_ptr_array_add(split, NULL);
+
+	return (gchar **) g_ptr_array_free(split, FALSE);
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+
+static void
+wf_library_search_word_free(WfSearchWord *word)
+{
+	g_hash_table_unref(word->songs);
+	g_free(word->text);
+
+	g_slice_free(WfSearchWord, word);
+}
+
+void
+wf_library_search_finalize(void)
+{
+	if (SearchData.words == NULL)
+	{
+		return;
+	}
+
+	g_hash_table_unref(SearchData.pending);
+	g_hash_table_unref(SearchData.song_words);
+	g_ptr_array_unref(SearchData.sorted);
+	g_hash_table_unref(SearchData.words);
+
+	SearchData = (WfSearchDetails) { 0 };
+}
+
+/* DESTRUCTORS END */
+
+/* END OF FILE */
@@ -23,6 +23,7 @@
 
 // Library includes
 #include <stdarg.h>
+#include <string.h>
 #include <glib.h>
 #include <glib-object.h>
 
@@ -51,14 +52,37 @@
  * Since this module only contains utilities for other modules, all of these
  * "utilities" are part of the normal module functions and constructors,
  * destructors, etc. are left out.
+ *
+ * It also provides a simple slab allocator for records of which there are a
+ * lot and that are allocated at roughly the same time, like the private data
+ * of songs.  Records are handed out from large blocks, so records allocated
+ * after each other are also next to each other in memory.
  */
 
 /* DESCRIPTION END */
 
 /* DEFINES BEGIN */
+
+// Alignment of records in a slab
+#define WF_MEMORY_SLAB_ALIGN (2 * sizeof(gpointer))
+
 /* DEFINES END */
 
 /* CUSTOM TYPES BEGIN */
+
+struct _WfMemorySlab
+{
+	GMutex mutex; // Slabs may be used from different threads
+
+	gsize record_size; // Size of a single record, including padding
+	guint block_records; // Amount of records in a single block
+
+	gchar *block; // Block that new records are currently taken from
+	guint block_used; // Amount of records used of the current block
+
+	gpointer free_list; // Records that have been freed, ready to be reused
+};
+
 /* CUSTOM TYPES END */
 
 /* FUNCTION PROTOTYPES BEGIN */
@@ -171,6 +195,87 @@ wf_memory_clear_key_file(GKeyFile **key_file)
 	}
 }
 
+/*
+ * Creates a new slab that hands out records of @record_size bytes, allocated
+ * @block_records at a time.  Slabs are meant to live as long as the
+ * application, so they cannot be destroyed.
+ */
+WfMemorySlab *
+wf_memory_slab_new(gsize record_size, guint block_records)
+{
+	WfMemorySlab *slab;
+
+	g_return_val_if_fail(record_size > 0, NULL);
+	g_return_val_if_fail(block_records > 0, NULL);
+
+	slab = g_new0(WfMemorySlab, 1);
+	g_mutex_init(&slab->mutex);
+
+	// Freed records store the free list link in their first bytes
+	record_size = MAX(record_size, sizeof(gpointer));
+	slab->record_size = (record_size + WF_MEMORY_SLAB_ALIGN - 1) & ~(WF_MEMORY_SLAB_ALIGN - 1);
+	slab->block_records = block_records;
+
+	return slab;
+}
+
+// Take a zeroed record from @slab, reusing freed records first
+gpointer
+wf_memory_slab_alloc0(WfMemorySlab *slab)
+{
+	gpointer mem;
+
+	g_return_val_if_fail(slab != NULL, NULL);
+
+	g_mutex_lock(&slab->mutex);
+
+	if (slab->free_list != NULL)
+	{
+		mem = slab->free_list;
+		slab->free_list = *(gpointer *) mem;
+	}
+	else
+	{
+		if (slab->block == NULL || slab->block_used >= slab->block_records)
+		{
+			/*
+			 * Blocks are never given back; freed records are reused
+			 * instead, which is fine for the objects a slab is used for.
+			 */
+			slab->block = g_malloc(slab->record_size * slab->block_records);
+			slab->block_used = 0;
+		}
+
+		mem = slab->block + (slab->record_size * slab->block_used);
+		slab->block_used++;
+	}
+
+	g_mutex_unlock(&slab->mutex);
+
+	memset(mem, 0, slab->record_size);
+
+	return mem;
+}
+
+// Give a record allocated with wf_memory_slab_alloc0() back to @slab
+void
+wf_memory_slab_free(WfMemorySlab *slab, gpointer mem)
+{
+	g_return_if_fail(slab != NULL);
+
+	if (mem == NULL)
+	{
+		return;
+	}
+
+	g_mutex_lock(&slab->mutex);
+
+	*(gpointer *) mem = slab->free_list;
+	slab->free_list = mem;
+
+	g_mutex_unlock(&slab->mutex);
+}
+
 /* MODULE FUNCTIONS END */
 
 /* END OF FILE */
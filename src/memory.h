@@ -37,6 +37,9 @@ G_BEGIN_DECLS
 /* DEFINES END */
 
 /* MODULE TYPES BEGIN */
+
+typedef struct _WfMemorySlab WfMemorySlab;
+
 /* MODULE TYPES END */
 
 /* FUNCTION PROTOTYPES BEGIN */
@@ -51,6 +54,10 @@ void wf_memory_clear_date_time(GDateTime **dt);
 void wf_memory_clear_variant(GVariant **value);
 void wf_memory_clear_key_file(GKeyFile **key_file);
 
+WfMemorySlab * wf_memory_slab_new(gsize record_size, guint block_records);
+gpointer wf_memory_slab_alloc0(WfMemorySlab *slab);
+void wf_memory_slab_free(WfMemorySlab *slab, gpointer mem);
+
 /* FUNCTION PROTOTYPES END */
 
 G_END_DECLS
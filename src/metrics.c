@@ -0,0 +1,228 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * metrics.c  This file is part of LibWoofer
+ * Copyright (C) 2023  Quico Augustijn
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this library.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <string.h>
+#include <glib.h>
+
+// Global includes
+/*< none >*/
+
+// Module includes
+#include <woofer/metrics.h>
+
+// Dependency includes
+/*< none >*/
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * This module keeps timing histograms of the operations that matter for the
+ * responsiveness of the software, so it can be seen where the time goes on a
+ * long-running instance without turning on debug messages.
+ *
+ * Every metric counts how often it has been measured and keeps the total,
+ * shortest and longest duration and a histogram with power of 2 buckets, all
+ * in microseconds.  The values only ever increase, so whoever reads them can
+ * calculate rates by comparing two readings.  Measurements may be recorded
+ * from any thread.
+ *
+ * When built with WF_ENABLE_METRICS set to 0, nothing is measured and the
+ * metrics are always empty.
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+typedef struct _WfMetricsHistogram WfMetricsHistogram;
+typedef struct _WfMetricsDetails WfMetricsDetails;
+
+struct _WfMetricsHistogram
+{
+	guint64 count;
+	guint64 total;
+	guint64 min;
+	guint64 max;
+
+	guint64 buckets[WF_METRICS_BUCKETS];
+};
+
+struct _WfMetricsDetails
+{
+	GMutex mutex;
+
+	WfMetricsHistogram histograms[WF_METRIC_COUNT];
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+#if WF_ENABLE_METRICS
+static guint wf_metrics_get_bucket(guint64 duration);
+#endif
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+
+// Names as reported, indexed by #WfMetric
+static const gchar * const MetricNames[WF_METRIC_COUNT] =
+{
+	"metadata-parse",
+	"library-read",
+	"library-write",
+	"pick",
+	"track-change",
+	"dbus-call",
+	"daemon-command"
+};
+
+#if WF_ENABLE_METRICS
+static WfMetricsDetails MetricsData = { 0 };
+#endif
+
+/* GLOBAL VARIABLES END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+#if WF_ENABLE_METRICS
+
+// Get the start time of a measurement to pass to wf_metrics_stop()
+gint64
+wf_metrics_start(void)
+{
+	return g_get_monotonic_time();
+}
+
+// Record the time passed since @start, as returned by wf_metrics_start()
+void
+wf_metrics_stop(WfMetric metric, gint64 start)
+{
+	wf_metrics_record(metric, g_get_monotonic_time() - start);
+}
+
+// Record a measurement of @duration microseconds
+void
+wf_metrics_record(WfMetric metric, gint64 duration)
+{
+	WfMetricsHistogram *hist;
+	guint64 value = (guint64) MAX(duration, 0);
+
+	g_return_if_fail(metric < WF_METRIC_COUNT);
+
+	g_mutex_lock(&MetricsData.mutex);
+
+	hist = &MetricsData.histograms[metric];
+
+	hist->min = (hist->count == 0) ? value : MIN(hist->min, value);
+	hist->max = MAX(hist->max, value);
+	hist->total += value;
+	hist->count++;
+	hist->buckets[wf_metrics_get_bucket(value)]++;
+
+	g_mutex_unlock(&MetricsData.mutex);
+}
+
+#endif
+
+/*
+ * wf_metrics_get_variant:
+ *
+ * Get all metrics as a dictionary of the metric name to a tuple with the
+ * count, the total, minimum and maximum duration in microseconds and the
+ * counts of the histogram buckets.
+ *
+ * Returns: (transfer floating): a variant of type %WF_METRICS_VARIANT_TYPE
+ */
+GVariant *
+wf_metrics_get_variant(void)
+{
+	GVariantBuilder builder;
+#if WF_ENABLE_METRICS
+	WfMetricsHistogram copy[WF_METRIC_COUNT];
+	WfMetricsHistogram *hist;
+	guint x;
+#endif
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE(WF_METRICS_VARIANT_TYPE));
+
+#if WF_ENABLE_METRICS
+	// Copy first, so the lock is not held while building the variant
+	g_mutex_lock(&MetricsData.mutex);
+	memcpy(copy, MetricsData.histograms, sizeof(copy));
+	g_mutex_unlock(&MetricsData.mutex);
+
+	for (x = 0; x < WF_METRIC_COUNT; x++)
+	{
+		hist = &copy[x];
+
+		g_variant_builder_add(&builder, "{s(tttt@at)}",
+		                      MetricNames[x],
+		                      hist->count,
+		                      hist->total,
+		                      hist->min,
+		                      hist->max,
+		                      g_variant_new_fixed_array(G_VARIANT_TYPE_UINT64, hist->buckets, WF_METRICS_BUCKETS, sizeof(guint64)));
+	}
+#else
+	(void) MetricNames;
+#endif
+
+	return g_variant_builder_end(&builder);
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+#if WF_ENABLE_METRICS
+
+// The bucket of @duration: the first one with a limit above it, or the last one
+static guint
+wf_metrics_get_bucket(guint64 duration)
+{
+	guint bucket = 0;
+
+	while (bucket < (WF_METRICS_BUCKETS - 1) && duration >= (G_GUINT64_CONSTANT(1) << bucket))
+	{
+		bucket++;
+	}
+
+	return bucket;
+}
+
+#endif
+
+/* MODULE UTILITIES END */
+
+/* END OF FILE */
@@ -0,0 +1,99 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * metrics.h  This file is part of LibWoofer
+ * Copyright (C) 2023  Quico Augustijn
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this library.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+#ifndef __WF_METRICS__
+#define __WF_METRICS__
+
+/* INCLUDES BEGIN */
+
+#include <glib.h>
+
+/* INCLUDES END */
+
+G_BEGIN_DECLS
+
+/* DEFINES BEGIN */
+
+// Build with -DWF_ENABLE_METRICS=0 to leave out all measurements
+#ifndef WF_ENABLE_METRICS
+#define WF_ENABLE_METRICS 1
+#endif
+
+// Amount of histogram buckets, bucket x counts durations below 2^x µs
+#define WF_METRICS_BUCKETS 24
+
+// Type of the variant returned by wf_metrics_get_variant()
+#define WF_METRICS_VARIANT_TYPE "a{s(ttttat)}"
+
+/* DEFINES END */
+
+/* MODULE TYPES BEGIN */
+
+typedef enum _WfMetric WfMetric;
+
+enum _WfMetric
+{
+	WF_METRIC_METADATA_PARSE, // Reading the metadata of a single file
+	WF_METRIC_LIBRARY_READ, // Reading the library file or its cache
+	WF_METRIC_LIBRARY_WRITE, // Writing the library file or journal
+	WF_METRIC_PICK, // Choosing new songs
+	WF_METRIC_TRACK_CHANGE, // Opening a song until its stream has started
+	WF_METRIC_DBUS_CALL, // Handling a D-Bus method call or property access
+	WF_METRIC_DAEMON_COMMAND, // Handling a command on the control socket
+
+	WF_METRIC_COUNT
+};
+
+/* MODULE TYPES END */
+
+/* CONSTRUCTOR PROTOTYPES BEGIN */
+/* CONSTRUCTOR PROTOTYPES END */
+
+/* GETTER/SETTER PROTOTYPES BEGIN */
+/* GETTER/SETTER PROTOTYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+#if WF_ENABLE_METRICS
+gint64 wf_metrics_start(void);
+void wf_metrics_stop(WfMetric metric, gint64 start);
+void wf_metrics_record(WfMetric metric, gint64 duration);
+#else
+#define wf_metrics_start() ((gint64) 0)
+#define wf_metrics_stop(metric, start) G_STMT_START { (void) (start); } G_STMT_END
+#define wf_metrics_record(metric, duration) G_STMT_START { (void) (duration); } G_STMT_END
+#endif
+
+GVariant * wf_metrics_get_variant(void);
+
+/* FUNCTION PROTOTYPES END */
+
+/* UTILITY PROTOTYPES BEGIN */
+/* UTILITY PROTOTYPES END */
+
+/* DESTRUCTOR PROTOTYPES BEGIN */
+/* DESTRUCTOR PROTOTYPES END */
+
+G_END_DECLS
+
+#endif /* __WF_METRICS__ */
+
+/* END OF FILE */
@@ -43,6 +43,7 @@
 // Dependency includes
 #include <woofer/utils.h>
 #include <woofer/memory.h>
+#include <woofer/metrics.h>
 
 // Resource includes
 #include <woofer/static/mediaplayer2.h>
@@ -84,11 +85,36 @@
 #define MPRIS_INTERFACE_PLAYLISTS "org.mpris.MediaPlayer2.Playlists"
 #define MPRIS_OBJECT_PATH "/org/mpris/MediaPlayer2"
 #define MPRIS_OBJECT_TRACK_ID "/org/mpris/MediaPlayer2/Track"
+#define MPRIS_OBJECT_NO_TRACK "/org/mpris/MediaPlayer2/TrackList/NoTrack"
+
+// With more pending changes than this, clients are told to fetch the list again
+#define MPRIS_TRACKLIST_MAX_CHANGES 100
 
 /* DEFINES END */
 
 /* CUSTOM TYPES BEGIN */
 
+// Player properties that changed since the last PropertiesChanged signal
+typedef enum _WfMprisChanged WfMprisChanged;
+
+enum _WfMprisChanged
+{
+	MPRIS_CHANGED_NONE = 0,
+	MPRIS_CHANGED_PLAYBACK_STATUS = 1 << 0,
+	MPRIS_CHANGED_RATE = 1 << 1,
+	MPRIS_CHANGED_METADATA = 1 << 2,
+	MPRIS_CHANGED_VOLUME = 1 << 3,
+	MPRIS_CHANGED_POSITION = 1 << 4,
+	MPRIS_CHANGED_MINIMUM_RATE = 1 << 5,
+	MPRIS_CHANGED_MAXIMUM_RATE = 1 << 6,
+	MPRIS_CHANGED_CAN_GO_NEXT = 1 << 7,
+	MPRIS_CHANGED_CAN_GO_PREVIOUS = 1 << 8,
+	MPRIS_CHANGED_CAN_PLAY = 1 << 9,
+	MPRIS_CHANGED_CAN_PAUSE = 1 << 10,
+	MPRIS_CHANGED_CAN_SEEK = 1 << 11,
+	MPRIS_CHANGED_CAN_CONTROL = 1 << 12
+};
+
 /*
  * Structures containing function pointers to call when clients (desktop
  * environment) calls any methods.
@@ -113,6 +139,21 @@ struct MediaPlayerMethods
 	WfFuncPlayerOpenUri open_uri_func;
 };
 
+struct MediaTrackListMethods
+{
+	WfFuncTrackListGetTracks get_tracks_func;
+	WfFuncTrackListGetMetadata get_metadata_func;
+	WfFuncTrackListGoTo go_to_func;
+};
+
+// A track that has been added to or removed from the track list
+struct MediaTrackChange
+{
+	gboolean added;
+	guint track_id;
+	guint after_track_id; // Only used for added tracks
+};
+
 /*
  * Every property has a small comment indicating if a property (for
  * clients/desktop environment) is read-only or read-writable.  A read-only
@@ -160,6 +201,15 @@ struct MediaWfPlayerDetails
 	gboolean can_control; // Read-only for D-Bus
 };
 
+// Structure to store properties for the MediaPlayer2.TrackList Interface
+struct MediaTrackListDetails
+{
+	struct MediaTrackListMethods callbacks;
+
+	GArray *changes; // Changes of type MediaTrackChange since the last signals
+	gboolean replaced; // Whether the list changed too much to report per track
+};
+
 // Structure to store metadata for a property in MediaPlayer2.Player
 struct MediaMetadataDetails
 {
@@ -224,6 +274,16 @@ mpris_method_called_player_cb(GDBusConnection *connection,
                               GDBusMethodInvocation *invocation,
                               gpointer user_data);
 
+static void
+mpris_method_called_tracklist_cb(GDBusConnection *connection,
+                                 const gchar *sender,
+                                 const gchar *object_path,
+                                 const gchar *interface_name,
+                                 const gchar *method_name,
+                                 GVariant *parameters,
+                                 GDBusMethodInvocation *invocation,
+                                 gpointer user_data);
+
 static GVariant *
 mpris_property_get_requested_root_cb(GDBusConnection *connection,
                                      const gchar *sender,
@@ -242,7 +302,24 @@ mpris_property_get_requested_player_cb(GDBusConnection *connection,
                                        GError **error,
                                        gpointer user_data);
 
+static GVariant *
+mpris_property_get_requested_tracklist_cb(GDBusConnection *connection,
+                                          const gchar *sender,
+                                          const gchar *object_path,
+                                          const gchar *interface_name,
+                                          const gchar *property_name,
+                                          GError **error,
+                                          gpointer user_data);
+
+static gboolean wf_mpris_flush_changes_cb(gpointer user_data);
+static gboolean wf_mpris_flush_track_list_cb(gpointer user_data);
+
+static void wf_mpris_mark_changed(WfMprisChanged changed);
+static void wf_mpris_metadata_changed(void);
+static GVariant * wf_mpris_peek_player_metadata(void);
 static void wf_mpris_remote_emit_properties_changed(GVariant *parameters);
+static void wf_mpris_remote_emit_track_list_signal(const gchar *signal_name, GVariant *parameters);
+static void wf_mpris_tracklist_add_change(gboolean added, guint track_id, guint after_track_id);
 
 static void wf_mpris_root_method_raise(GVariant *parameters);
 static void wf_mpris_root_method_quit(GVariant *parameters);
@@ -257,6 +334,9 @@ static void wf_mpris_player_method_seek(GVariant *parameters);
 static void wf_mpris_player_method_setposition(GVariant *parameters);
 static void wf_mpris_player_method_openuri(GVariant *parameters);
 
+static GVariant * wf_mpris_tracklist_method_gettracksmetadata(GVariant *parameters);
+static void wf_mpris_tracklist_method_goto(GVariant *parameters);
+
 static void wf_mpris_emit_root_raise(void);
 static void wf_mpris_emit_root_quit(void);
 static void wf_mpris_emit_player_next(void);
@@ -266,13 +346,16 @@ static void wf_mpris_emit_player_play_pause(void);
 static void wf_mpris_emit_player_stop(void);
 static void wf_mpris_emit_player_play(void);
 static void wf_mpris_emit_player_seek(gint64 offset);
-static void wf_mpris_emit_player_set_position(const gchar *track_id, gint64 position);
+static void wf_mpris_emit_player_set_position(guint track_id, gint64 position);
 static void wf_mpris_emit_player_open_uri(const gchar *uri);
+static void wf_mpris_emit_tracklist_go_to(guint track_id);
 
 static GVariant * wf_mpris_new_variant_str(const gchar *str);
 static GVariant * wf_mpris_new_variant_strv(gchar * const *strv);
 static GVariant * wf_mpris_new_variant_date_time(GDateTime *dt);
 static GVariant * wf_mpris_new_variant_track_path(guint track_id);
+static GVariant * wf_mpris_new_variant_track_metadata(guint track_id);
+static gboolean wf_mpris_get_track_id_from_path(const gchar *object_path, guint *track_id_rv);
 
 /* FUNCTION PROTOTYPES END */
 
@@ -282,10 +365,18 @@ static GDBusConnection *SessionConnection = NULL;
 static guint BusNameIdentifier = 0;
 static guint InterfaceRootId = 0;
 static guint InterfacePlayerId = 0;
+static guint InterfaceTrackListId = 0;
+
+// Changes are collected and sent together once the main loop is idle
+static WfMprisChanged ChangedProperties = MPRIS_CHANGED_NONE;
+static guint FlushChangesId = 0;
+static guint FlushTrackListId = 0;
+static GVariant *MetadataCache = NULL; // Built when needed, until the metadata changes
 
 static struct MediaMetadataDetails MediaMetadataInfo = { 0 };
 static struct MediaRootDetails MediaRootData = { 0 };
 static struct MediaWfPlayerDetails MediaPlayerData = { .metadata = &MediaMetadataInfo };
+static struct MediaTrackListDetails MediaTrackListData = { 0 };
 
 static const GDBusInterfaceVTable InterfaceRootMethodVTable =
 {
@@ -301,6 +392,13 @@ static const GDBusInterfaceVTable InterfacePlayerMethodVTable =
 	NULL
 };
 
+static const GDBusInterfaceVTable InterfaceTrackListMethodVTable =
+{
+	mpris_method_called_tracklist_cb,
+	mpris_property_get_requested_tracklist_cb,
+	NULL
+};
+
 /* GLOBAL VARIABLES END */
 
 /* CONSTRUCTORS BEGIN */
@@ -469,7 +567,19 @@ wf_mpris_set_player_playback_status(WfPlaybackStatus status)
 {
 	g_return_if_fail(status > WF_MPRIS_NOT_PLAYING && status < WF_MPRIS_DEFINED);
 
+	if (MediaPlayerData.playback_status == status)
+	{
+		return;
+	}
+
+	// Metadata is only reported while not stopped
+	if (MediaPlayerData.playback_status == WF_MPRIS_STOPPED || status == WF_MPRIS_STOPPED)
+	{
+		wf_mpris_metadata_changed();
+	}
+
 	MediaPlayerData.playback_status = status;
+	wf_mpris_mark_changed(MPRIS_CHANGED_PLAYBACK_STATUS);
 }
 
 GVariant *
@@ -495,7 +605,13 @@ wf_mpris_set_player_rate(gdouble rate)
 {
 	g_return_if_fail(rate > 0.0 && rate < 10.0);
 
+	if (MediaPlayerData.rate == rate)
+	{
+		return;
+	}
+
 	MediaPlayerData.rate = rate;
+	wf_mpris_mark_changed(MPRIS_CHANGED_RATE);
 }
 
 GVariant *
@@ -507,46 +623,7 @@ wf_mpris_get_player_rate(void)
 GVariant *
 wf_mpris_get_player_metadata(void)
 {
-	/*
-	 * According to the FreeDesktop MPRIS (Specifications), Metadata is of
-	 * type Metadata_map, described as "a{sv}" (array of string/value pairs).
-	 */
-
-	static GVariantBuilder builder;
-	struct MediaMetadataDetails *info = MediaPlayerData.metadata;
-
-	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
-
-	// Always required
-	g_variant_builder_add(&builder, "{sv}", "mpris:trackid", wf_mpris_new_variant_track_path(info->track_id));
-
-	if (MediaPlayerData.playback_status != WF_MPRIS_STOPPED)
-	{
-		// Only relevant while active
-		g_variant_builder_add(&builder, "{sv}", "mpris:length", g_variant_new_int64(info->length));
-		g_variant_builder_add(&builder, "{sv}", "mpris:artUrl", wf_mpris_new_variant_str(info->art_url));
-		g_variant_builder_add(&builder, "{sv}", "xesam:album", wf_mpris_new_variant_str(info->album));
-		g_variant_builder_add(&builder, "{sv}", "xesam:albumArtist", wf_mpris_new_variant_strv(info->album_artists));
-		g_variant_builder_add(&builder, "{sv}", "xesam:artist", wf_mpris_new_variant_strv(info->artists));
-		g_variant_builder_add(&builder, "{sv}", "xesam:asText", wf_mpris_new_variant_str(info->as_text));
-		g_variant_builder_add(&builder, "{sv}", "xesam:audioBPM", g_variant_new_int32(info->audio_bpm));
-		g_variant_builder_add(&builder, "{sv}", "xesam:autoRating", g_variant_new_double(info->auto_rating));
-		g_variant_builder_add(&builder, "{sv}", "xesam:comment", wf_mpris_new_variant_strv(info->comments));
-		g_variant_builder_add(&builder, "{sv}", "xesam:composer", wf_mpris_new_variant_strv(info->composers));
-		g_variant_builder_add(&builder, "{sv}", "xesam:contentCreated", wf_mpris_new_variant_date_time(info->content_created));
-		g_variant_builder_add(&builder, "{sv}", "xesam:discNumber", g_variant_new_int32(info->disc_number));
-		g_variant_builder_add(&builder, "{sv}", "xesam:firstUsed", wf_mpris_new_variant_date_time(info->first_used));
-		g_variant_builder_add(&builder, "{sv}", "xesam:genre", wf_mpris_new_variant_strv(info->genres));
-		g_variant_builder_add(&builder, "{sv}", "xesam:lastUsed", wf_mpris_new_variant_date_time(info->last_used));
-		g_variant_builder_add(&builder, "{sv}", "xesam:lyricist", wf_mpris_new_variant_strv(info->lyricists));
-		g_variant_builder_add(&builder, "{sv}", "xesam:title", wf_mpris_new_variant_str(info->title));
-		g_variant_builder_add(&builder, "{sv}", "xesam:trackNumber", g_variant_new_int32(info->track_number));
-		g_variant_builder_add(&builder, "{sv}", "xesam:url", wf_mpris_new_variant_str(info->url));
-		g_variant_builder_add(&builder, "{sv}", "xesam:useCount", g_variant_new_int32(info->use_count));
-		g_variant_builder_add(&builder, "{sv}", "xesam:userRating", g_variant_new_double(info->user_rating));
-	}
-
-	return g_variant_builder_end(&builder);
+	return g_variant_ref(wf_mpris_peek_player_metadata());
 }
 
 void
@@ -554,7 +631,13 @@ wf_mpris_set_player_volume(gdouble volume)
 {
 	g_return_if_fail(volume >= 0.0 && volume <= 1.0);
 
+	if (MediaPlayerData.volume == volume)
+	{
+		return;
+	}
+
 	MediaPlayerData.volume = volume;
+	wf_mpris_mark_changed(MPRIS_CHANGED_VOLUME);
 }
 
 GVariant *
@@ -568,7 +651,13 @@ wf_mpris_set_player_position(gint64 position)
 {
 	g_return_if_fail(position >= 0);
 
+	if (MediaPlayerData.position == position)
+	{
+		return;
+	}
+
 	MediaPlayerData.position = position;
+	wf_mpris_mark_changed(MPRIS_CHANGED_POSITION);
 }
 
 GVariant *
@@ -582,7 +671,13 @@ wf_mpris_set_player_minimum_rate(gdouble minimum_rate)
 {
 	g_return_if_fail(minimum_rate >= 0.0 && minimum_rate <= 1.0);
 
+	if (MediaPlayerData.minimum_rate == minimum_rate)
+	{
+		return;
+	}
+
 	MediaPlayerData.minimum_rate = minimum_rate;
+	wf_mpris_mark_changed(MPRIS_CHANGED_MINIMUM_RATE);
 }
 
 GVariant *
@@ -596,7 +691,13 @@ wf_mpris_set_player_maximum_rate(gdouble maximum_rate)
 {
 	g_return_if_fail(maximum_rate >= 0.0 && maximum_rate <= 1.0);
 
+	if (MediaPlayerData.maximum_rate == maximum_rate)
+	{
+		return;
+	}
+
 	MediaPlayerData.maximum_rate = maximum_rate;
+	wf_mpris_mark_changed(MPRIS_CHANGED_MAXIMUM_RATE);
 }
 
 GVariant *
@@ -608,7 +709,13 @@ wf_mpris_get_player_maximum_rate(void)
 void
 wf_mpris_set_player_can_go_next(gboolean can_go_next)
 {
+	if (MediaPlayerData.can_go_next == can_go_next)
+	{
+		return;
+	}
+
 	MediaPlayerData.can_go_next = can_go_next;
+	wf_mpris_mark_changed(MPRIS_CHANGED_CAN_GO_NEXT);
 }
 
 GVariant *
@@ -620,7 +727,13 @@ wf_mpris_get_player_can_go_next(void)
 void
 wf_mpris_set_player_can_go_previous(gboolean can_go_previous)
 {
+	if (MediaPlayerData.can_go_previous == can_go_previous)
+	{
+		return;
+	}
+
 	MediaPlayerData.can_go_previous = can_go_previous;
+	wf_mpris_mark_changed(MPRIS_CHANGED_CAN_GO_PREVIOUS);
 }
 
 GVariant *
@@ -632,7 +745,13 @@ wf_mpris_get_player_can_go_previous(void)
 void
 wf_mpris_set_player_can_play(gboolean can_play)
 {
+	if (MediaPlayerData.can_play == can_play)
+	{
+		return;
+	}
+
 	MediaPlayerData.can_play = can_play;
+	wf_mpris_mark_changed(MPRIS_CHANGED_CAN_PLAY);
 }
 
 GVariant *
@@ -644,7 +763,13 @@ wf_mpris_get_player_can_play(void)
 void
 wf_mpris_set_player_can_pause(gboolean can_pause)
 {
+	if (MediaPlayerData.can_pause == can_pause)
+	{
+		return;
+	}
+
 	MediaPlayerData.can_pause = can_pause;
+	wf_mpris_mark_changed(MPRIS_CHANGED_CAN_PAUSE);
 }
 
 GVariant *
@@ -656,7 +781,13 @@ wf_mpris_get_player_can_pause(void)
 void
 wf_mpris_set_player_can_seek(gboolean can_seek)
 {
+	if (MediaPlayerData.can_seek == can_seek)
+	{
+		return;
+	}
+
 	MediaPlayerData.can_seek = can_seek;
+	wf_mpris_mark_changed(MPRIS_CHANGED_CAN_SEEK);
 }
 
 GVariant *
@@ -668,7 +799,13 @@ wf_mpris_get_player_can_seek(void)
 void
 wf_mpris_set_player_can_control(gboolean can_control)
 {
+	if (MediaPlayerData.can_control == can_control)
+	{
+		return;
+	}
+
 	MediaPlayerData.can_control = can_control;
+	wf_mpris_mark_changed(MPRIS_CHANGED_CAN_CONTROL);
 }
 
 GVariant *
@@ -677,12 +814,48 @@ wf_mpris_get_player_can_control(void)
 	return g_variant_new_boolean(MediaPlayerData.can_control);
 }
 
+// TrackList interface getters
+
+GVariant *
+wf_mpris_get_tracklist_tracks(void)
+{
+	GVariantBuilder builder;
+	guint *tracks = NULL;
+	gsize length = 0;
+	gsize i;
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("ao"));
+
+	if (MediaTrackListData.callbacks.get_tracks_func != NULL)
+	{
+		tracks = MediaTrackListData.callbacks.get_tracks_func(&length);
+	}
+
+	for (i = 0; i < length; i++)
+	{
+		g_variant_builder_add_value(&builder, wf_mpris_new_variant_track_path(tracks[i]));
+	}
+
+	g_free(tracks);
+
+	return g_variant_builder_end(&builder);
+}
+
+GVariant *
+wf_mpris_get_tracklist_can_edit_tracks(void)
+{
+	// The track list mirrors the library, which clients cannot change
+	return g_variant_new_boolean(FALSE);
+}
+
 // Metadata setters
 
 void
 wf_mpris_set_info_track_id(guint track_id)
 {
 	MediaMetadataInfo.track_id = track_id;
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -691,6 +864,8 @@ wf_mpris_set_info_url(const gchar *url)
 	g_free(MediaMetadataInfo.url);
 
 	MediaMetadataInfo.url = g_strdup(url);
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -699,6 +874,8 @@ wf_mpris_set_info_title(const gchar *title)
 	g_free(MediaMetadataInfo.title);
 
 	MediaMetadataInfo.title = g_strdup(title);
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -707,6 +884,8 @@ wf_mpris_set_info_album(const gchar *album)
 	g_free(MediaMetadataInfo.album);
 
 	MediaMetadataInfo.album = g_strdup(album);
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -715,6 +894,8 @@ wf_mpris_set_info_artists(const gchar * const *artists)
 	g_strfreev(MediaMetadataInfo.artists);
 
 	MediaMetadataInfo.artists = g_strdupv((gchar **) artists);
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -723,6 +904,8 @@ wf_mpris_set_info_album_artists(const gchar * const *album_artists)
 	g_strfreev(MediaMetadataInfo.album_artists);
 
 	MediaMetadataInfo.album_artists = g_strdupv((gchar **) album_artists);
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -731,6 +914,8 @@ wf_mpris_set_info_composers(const gchar * const *composers)
 	g_strfreev(MediaMetadataInfo.composers);
 
 	MediaMetadataInfo.composers = g_strdupv((gchar **) composers);
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -739,6 +924,8 @@ wf_mpris_set_info_lyricists(const gchar * const *lyricists)
 	g_strfreev(MediaMetadataInfo.lyricists);
 
 	MediaMetadataInfo.lyricists = g_strdupv((gchar **) lyricists);
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -747,6 +934,8 @@ wf_mpris_set_info_genres(const gchar * const *genres)
 	g_strfreev(MediaMetadataInfo.genres);
 
 	MediaMetadataInfo.genres = g_strdupv((gchar **) genres);
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -755,6 +944,8 @@ wf_mpris_set_info_dics_number(gint disc_number) // >= 0
 	g_return_if_fail(disc_number >= 0);
 
 	MediaMetadataInfo.disc_number = disc_number;
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -763,6 +954,8 @@ wf_mpris_set_info_track_number(gint track_number) // >= 0
 	g_return_if_fail(track_number >= 0);
 
 	MediaMetadataInfo.track_number = track_number;
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -771,6 +964,8 @@ wf_mpris_set_info_beats_per_minute(gint bpm) // >= 0
 	g_return_if_fail(bpm >= 0);
 
 	MediaMetadataInfo.audio_bpm = bpm;
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -779,6 +974,8 @@ wf_mpris_set_info_duration(gint64 duration) // Nanoseconds
 	g_return_if_fail(duration >= 0);
 
 	MediaMetadataInfo.length = duration;
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -787,6 +984,8 @@ wf_mpris_set_info_rating(gint rating) // [0, 100]
 	g_return_if_fail(rating >= 0 && rating <= 100);
 
 	MediaMetadataInfo.user_rating = (((gdouble) rating) / 100);
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -794,7 +993,9 @@ wf_mpris_set_info_score(gdouble score) // [0.0, 100.0]
 {
 	g_return_if_fail(score >= 0.0 && score <= 100.0);
 
-	MediaMetadataInfo.auto_rating = (score / 10);
+	MediaMetadataInfo.auto_rating = (score / 100);
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -803,12 +1004,14 @@ wf_mpris_set_info_play_count(gint play_count) // >= 0
 	g_return_if_fail(play_count >= 0);
 
 	MediaMetadataInfo.use_count = play_count;
+
+	wf_mpris_metadata_changed();
 }
 
 void
 wf_mpris_set_info_first_played(GDateTime *first_used) // Adds reference
 {
-	g_date_time_unref(MediaMetadataInfo.first_used);
+	wf_memory_clear_date_time(&MediaMetadataInfo.first_used);
 
 	if (first_used == NULL)
 	{
@@ -818,6 +1021,8 @@ wf_mpris_set_info_first_played(GDateTime *first_used) // Adds reference
 	{
 		MediaMetadataInfo.first_used = g_date_time_ref(first_used);
 	}
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -846,6 +1051,8 @@ wf_mpris_set_info_last_played(GDateTime *last_used) // Adds reference
 	{
 		MediaMetadataInfo.last_used = g_date_time_ref(last_used);
 	}
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -864,7 +1071,7 @@ wf_mpris_set_info_last_played_sec(gint64 last_used) // >= 0
 void
 wf_mpris_set_info_content_created(GDateTime *content_created) // Adds reference
 {
-	g_date_time_unref(MediaMetadataInfo.content_created);
+	wf_memory_clear_date_time(&MediaMetadataInfo.content_created);
 
 	if (content_created == NULL)
 	{
@@ -874,6 +1081,8 @@ wf_mpris_set_info_content_created(GDateTime *content_created) // Adds reference
 	{
 		MediaMetadataInfo.content_created = g_date_time_ref(content_created);
 	}
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -895,6 +1104,8 @@ wf_mpris_set_info_art_url(const gchar *art_url)
 	g_free(MediaMetadataInfo.art_url);
 
 	MediaMetadataInfo.art_url = g_strdup(art_url);
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -903,6 +1114,8 @@ wf_mpris_set_info_lyrics(const gchar *lyrics)
 	g_free(MediaMetadataInfo.as_text);
 
 	MediaMetadataInfo.as_text = g_strdup(lyrics);
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -911,6 +1124,8 @@ wf_mpris_set_info_comments(const gchar * const *comments)
 	g_strfreev(MediaMetadataInfo.comments);
 
 	MediaMetadataInfo.comments = g_strdupv((gchar **) comments);
+
+	wf_mpris_metadata_changed();
 }
 
 void
@@ -979,6 +1194,24 @@ wf_mpris_connect_player_open_uri(WfFuncPlayerOpenUri cb_func)
 	MediaPlayerData.callbacks.open_uri_func = cb_func;
 }
 
+void
+wf_mpris_connect_tracklist_get_tracks(WfFuncTrackListGetTracks cb_func)
+{
+	MediaTrackListData.callbacks.get_tracks_func = cb_func;
+}
+
+void
+wf_mpris_connect_tracklist_get_metadata(WfFuncTrackListGetMetadata cb_func)
+{
+	MediaTrackListData.callbacks.get_metadata_func = cb_func;
+}
+
+void
+wf_mpris_connect_tracklist_go_to(WfFuncTrackListGoTo cb_func)
+{
+	MediaTrackListData.callbacks.go_to_func = cb_func;
+}
+
 /* GETTERS/SETTERS END */
 
 /* CALLBACK FUNCTIONS BEGIN */
@@ -986,7 +1219,7 @@ wf_mpris_connect_player_open_uri(WfFuncPlayerOpenUri cb_func)
 static void
 wf_mpris_bus_acquired_cb(GDBusConnection *connection, const gchar *name, gpointer user_data)
 {
-	GDBusInterfaceInfo *interface_root = NULL, *interface_player = NULL;
+	GDBusInterfaceInfo *interface_root = NULL, *interface_player = NULL, *interface_tracklist = NULL;
 	GError *error = NULL;
 
 	g_debug("D-Bus acquired bus <%s>", name);
@@ -1033,6 +1266,30 @@ wf_mpris_bus_acquired_cb(GDBusConnection *connection, const gchar *name, gpointe
 		return;
 	}
 
+	if (MediaRootData.has_track_list)
+	{
+		interface_tracklist = mp2_org_mpris_mediaplayer2_tracklist_get_interface_info();
+
+		// Register track list interface object
+		InterfaceTrackListId = g_dbus_connection_register_object(SessionConnection,
+		                                                         MPRIS_OBJECT_PATH,
+		                                                         interface_tracklist,
+		                                                         &InterfaceTrackListMethodVTable,
+		                                                         NULL /* user_data */,
+		                                                         NULL /* GDestroyNotify */,
+		                                                         &error);
+		if (error != NULL)
+		{
+			g_warning("Failed to register D-Bus object (MediaPlayer2.TrackList): %s", error->message);
+			g_error_free(error);
+
+			g_dbus_connection_unregister_object(SessionConnection, InterfaceTrackListId);
+			InterfaceTrackListId = 0;
+
+			return;
+		}
+	}
+
 	g_info("Media Player Remote Interface objects registered");
 }
 
@@ -1060,6 +1317,9 @@ mpris_method_called_root_cb(GDBusConnection *connection,
                             gpointer user_data)
 {
 	gchar *method;
+	gint64 start;
+
+	start = wf_metrics_start();
 
 	g_info("Remote Media Player Interface method %s called from %s", method_name, sender);
 
@@ -1088,6 +1348,8 @@ mpris_method_called_root_cb(GDBusConnection *connection,
 	g_free(method);
 
 	g_dbus_method_invocation_return_value(invocation, NULL /* parameters */);
+
+	wf_metrics_stop(WF_METRIC_DBUS_CALL, start);
 }
 
 // GDBusInterfaceMethodCallFunc
@@ -1102,6 +1364,9 @@ mpris_method_called_player_cb(GDBusConnection *connection,
                             gpointer user_data)
 {
 	gchar *method;
+	gint64 start;
+
+	start = wf_metrics_start();
 
 	g_info("Remote Media Player Interface method %s called from %s", method_name, sender);
 
@@ -1152,6 +1417,53 @@ mpris_method_called_player_cb(GDBusConnection *connection,
 	g_free(method);
 
 	g_dbus_method_invocation_return_value(invocation, NULL /* parameters */);
+
+	wf_metrics_stop(WF_METRIC_DBUS_CALL, start);
+}
+
+// GDBusInterfaceMethodCallFunc
+static void
+mpris_method_called_tracklist_cb(GDBusConnection *connection,
+                                 const gchar *sender,
+                                 const gchar *object_path,
+                                 const gchar *interface_name,
+                                 const gchar *method_name,
+                                 GVariant *parameters,
+                                 GDBusMethodInvocation *invocation,
+                                 gpointer user_data)
+{
+	GVariant *value = NULL;
+	gchar *method;
+	gint64 start;
+
+	start = wf_metrics_start();
+
+	g_info("Remote Media Player Interface method %s called from %s", method_name, sender);
+
+	method = g_strdup(method_name);
+	wf_utils_str_to_lower(method);
+
+	if (wf_utils_str_is_equal(method, "gettracksmetadata"))
+	{
+		value = wf_mpris_tracklist_method_gettracksmetadata(parameters);
+	}
+	else if (wf_utils_str_is_equal(method, "goto"))
+	{
+		wf_mpris_tracklist_method_goto(parameters);
+	}
+	else
+	{
+		/*
+		 * AddTrack and RemoveTrack have no effect, because CanEditTracks is
+		 * FALSE
+		 */
+	}
+
+	g_free(method);
+
+	g_dbus_method_invocation_return_value(invocation, value);
+
+	wf_metrics_stop(WF_METRIC_DBUS_CALL, start);
 }
 
 // GDBusInterfaceGetPropertyFunc
@@ -1307,53 +1619,423 @@ mpris_property_get_requested_player_cb(GDBusConnection *connection,
 	return value;
 }
 
-/* CALLBACK FUNCTIONS END */
-
-/* MODULE FUNCTIONS BEGIN */
-
-void
-wf_mpris_flush_changes(void)
+// GDBusInterfaceGetPropertyFunc
+static GVariant *
+mpris_property_get_requested_tracklist_cb(GDBusConnection *connection,
+                                          const gchar *sender,
+                                          const gchar *object_path,
+                                          const gchar *interface_name,
+                                          const gchar *property_name,
+                                          GError **error,
+                                          gpointer user_data)
 {
-	GVariant *values;
-	GVariantBuilder builder;
+	gchar *property;
+	GVariant *value = NULL;
 
-	g_variant_builder_init(&builder, G_VARIANT_TYPE_ARRAY);
+	property = g_strdup(property_name);
+	wf_utils_str_to_lower(property);
 
-	// Add relevant properties (properties that may change frequently in runtime)
-	g_variant_builder_add(&builder, "{sv}", "Rate", wf_mpris_get_player_rate());
-	g_variant_builder_add(&builder, "{sv}", "Volume", wf_mpris_get_player_volume());
-	g_variant_builder_add(&builder, "{sv}", "Position", wf_mpris_get_player_position());
-	g_variant_builder_add(&builder, "{sv}", "PlaybackStatus", wf_mpris_get_player_playback_status());
-	g_variant_builder_add(&builder, "{sv}", "Metadata", wf_mpris_get_player_metadata());
+	if (wf_utils_str_is_equal(property, "tracks"))
+	{
+		value = wf_mpris_get_tracklist_tracks();
+	}
+	else if (wf_utils_str_is_equal(property, "canedittracks"))
+	{
+		value = wf_mpris_get_tracklist_can_edit_tracks();
+	}
+	else
+	{
+		g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY,
+		            "Property %s.%s not recognised", interface_name, property_name);
+	}
 
-	values = g_variant_new("(sa{sv}as)", MPRIS_INTERFACE_PLAYER, &builder, NULL /* terminator */);
+	g_free(property);
 
-	wf_mpris_remote_emit_properties_changed(values);
+	return value;
 }
 
-static void
-wf_mpris_remote_emit_properties_changed(GVariant *parameters)
+static gboolean
+wf_mpris_flush_changes_cb(gpointer user_data)
 {
-	gboolean res;
-	GError *error = NULL;
+	WfMprisChanged changed = ChangedProperties;
+	GVariant *values;
+	GVariantBuilder builder;
 
-	g_return_if_fail(G_IS_DBUS_CONNECTION(SessionConnection));
+	FlushChangesId = 0;
+	ChangedProperties = MPRIS_CHANGED_NONE;
 
-	res = g_dbus_connection_emit_signal(SessionConnection,
-	                                    NULL /* destination bus */,
-	                                    MPRIS_OBJECT_PATH,
-	                                    "org.freedesktop.DBus.Properties",
-	                                    "PropertiesChanged",
-	                                    parameters,
-	                                    &error);
+	if (SessionConnection == NULL)
+	{
+		// Nobody to tell
+		return G_SOURCE_REMOVE;
+	}
 
-	if (res)
+	g_variant_builder_init(&builder, G_VARIANT_TYPE_ARRAY);
+
+	// Add only the properties that changed since the last time
+	if (changed & MPRIS_CHANGED_PLAYBACK_STATUS)
 	{
-		g_info("MPRIS clients notified of changed properties");
+		g_variant_builder_add(&builder, "{sv}", "PlaybackStatus", wf_mpris_get_player_playback_status());
 	}
-	else
+	if (changed & MPRIS_CHANGED_RATE)
 	{
-		g_warning("Failed to notify MPRIS clients of property changes (by emitting D-Bus signal PropertiesChanged): %s", error->message);
+		g_variant_builder_add(&builder, "{sv}", "Rate", wf_mpris_get_player_rate());
+	}
+	if (changed & MPRIS_CHANGED_METADATA)
+	{
+		g_variant_builder_add(&builder, "{sv}", "Metadata", wf_mpris_peek_player_metadata());
+	}
+	if (changed & MPRIS_CHANGED_VOLUME)
+	{
+		g_variant_builder_add(&builder, "{sv}", "Volume", wf_mpris_get_player_volume());
+	}
+	if (changed & MPRIS_CHANGED_POSITION)
+	{
+		g_variant_builder_add(&builder, "{sv}", "Position", wf_mpris_get_player_position());
+	}
+	if (changed & MPRIS_CHANGED_MINIMUM_RATE)
+	{
+		g_variant_builder_add(&builder, "{sv}", "MinimumRate", wf_mpris_get_player_minimum_rate());
+	}
+	if (changed & MPRIS_CHANGED_MAXIMUM_RATE)
+	{
+		g_variant_builder_add(&builder, "{sv}", "MaximumRate", wf_mpris_get_player_maximum_rate());
+	}
+	if (changed & MPRIS_CHANGED_CAN_GO_NEXT)
+	{
+		g_variant_builder_add(&builder, "{sv}", "CanGoNext", wf_mpris_get_player_can_go_next());
+	}
+	if (changed & MPRIS_CHANGED_CAN_GO_PREVIOUS)
+	{
+		g_variant_builder_add(&builder, "{sv}", "CanGoPrevious", wf_mpris_get_player_can_go_previous());
+	}
+	if (changed & MPRIS_CHANGED_CAN_PLAY)
+	{
+		g_variant_builder_add(&builder, "{sv}", "CanPlay", wf_mpris_get_player_can_play());
+	}
+	if (changed & MPRIS_CHANGED_CAN_PAUSE)
+	{
+		g_variant_builder_add(&builder, "{sv}", "CanPause", wf_mpris_get_player_can_pause());
+	}
+	if (changed & MPRIS_CHANGED_CAN_SEEK)
+	{
+		g_variant_builder_add(&builder, "{sv}", "CanSeek", wf_mpris_get_player_can_seek());
+	}
+	if (changed & MPRIS_CHANGED_CAN_CONTROL)
+	{
+		g_variant_builder_add(&builder, "{sv}", "CanControl", wf_mpris_get_player_can_control());
+	}
+
+	values = g_variant_new("(sa{sv}as)", MPRIS_INTERFACE_PLAYER, &builder, NULL /* terminator */);
+
+	wf_mpris_remote_emit_properties_changed(values);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+wf_mpris_flush_track_list_cb(gpointer user_data)
+{
+	struct MediaTrackListDetails *data = &MediaTrackListData;
+	struct MediaTrackChange *change;
+	GVariant *metadata;
+	guint current_track_id = 0;
+	guint i;
+
+	FlushTrackListId = 0;
+
+	if (SessionConnection == NULL || InterfaceTrackListId == 0)
+	{
+		// Nobody to tell
+	}
+	else if (data->replaced)
+	{
+		if (MediaPlayerData.playback_status != WF_MPRIS_STOPPED)
+		{
+			current_track_id = MediaMetadataInfo.track_id;
+		}
+
+		// Clients fetch the metadata of the tracks they need by themselves
+		wf_mpris_remote_emit_track_list_signal("TrackListReplaced",
+		                                       g_variant_new("(@ao@o)",
+		                                                     wf_mpris_get_tracklist_tracks(),
+		                                                     wf_mpris_new_variant_track_path(current_track_id)));
+	}
+	else
+	{
+		for (i = 0; i < data->changes->len; i++)
+		{
+			change = &g_array_index(data->changes, struct MediaTrackChange, i);
+
+			if (change->added)
+			{
+				// The track may have been removed again in the meantime
+				metadata = wf_mpris_new_variant_track_metadata(change->track_id);
+
+				if (metadata != NULL)
+				{
+					wf_mpris_remote_emit_track_list_signal("TrackAdded",
+					                                       g_variant_new("(@a{sv}@o)",
+					                                                     metadata,
+					                                                     wf_mpris_new_variant_track_path(change->after_track_id)));
+				}
+			}
+			else
+			{
+				wf_mpris_remote_emit_track_list_signal("TrackRemoved",
+				                                       g_variant_new("(@o)", wf_mpris_new_variant_track_path(change->track_id)));
+			}
+		}
+	}
+
+	if (data->changes != NULL)
+	{
+		g_array_set_size(data->changes, 0);
+	}
+
+	data->replaced = FALSE;
+
+	return G_SOURCE_REMOVE;
+}
+
+/* CALLBACK FUNCTIONS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+void
+wf_mpris_flush_changes(void)
+{
+	if (ChangedProperties != MPRIS_CHANGED_NONE && FlushChangesId == 0)
+	{
+		FlushChangesId = g_idle_add(wf_mpris_flush_changes_cb, NULL /* user_data */);
+	}
+}
+
+void
+wf_mpris_tracklist_track_added(guint track_id, guint after_track_id)
+{
+	wf_mpris_tracklist_add_change(TRUE, track_id, after_track_id);
+}
+
+void
+wf_mpris_tracklist_track_removed(guint track_id)
+{
+	wf_mpris_tracklist_add_change(FALSE, track_id, 0);
+}
+
+void
+wf_mpris_tracklist_replaced(void)
+{
+	if (InterfaceTrackListId == 0)
+	{
+		// Clients will read the list when they get connected
+		return;
+	}
+
+	MediaTrackListData.replaced = TRUE;
+
+	if (FlushTrackListId == 0)
+	{
+		FlushTrackListId = g_idle_add(wf_mpris_flush_track_list_cb, NULL /* user_data */);
+	}
+}
+
+/*
+ * wf_mpris_player_seeked:
+ * @position: the new position (in microseconds)
+ *
+ * Tell clients that the position jumped, instead of moving on with the
+ * playback rate.  Clients do not get notified of position changes otherwise.
+ */
+void
+wf_mpris_player_seeked(gint64 position)
+{
+	gboolean res;
+	GError *error = NULL;
+
+	g_return_if_fail(position >= 0);
+
+	MediaPlayerData.position = position;
+
+	if (InterfacePlayerId == 0)
+	{
+		return;
+	}
+
+	res = g_dbus_connection_emit_signal(SessionConnection,
+	                                    NULL /* destination bus */,
+	                                    MPRIS_OBJECT_PATH,
+	                                    MPRIS_INTERFACE_PLAYER,
+	                                    "Seeked",
+	                                    g_variant_new("(x)", position),
+	                                    &error);
+
+	if (!res)
+	{
+		g_warning("Failed to notify MPRIS clients of a seek (by emitting D-Bus signal Seeked): %s", error->message);
+	}
+
+	g_clear_error(&error);
+}
+
+/*
+ * Remember a change of the track list, to report the changes in one go.  When
+ * a lot of tracks change at once (like while loading the library), replacing
+ * the whole list is cheaper for both sides than a signal per track.
+ */
+static void
+wf_mpris_tracklist_add_change(gboolean added, guint track_id, guint after_track_id)
+{
+	struct MediaTrackListDetails *data = &MediaTrackListData;
+	struct MediaTrackChange change = { added, track_id, after_track_id };
+
+	if (InterfaceTrackListId == 0 || data->replaced)
+	{
+		// Nobody to tell or already reporting the whole list
+		return;
+	}
+
+	if (data->changes == NULL)
+	{
+		data->changes = g_array_new(FALSE, FALSE, sizeof(struct MediaTrackChange));
+	}
+
+	if (data->changes->len >= MPRIS_TRACKLIST_MAX_CHANGES)
+	{
+		g_array_set_size(data->changes, 0);
+		wf_mpris_tracklist_replaced();
+
+		return;
+	}
+
+	g_array_append_val(data->changes, change);
+
+	if (FlushTrackListId == 0)
+	{
+		FlushTrackListId = g_idle_add(wf_mpris_flush_track_list_cb, NULL /* user_data */);
+	}
+}
+
+// Remember that properties changed, to report them in one go
+static void
+wf_mpris_mark_changed(WfMprisChanged changed)
+{
+	ChangedProperties |= changed;
+
+	wf_mpris_flush_changes();
+}
+
+static void
+wf_mpris_metadata_changed(void)
+{
+	if (MetadataCache != NULL)
+	{
+		g_variant_unref(MetadataCache);
+		MetadataCache = NULL;
+	}
+
+	wf_mpris_mark_changed(MPRIS_CHANGED_METADATA);
+}
+
+static GVariant *
+wf_mpris_peek_player_metadata(void)
+{
+	/*
+	 * According to the FreeDesktop MPRIS (Specifications), Metadata is of
+	 * type Metadata_map, described as "a{sv}" (array of string/value pairs).
+	 */
+
+	GVariantBuilder builder;
+	struct MediaMetadataDetails *info = MediaPlayerData.metadata;
+
+	if (MetadataCache != NULL)
+	{
+		return MetadataCache;
+	}
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+
+	// Always required
+	g_variant_builder_add(&builder, "{sv}", "mpris:trackid", wf_mpris_new_variant_track_path(info->track_id));
+
+	if (MediaPlayerData.playback_status != WF_MPRIS_STOPPED)
+	{
+		// Only relevant while active
+		g_variant_builder_add(&builder, "{sv}", "mpris:length", g_variant_new_int64(info->length));
+		g_variant_builder_add(&builder, "{sv}", "mpris:artUrl", wf_mpris_new_variant_str(info->art_url));
+		g_variant_builder_add(&builder, "{sv}", "xesam:album", wf_mpris_new_variant_str(info->album));
+		g_variant_builder_add(&builder, "{sv}", "xesam:albumArtist", wf_mpris_new_variant_strv(info->album_artists));
+		g_variant_builder_add(&builder, "{sv}", "xesam:artist", wf_mpris_new_variant_strv(info->artists));
+		g_variant_builder_add(&builder, "{sv}", "xesam:asText", wf_mpris_new_variant_str(info->as_text));
+		g_variant_builder_add(&builder, "{sv}", "xesam:audioBPM", g_variant_new_int32(info->audio_bpm));
+		g_variant_builder_add(&builder, "{sv}", "xesam:autoRating", g_variant_new_double(info->auto_rating));
+		g_variant_builder_add(&builder, "{sv}", "xesam:comment", wf_mpris_new_variant_strv(info->comments));
+		g_variant_builder_add(&builder, "{sv}", "xesam:composer", wf_mpris_new_variant_strv(info->composers));
+		g_variant_builder_add(&builder, "{sv}", "xesam:contentCreated", wf_mpris_new_variant_date_time(info->content_created));
+		g_variant_builder_add(&builder, "{sv}", "xesam:discNumber", g_variant_new_int32(info->disc_number));
+		g_variant_builder_add(&builder, "{sv}", "xesam:firstUsed", wf_mpris_new_variant_date_time(info->first_used));
+		g_variant_builder_add(&builder, "{sv}", "xesam:genre", wf_mpris_new_variant_strv(info->genres));
+		g_variant_builder_add(&builder, "{sv}", "xesam:lastUsed", wf_mpris_new_variant_date_time(info->last_used));
+		g_variant_builder_add(&builder, "{sv}", "xesam:lyricist", wf_mpris_new_variant_strv(info->lyricists));
+		g_variant_builder_add(&builder, "{sv}", "xesam:title", wf_mpris_new_variant_str(info->title));
+		g_variant_builder_add(&builder, "{sv}", "xesam:trackNumber", g_variant_new_int32(info->track_number));
+		g_variant_builder_add(&builder, "{sv}", "xesam:url", wf_mpris_new_variant_str(info->url));
+		g_variant_builder_add(&builder, "{sv}", "xesam:useCount", g_variant_new_int32(info->use_count));
+		g_variant_builder_add(&builder, "{sv}", "xesam:userRating", g_variant_new_double(info->user_rating));
+	}
+
+	MetadataCache = g_variant_ref_sink(g_variant_builder_end(&builder));
+
+	return MetadataCache;
+}
+
+static void
+wf_mpris_remote_emit_properties_changed(GVariant *parameters)
+{
+	gboolean res;
+	GError *error = NULL;
+
+	g_return_if_fail(G_IS_DBUS_CONNECTION(SessionConnection));
+
+	res = g_dbus_connection_emit_signal(SessionConnection,
+	                                    NULL /* destination bus */,
+	                                    MPRIS_OBJECT_PATH,
+	                                    "org.freedesktop.DBus.Properties",
+	                                    "PropertiesChanged",
+	                                    parameters,
+	                                    &error);
+
+	if (res)
+	{
+		g_info("MPRIS clients notified of changed properties");
+	}
+	else
+	{
+		g_warning("Failed to notify MPRIS clients of property changes (by emitting D-Bus signal PropertiesChanged): %s", error->message);
+	}
+
+	g_clear_error(&error);
+}
+
+static void
+wf_mpris_remote_emit_track_list_signal(const gchar *signal_name, GVariant *parameters)
+{
+	gboolean res;
+	GError *error = NULL;
+
+	g_return_if_fail(G_IS_DBUS_CONNECTION(SessionConnection));
+
+	res = g_dbus_connection_emit_signal(SessionConnection,
+	                                    NULL /* destination bus */,
+	                                    MPRIS_OBJECT_PATH,
+	                                    MPRIS_INTERFACE_TRACKLIST,
+	                                    signal_name,
+	                                    parameters,
+	                                    &error);
+
+	if (!res)
+	{
+		g_warning("Failed to notify MPRIS clients of track list changes (by emitting D-Bus signal %s): %s", signal_name, error->message);
 	}
 
 	g_clear_error(&error);
@@ -1410,12 +2092,12 @@ wf_mpris_player_method_play(GVariant *parameters)
 static void
 wf_mpris_player_method_seek(GVariant *parameters)
 {
-	gint64 position;
+	gint64 offset;
 
 	g_return_if_fail(g_variant_is_of_type(parameters, (const GVariantType *) "(x)"));
 
-	position = g_variant_get_int64(parameters);
-	wf_mpris_emit_player_seek(position);
+	g_variant_get(parameters, "(x)", &offset);
+	wf_mpris_emit_player_seek(offset);
 }
 
 static void
@@ -1423,12 +2105,17 @@ wf_mpris_player_method_setposition(GVariant *parameters)
 {
 	const gchar *object_path;
 	gint64 position;
+	guint track_id;
 
 	g_return_if_fail(g_variant_is_of_type(parameters, (const GVariantType *) "(ox)"));
 
-	object_path = g_variant_get_string(parameters, NULL /* length_rv */);
-	position = g_variant_get_int64(parameters);
-	wf_mpris_emit_player_set_position(object_path, position);
+	g_variant_get(parameters, "(&ox)", &object_path, &position);
+
+	// Only positions of valid tracks can be set
+	if (wf_mpris_get_track_id_from_path(object_path, &track_id))
+	{
+		wf_mpris_emit_player_set_position(track_id, position);
+	}
 }
 
 static void
@@ -1442,6 +2129,62 @@ wf_mpris_player_method_openuri(GVariant *parameters)
 	wf_mpris_emit_player_open_uri(uri);
 }
 
+static GVariant *
+wf_mpris_tracklist_method_gettracksmetadata(GVariant *parameters)
+{
+	GVariantBuilder builder;
+	GVariantIter *iter;
+	GVariant *metadata;
+	const gchar *object_path;
+	guint track_id;
+
+	g_return_val_if_fail(g_variant_is_of_type(parameters, (const GVariantType *) "(ao)"), NULL);
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("aa{sv}"));
+
+	/*
+	 * Only the requested tracks are looked up, so clients can page through a
+	 * large library by asking for a few tracks at a time.  Unknown tracks are
+	 * left out, as allowed by the specifications.
+	 */
+	g_variant_get(parameters, "(ao)", &iter);
+
+	while (g_variant_iter_loop(iter, "&o", &object_path))
+	{
+		if (!wf_mpris_get_track_id_from_path(object_path, &track_id))
+		{
+			continue;
+		}
+
+		metadata = wf_mpris_new_variant_track_metadata(track_id);
+
+		if (metadata != NULL)
+		{
+			g_variant_builder_add_value(&builder, metadata);
+		}
+	}
+
+	g_variant_iter_free(iter);
+
+	return g_variant_new("(aa{sv})", &builder);
+}
+
+static void
+wf_mpris_tracklist_method_goto(GVariant *parameters)
+{
+	const gchar *object_path;
+	guint track_id;
+
+	g_return_if_fail(g_variant_is_of_type(parameters, (const GVariantType *) "(o)"));
+
+	g_variant_get(parameters, "(&o)", &object_path);
+
+	if (wf_mpris_get_track_id_from_path(object_path, &track_id))
+	{
+		wf_mpris_emit_tracklist_go_to(track_id);
+	}
+}
+
 static void
 wf_mpris_emit_root_raise(void)
 {
@@ -1524,7 +2267,7 @@ wf_mpris_emit_player_seek(gint64 offset)
 }
 
 static void
-wf_mpris_emit_player_set_position(const gchar *track_id, gint64 position)
+wf_mpris_emit_player_set_position(guint track_id, gint64 position)
 {
 	if (MediaPlayerData.callbacks.set_position_func != NULL)
 	{
@@ -1541,6 +2284,15 @@ wf_mpris_emit_player_open_uri(const gchar *uri)
 	}
 }
 
+static void
+wf_mpris_emit_tracklist_go_to(guint track_id)
+{
+	if (MediaTrackListData.callbacks.go_to_func != NULL)
+	{
+		MediaTrackListData.callbacks.go_to_func(track_id);
+	}
+}
+
 /* MODULE FUNCTIONS END */
 
 /* MODULE UTILITIES BEGIN */
@@ -1592,11 +2344,69 @@ wf_mpris_new_variant_date_time(GDateTime *dt)
 	}
 }
 
-// Creates a GVariant string with the right D-Bus Track object path
+// Creates a GVariant object path for a track; 0 stands for no track
 static GVariant *
 wf_mpris_new_variant_track_path(guint track_id)
 {
-	return g_variant_new_printf("%s/%u", MPRIS_OBJECT_TRACK_ID, track_id);
+	GVariant *path;
+	gchar *str;
+
+	if (track_id == 0)
+	{
+		return g_variant_new_object_path(MPRIS_OBJECT_NO_TRACK);
+	}
+
+	str = g_strdup_printf("%s/%u", MPRIS_OBJECT_TRACK_ID, track_id);
+	path = g_variant_new_object_path(str);
+	g_free(str);
+
+	return path;
+}
+
+// Creates the metadata of a track in the track list, or NULL if it is unknown
+static GVariant *
+wf_mpris_new_variant_track_metadata(guint track_id)
+{
+	GVariantBuilder builder;
+
+	if (MediaTrackListData.callbacks.get_metadata_func == NULL)
+	{
+		return NULL;
+	}
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+	g_variant_builder_add(&builder, "{sv}", "mpris:trackid", wf_mpris_new_variant_track_path(track_id));
+
+	if (!MediaTrackListData.callbacks.get_metadata_func(track_id, &builder))
+	{
+		g_variant_builder_clear(&builder);
+
+		return NULL;
+	}
+
+	return g_variant_builder_end(&builder);
+}
+
+// Gets the track id from a D-Bus Track object path
+static gboolean
+wf_mpris_get_track_id_from_path(const gchar *object_path, guint *track_id_rv)
+{
+	const gchar *prefix = MPRIS_OBJECT_TRACK_ID "/";
+	guint64 track_id;
+
+	if (object_path == NULL || !g_str_has_prefix(object_path, prefix))
+	{
+		return FALSE;
+	}
+
+	if (!g_ascii_string_to_unsigned(object_path + strlen(prefix), 10, 1, G_MAXUINT, &track_id, NULL /* error */))
+	{
+		return FALSE;
+	}
+
+	*track_id_rv = (guint) track_id;
+
+	return TRUE;
 }
 
 /* MODULE UTILITIES END */
@@ -1606,15 +2416,49 @@ wf_mpris_new_variant_track_path(guint track_id)
 void
 wf_mpris_deactivate(void)
 {
+	if (FlushChangesId != 0)
+	{
+		g_source_remove(FlushChangesId);
+		FlushChangesId = 0;
+	}
+
+	ChangedProperties = MPRIS_CHANGED_NONE;
+
+	if (FlushTrackListId != 0)
+	{
+		g_source_remove(FlushTrackListId);
+		FlushTrackListId = 0;
+	}
+
+	if (MediaTrackListData.changes != NULL)
+	{
+		g_array_unref(MediaTrackListData.changes);
+		MediaTrackListData.changes = NULL;
+	}
+
+	MediaTrackListData.replaced = FALSE;
+
+	if (MetadataCache != NULL)
+	{
+		g_variant_unref(MetadataCache);
+		MetadataCache = NULL;
+	}
+
 	g_dbus_connection_unregister_object(SessionConnection, InterfaceRootId);
 	g_dbus_connection_unregister_object(SessionConnection, InterfacePlayerId);
 
+	if (InterfaceTrackListId != 0)
+	{
+		g_dbus_connection_unregister_object(SessionConnection, InterfaceTrackListId);
+	}
+
 	g_bus_unown_name(BusNameIdentifier);
 
 	g_object_unref(SessionConnection);
 
 	InterfaceRootId = 0;
 	InterfacePlayerId = 0;
+	InterfaceTrackListId = 0;
 	BusNameIdentifier = 0;
 	SessionConnection = NULL;
 
@@ -76,9 +76,18 @@ typedef void (*WfFuncPlayerPlayPause) (void);
 typedef void (*WfFuncPlayerStop) (void);
 typedef void (*WfFuncPlayerPlay) (void);
 typedef void (*WfFuncPlayerSeek) (gint64 offset);
-typedef void (*WfFuncPlayerSetPosition) (const gchar *track_id, gint64 position);
+typedef void (*WfFuncPlayerSetPosition) (guint track_id, gint64 position);
 typedef void (*WfFuncPlayerOpenUri) (const gchar *uri);
 
+/*
+ * The track list is owned by the application; these callbacks are used to look
+ * up the tracks and their metadata when a client asks for them.  Track ids are
+ * the same ids as used with wf_mpris_set_info_track_id().
+ */
+typedef guint * (*WfFuncTrackListGetTracks) (gsize *length_rv);
+typedef gboolean (*WfFuncTrackListGetMetadata) (guint track_id, GVariantBuilder *builder);
+typedef void (*WfFuncTrackListGoTo) (guint track_id);
+
 /* MODULE TYPES END */
 
 /* CONSTRUCTOR PROTOTYPES BEGIN */
@@ -136,6 +145,10 @@ GVariant * wf_mpris_get_player_can_seek(void);
 void wf_mpris_set_player_can_control(gboolean can_control);
 GVariant * wf_mpris_get_player_can_control(void);
 
+/* TrackList interface getters */
+GVariant * wf_mpris_get_tracklist_tracks(void);
+GVariant * wf_mpris_get_tracklist_can_edit_tracks(void);
+
 /* Metadata setters */
 void wf_mpris_set_info_track_id(guint track_id);
 void wf_mpris_set_info_url(const gchar *url);
@@ -175,12 +188,20 @@ void wf_mpris_connect_player_play(WfFuncPlayerPlay cb_func);
 void wf_mpris_connect_player_seek(WfFuncPlayerSeek cb_func);
 void wf_mpris_connect_player_set_position(WfFuncPlayerSetPosition cb_func);
 void wf_mpris_connect_player_open_uri(WfFuncPlayerOpenUri cb_func);
+void wf_mpris_connect_tracklist_get_tracks(WfFuncTrackListGetTracks cb_func);
+void wf_mpris_connect_tracklist_get_metadata(WfFuncTrackListGetMetadata cb_func);
+void wf_mpris_connect_tracklist_go_to(WfFuncTrackListGoTo cb_func);
 
 /* GETTER/SETTER PROTOTYPES END */
 
 /* FUNCTION PROTOTYPES BEGIN */
 
 void wf_mpris_flush_changes(void);
+void wf_mpris_player_seeked(gint64 position);
+
+void wf_mpris_tracklist_track_added(guint track_id, guint after_track_id);
+void wf_mpris_tracklist_track_removed(guint track_id);
+void wf_mpris_tracklist_replaced(void);
 
 /* FUNCTION PROTOTYPES END */
 
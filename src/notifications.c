@@ -34,6 +34,7 @@
 // Dependency includes
 #include <woofer/song.h>
 #include <woofer/utils.h>
+#include <woofer/memory.h>
 
 // Resource includes
 /*< none >*/
@@ -45,6 +46,11 @@
 /*
  * This module provides the application with built-in support for desktop
  * notifications using #GNotification.
+ *
+ * Player notifications are not sent right away: when skipping through songs,
+ * only the song that is still playing after a short delay gets one.  Its
+ * message is only formatted at that point, and the same #GNotification is
+ * used for all of them.
  */
 
 /* DESCRIPTION END */
@@ -54,12 +60,32 @@
 #define NOTIFICATION_ID_DEFAULT WF_NAME
 #define NOTIFICATION_ID_PLAYER "player"
 
+// Time in milliseconds a song has to keep playing to get a notification
+#define NOTIFICATION_PLAYER_DELAY 400
+
 /* DEFINES END */
 
 /* CUSTOM TYPES BEGIN */
+
+typedef struct _WfNotificationsPlayer WfNotificationsPlayer;
+
+struct _WfNotificationsPlayer
+{
+	guint source_id; // Timeout of the pending notification
+	WfSong *song; // Song of the pending notification
+	gint64 duration;
+
+	GNotification *notification; // Reused for every player notification
+	gchar *body; // Body of the notification that is shown now
+};
+
 /* CUSTOM TYPES END */
 
 /* FUNCTION PROTOTYPES BEGIN */
+
+static gboolean wf_notifications_player_timeout_cb(gpointer user_data);
+static void wf_notifications_player_cancel(void);
+
 /* FUNCTION PROTOTYPES END */
 
 /* GLOBAL VARIABLES BEGIN */
@@ -67,6 +93,8 @@
 static GApplication *App;
 static gboolean Active;
 
+static WfNotificationsPlayer PlayerData = { 0 };
+
 /* GLOBAL VARIABLES END */
 
 /* CONSTRUCTORS BEGIN */
@@ -85,6 +113,42 @@ wf_notifications_init(GApplication *application)
 /* GETTERS/SETTERS END */
 
 /* CALLBACK FUNCTIONS BEGIN */
+
+// The song has been playing long enough, so send its notification
+static gboolean
+wf_notifications_player_timeout_cb(gpointer user_data)
+{
+	gchar *body;
+
+	PlayerData.source_id = 0;
+
+	body = wf_notifications_get_default_player_message(PlayerData.song, PlayerData.duration);
+
+	// Do not bother the notification daemon with what it is showing already
+	if (!Active || PlayerData.body == NULL || g_strcmp0(body, PlayerData.body) != 0)
+	{
+		if (PlayerData.notification == NULL)
+		{
+			PlayerData.notification = g_notification_new("Now playing");
+
+			// Player notifications don't need the users attention
+			g_notification_set_priority(PlayerData.notification, G_NOTIFICATION_PRIORITY_LOW);
+		}
+
+		g_notification_set_body(PlayerData.notification, body);
+		g_application_send_notification(App, NOTIFICATION_ID_PLAYER, PlayerData.notification);
+
+		Active = TRUE;
+	}
+
+	g_free(PlayerData.body);
+	PlayerData.body = body;
+
+	g_clear_object(&PlayerData.song);
+
+	return G_SOURCE_REMOVE;
+}
+
 /* CALLBACK FUNCTIONS END */
 
 /* MODULE FUNCTIONS BEGIN */
@@ -114,6 +178,12 @@ wf_notifications_send(const gchar *id, const gchar *title, const gchar *body, GN
 
 	g_return_if_fail(id != NULL);
 
+	if (App == NULL)
+	{
+		// Not initialized, like when running as a daemon
+		return;
+	}
+
 	if (title != NULL)
 	{
 		g_noti = g_notification_new(title);
@@ -133,6 +203,13 @@ wf_notifications_send(const gchar *id, const gchar *title, const gchar *body, GN
 
 	// Send the notification with id 'player'.  This is used to replace this notification with newer ones.
 	g_application_send_notification(App, id, g_noti);
+	g_object_unref(g_noti);
+
+	if (g_strcmp0(id, NOTIFICATION_ID_PLAYER) == 0)
+	{
+		// Whatever the player notification showed has been replaced
+		wf_memory_clear_str(&PlayerData.body);
+	}
 
 	Active = TRUE;
 }
@@ -146,6 +223,9 @@ wf_notifications_withdraw_default(void)
 void
 wf_notifications_withdraw_playing(void)
 {
+	wf_notifications_player_cancel();
+	wf_memory_clear_str(&PlayerData.body);
+
 	wf_notifications_withdraw(NOTIFICATION_ID_PLAYER);
 }
 
@@ -154,19 +234,30 @@ wf_notifications_withdraw(const gchar *id)
 {
 	g_return_if_fail(id != NULL);
 
+	if (App == NULL)
+	{
+		return;
+	}
+
 	g_application_withdraw_notification(App, id);
 }
 
 void
 wf_notifications_default_player_handler(WfSong *song, gint64 duration)
 {
-	gchar *info;
+	if (App == NULL)
+	{
+		return;
+	}
 
 	if (song != NULL)
 	{
-		info = wf_notifications_get_default_player_message(song, duration);
-		wf_notifications_send_playing("Now playing", info);
-		g_free(info);
+		// Replaces the notification of a song that was skipped right away
+		wf_notifications_player_cancel();
+
+		PlayerData.song = g_object_ref(song);
+		PlayerData.duration = duration;
+		PlayerData.source_id = g_timeout_add(NOTIFICATION_PLAYER_DELAY, wf_notifications_player_timeout_cb, NULL /* user_data */);
 	}
 	else
 	{
@@ -174,6 +265,19 @@ wf_notifications_default_player_handler(WfSong *song, gint64 duration)
 	}
 }
 
+// Forget about the pending player notification, if any
+static void
+wf_notifications_player_cancel(void)
+{
+	if (PlayerData.source_id > 0)
+	{
+		g_source_remove(PlayerData.source_id);
+		PlayerData.source_id = 0;
+	}
+
+	g_clear_object(&PlayerData.song);
+}
+
 /* MODULE FUNCTIONS END */
 
 /* MODULE UTILITIES BEGIN */
@@ -221,12 +325,17 @@ wf_notifications_get_default_player_message(WfSong *song, gint64 duration)
 void
 wf_notifications_finalize(void)
 {
+	wf_notifications_player_cancel();
+
 	if (Active)
 	{
 		wf_notifications_withdraw_default();
 		wf_notifications_withdraw_playing();
 	}
 
+	g_clear_object(&PlayerData.notification);
+	wf_memory_clear_str(&PlayerData.body);
+
 	App = NULL;
 	Active = FALSE;
 }
@@ -32,6 +32,11 @@
 #include <glib-object.h>
 #include <gio/gio.h>
 #include <gst/gst.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_UNIX
+#include <sys/mman.h>
+#endif
 
 // Global includes
 /*< none >*/
@@ -43,10 +48,13 @@
 #include <woofer/song.h>
 #include <woofer/song_private.h>
 #include <woofer/song_manager.h>
+#include <woofer/library.h>
+#include <woofer/library_private.h>
 #include <woofer/settings.h>
 #include <woofer/mpris.h>
 #include <woofer/utils.h>
 #include <woofer/memory.h>
+#include <woofer/metrics.h>
 
 // Resource includes
 /*< none >*/
@@ -87,8 +95,30 @@
  * - Any source element that handles and reads an URI.
  * - decodebin that handles the raw data decoding process and manages
  *   demuxers.
+ * - concat that passes on the decoded data of one song after another, or
+ *   audiomixer if the songs crossfade.
+ * - Optionally a processing bin with rgvolume and rglimiter that applies
+ *   the ReplayGain tags of the song, without clipping.
  * - playsink that processes the decoded data to the sound services.
  *
+ * The source and decodebin of a song together form a branch, which is linked
+ * to a request pad of concat.  For gapless playback, the branch of the
+ * upcoming song is created and prerolled while the current one is still
+ * playing.  When the current song ends, concat continues with the data of the
+ * next branch right away, without the pipeline having to change state.  The
+ * switch is noticed when the stream start of the new song reaches the sink.
+ * The elements of a finished branch are kept outside of the pipeline, so the
+ * next branch only has to set a new location instead of creating them again.
+ *
+ * To crossfade, audiomixer takes the place of concat.  The decoded pad of the
+ * standby branch is blocked once it prerolled.  Shortly before the current
+ * song ends, it is linked to the mixer with a pad offset, so its data starts
+ * at the current running time, and the standby branch becomes the current
+ * one.  Pad probes ramp the volume of both mixer pads on the streaming
+ * threads, by the timestamps of the buffers that pass.  The previous branch
+ * is freed once its end of stream reached the mixer.  As the mixer does not
+ * pass on the stream starts of its pads, the new song is reported right away.
+ *
  * The call gst_element_make_from_uri() takes an URI, constructs a proper
  * source element and returns it.  The element returned can be of a variety of
  * source element types.  The most obvious and probably most used one is filesrc
@@ -111,11 +141,34 @@
 #undef G_LOG_DOMAIN
 #define G_LOG_DOMAIN WF_TAG "-player"
 
+// Renamed in GStreamer 1.20
+#if !GST_CHECK_VERSION(1, 20, 0)
+#define gst_element_request_pad_simple gst_element_get_request_pad
+#endif
+
+// Read the start of the upcoming song in advance, so it is in the page cache
+#define PREFETCH_SIZE (4 * 1024 * 1024)
+#define PREFETCH_CHUNK_SIZE (256 * 1024)
+
+// Decoders kept for reuse; enough for the current and the upcoming song
+#define SPARE_DECODERS 2
+
+// Position updates: query the pipeline again after this time and slow down if nobody listens
+#define POSITION_RESYNC_TIME (5 * GST_SECOND)
+#define UPDATE_INTERVAL_IDLE_FACTOR 10
+
+// Interval in milliseconds to check whether the crossfade to the upcoming song has to start
+#define CROSSFADE_CHECK_INTERVAL 100
+
 /* DEFINES END */
 
 /* CUSTOM TYPES BEGIN */
 
 typedef struct _WfPlayerEvents WfPlayerEvents;
+typedef struct _WfPlayerBranch WfPlayerBranch;
+typedef struct _WfPlayerPrefetch WfPlayerPrefetch;
+typedef struct _WfPlayerRamEntry WfPlayerRamEntry;
+typedef struct _WfPlayerFade WfPlayerFade;
 typedef struct _WfPlayerDetails WfPlayerDetails;
 
 struct _WfPlayerEvents
@@ -123,20 +176,109 @@ struct _WfPlayerEvents
 	WfFuncReportMsg report_msg;
 	WfFuncStateChanged state_changed;
 	WfFuncPositionUpdated position_updated;
+	WfFuncPositionWanted position_wanted;
 	WfFuncNotification notification;
 };
 
+// The elements that read and decode a single song
+struct _WfPlayerBranch
+{
+	WfSong *song; // Reference owned by the branch
+
+	GstElement *source; // Data source (input)
+	GstElement *decoder; // Data decoder (convert)
+	gchar *scheme; // URI scheme the source handles or %NULL for a memory source
+	gulong pad_added_handler;
+
+	// Set from a streaming thread, protected by the branch mutex
+	GstPad *pad; // Request pad of concat or the mixer the decoder is linked to
+	gboolean dropped;
+	gboolean held; // Keep the decoded data back until the crossfade starts
+	GstPad *decoded; // Blocked pad of the decoder, while held
+	gulong block_probe;
+
+	gulong fade_probe; // Probe ramping the volume of the mixer pad, if fading in
+};
+
+// A read-ahead of the upcoming song, freed when it finishes or is cancelled
+struct _WfPlayerPrefetch
+{
+	WfSong *song; // Reference owned by the prefetch
+	GCancellable *cancellable;
+	GInputStream *stream;
+	gsize read;
+
+	GByteArray *content; // All data read so far for the RAM cache, or %NULL
+};
+
+// A volume ramp on a mixer pad, applied from its streaming thread
+struct _WfPlayerFade
+{
+	GstClockTime length; // Duration of the fade
+	GstClockTime start; // Timestamp of the first buffer, or GST_CLOCK_TIME_NONE
+	gboolean in; // Fade in instead of out
+};
+
+// Data of a song kept in memory for playing from RAM
+struct _WfPlayerRamEntry
+{
+	guint32 hash; // Hash of the song
+	GBytes *bytes; // Complete content, mapped or read
+
+	// To notice the file changed after it was cached
+	gchar *path; // Local path, %NULL if not a local file
+	gint64 mtime; // Of the local file
+	gint64 modified; // As known by the library, for other files
+};
+
 struct _WfPlayerDetails
 {
 	WfPlayerEvents events;
 
 	WfPlayerStatus status; // Current state
+	gboolean remote; // Whether to provide the MPRIS interface
 
 	GstElementFactory *giostreamfactory; // giostreamsrc element factory
 	GstElement *pipeline; // Currently used pipeline
-	GstElement *source; // Currently used data source (input)
-	GstElement *decoder; // Currently used data decoder (convert)
+	GstElement *concat; // Joins the decoded songs together
+	GstElement *mixer; // Joins the decoded songs instead of concat, while crossfading is enabled
+	gboolean mixer_unavailable; // The plugin for the mixer is not installed
+	gboolean crossfade; // Whether the mixer is used
+	GstElement *processing; // Audio processing between concat and sink, if enabled
+	GstElement *rgvolume; // ReplayGain element inside the processing bin
+	gboolean processing_unavailable; // The plugins for processing are not installed
 	GstElement *sink; // Currently used data sink (output)
+
+	WfPlayerBranch *branch; // Branch of the current song
+	WfPlayerBranch *standby; // Branch of the upcoming song, prepared in advance
+	WfSong *standby_failed; // Upcoming song that could not be prepared
+	WfPlayerBranch *fading; // Branch of the previous song, while it fades out
+	guint crossfade_check; // Event source ID to start the crossfade in time
+	gint64 branch_base; // Position of the pipeline where the current branch started
+	GMutex branch_mutex;
+
+	// Elements of freed branches, kept out of the pipeline for reuse
+	GHashTable *spare_sources; // URI scheme as key, source element as value
+	GstElement *spare_stream_source; // Memory source
+	GQueue spare_decoders;
+
+	// Warm-up: the upcoming song prerolled in the current branch before anything is played
+	guint warm_up_id; // Idle source of the pending warm-up
+	gboolean warm; // The current branch is the one of the warm-up
+	gboolean warm_started; // Its stream started, but this has not been reported
+
+	WfPlayerPrefetch *prefetch; // Read-ahead in progress, if any
+	WfSong *prefetched; // Song of the last completed read-ahead, only for comparison
+
+	// Songs loaded for playing from RAM, the most recently used first
+	GHashTable *ram_cache; // Song hash as key, link in ram_cache_order as value
+	GQueue ram_cache_order; // Of WfPlayerRamEntry
+	gsize ram_cache_size; // Total number of bytes held
+#if GLIB_CHECK_VERSION(2, 64, 0)
+	GMemoryMonitor *memory_monitor;
+	gulong memory_warning_handler;
+#endif
+
 	GstBus *bus; // Currently used bus
 	GstQuery *query_duration; // Query for duration
 	GstQuery *query_position; // Query for position
@@ -144,6 +286,7 @@ struct _WfPlayerDetails
 	const gchar *play_msg; // Custom play message
 	WfSong *song; // Song currently playing
 	gint64 duration; // Duration in nanoseconds of the current pipeline
+	gint64 opened; // Time the current song was opened, until its stream started (for the metrics)
 	gdouble volume; // Currently used volume
 
 	// Volume updated signal handler
@@ -151,6 +294,16 @@ struct _WfPlayerDetails
 	gulong volume_handler;
 
 	guint update_event; // Event source ID for the front-end update interval
+	guint update_interval; // Interval in milliseconds the update event runs at
+
+	// Last queried position and the clock time it was queried at (or GST_CLOCK_TIME_NONE)
+	gint64 position_base;
+	GstClockTime position_clock;
+
+	// Only one seek is in flight; of the requests made meanwhile only the last one is done
+	gboolean seeking; // A flushing seek has been sent and has not completed yet
+	gint64 seek_target; // Position of the last requested seek (nanoseconds)
+	gint64 seek_pending; // Position to seek to once the current seek completes, or -1
 };
 
 /* CUSTOM TYPES END */
@@ -161,9 +314,18 @@ static void wf_player_set_volume_internal(gdouble volume);
 
 static gboolean wf_player_message_arrived_cb(GstBus *bus, GstMessage *message, gpointer user_data);
 static void wf_player_pipeline_pad_added_cb(GstElement *source_element, GstPad *pad, gpointer user_data);
+static GstPadProbeReturn wf_player_crossfade_block_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn wf_player_crossfade_ramp_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static gboolean wf_player_crossfade_check_cb(gpointer user_data);
+static gboolean wf_player_crossfade_faded_cb(gpointer user_data);
+static void wf_player_upcoming_changed_cb(WfSong *song);
+static void wf_player_prefetch_open_cb(GObject *source_object, GAsyncResult *result, gpointer user_data);
+static void wf_player_prefetch_read_cb(GObject *source_object, GAsyncResult *result, gpointer user_data);
+#if GLIB_CHECK_VERSION(2, 64, 0)
+static void wf_player_ram_cache_memory_warning_cb(GMemoryMonitor *monitor, GMemoryMonitorWarningLevel level, gpointer user_data);
+#endif
 
 static gboolean wf_player_update_event_run_cb(gpointer user_data);
-static void wf_player_update_event_rm_cb(gpointer data);
 
 static void wf_player_volume_updated_cb(GObject *object, GParamSpec *pspec, gpointer user_data);
 
@@ -177,10 +339,19 @@ static void wf_player_remote_pause_cb(void);
 static void wf_player_remote_play_pause_cb(void);
 static void wf_player_remote_stop_cb(void);
 static void wf_player_remote_play_cb(void);
+static guint * wf_player_remote_get_tracks_cb(gsize *length_rv);
+static gboolean wf_player_remote_get_track_metadata_cb(guint track_id, GVariantBuilder *builder);
+static void wf_player_remote_go_to_cb(guint track_id);
+static void wf_player_remote_seek_cb(gint64 offset);
+static void wf_player_remote_set_position_cb(guint track_id, gint64 position);
+static void wf_player_remote_song_added_cb(WfSong *song, WfSong *song_before);
+static void wf_player_remote_song_removed_cb(WfSong *song);
+static void wf_player_remote_songs_cleared_cb(void);
 
 static void wf_player_emit_report_msg(WfPlayerEvents *events, const gchar *message);
 static void wf_player_emit_state_changed(WfPlayerEvents *events, WfPlayerStatus status, gdouble duration);
 static void wf_player_emit_position_updated(WfPlayerEvents *events, gdouble duration, gdouble position);
+static gboolean wf_player_emit_position_wanted(WfPlayerEvents *events);
 static void wf_player_emit_notification(WfPlayerEvents *events, WfSong *song, gint64 duration);
 
 static void wf_player_message_eos(GstMessage *msg);
@@ -191,6 +362,7 @@ static void wf_player_message_buffering(GstMessage *msg);
 static void wf_player_message_state_changed(GstMessage *msg);
 static void wf_player_message_async_done(GstMessage *msg);
 static void wf_player_message_stream_start(GstMessage *msg);
+static void wf_player_stream_started(gboolean gapless);
 
 static void wf_player_state_ready(void);
 static void wf_player_state_paused(void);
@@ -202,23 +374,65 @@ static void wf_player_remote_reset(void);
 static void wf_player_songs_updated(void);
 static void wf_player_report_playing(void);
 
-static void wf_player_pipeline_add_source(GstElement *element);
+static GstElement * wf_player_pipeline_create_source(WfSong *song, gchar **scheme_rv);
 static GstElement * wf_player_pipeline_memory_source_get(void);
-static gboolean wf_player_pipeline_memory_source_set_file(GstElement *source, GFile *file);
+static gboolean wf_player_pipeline_memory_source_set_song(GstElement *source, WfSong *song);
+static GBytes * wf_player_pipeline_memory_load_file(GFile *file);
+static GBytes * wf_player_pipeline_memory_map_file(GFile *file);
+
+static gsize wf_player_ram_cache_get_budget(void);
+static GBytes * wf_player_ram_cache_lookup(WfSong *song);
+static gboolean wf_player_ram_cache_is_stale(WfPlayerRamEntry *entry, WfSong *song);
+static void wf_player_ram_cache_insert(WfSong *song, GBytes *bytes);
+static void wf_player_ram_cache_remove(GList *link);
+static void wf_player_ram_cache_trim(gsize budget);
+
+static WfPlayerBranch * wf_player_branch_new(WfSong *song);
+static gboolean wf_player_branch_is_active(WfPlayerBranch *branch);
+static gboolean wf_player_branch_owns_object(WfPlayerBranch *branch, GstObject *object);
+static gboolean wf_player_branch_query_duration(WfPlayerBranch *branch, GstQuery *query);
+
+static GstElement * wf_player_cache_take_source(const gchar *scheme);
+static GstElement * wf_player_cache_take_decoder(void);
+static void wf_player_cache_put(const gchar *scheme, GstElement *source, GstElement *decoder);
+
+static WfSong * wf_player_get_upcoming_song(void);
+static void wf_player_standby_update(void);
+static void wf_player_standby_advance(void);
+static void wf_player_standby_clear(void);
+static void wf_player_crossfade_schedule(void);
+static gboolean wf_player_crossfade_start(gint64 remaining);
+static void wf_player_crossfade_finish(void);
+static void wf_player_warm_up_schedule(void);
+static gboolean wf_player_warm_up_cb(gpointer user_data);
+static gboolean wf_player_warm_up_adopt(WfSong *song);
+static void wf_player_warm_up_clear(gboolean drop);
+
+static void wf_player_prefetch_update(WfSong *song);
+static void wf_player_prefetch_cancel(void);
+static void wf_player_prefetch_read(WfPlayerPrefetch *prefetch);
+
+static GstElement * wf_player_pipeline_processing_new(void);
+static void wf_player_pipeline_update_processing(void);
+static GstElement * wf_player_pipeline_get_joiner(void);
+static void wf_player_pipeline_update_mixer(void);
 
 static void wf_player_pipeline_open(WfSong *song);
-static void wf_player_pipeline_set_song(WfSong *song);
 static void wf_player_pipeline_update_volume(void);
 static void wf_player_pipeline_play(void);
 static void wf_player_pipeline_pause(void);
 static void wf_player_pipeline_ready(void);
 static void wf_player_pipeline_stop(void);
-static void wf_player_pipeline_seek(gdouble position);
+static void wf_player_pipeline_seek(gint64 position);
+static void wf_player_pipeline_seek_reset(void);
 static gboolean wf_player_pipeline_has_data(void);
 static gint64 wf_player_pipeline_get_duration(void);
 static gint64 wf_player_pipeline_get_position(void);
 
 static void wf_player_update_event_update(void);
+static guint wf_player_update_event_get_interval(gboolean wanted);
+static gint64 wf_player_position_estimate(void);
+static void wf_player_position_invalidate(void);
 
 static gdouble wf_player_get_played_fraction(void);
 
@@ -229,6 +443,11 @@ static void wf_player_play_prev_song(void);
 static void wf_player_seek(gint64 position);
 
 static void wf_player_remote_finalize(void);
+static void wf_player_branch_free(WfPlayerBranch *branch);
+static void wf_player_prefetch_free(WfPlayerPrefetch *prefetch);
+static void wf_player_fade_free(gpointer data);
+static void wf_player_cache_clear(void);
+static void wf_player_ram_cache_clear(void);
 static void wf_player_pipeline_destruct(void);
 
 /* FUNCTION PROTOTYPES END */
@@ -238,7 +457,10 @@ static void wf_player_pipeline_destruct(void);
 static WfPlayerDetails PlayerData =
 {
 	.status = WF_PLAYER_NO_STATUS,
+	.remote = TRUE,
 	.volume = 1.0,
+	.position_clock = GST_CLOCK_TIME_NONE,
+	.seek_pending = -1,
 };
 
 /* GLOBAL VARIABLES END */
@@ -252,6 +474,7 @@ wf_player_init(void)
 
 	// Modules initialization
 	wf_song_manager_init();
+	wf_song_manager_connect_event_upcoming_changed(wf_player_upcoming_changed_cb);
 	wf_player_remote_init();
 
 	// Pipeline construction and playback preparations
@@ -268,12 +491,20 @@ wf_player_init(void)
 
 	// Now ready
 	PlayerData.status = WF_PLAYER_INIT;
+
+	// Get the first song ready in the background
+	wf_player_warm_up_schedule();
 }
 
 // Player remote handles information for MPRIS clients
 static void
 wf_player_remote_init(void)
 {
+	if (!PlayerData.remote)
+	{
+		return;
+	}
+
 	// Connect to MPRIS signals
 	wf_mpris_connect_player_next(wf_player_remote_next_cb);
 	wf_mpris_connect_player_previous(wf_player_remote_previous_cb);
@@ -281,8 +512,19 @@ wf_player_remote_init(void)
 	wf_mpris_connect_player_play_pause(wf_player_remote_play_pause_cb);
 	wf_mpris_connect_player_stop(wf_player_remote_stop_cb);
 	wf_mpris_connect_player_play(wf_player_remote_play_cb);
+	wf_mpris_connect_tracklist_get_tracks(wf_player_remote_get_tracks_cb);
+	wf_mpris_connect_tracklist_get_metadata(wf_player_remote_get_track_metadata_cb);
+	wf_mpris_connect_tracklist_go_to(wf_player_remote_go_to_cb);
+	wf_mpris_connect_player_seek(wf_player_remote_seek_cb);
+	wf_mpris_connect_player_set_position(wf_player_remote_set_position_cb);
+
+	// Report changes of the library as changes of the track list
+	wf_song_connect_event_added(wf_player_remote_song_added_cb);
+	wf_song_connect_event_removed(wf_player_remote_song_removed_cb);
+	wf_song_connect_event_cleared(wf_player_remote_songs_cleared_cb);
 
 	// Set MPRIS properties
+	wf_mpris_set_root_has_track_list(TRUE);
 	wf_mpris_set_player_playback_status(WF_MPRIS_STOPPED);
 	wf_mpris_set_player_minimum_rate(1.0);
 	wf_mpris_set_player_maximum_rate(1.0);
@@ -292,7 +534,7 @@ wf_player_remote_init(void)
 	wf_mpris_set_player_can_go_previous(TRUE);
 	wf_mpris_set_player_can_play(TRUE);
 	wf_mpris_set_player_can_pause(TRUE);
-	wf_mpris_set_player_can_seek(FALSE);
+	wf_mpris_set_player_can_seek(TRUE);
 	wf_mpris_set_player_can_control(TRUE);
 
 	// Try to activate
@@ -303,7 +545,7 @@ static gboolean
 wf_player_pipeline_construct(void)
 {
 	GstElement *pipeline;
-	GstElement *decoder = NULL;
+	GstElement *concat = NULL;
 	GstElement *sink = NULL;
 	GstBus *bus;
 
@@ -315,12 +557,12 @@ wf_player_pipeline_construct(void)
 
 	// Create elements
 	PlayerData.pipeline = pipeline = gst_pipeline_new("pipeline");
-	PlayerData.decoder = decoder = gst_element_factory_make("decodebin", "decoder");
+	PlayerData.concat = concat = gst_element_factory_make("concat", "concat");
 	PlayerData.sink = sink = gst_element_factory_make("playsink", "sink");
 	PlayerData.duration = GST_CLOCK_TIME_NONE;
 
 	// Return if any elements are not present
-	if (pipeline == NULL || decoder == NULL || sink == NULL)
+	if (pipeline == NULL || concat == NULL || sink == NULL)
 	{
 		g_warning("Could not create one or more GStreamer elements");
 		wf_player_pipeline_destruct();
@@ -336,11 +578,17 @@ wf_player_pipeline_construct(void)
 	PlayerData.volume_handler = g_signal_connect(PlayerData.volume_instance, "notify::volume", G_CALLBACK(wf_player_volume_updated_cb), NULL /* user_data */);
 
 	// Add elements to pipeline (this will transfer ownership of the elements)
-	gst_bin_add(GST_BIN(pipeline), decoder);
+	gst_bin_add(GST_BIN(pipeline), concat);
 	gst_bin_add(GST_BIN(pipeline), sink);
 
-	// Linking dynamic pads when they become available by the element
-	g_signal_connect(decoder, "pad-added", G_CALLBACK(wf_player_pipeline_pad_added_cb), sink);
+	// The branches of the songs are linked to concat once their pads appear
+	if (!gst_element_link_pads(concat, "src", sink, "audio_sink"))
+	{
+		g_warning("Could not link the GStreamer elements");
+		wf_player_pipeline_destruct();
+
+		return FALSE;
+	}
 
 	// Get pipeline bus
 	PlayerData.bus = bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
@@ -376,6 +624,12 @@ wf_player_connect_event_position_updated(WfFuncPositionUpdated cb_func)
 	PlayerData.events.position_updated = cb_func;
 }
 
+void
+wf_player_connect_event_position_wanted(WfFuncPositionWanted cb_func)
+{
+	PlayerData.events.position_wanted = cb_func;
+}
+
 void
 wf_player_connect_event_notification(WfFuncNotification cb_func)
 {
@@ -401,6 +655,21 @@ wf_player_get_volume_percentage(void)
 	return (volume * 100.0);
 }
 
+/*
+ * wf_player_set_remote_enabled:
+ * @enabled: whether to provide the MPRIS interface
+ *
+ * Sets whether the player can be controlled by MPRIS clients.  This is enabled
+ * by default and has to be set before wf_player_init() to have any effect.
+ */
+void
+wf_player_set_remote_enabled(gboolean enabled)
+{
+	g_return_if_fail(PlayerData.status == WF_PLAYER_NO_STATUS);
+
+	PlayerData.remote = enabled;
+}
+
 void
 wf_player_set_volume(gdouble volume)
 {
@@ -494,7 +763,11 @@ wf_player_message_arrived_cb(GstBus *bus, GstMessage *message, gpointer user_dat
 		case GST_MESSAGE_ELEMENT:
 		case GST_MESSAGE_SEGMENT_START:
 		case GST_MESSAGE_SEGMENT_DONE:
+			break;
 		case GST_MESSAGE_DURATION_CHANGED:
+			// Query it again when it is needed
+			PlayerData.duration = GST_CLOCK_TIME_NONE;
+			break;
 		case GST_MESSAGE_LATENCY:
 			break;
 		case GST_MESSAGE_ASYNC_DONE:
@@ -518,16 +791,187 @@ wf_player_message_arrived_cb(GstBus *bus, GstMessage *message, gpointer user_dat
 	return G_SOURCE_CONTINUE; // %TRUE
 }
 
+// Called from a streaming thread when the decoder of a branch has a new stream
 static void
 wf_player_pipeline_pad_added_cb(GstElement *source_element, GstPad *pad, gpointer user_data)
 {
-	GstElement *sink_element = (GstElement *) user_data;
+	WfPlayerBranch *branch = user_data;
+	GstPad *concat_pad = NULL;
+	GstCaps *caps;
+	gboolean is_audio = FALSE;
+
+	g_return_if_fail(GST_IS_PAD(pad));
+
+	caps = gst_pad_get_current_caps(pad);
+
+	if (caps == NULL)
+	{
+		caps = gst_pad_query_caps(pad, NULL /* filter */);
+	}
+
+	if (caps != NULL)
+	{
+		if (gst_caps_get_size(caps) > 0)
+		{
+			is_audio = g_str_has_prefix(gst_structure_get_name(gst_caps_get_structure(caps, 0)), "audio/");
+		}
+
+		gst_caps_unref(caps);
+	}
+
+	if (!is_audio)
+	{
+		// Things like embedded cover art are of no use
+		return;
+	}
+
+	g_mutex_lock(&PlayerData.branch_mutex);
+
+	// Only the first audio stream of the song is played
+	if (!branch->dropped && branch->pad == NULL && branch->decoded == NULL)
+	{
+		if (branch->held)
+		{
+			// Preroll up to the pad, it is linked to the mixer when the crossfade starts
+			branch->decoded = gst_object_ref(pad);
+			branch->block_probe = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM, wf_player_crossfade_block_cb, NULL /* user_data */, NULL /* destroy_data */);
+		}
+		else
+		{
+			concat_pad = branch->pad = gst_element_request_pad_simple(wf_player_pipeline_get_joiner(), "sink_%u");
+		}
+	}
+
+	g_mutex_unlock(&PlayerData.branch_mutex);
+
+	if (concat_pad != NULL && gst_pad_link(pad, concat_pad) != GST_PAD_LINK_OK)
+	{
+		g_warning("Could not link the decoded stream");
+	}
+}
+
+// Keeps the data of a held branch back, until the probe is removed
+static GstPadProbeReturn
+wf_player_crossfade_block_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+	return GST_PAD_PROBE_OK;
+}
+
+// Called from a streaming thread for the data going into a mixer pad that fades
+static GstPadProbeReturn
+wf_player_crossfade_ramp_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+	WfPlayerFade *fade = user_data;
+	GstBuffer *buffer;
+	GstClockTime pts;
+	gdouble progress;
+
+	if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM)
+	{
+		if (!fade->in && GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_EOS)
+		{
+			// The previous song is over; its branch can go
+			g_idle_add(wf_player_crossfade_faded_cb, NULL /* data */);
+		}
+
+		return GST_PAD_PROBE_OK;
+	}
+
+	buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+	pts = (buffer == NULL) ? GST_CLOCK_TIME_NONE : GST_BUFFER_PTS(buffer);
+
+	if (!GST_CLOCK_TIME_IS_VALID(pts))
+	{
+		return GST_PAD_PROBE_OK;
+	}
+
+	if (!GST_CLOCK_TIME_IS_VALID(fade->start))
+	{
+		fade->start = pts;
+	}
+
+	progress = (pts > fade->start) ? (gdouble) (pts - fade->start) / fade->length : 0.0;
+	progress = CLAMP(progress, 0.0, 1.0);
+
+	g_object_set(pad, "volume", (fade->in) ? progress : 1.0 - progress, NULL /* terminator */);
+
+	return GST_PAD_PROBE_OK;
+}
+
+// Executed in an interval while the upcoming song is held back, to start the crossfade in time
+static gboolean
+wf_player_crossfade_check_cb(gpointer user_data)
+{
+	gint64 length;
+	gint64 duration;
+	gint64 remaining;
+
+	if (!PlayerData.crossfade || PlayerData.standby == NULL || !PlayerData.standby->held)
+	{
+		PlayerData.crossfade_check = 0;
+
+		return G_SOURCE_REMOVE; // FALSE
+	}
+
+	if (PlayerData.status != WF_PLAYER_PLAYING || PlayerData.seeking)
+	{
+		return G_SOURCE_CONTINUE; // %TRUE
+	}
+
+	length = wf_settings_static_get_double(WF_SETTING_CROSSFADE_DURATION) * GST_SECOND;
+	duration = wf_player_pipeline_get_duration();
+	remaining = duration - wf_player_pipeline_get_position();
+
+	// Without a duration or once too late, the songs simply follow each other
+	if (duration <= 0 || remaining > length || remaining <= 0)
+	{
+		return G_SOURCE_CONTINUE; // %TRUE
+	}
+
+	if (!wf_player_crossfade_start(remaining))
+	{
+		// The upcoming song did not preroll yet
+		return G_SOURCE_CONTINUE; // %TRUE
+	}
+
+	PlayerData.crossfade_check = 0;
+
+	return G_SOURCE_REMOVE; // FALSE
+}
+
+// The previous song has faded out completely
+static gboolean
+wf_player_crossfade_faded_cb(gpointer user_data)
+{
+	GstPad *pad = NULL;
+
+	if (PlayerData.fading == NULL)
+	{
+		return G_SOURCE_REMOVE; // FALSE
+	}
+
+	g_mutex_lock(&PlayerData.branch_mutex);
+
+	if (PlayerData.fading->pad != NULL)
+	{
+		pad = gst_object_ref(PlayerData.fading->pad);
+	}
+
+	g_mutex_unlock(&PlayerData.branch_mutex);
 
-	g_return_if_fail(GST_IS_ELEMENT(source_element));
-	g_return_if_fail(GST_IS_ELEMENT(sink_element));
+	// The end of stream may belong to a branch that has been freed meanwhile
+	if (pad != NULL && GST_PAD_IS_EOS(pad))
+	{
+		wf_player_branch_free(PlayerData.fading);
+		PlayerData.fading = NULL;
+	}
+
+	if (pad != NULL)
+	{
+		gst_object_unref(pad);
+	}
 
-	// Link pads
-	gst_element_link(source_element, sink_element);
+	return G_SOURCE_REMOVE; // FALSE
 }
 
 // Executed in a specified interval.  Report the duration and position of the player to the front-end
@@ -538,11 +982,22 @@ wf_player_update_event_run_cb(gpointer user_data)
 	gint64 duration;
 	gdouble d_pos;
 	gdouble d_dur;
+	gboolean wanted;
+	guint interval;
+
+	if (!wf_player_is_active())
+	{
+		PlayerData.update_event = 0;
 
-	if (wf_player_is_active())
+		return G_SOURCE_REMOVE; // FALSE
+	}
+
+	wanted = wf_player_emit_position_wanted(&PlayerData.events);
+
+	if (wanted)
 	{
-		// Get information
-		position = wf_player_pipeline_get_position();
+		// Get information; the duration is cached and the position mostly calculated
+		position = wf_player_position_estimate();
 		duration = wf_player_pipeline_get_duration();
 
 		// Convert to seconds
@@ -553,22 +1008,28 @@ wf_player_update_event_run_cb(gpointer user_data)
 		{
 			wf_player_emit_position_updated(&PlayerData.events, d_pos, d_dur);
 		}
-
-		return G_SOURCE_CONTINUE; // %TRUE
 	}
-	else
+
+	interval = wf_player_update_event_get_interval(wanted);
+
+	if (interval == 0)
 	{
+		// Updates have been turned off in the meantime
+		PlayerData.update_interval = 0;
 		PlayerData.update_event = 0;
 
 		return G_SOURCE_REMOVE; // FALSE
 	}
-}
+	else if (interval != PlayerData.update_interval)
+	{
+		// Continue at a different pace
+		PlayerData.update_interval = interval;
+		PlayerData.update_event = g_timeout_add(interval, wf_player_update_event_run_cb, NULL /* data */);
 
-// Event source got removed
-static void
-wf_player_update_event_rm_cb(gpointer data)
-{
-	PlayerData.update_event = 0;
+		return G_SOURCE_REMOVE; // FALSE
+	}
+
+	return G_SOURCE_CONTINUE; // %TRUE
 }
 
 static void
@@ -597,6 +1058,126 @@ wf_player_volume_updated_cb(GObject *object, GParamSpec *pspec, gpointer user_da
 	}
 }
 
+// The song manager decided on a different song to play after the current one
+static void
+wf_player_upcoming_changed_cb(WfSong *song)
+{
+	wf_player_standby_update();
+	wf_player_warm_up_schedule();
+	wf_player_prefetch_update(song);
+}
+
+static void
+wf_player_prefetch_open_cb(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+	WfPlayerPrefetch *prefetch = user_data;
+	GFileInputStream *stream;
+	GError *error = NULL;
+
+	stream = g_file_read_finish(G_FILE(source_object), result, &error);
+
+	if (stream == NULL)
+	{
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		{
+			g_debug("Could not prefetch the next song: %s", error->message);
+		}
+
+		g_error_free(error);
+		wf_player_prefetch_free(prefetch);
+
+		return;
+	}
+
+	prefetch->stream = G_INPUT_STREAM(stream);
+	wf_player_prefetch_read(prefetch);
+}
+
+static void
+wf_player_prefetch_read_cb(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+	WfPlayerPrefetch *prefetch = user_data;
+	GBytes *bytes;
+	GBytes *bytes_complete;
+	gsize length;
+	GError *error = NULL;
+
+	bytes = g_input_stream_read_bytes_finish(G_INPUT_STREAM(source_object), result, &error);
+
+	if (bytes == NULL)
+	{
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		{
+			g_debug("Could not prefetch the next song: %s", error->message);
+		}
+
+		g_error_free(error);
+		wf_player_prefetch_free(prefetch);
+
+		return;
+	}
+
+	length = g_bytes_get_size(bytes);
+
+	if (prefetch->content != NULL)
+	{
+		if (length == 0)
+		{
+			// Complete, so it can be played from memory
+			bytes_complete = g_byte_array_free_to_bytes(prefetch->content);
+			prefetch->content = NULL;
+
+			wf_player_ram_cache_insert(prefetch->song, bytes_complete);
+			g_bytes_unref(bytes_complete);
+		}
+		else if (prefetch->content->len + length > wf_player_ram_cache_get_budget())
+		{
+			// Too large to keep, so only read ahead as usual
+			g_byte_array_unref(prefetch->content);
+			prefetch->content = NULL;
+		}
+		else
+		{
+			g_byte_array_append(prefetch->content, g_bytes_get_data(bytes, NULL /* size */), length);
+		}
+	}
+
+	// Otherwise the data itself is not needed, only that it has been read once
+	g_bytes_unref(bytes);
+
+	prefetch->read += length;
+
+	if (length == 0 ||
+	    (prefetch->content == NULL && prefetch->read >= PREFETCH_SIZE) ||
+	    g_cancellable_is_cancelled(prefetch->cancellable))
+	{
+		// End of file, enough data or no longer needed
+		wf_player_prefetch_free(prefetch);
+
+		return;
+	}
+
+	wf_player_prefetch_read(prefetch);
+}
+
+#if GLIB_CHECK_VERSION(2, 64, 0)
+static void
+wf_player_ram_cache_memory_warning_cb(GMemoryMonitor *monitor, GMemoryMonitorWarningLevel level, gpointer user_data)
+{
+	if (level >= G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM)
+	{
+		g_debug("Memory is running low, dropping all cached songs");
+
+		wf_player_ram_cache_trim(0);
+	}
+	else
+	{
+		// Keep the most recently used half
+		wf_player_ram_cache_trim(PlayerData.ram_cache_size / 2);
+	}
+}
+#endif
+
 static void
 wf_player_remote_next_cb(void)
 {
@@ -645,29 +1226,180 @@ wf_player_remote_play_cb(void)
 	wf_player_play();
 }
 
-/* CALLBACK FUNCTIONS END */
-
-/* MODULE FUNCTIONS BEGIN */
-
-static void
-wf_player_emit_report_msg(WfPlayerEvents *events, const gchar *message)
+// The track list is the library, with the song hashes as track ids
+static guint *
+wf_player_remote_get_tracks_cb(gsize *length_rv)
 {
-	g_return_if_fail(events != NULL);
+	WfSong *song;
+	guint *tracks;
+	gsize length = 0;
 
-	if (events->report_msg != NULL)
+	tracks = g_new(guint, wf_song_get_count() + 1);
+
+	for (song = wf_song_get_first(); song != NULL; song = wf_song_get_next(song))
 	{
-		events->report_msg(message);
+		tracks[length++] = wf_song_get_hash(song);
 	}
+
+	*length_rv = length;
+
+	return tracks;
 }
 
-static void
-wf_player_emit_state_changed(WfPlayerEvents *events, WfPlayerStatus status, gdouble duration)
+static gboolean
+wf_player_remote_get_track_metadata_cb(guint track_id, GVariantBuilder *builder)
 {
-	g_return_if_fail(events != NULL);
+	WfSong *song = wf_song_get_by_hash(track_id);
+	const gchar *title, *artist, *album;
+	gchar *uri;
 
-	if (events->state_changed != NULL)
+	if (song == NULL)
 	{
-		events->state_changed(status, duration);
+		return FALSE;
+	}
+
+	// The song may not have been loaded completely yet
+	wf_library_load_song(song);
+
+	uri = wf_song_get_uri(song);
+	title = wf_song_get_title(song);
+	artist = wf_song_get_artist(song);
+	album = wf_song_get_album(song);
+
+	const gchar *all_artists[] = { artist, NULL };
+
+	if (uri != NULL)
+	{
+		g_variant_builder_add(builder, "{sv}", "xesam:url", g_variant_new_take_string(uri));
+	}
+
+	g_variant_builder_add(builder, "{sv}", "xesam:title",
+	                      g_variant_new_string((title != NULL) ? title : wf_song_get_name_not_empty(song)));
+
+	if (artist != NULL)
+	{
+		g_variant_builder_add(builder, "{sv}", "xesam:artist", g_variant_new_strv(all_artists, -1));
+	}
+
+	if (album != NULL)
+	{
+		g_variant_builder_add(builder, "{sv}", "xesam:album", g_variant_new_string(album));
+	}
+
+	g_variant_builder_add(builder, "{sv}", "mpris:length", g_variant_new_int64((gint64) wf_song_get_duration(song) * G_USEC_PER_SEC));
+	g_variant_builder_add(builder, "{sv}", "xesam:userRating", g_variant_new_double(wf_song_get_rating(song) / 100.0));
+	g_variant_builder_add(builder, "{sv}", "xesam:autoRating", g_variant_new_double(wf_song_get_score(song) / 100.0));
+	g_variant_builder_add(builder, "{sv}", "xesam:useCount", g_variant_new_int32(wf_song_get_play_count(song)));
+
+	return TRUE;
+}
+
+static void
+wf_player_remote_go_to_cb(guint track_id)
+{
+	WfSong *song = wf_song_get_by_hash(track_id);
+
+	g_info("Remote: Go to track %u", track_id);
+
+	if (song != NULL)
+	{
+		wf_player_open(song);
+	}
+}
+
+// Seek relative to the current position, @offset is in microseconds
+static void
+wf_player_remote_seek_cb(gint64 offset)
+{
+	gint64 position;
+
+	if (!wf_player_is_active())
+	{
+		return;
+	}
+
+	// While scrubbing, continue from where the last seek goes to
+	position = PlayerData.seeking ? PlayerData.seek_target : wf_player_pipeline_get_position();
+	position += offset * GST_USECOND;
+
+	if (PlayerData.duration != GST_CLOCK_TIME_NONE && position > PlayerData.duration)
+	{
+		// Seeking past the end is like skipping to the next song
+		wf_player_forward(FALSE);
+
+		return;
+	}
+
+	wf_player_seek(MAX(position, 0));
+}
+
+// Seek to @position (in microseconds) if @track_id is the current song
+static void
+wf_player_remote_set_position_cb(guint track_id, gint64 position)
+{
+	position *= GST_USECOND;
+
+	if (!wf_player_is_active() ||
+	    PlayerData.song == NULL ||
+	    wf_song_get_hash(PlayerData.song) != track_id ||
+	    position < 0 ||
+	    (PlayerData.duration != GST_CLOCK_TIME_NONE && position > PlayerData.duration))
+	{
+		// Ignored, as the specification demands
+		return;
+	}
+
+	wf_player_seek(position);
+}
+
+static void
+wf_player_remote_song_added_cb(WfSong *song, WfSong *song_before)
+{
+	guint after_track_id = 0;
+
+	if (song_before != NULL)
+	{
+		after_track_id = wf_song_get_hash(song_before);
+	}
+
+	wf_mpris_tracklist_track_added(wf_song_get_hash(song), after_track_id);
+}
+
+static void
+wf_player_remote_song_removed_cb(WfSong *song)
+{
+	wf_mpris_tracklist_track_removed(wf_song_get_hash(song));
+}
+
+static void
+wf_player_remote_songs_cleared_cb(void)
+{
+	wf_mpris_tracklist_replaced();
+}
+
+/* CALLBACK FUNCTIONS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+static void
+wf_player_emit_report_msg(WfPlayerEvents *events, const gchar *message)
+{
+	g_return_if_fail(events != NULL);
+
+	if (events->report_msg != NULL)
+	{
+		events->report_msg(message);
+	}
+}
+
+static void
+wf_player_emit_state_changed(WfPlayerEvents *events, WfPlayerStatus status, gdouble duration)
+{
+	g_return_if_fail(events != NULL);
+
+	if (events->state_changed != NULL)
+	{
+		events->state_changed(status, duration);
 	}
 }
 
@@ -682,6 +1414,20 @@ wf_player_emit_position_updated(WfPlayerEvents *events, gdouble duration, gdoubl
 	}
 }
 
+static gboolean
+wf_player_emit_position_wanted(WfPlayerEvents *events)
+{
+	g_return_val_if_fail(events != NULL, FALSE);
+
+	if (events->position_wanted != NULL)
+	{
+		return events->position_wanted();
+	}
+
+	// Nobody told otherwise, so better keep the updates coming
+	return (events->position_updated != NULL);
+}
+
 static void
 wf_player_emit_notification(WfPlayerEvents *events, WfSong *song, gint64 duration)
 {
@@ -724,6 +1470,34 @@ wf_player_message_error(GstMessage *msg)
 
 	g_return_if_fail(GST_IS_MESSAGE(msg));
 
+	if (wf_player_branch_owns_object(PlayerData.standby, GST_MESSAGE_SRC(msg)))
+	{
+		/*
+		 * Only the upcoming song failed, which does not affect the current
+		 * one.  It will be opened the usual way when it is its turn.
+		 */
+		gst_message_parse_error(msg, &error, NULL /* debug */);
+		g_message("Could not prepare the next song: %s", (error != NULL) ? error->message : "unknown error");
+		g_clear_error(&error);
+
+		PlayerData.standby_failed = PlayerData.standby->song;
+		wf_player_standby_clear();
+
+		return;
+	}
+
+	if (PlayerData.warm)
+	{
+		// Nothing is playing yet; the song is opened the usual way when played
+		gst_message_parse_error(msg, &error, NULL /* debug */);
+		g_message("Could not preroll the upcoming song: %s", (error != NULL) ? error->message : "unknown error");
+		g_clear_error(&error);
+
+		wf_player_warm_up_clear(TRUE);
+
+		return;
+	}
+
 	song = PlayerData.song;
 
 	// Update statistics, even though they might not be accurate
@@ -851,6 +1625,9 @@ wf_player_message_state_changed(GstMessage *msg)
 		return;
 	}
 
+	// The clock no longer runs along with the position
+	wf_player_position_invalidate();
+
 	switch (newstate)
 	{
 		case GST_STATE_VOID_PENDING:
@@ -876,13 +1653,66 @@ static void
 wf_player_message_async_done(GstMessage *msg)
 {
 	g_info("Asynchronous state change done");
+
+	// After prerolling or seeking, the duration and position are known
+	wf_player_position_invalidate();
+	wf_player_pipeline_get_duration();
+
+	if (PlayerData.seeking)
+	{
+		PlayerData.seeking = FALSE;
+
+		// Continue with the last request that came in meanwhile
+		if (PlayerData.seek_pending >= 0)
+		{
+			wf_player_pipeline_seek(PlayerData.seek_pending);
+		}
+		else
+		{
+			// Scrubbing is over; the position reported is where playback continues
+			wf_mpris_player_seeked(wf_player_pipeline_get_position() / GST_USECOND);
+		}
+	}
 }
 
 static void
 wf_player_message_stream_start(GstMessage *msg)
+{
+	gboolean gapless = FALSE;
+
+	if (PlayerData.warm)
+	{
+		// Prerolled in advance, this is reported once the song gets played
+		PlayerData.warm_started = TRUE;
+
+		return;
+	}
+
+	if (PlayerData.standby != NULL && wf_player_branch_is_active(PlayerData.standby))
+	{
+		// The previous song has ended and the prepared one took over
+		wf_player_standby_advance();
+		gapless = TRUE;
+	}
+
+	wf_player_stream_started(gapless);
+}
+
+// The current song has started; if @gapless, the previous one led right into it
+static void
+wf_player_stream_started(gboolean gapless)
 {
 	g_info("Player started playback");
 
+	if (PlayerData.opened != 0)
+	{
+		wf_metrics_stop(WF_METRIC_TRACK_CHANGE, PlayerData.opened);
+		PlayerData.opened = 0;
+	}
+
+	// The position starts again for this song
+	wf_player_position_invalidate();
+
 	// Just started playing, so change state
 	PlayerData.status = WF_PLAYER_PLAYING;
 
@@ -904,6 +1734,15 @@ wf_player_message_stream_start(GstMessage *msg)
 
 	// Set up an event interval to update the front-end
 	wf_player_update_event_update();
+
+	if (gapless)
+	{
+		// The pipeline stays in the playing state, so report it here
+		wf_player_state_playing();
+	}
+
+	// Prepare whatever comes next
+	wf_player_standby_update();
 }
 
 static void
@@ -1050,79 +1889,1127 @@ wf_player_report_playing(void)
 	wf_player_emit_report_msg(&PlayerData.events, msg);
 }
 
-static void
-wf_player_pipeline_add_source(GstElement *element)
+// Create the source and decoder for @song and add them to the pipeline
+static WfPlayerBranch *
+wf_player_branch_new(WfSong *song)
 {
-	if (PlayerData.source != NULL)
+	WfPlayerBranch *branch;
+	GstElement *source;
+	GstElement *decoder;
+	gchar *scheme = NULL;
+
+	g_return_val_if_fail(WF_IS_SONG(song), NULL);
+
+	source = wf_player_pipeline_create_source(song, &scheme);
+
+	if (source == NULL)
 	{
-		// Unlink and remove the old source element (this will free it)
-		gst_element_set_state(PlayerData.source, GST_STATE_NULL);
-		gst_element_unlink(PlayerData.source, PlayerData.decoder);
-		gst_bin_remove(GST_BIN(PlayerData.pipeline), PlayerData.source);
+		return NULL;
 	}
 
-	// Now add and link the new element
-	gst_bin_add(GST_BIN(PlayerData.pipeline), element);
-	gst_element_link(element, PlayerData.decoder);
+	// Decoders in the NULL state have no state of their own left, so any will do
+	decoder = wf_player_cache_take_decoder();
 
-	PlayerData.source = element;
+	if (decoder == NULL)
+	{
+		decoder = gst_element_factory_make("decodebin", NULL /* name */);
+
+		if (decoder != NULL)
+		{
+			gst_object_ref_sink(decoder);
+		}
+	}
+
+	if (decoder == NULL)
+	{
+		g_warning("Could not create a decoder");
+		wf_player_cache_put(scheme, source, NULL /* decoder */);
+		g_free(scheme);
+
+		return NULL;
+	}
+
+	branch = g_slice_new0(WfPlayerBranch);
+	branch->song = g_object_ref(song);
+	branch->source = source;
+	branch->decoder = decoder;
+	branch->scheme = scheme;
+
+	// Add elements to pipeline; from now on, the pipeline holds the references
+	gst_bin_add_many(GST_BIN(PlayerData.pipeline), source, decoder, NULL /* terminator */);
+	gst_object_unref(source);
+	gst_object_unref(decoder);
+
+	gst_element_link(source, decoder);
+
+	// Linking dynamic pads when they become available by the element
+	branch->pad_added_handler = g_signal_connect(decoder, "pad-added", G_CALLBACK(wf_player_pipeline_pad_added_cb), branch);
+
+	return branch;
 }
 
-static GstElement *
-wf_player_pipeline_memory_source_get(void)
+// %TRUE if concat is passing on the data of @branch (never while crossfading)
+static gboolean
+wf_player_branch_is_active(WfPlayerBranch *branch)
 {
-	GstElement *element = PlayerData.source;
-	GstElementFactory *factory = PlayerData.giostreamfactory;
-	GstElementFactory *element_factory;
+	GstPad *active = NULL;
+	gboolean result;
 
-	if (factory == NULL)
+	g_object_get(PlayerData.concat, "active-pad", &active, NULL /* terminator */);
+
+	g_mutex_lock(&PlayerData.branch_mutex);
+	result = (active != NULL && active == branch->pad);
+	g_mutex_unlock(&PlayerData.branch_mutex);
+
+	if (active != NULL)
 	{
-		factory = PlayerData.giostreamfactory = gst_element_factory_find("giostreamsrc");
+		gst_object_unref(active);
 	}
 
-	if (element != NULL)
-	{
-		element_factory = gst_element_get_factory(element);
+	return result;
+}
 
-		if (factory == element_factory) // Compare pointer
-		{
-			// Re-use element
-			return element;
-		}
+// %TRUE if @object is one of the elements of @branch or part of them
+static gboolean
+wf_player_branch_owns_object(WfPlayerBranch *branch, GstObject *object)
+{
+	if (branch == NULL || object == NULL)
+	{
+		return FALSE;
 	}
 
-	// Otherwise create a new one
-	return gst_element_factory_create(factory, NULL /* name */);
+	return (object == GST_OBJECT(branch->source) ||
+	        object == GST_OBJECT(branch->decoder) ||
+	        gst_object_has_as_ancestor(object, GST_OBJECT(branch->source)) ||
+	        gst_object_has_as_ancestor(object, GST_OBJECT(branch->decoder)));
 }
 
+// Ask the decoder of @branch for the duration of its song
 static gboolean
-wf_player_pipeline_memory_source_set_file(GstElement *source, GFile *file)
+wf_player_branch_query_duration(WfPlayerBranch *branch, GstQuery *query)
 {
-	GInputStream *input_stream;
-	gchar *content = NULL;
-	gsize length = 0;
-	GError *error = NULL;
+	GstPad *pad = NULL;
+	gboolean res;
 
-	// Read file
-	if (!g_file_load_contents(file, NULL /* GCancellable */, &content, &length, NULL /* etag_out */, &error))
+	if (branch == NULL)
 	{
-		g_warning("Failed to get content from file: %s", error->message);
+		return FALSE;
+	}
+
+	g_mutex_lock(&PlayerData.branch_mutex);
+
+	if (branch->pad != NULL)
+	{
+		pad = gst_object_ref(branch->pad);
+	}
+
+	g_mutex_unlock(&PlayerData.branch_mutex);
+
+	if (pad == NULL)
+	{
+		return FALSE;
+	}
+
+	res = gst_pad_peer_query(pad, query);
+	gst_object_unref(pad);
+
+	return res;
+}
+
+// The song that will be played after the current one, if nothing changes
+static WfSong *
+wf_player_get_upcoming_song(void)
+{
+	WfSong *song;
+
+	song = wf_song_manager_get_queue_song();
+
+	if (song == NULL)
+	{
+		song = wf_song_manager_get_next_song();
+	}
+
+	return song;
+}
+
+/*
+ * Make sure the standby branch matches the song that is up next: create it if
+ * gapless playback is possible, or drop it if it is no longer needed.
+ */
+static void
+wf_player_standby_update(void)
+{
+	WfSong *song = NULL;
+
+	if (PlayerData.pipeline != NULL &&
+	    PlayerData.song != NULL &&
+	    wf_player_is_active() &&
+	    !wf_song_get_stop_flag(PlayerData.song) &&
+	    wf_settings_static_get_bool(WF_SETTING_GAPLESS_PLAYBACK))
+	{
+		song = wf_player_get_upcoming_song();
+	}
+
+	if (PlayerData.standby != NULL && PlayerData.standby->song == song)
+	{
+		// Still up-to-date
+		return;
+	}
+
+	wf_player_standby_clear();
+
+	if (song == NULL || song == PlayerData.standby_failed)
+	{
+		return;
+	}
+
+	PlayerData.standby = wf_player_branch_new(song);
+
+	if (PlayerData.standby != NULL)
+	{
+		g_debug("Preparing the next song for gapless playback");
+
+		// Not linked to the mixer before the crossfade, as the mixer would play it right away
+		PlayerData.standby->held = PlayerData.crossfade;
+
+		// Preroll; concat holds the data back until the current song ends
+		gst_element_sync_state_with_parent(PlayerData.standby->decoder);
+		gst_element_sync_state_with_parent(PlayerData.standby->source);
+
+		wf_player_crossfade_schedule();
+	}
+}
+
+// Make the standby branch the current one, after concat has switched to it
+static void
+wf_player_standby_advance(void)
+{
+	WfPlayerBranch *finished = PlayerData.branch;
+	WfSong *song = PlayerData.standby->song;
+
+	g_info("Continuing with the next song without a gap");
+
+	// The change is done once the new song is reported as started
+	PlayerData.opened = wf_metrics_start();
+
+	if (PlayerData.song != NULL)
+	{
+		// It has been played until the very end
+		wf_song_manager_add_played_song(PlayerData.song, 1.0, FALSE);
+		wf_song_set_status(PlayerData.song, WF_SONG_AVAILABLE);
+	}
+
+	// Take the song out of the list it came from, like wf_player_play_next_song()
+	if (song == wf_song_manager_get_queue_song())
+	{
+		wf_song_manager_rm_queue_song(song);
+	}
+	else if (song == wf_song_manager_get_next_song())
+	{
+		wf_song_manager_rm_next_song(song);
+	}
+
+	PlayerData.branch = PlayerData.standby;
+	PlayerData.standby = NULL;
+	PlayerData.standby_failed = NULL;
+
+	PlayerData.song = song;
+	PlayerData.duration = GST_CLOCK_TIME_NONE;
+	PlayerData.play_msg = "Going forward";
+
+	// Its data has been passed on completely, so it can go
+	wf_player_branch_free(finished);
+}
+
+static void
+wf_player_standby_clear(void)
+{
+	wf_player_branch_free(PlayerData.standby);
+	PlayerData.standby = NULL;
+}
+
+// Check regularly whether to start the crossfade, while the standby branch is held
+static void
+wf_player_crossfade_schedule(void)
+{
+	if (PlayerData.crossfade_check == 0 &&
+	    PlayerData.standby != NULL &&
+	    PlayerData.standby->held)
+	{
+		PlayerData.crossfade_check = g_timeout_add(CROSSFADE_CHECK_INTERVAL, wf_player_crossfade_check_cb, NULL /* data */);
+	}
+}
+
+/*
+ * Link the held standby branch to the mixer and fade over to it, in the
+ * @remaining time of the current song.  The standby branch becomes the current
+ * one right away.  Returns %FALSE if the standby branch has not prerolled yet.
+ */
+static gboolean
+wf_player_crossfade_start(gint64 remaining)
+{
+	WfPlayerBranch *branch = PlayerData.standby;
+	WfPlayerFade *fade;
+	GstEvent *event;
+	GstPad *mixer_src;
+	GstPad *decoded;
+	GstPad *pad = NULL;
+	GstPad *previous = NULL;
+	const GstSegment *segment;
+	gint64 position = 0;
+	gint64 running_time = 0;
+
+	g_return_val_if_fail(branch != NULL && branch->held, FALSE);
+
+	g_mutex_lock(&PlayerData.branch_mutex);
+	decoded = branch->decoded;
+
+	if (decoded != NULL)
+	{
+		branch->decoded = NULL;
+		branch->held = FALSE;
+		pad = branch->pad = gst_element_request_pad_simple(PlayerData.mixer, "sink_%u");
+	}
+
+	if (PlayerData.branch != NULL && PlayerData.branch->pad != NULL)
+	{
+		previous = gst_object_ref(PlayerData.branch->pad);
+	}
+
+	g_mutex_unlock(&PlayerData.branch_mutex);
+
+	if (decoded == NULL)
+	{
+		g_clear_pointer(&previous, gst_object_unref);
+
+		return FALSE;
+	}
+
+	// Start the new song at the running time the mixer has reached
+	gst_element_query_position(PlayerData.pipeline, GST_FORMAT_TIME, &position);
+	mixer_src = gst_element_get_static_pad(PlayerData.mixer, "src");
+	event = gst_pad_get_sticky_event(mixer_src, GST_EVENT_SEGMENT, 0 /* idx */);
+
+	if (event != NULL)
+	{
+		gst_event_parse_segment(event, &segment);
+		running_time = gst_segment_to_running_time(segment, GST_FORMAT_TIME, position);
+		gst_event_unref(event);
+	}
+
+	gst_object_unref(mixer_src);
+
+	g_info("Crossfading to the next song");
+
+	if (running_time > 0)
+	{
+		gst_pad_set_offset(pad, running_time);
+	}
+
+	g_object_set(pad, "volume", 0.0, NULL /* terminator */);
+
+	fade = g_slice_new(WfPlayerFade);
+	fade->length = remaining;
+	fade->start = GST_CLOCK_TIME_NONE;
+	fade->in = TRUE;
+	branch->fade_probe = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, wf_player_crossfade_ramp_cb, fade, wf_player_fade_free);
+
+	if (previous != NULL)
+	{
+		fade = g_slice_new(WfPlayerFade);
+		fade->length = remaining;
+		fade->start = GST_CLOCK_TIME_NONE;
+		fade->in = FALSE;
+		gst_pad_add_probe(previous, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, wf_player_crossfade_ramp_cb, fade, wf_player_fade_free);
+		gst_object_unref(previous);
+	}
+
+	if (gst_pad_link(decoded, pad) != GST_PAD_LINK_OK)
+	{
+		g_warning("Could not link the decoded stream");
+	}
+
+	// Let the prerolled data flow
+	gst_pad_remove_probe(decoded, branch->block_probe);
+	branch->block_probe = 0;
+	gst_object_unref(decoded);
+
+	// A fade still going on is cut short
+	wf_player_branch_free(PlayerData.fading);
+
+	// Keep the current branch until it ended, it is not freed when advancing
+	PlayerData.fading = PlayerData.branch;
+	PlayerData.branch = NULL;
+	PlayerData.branch_base = position;
+
+	wf_player_standby_advance();
+	wf_player_stream_started(TRUE);
+
+	return TRUE;
+}
+
+// Stop any crossfade, which leaves the current branch playing alone at full volume
+static void
+wf_player_crossfade_finish(void)
+{
+	GstPad *pad = NULL;
+
+	wf_player_branch_free(PlayerData.fading);
+	PlayerData.fading = NULL;
+	PlayerData.branch_base = 0;
+
+	if (PlayerData.branch == NULL)
+	{
+		return;
+	}
+
+	g_mutex_lock(&PlayerData.branch_mutex);
+
+	if (PlayerData.branch->pad != NULL)
+	{
+		pad = gst_object_ref(PlayerData.branch->pad);
+	}
+
+	g_mutex_unlock(&PlayerData.branch_mutex);
+
+	if (pad == NULL)
+	{
+		return;
+	}
+
+	if (PlayerData.branch->fade_probe != 0)
+	{
+		gst_pad_remove_probe(pad, PlayerData.branch->fade_probe);
+		PlayerData.branch->fade_probe = 0;
+
+		g_object_set(pad, "volume", 1.0, NULL /* terminator */);
+	}
+
+	// After a flushing seek, the running time of the branch and the mixer start over together
+	gst_pad_set_offset(pad, 0);
+	gst_object_unref(pad);
+}
+
+// Preroll the upcoming song while the main loop is idle, until something is played
+static void
+wf_player_warm_up_schedule(void)
+{
+	if (PlayerData.pipeline == NULL ||
+	    PlayerData.status != WF_PLAYER_INIT ||
+	    PlayerData.warm_up_id > 0 ||
+	    !wf_settings_static_get_bool(WF_SETTING_WARM_UP_PIPELINE))
+	{
+		return;
+	}
+
+	PlayerData.warm_up_id = g_idle_add_full(G_PRIORITY_LOW, wf_player_warm_up_cb, NULL /* user_data */, NULL /* notify */);
+}
+
+/*
+ * Open the upcoming song paused, without making it the current song.  This
+ * loads the plugins, resolves the element factories and sets up the sink
+ * before the first play, which then only has to set the pipeline to playing.
+ */
+static gboolean
+wf_player_warm_up_cb(gpointer user_data)
+{
+	GstElement *source;
+	WfSong *song;
+
+	PlayerData.warm_up_id = 0;
+
+	// Never replace a song that has been opened for real
+	if (PlayerData.pipeline == NULL ||
+	    PlayerData.status != WF_PLAYER_INIT ||
+	    (PlayerData.branch != NULL && !PlayerData.warm))
+	{
+		return G_SOURCE_REMOVE;
+	}
+
+	song = wf_player_get_upcoming_song();
+
+	if (PlayerData.warm && PlayerData.branch->song == song)
+	{
+		// Still up-to-date
+		return G_SOURCE_REMOVE;
+	}
+
+	wf_player_warm_up_clear(TRUE);
+
+	if (song == NULL)
+	{
+		// Nothing to preroll, but the memory source can already be looked up
+		if (wf_settings_static_get_bool(WF_SETTING_PREFER_PLAY_FROM_RAM) && PlayerData.spare_stream_source == NULL)
+		{
+			source = wf_player_pipeline_memory_source_get();
+			wf_player_cache_put(NULL /* scheme */, source, NULL /* decoder */);
+		}
+
+		return G_SOURCE_REMOVE;
+	}
+
+	wf_player_pipeline_update_mixer();
+	wf_player_pipeline_update_processing();
+
+	PlayerData.branch = wf_player_branch_new(song);
+
+	if (PlayerData.branch == NULL)
+	{
+		return G_SOURCE_REMOVE;
+	}
+
+	g_debug("Prerolling the upcoming song in advance");
+
+	PlayerData.warm = TRUE;
+
+	wf_player_pipeline_update_volume();
+	gst_element_set_state(PlayerData.pipeline, GST_STATE_PAUSED);
+
+	return G_SOURCE_REMOVE;
+}
+
+/*
+ * Make the branch of the warm-up the current one if it is the one of @song,
+ * which leaves nothing to do but to start playing.  Otherwise the warm-up is
+ * over and the song has to be opened the usual way.
+ */
+static gboolean
+wf_player_warm_up_adopt(WfSong *song)
+{
+	gboolean adopt = (PlayerData.warm && PlayerData.branch->song == song);
+	gboolean started = PlayerData.warm_started;
+
+	wf_player_warm_up_clear(FALSE);
+
+	if (!adopt)
+	{
+		return FALSE;
+	}
+
+	g_debug("Using the song prerolled in advance");
+
+	PlayerData.song = song;
+	PlayerData.duration = GST_CLOCK_TIME_NONE;
+
+	if (started)
+	{
+		// Report what was held back during the warm-up
+		wf_player_message_stream_start(NULL /* msg */);
+	}
+
+	return TRUE;
+}
+
+// Stop warming up and drop its branch if @drop, otherwise it is kept as it is
+static void
+wf_player_warm_up_clear(gboolean drop)
+{
+	if (PlayerData.warm_up_id > 0)
+	{
+		g_source_remove(PlayerData.warm_up_id);
+		PlayerData.warm_up_id = 0;
+	}
+
+	if (!PlayerData.warm)
+	{
+		return;
+	}
+
+	PlayerData.warm = FALSE;
+	PlayerData.warm_started = FALSE;
+
+	if (drop)
+	{
+		gst_element_set_state(PlayerData.pipeline, GST_STATE_READY);
+
+		wf_player_branch_free(PlayerData.branch);
+		PlayerData.branch = NULL;
+	}
+}
+
+/*
+ * Start reading the beginning of @song at a low priority, so opening it later
+ * does not have to wait for a slow disk or network share.  A read-ahead of
+ * another song is cancelled.
+ *
+ * When playing from RAM, the song is loaded into the RAM cache as well: local
+ * files are mapped right away and their beginning is read, others are read
+ * completely.
+ */
+static void
+wf_player_prefetch_update(WfSong *song)
+{
+	WfPlayerPrefetch *prefetch;
+	GBytes *bytes;
+	GFile *file;
+	gboolean ram;
+	gchar *uri;
+
+	if ((PlayerData.prefetch != NULL && PlayerData.prefetch->song == song) ||
+	    (PlayerData.prefetch == NULL && PlayerData.prefetched == song && song != NULL))
+	{
+		// Already in progress or done
+		return;
+	}
+
+	wf_player_prefetch_cancel();
+	PlayerData.prefetched = NULL;
+
+	if (song == NULL)
+	{
+		return;
+	}
+
+	ram = wf_settings_static_get_bool(WF_SETTING_PREFER_PLAY_FROM_RAM) && wf_player_ram_cache_get_budget() > 0;
+
+	if (ram && (bytes = wf_player_ram_cache_lookup(song)) != NULL)
+	{
+		// Already in memory
+		g_bytes_unref(bytes);
+		PlayerData.prefetched = song;
+
+		return;
+	}
+
+	uri = wf_song_get_uri(song);
+
+	if (uri == NULL)
+	{
+		return;
+	}
+
+	file = g_file_new_for_uri(uri);
+
+	if (ram)
+	{
+		// Mapping is cheap and the kernel reads the pages in the background
+		bytes = wf_player_pipeline_memory_map_file(file);
+
+		if (bytes != NULL)
+		{
+			wf_player_ram_cache_insert(song, bytes);
+			g_bytes_unref(bytes);
+
+			// The read-ahead of the kernel is only a hint, so still read the start now
+			ram = FALSE;
+		}
+	}
+
+	prefetch = g_slice_new0(WfPlayerPrefetch);
+	prefetch->song = g_object_ref(song);
+	prefetch->cancellable = g_cancellable_new();
+	prefetch->content = ram ? g_byte_array_new() : NULL;
+
+	PlayerData.prefetch = prefetch;
+
+	g_file_read_async(file, G_PRIORITY_LOW, prefetch->cancellable, wf_player_prefetch_open_cb, prefetch);
+
+	g_object_unref(file);
+	g_free(uri);
+}
+
+static void
+wf_player_prefetch_cancel(void)
+{
+	if (PlayerData.prefetch == NULL)
+	{
+		return;
+	}
+
+	// It will be freed once the pending operation returns
+	g_cancellable_cancel(PlayerData.prefetch->cancellable);
+	PlayerData.prefetch = NULL;
+}
+
+static void
+wf_player_prefetch_read(WfPlayerPrefetch *prefetch)
+{
+	g_input_stream_read_bytes_async(prefetch->stream, PREFETCH_CHUNK_SIZE, G_PRIORITY_LOW,
+	                                prefetch->cancellable, wf_player_prefetch_read_cb, prefetch);
+}
+
+/*
+ * Create an element that reads the data of @song, or reuse one that read an
+ * earlier song.  The returned element is not floating.  @scheme_rv is set to
+ * the URI scheme it handles, or %NULL if it reads from memory.
+ */
+static GstElement *
+wf_player_pipeline_create_source(WfSong *song, gchar **scheme_rv)
+{
+	const gchar *msg;
+	GstElement *source = NULL;
+	GError *error = NULL;
+	gchar *scheme;
+	gchar *uri;
+
+	*scheme_rv = NULL;
+
+	uri = wf_song_get_uri(song);
+
+	if (wf_settings_static_get_bool(WF_SETTING_PREFER_PLAY_FROM_RAM)) // If %TRUE
+	{
+		// Get an element that reads from memory
+		source = wf_player_pipeline_memory_source_get();
+
+		// Read the full file content and set the source stream
+		if (source != NULL && !wf_player_pipeline_memory_source_set_song(source, song))
+		{
+			// Fall back to reading the file directly
+			wf_player_cache_put(NULL /* scheme */, source, NULL /* decoder */);
+			source = NULL;
+		}
+
+		if (source != NULL)
+		{
+			g_free(uri);
+
+			return source;
+		}
+	}
+
+	scheme = g_uri_parse_scheme(uri);
+
+	// Only the location has to be changed for an element of the same scheme
+	source = wf_player_cache_take_source(scheme);
+
+	if (source != NULL && !gst_uri_handler_set_uri(GST_URI_HANDLER(source), uri, NULL /* error */))
+	{
+		gst_object_unref(source);
+		source = NULL;
+	}
+
+	if (source == NULL)
+	{
+		// Create an element for this URI
+		source = gst_element_make_from_uri(GST_URI_SRC, uri, NULL /* element name */, &error);
+
+		if (source != NULL)
+		{
+			gst_object_ref_sink(source);
+		}
+	}
+
+	if (source == NULL || error != NULL)
+	{
+		msg = (error != NULL && error->message != NULL) ? error->message : "Could not create source element";
+		g_warning("Failed to create source for %s: %s", uri, msg);
+		g_clear_error(&error);
+
+		if (source != NULL)
+		{
+			gst_object_unref(source);
+		}
+
+		source = NULL;
+	}
+
+	if (source != NULL)
+	{
+		*scheme_rv = scheme;
+	}
+	else
+	{
+		g_free(scheme);
+	}
+
+	g_free(uri);
+
+	return source;
+}
+
+static GstElement *
+wf_player_pipeline_memory_source_get(void)
+{
+	GstElementFactory *factory = PlayerData.giostreamfactory;
+	GstElement *element;
+
+	if (factory == NULL)
+	{
+		factory = PlayerData.giostreamfactory = gst_element_factory_find("giostreamsrc");
+	}
+
+	if (factory == NULL)
+	{
+		return NULL;
+	}
+
+	if (PlayerData.spare_stream_source != NULL)
+	{
+		element = PlayerData.spare_stream_source;
+		PlayerData.spare_stream_source = NULL;
+
+		return element;
+	}
+
+	// Every branch needs an element of its own
+	element = gst_element_factory_create(factory, NULL /* name */);
+
+	if (element != NULL)
+	{
+		gst_object_ref_sink(element);
+	}
+
+	return element;
+}
+
+// Take a source element of a freed branch that handles @scheme
+static GstElement *
+wf_player_cache_take_source(const gchar *scheme)
+{
+	GstElement *source = NULL;
+	gpointer key = NULL;
+
+	if (scheme == NULL || PlayerData.spare_sources == NULL)
+	{
+		return NULL;
+	}
+
+	if (g_hash_table_lookup_extended(PlayerData.spare_sources, scheme, &key, (gpointer *) &source))
+	{
+		// Transfer the reference to the caller
+		g_hash_table_steal(PlayerData.spare_sources, scheme);
+		g_free(key);
+	}
+
+	return source;
+}
+
+static GstElement *
+wf_player_cache_take_decoder(void)
+{
+	return g_queue_pop_head(&PlayerData.spare_decoders);
+}
+
+/*
+ * Keep the elements of a branch that are no longer needed, which must be in
+ * the NULL state and outside of the pipeline.  This takes the references of
+ * @source and @decoder, which can be %NULL.
+ */
+static void
+wf_player_cache_put(const gchar *scheme, GstElement *source, GstElement *decoder)
+{
+	if (decoder != NULL)
+	{
+		if (g_queue_get_length(&PlayerData.spare_decoders) < SPARE_DECODERS)
+		{
+			g_queue_push_tail(&PlayerData.spare_decoders, decoder);
+		}
+		else
+		{
+			gst_object_unref(decoder);
+		}
+	}
+
+	if (source == NULL)
+	{
+		return;
+	}
+
+	if (scheme == NULL)
+	{
+		// Do not keep the data of the previous song in memory
+		g_object_set(source, "stream", NULL, NULL /* terminator */);
+
+		if (PlayerData.spare_stream_source == NULL)
+		{
+			PlayerData.spare_stream_source = source;
+		}
+		else
+		{
+			gst_object_unref(source);
+		}
+
+		return;
+	}
+
+	if (PlayerData.spare_sources == NULL)
+	{
+		PlayerData.spare_sources = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, gst_object_unref);
+	}
+
+	if (g_hash_table_contains(PlayerData.spare_sources, scheme))
+	{
+		gst_object_unref(source);
+	}
+	else
+	{
+		g_hash_table_insert(PlayerData.spare_sources, g_strdup(scheme), source);
+	}
+}
+
+// Let @source read the content of @song from memory, taken from the RAM cache if it is in there
+static gboolean
+wf_player_pipeline_memory_source_set_song(GstElement *source, WfSong *song)
+{
+	GInputStream *input_stream;
+	GBytes *bytes;
+	GFile *file;
+	bytes = wf_player_ram_cache_lookup(song);
+
+	if (bytes == NULL)
+	{
+		file = wf_song_dup_file(song);
+		bytes = wf_player_pipeline_memory_load_file(file);
+		g_object_unref(file);
+
+		if (bytes == NULL)
+		{
+			return FALSE;
+		}
+
+		// Keep it, so playing it again or going back does not read it again
+		wf_player_ram_cache_insert(song, bytes);
+	}
+
+	// Create an input stream and set it as the element source
+	input_stream = g_memory_input_stream_new_from_bytes(bytes);
+	g_bytes_unref(bytes);
+
+	g_object_set(source, "stream", G_INPUT_STREAM(input_stream), NULL /* terminator */);
+
+	g_object_unref(input_stream);
+
+	return TRUE;
+}
+
+// Get the complete content of @file, mapped for local files
+static GBytes *
+wf_player_pipeline_memory_load_file(GFile *file)
+{
+	GBytes *bytes;
+	gchar *content = NULL;
+	gsize length = 0;
+	GError *error = NULL;
+
+	// Local files are mapped, so playback can start before everything is read
+	bytes = wf_player_pipeline_memory_map_file(file);
+
+	if (bytes != NULL)
+	{
+		return bytes;
+	}
+
+	// Read file
+	if (!g_file_load_contents(file, NULL /* GCancellable */, &content, &length, NULL /* etag_out */, &error))
+	{
+		g_warning("Failed to get content from file: %s", error->message);
+
+		g_error_free(error);
+
+		return NULL;
+	}
+
+	return g_bytes_new_take(content, length);
+}
+
+/*
+ * Map the content of a local file into memory.  The pages are shared with the
+ * page cache of the kernel, so no copy of the file is made and the data is
+ * read when it is needed, or in advance by the kernel.
+ */
+static GBytes *
+wf_player_pipeline_memory_map_file(GFile *file)
+{
+	GMappedFile *mapped;
+	GBytes *bytes;
+	GError *error = NULL;
+	gchar *path;
+
+	path = g_file_get_path(file);
+
+	if (path == NULL)
+	{
+		// Not a local file
+		return NULL;
+	}
+
+	mapped = g_mapped_file_new(path, FALSE /* writable */, &error);
+	g_free(path);
+
+	if (mapped == NULL)
+	{
+		g_info("Failed to map file: %s", error->message);
+		g_error_free(error);
+
+		return NULL;
+	}
+
+#ifdef G_OS_UNIX
+	if (g_mapped_file_get_length(mapped) > 0)
+	{
+		/*
+		 * The file is read from start to end, so let the kernel read ahead
+		 * in the background.  This is only a hint; failure is harmless.
+		 */
+		posix_madvise(g_mapped_file_get_contents(mapped), g_mapped_file_get_length(mapped),
+		              POSIX_MADV_SEQUENTIAL);
+		posix_madvise(g_mapped_file_get_contents(mapped), g_mapped_file_get_length(mapped),
+		              POSIX_MADV_WILLNEED);
+	}
+#endif
+
+	// The bytes keep the mapping alive for as long as the stream uses it
+	bytes = g_mapped_file_get_bytes(mapped);
+	g_mapped_file_unref(mapped);
+
+	return bytes;
+}
+
+// Number of bytes the RAM cache may hold, 0 if disabled
+static gsize
+wf_player_ram_cache_get_budget(void)
+{
+	guint64 budget;
+
+	// The setting is in MiB, which does not fit in a #gsize on 32-bit systems
+	budget = (guint64) MAX(wf_settings_static_get_int(WF_SETTING_RAM_CACHE_SIZE), 0) * 1024 * 1024;
+
+	return (gsize) MIN(budget, G_MAXSIZE);
+}
+
+/*
+ * Check whether the file of the cached content was changed after it was
+ * cached.  Mapped content of a file that was truncated would even crash the
+ * player once read.
+ */
+static gboolean
+wf_player_ram_cache_is_stale(WfPlayerRamEntry *entry, WfSong *song)
+{
+	GStatBuf info;
+
+	if (entry->path == NULL)
+	{
+		return (wf_song_get_modified(song) != entry->modified);
+	}
+
+	if (g_stat(entry->path, &info) != 0)
+	{
+		return TRUE;
+	}
+
+	return ((guint64) info.st_size != g_bytes_get_size(entry->bytes) || (gint64) info.st_mtime != entry->mtime);
+}
+
+// Get a new reference to the cached content of @song and mark it as used, or %NULL
+static GBytes *
+wf_player_ram_cache_lookup(WfSong *song)
+{
+	WfPlayerRamEntry *entry;
+	GList *link;
+
+	if (PlayerData.ram_cache == NULL)
+	{
+		return NULL;
+	}
+
+	link = g_hash_table_lookup(PlayerData.ram_cache, GUINT_TO_POINTER(wf_song_get_hash(song)));
+
+	if (link == NULL)
+	{
+		return NULL;
+	}
+
+	if (wf_player_ram_cache_is_stale(link->data, song))
+	{
+		g_debug("Dropping the cached content of a changed file");
+		wf_player_ram_cache_remove(link);
+
+		return NULL;
+	}
+
+	// Most recently used
+	g_queue_unlink(&PlayerData.ram_cache_order, link);
+	g_queue_push_head_link(&PlayerData.ram_cache_order, link);
+
+	entry = link->data;
+
+	return g_bytes_ref(entry->bytes);
+}
+
+/*
+ * Keep @bytes as the content of @song, evicting the least recently used songs
+ * until everything fits within the budget.  Content that is larger than the
+ * budget by itself is not kept.
+ */
+static void
+wf_player_ram_cache_insert(WfSong *song, GBytes *bytes)
+{
+	WfPlayerRamEntry *entry;
+	GStatBuf info;
+	GList *link;
+	GFile *file;
+	guint32 hash = wf_song_get_hash(song);
+	gsize budget = wf_player_ram_cache_get_budget();
+	gsize size = g_bytes_get_size(bytes);
+
+	if (size > budget)
+	{
+		return;
+	}
+
+	if (PlayerData.ram_cache == NULL)
+	{
+		PlayerData.ram_cache = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+#if GLIB_CHECK_VERSION(2, 64, 0)
+		// Give the memory back when the system runs low
+		PlayerData.memory_monitor = g_memory_monitor_dup_default();
+		PlayerData.memory_warning_handler = g_signal_connect(PlayerData.memory_monitor, "low-memory-warning",
+		                                                     G_CALLBACK(wf_player_ram_cache_memory_warning_cb), NULL /* user_data */);
+#endif
+	}
+
+	link = g_hash_table_lookup(PlayerData.ram_cache, GUINT_TO_POINTER(hash));
+
+	if (link != NULL)
+	{
+		// Replace the old content
+		wf_player_ram_cache_remove(link);
+	}
+
+	wf_player_ram_cache_trim(budget - size);
+
+	entry = g_slice_new0(WfPlayerRamEntry);
+	entry->hash = hash;
+	entry->bytes = g_bytes_ref(bytes);
+	entry->modified = wf_song_get_modified(song);
 
-		g_error_free(error);
+	file = wf_song_dup_file(song);
+	entry->path = g_file_get_path(file);
+	g_object_unref(file);
 
-		return FALSE;
-	}
-	else
+	if (entry->path != NULL && g_stat(entry->path, &info) == 0)
 	{
-		// Create an input stream
-		input_stream = g_memory_input_stream_new_from_data(content, length, g_free);
+		entry->mtime = (gint64) info.st_mtime;
+	}
+
+	g_queue_push_head(&PlayerData.ram_cache_order, entry);
+	g_hash_table_insert(PlayerData.ram_cache, GUINT_TO_POINTER(hash), PlayerData.ram_cache_order.head);
+	PlayerData.ram_cache_size += size;
+}
+
+static void
+wf_player_ram_cache_remove(GList *link)
+{
+	WfPlayerRamEntry *entry = link->data;
 
-		// Set the input stream as the element source
-		g_object_set(source, "stream", G_INPUT_STREAM(input_stream), NULL /* terminator */);
+	g_hash_table_remove(PlayerData.ram_cache, GUINT_TO_POINTER(entry->hash));
+	g_queue_delete_link(&PlayerData.ram_cache_order, link);
+	PlayerData.ram_cache_size -= g_bytes_get_size(entry->bytes);
 
-		g_object_unref(input_stream);
+	// A stream that still reads it has its own reference
+	g_bytes_unref(entry->bytes);
+	g_free(entry->path);
+	g_slice_free(WfPlayerRamEntry, entry);
+}
 
-		return TRUE;
+// Evict the least recently used songs until at most @budget bytes are held
+static void
+wf_player_ram_cache_trim(gsize budget)
+{
+	while (PlayerData.ram_cache_size > budget && PlayerData.ram_cache_order.tail != NULL)
+	{
+		wf_player_ram_cache_remove(PlayerData.ram_cache_order.tail);
 	}
 }
 
@@ -1137,6 +3024,12 @@ wf_player_pipeline_open(WfSong *song)
 		return;
 	}
 
+	// The warm-up may have prerolled this song already
+	if (wf_player_warm_up_adopt(song))
+	{
+		return;
+	}
+
 	if (PlayerData.song != NULL)
 	{
 		// Do not stop in the future after this previous song, as a new one is forced to play
@@ -1147,9 +3040,19 @@ wf_player_pipeline_open(WfSong *song)
 
 	// If active, stop playback
 	gst_element_set_state(PlayerData.pipeline, GST_STATE_READY);
+	wf_player_pipeline_seek_reset();
+
+	// Now replace whatever was there by the new song
+	wf_player_standby_clear();
+	wf_player_crossfade_finish();
+	wf_player_branch_free(PlayerData.branch);
+	PlayerData.standby_failed = NULL;
 
-	// Now set the new song
-	wf_player_pipeline_set_song(song);
+	// With no data flowing, the mixer and processing can be relinked
+	wf_player_pipeline_update_mixer();
+	wf_player_pipeline_update_processing();
+
+	PlayerData.branch = wf_player_branch_new(song);
 
 	// Force set volume
 	wf_player_pipeline_update_volume();
@@ -1167,46 +3070,191 @@ wf_player_pipeline_open(WfSong *song)
 	 */
 }
 
+/*
+ * Create a bin that applies the ReplayGain tags that flow along with the
+ * decoded data.  The limiter prevents clipping if the gain is positive.  The
+ * converters are needed, as the ReplayGain elements only process floats.
+ */
+static GstElement *
+wf_player_pipeline_processing_new(void)
+{
+	GstElement *bin;
+	GstElement *convert_in, *rgvolume, *rglimiter, *convert_out;
+	GstPad *pad;
+
+	convert_in = gst_element_factory_make("audioconvert", NULL /* name */);
+	rgvolume = gst_element_factory_make("rgvolume", "rgvolume");
+	rglimiter = gst_element_factory_make("rglimiter", NULL /* name */);
+	convert_out = gst_element_factory_make("audioconvert", NULL /* name */);
+
+	if (convert_in == NULL || rgvolume == NULL || rglimiter == NULL || convert_out == NULL)
+	{
+		g_message("ReplayGain is not available, as one or more GStreamer elements are missing");
+
+		g_clear_pointer(&convert_in, gst_object_unref);
+		g_clear_pointer(&rgvolume, gst_object_unref);
+		g_clear_pointer(&rglimiter, gst_object_unref);
+		g_clear_pointer(&convert_out, gst_object_unref);
+
+		return NULL;
+	}
+
+	bin = gst_bin_new("processing");
+	gst_bin_add_many(GST_BIN(bin), convert_in, rgvolume, rglimiter, convert_out, NULL /* terminator */);
+
+	if (!gst_element_link_many(convert_in, rgvolume, rglimiter, convert_out, NULL /* terminator */))
+	{
+		g_warning("Could not link the audio processing elements");
+		gst_object_unref(bin);
+
+		return NULL;
+	}
+
+	// Expose the pads of the outer elements on the bin
+	pad = gst_element_get_static_pad(convert_in, "sink");
+	gst_element_add_pad(bin, gst_ghost_pad_new("sink", pad));
+	gst_object_unref(pad);
+
+	pad = gst_element_get_static_pad(convert_out, "src");
+	gst_element_add_pad(bin, gst_ghost_pad_new("src", pad));
+	gst_object_unref(pad);
+
+	PlayerData.rgvolume = rgvolume;
+
+	return bin;
+}
+
+/*
+ * Insert or remove the processing between concat (or the mixer) and the sink,
+ * depending on the settings.  Relinking is only done while the pipeline is not
+ * running.
+ */
 static void
-wf_player_pipeline_set_song(WfSong *song)
+wf_player_pipeline_update_processing(void)
 {
-	const gchar *uri;
-	const gchar *msg;
-	GFile *file;
-	GstElement *source = NULL;
-	GError *error = NULL;
+	GstElement *joiner = wf_player_pipeline_get_joiner();
+	WfReplayGainMode mode;
+	gboolean linked;
 
-	g_return_if_fail(WF_IS_SONG(song));
+	mode = wf_settings_static_get_enum(WF_SETTING_REPLAY_GAIN);
 
-	file = wf_song_get_file(song);
-	uri = wf_song_get_uri(song);
+	if (mode != WF_REPLAY_GAIN_OFF && PlayerData.processing == NULL && !PlayerData.processing_unavailable)
+	{
+		PlayerData.processing = wf_player_pipeline_processing_new();
 
-	if (wf_settings_static_get_bool(WF_SETTING_PREFER_PLAY_FROM_RAM)) // If %TRUE
+		if (PlayerData.processing == NULL)
+		{
+			// Do not try again every song
+			PlayerData.processing_unavailable = TRUE;
+		}
+		else
+		{
+			gst_element_unlink(joiner, PlayerData.sink);
+			gst_bin_add(GST_BIN(PlayerData.pipeline), PlayerData.processing);
+
+			linked = (gst_element_link(joiner, PlayerData.processing) &&
+			          gst_element_link_pads(PlayerData.processing, "src", PlayerData.sink, "audio_sink"));
+
+			if (!linked)
+			{
+				g_warning("Could not link the audio processing");
+			}
+
+			gst_element_sync_state_with_parent(PlayerData.processing);
+		}
+	}
+	else if (mode == WF_REPLAY_GAIN_OFF && PlayerData.processing != NULL)
 	{
-		// Create an element that reads from memory
-		source = wf_player_pipeline_memory_source_get();
+		gst_element_set_state(PlayerData.processing, GST_STATE_NULL);
 
-		// Read the full file content and set the source stream
-		wf_player_pipeline_memory_source_set_file(source, file);
+		// Removing from the pipeline unlinks and frees it
+		gst_bin_remove(GST_BIN(PlayerData.pipeline), PlayerData.processing);
+		PlayerData.processing = NULL;
+		PlayerData.rgvolume = NULL;
+
+		if (!gst_element_link_pads(joiner, "src", PlayerData.sink, "audio_sink"))
+		{
+			g_warning("Could not link the GStreamer elements");
+		}
 	}
 
-	if (source == NULL)
+	if (PlayerData.rgvolume != NULL)
 	{
-		// Create an element for this URI
-		source = gst_element_make_from_uri(GST_URI_SRC, uri, NULL /* element name */, &error);
+		g_object_set(PlayerData.rgvolume,
+		             "album-mode", (mode == WF_REPLAY_GAIN_ALBUM),
+		             "pre-amp", wf_settings_static_get_double(WF_SETTING_REPLAY_GAIN_PRE_AMP),
+		             NULL /* terminator */);
 	}
+}
 
-	if (source == NULL || error != NULL)
+// The element the branches are linked to
+static GstElement *
+wf_player_pipeline_get_joiner(void)
+{
+	return (PlayerData.crossfade) ? PlayerData.mixer : PlayerData.concat;
+}
+
+/*
+ * Use the mixer instead of concat if the songs should crossfade, which only
+ * is done for gapless playback.  Like the processing, this is only relinked
+ * while the pipeline is not running and no branches are linked.
+ */
+static void
+wf_player_pipeline_update_mixer(void)
+{
+	gboolean crossfade;
+	GstPad *src;
+	GstPad *peer;
+
+	crossfade = (wf_settings_static_get_double(WF_SETTING_CROSSFADE_DURATION) > 0.0 &&
+	             wf_settings_static_get_bool(WF_SETTING_GAPLESS_PLAYBACK));
+
+	if (crossfade && PlayerData.mixer == NULL && !PlayerData.mixer_unavailable)
 	{
-		msg = (error != NULL && error->message != NULL) ? error->message : "Could not create source element";
-		g_warning("Failed to create source for %s: %s", uri, msg);
-		g_clear_error(&error);
+		PlayerData.mixer = gst_element_factory_make("audiomixer", "mixer");
+
+		if (PlayerData.mixer == NULL)
+		{
+			g_message("Crossfading is not available, as the audiomixer GStreamer element is missing");
+
+			// Do not try again every song
+			PlayerData.mixer_unavailable = TRUE;
+		}
+		else
+		{
+			gst_bin_add(GST_BIN(PlayerData.pipeline), PlayerData.mixer);
+			gst_element_sync_state_with_parent(PlayerData.mixer);
+		}
+	}
 
+	crossfade = (crossfade && PlayerData.mixer != NULL);
+
+	if (crossfade == PlayerData.crossfade)
+	{
 		return;
 	}
 
-	// And add the element to the pipeline
-	wf_player_pipeline_add_source(source);
+	// Move the link to the processing or the sink over to the other element
+	src = gst_element_get_static_pad(wf_player_pipeline_get_joiner(), "src");
+	peer = gst_pad_get_peer(src);
+	PlayerData.crossfade = crossfade;
+
+	if (peer != NULL)
+	{
+		gst_pad_unlink(src, peer);
+		gst_object_unref(src);
+
+		src = gst_element_get_static_pad(wf_player_pipeline_get_joiner(), "src");
+
+		if (gst_pad_link(src, peer) != GST_PAD_LINK_OK)
+		{
+			g_warning("Could not link the GStreamer elements");
+		}
+
+		gst_object_unref(peer);
+	}
+
+	gst_object_unref(src);
 }
 
 static void
@@ -1281,6 +3329,12 @@ wf_player_pipeline_ready(void)
 	g_return_if_fail(PlayerData.pipeline != NULL);
 
 	gst_element_set_state(PlayerData.pipeline, GST_STATE_READY);
+	wf_player_pipeline_seek_reset();
+
+	// Nothing follows anymore
+	wf_player_standby_clear();
+	wf_player_crossfade_finish();
+	wf_player_warm_up_clear(FALSE);
 
 	if (PlayerData.song != NULL)
 	{
@@ -1304,19 +3358,63 @@ wf_player_pipeline_stop(void)
 	PlayerData.status = WF_PLAYER_STOPPED;
 }
 
+/*
+ * Seek to @position (in nanoseconds).  If a seek is still in flight, this
+ * seek is only remembered and done once that one completes, replacing any
+ * other seek remembered before.  So when scrubbing, the pipeline does not
+ * flush for every intermediate position.
+ */
 static void
-wf_player_pipeline_seek(gdouble position)
+wf_player_pipeline_seek(gint64 position)
 {
+	GstSeekFlags flags = GST_SEEK_FLAG_FLUSH;
+
 	g_return_if_fail(PlayerData.pipeline != NULL);
-	g_return_if_fail(position >= 0.0);
+	g_return_if_fail(position >= 0);
+
+	PlayerData.seek_target = position;
+
+	if (PlayerData.seeking)
+	{
+		PlayerData.seek_pending = position;
+
+		return;
+	}
+
+	if (wf_settings_static_get_bool(WF_SETTING_FAST_SEEK))
+	{
+		// Parsers can jump right there instead of scanning the file
+		flags |= GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_NEAREST;
+	}
+	else
+	{
+		flags |= GST_SEEK_FLAG_ACCURATE;
+	}
 
-	gst_element_seek_simple(PlayerData.pipeline, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT, position);
+	PlayerData.seek_pending = -1;
+
+	if (PlayerData.crossfade)
+	{
+		// Seeking the mixer seeks all of its pads, so the previous song cannot go on fading out
+		wf_player_crossfade_finish();
+	}
+
+	// Completes with an "async done" message
+	PlayerData.seeking = gst_element_seek_simple(PlayerData.pipeline, GST_FORMAT_TIME, flags, position);
+}
+
+// Forget about seeks in flight, as the pipeline no longer plays that song
+static void
+wf_player_pipeline_seek_reset(void)
+{
+	PlayerData.seeking = FALSE;
+	PlayerData.seek_pending = -1;
 }
 
 static gboolean
 wf_player_pipeline_has_data(void)
 {
-	return (PlayerData.pipeline != NULL && PlayerData.source != NULL);
+	return (PlayerData.pipeline != NULL && PlayerData.branch != NULL);
 }
 
 static gint64
@@ -1333,8 +3431,16 @@ wf_player_pipeline_get_duration(void)
 		return PlayerData.duration;
 	}
 
-	// First try the pipeline duration
-	res = gst_element_query(PlayerData.pipeline, PlayerData.query_duration);
+	if (PlayerData.crossfade)
+	{
+		// The mixer reports the longest of its pads, which may still include the previous song
+		res = wf_player_branch_query_duration(PlayerData.branch, PlayerData.query_duration);
+	}
+	else
+	{
+		// First try the pipeline duration
+		res = gst_element_query(PlayerData.pipeline, PlayerData.query_duration);
+	}
 
 	if (res)
 	{
@@ -1363,7 +3469,8 @@ wf_player_pipeline_get_position(void)
 
 	res = gst_element_query_position(PlayerData.pipeline, GST_FORMAT_TIME, &position);
 
-	return (res ? position : 0);
+	// When crossfading, the output of the mixer continues from the previous song
+	return (res ? MAX(position - PlayerData.branch_base, 0) : 0);
 }
 
 static void
@@ -1375,19 +3482,20 @@ wf_player_update_event_update(void)
 	 */
 
 	gboolean is_active;
-	gint interval;
+	guint interval;
 
 	is_active = wf_player_is_active();
-	interval = wf_settings_static_get_int(WF_SETTING_UPDATE_INTERVAL);
+	interval = wf_player_update_event_get_interval(wf_player_emit_position_wanted(&PlayerData.events));
 
 	if (interval > 0 && PlayerData.update_event == 0 && is_active)
 	{
-		PlayerData.update_event = g_timeout_add_full(G_PRIORITY_DEFAULT, interval, wf_player_update_event_run_cb, NULL /* data */, wf_player_update_event_rm_cb);
+		PlayerData.update_interval = interval;
+		PlayerData.update_event = g_timeout_add(interval, wf_player_update_event_run_cb, NULL /* data */);
 
 		// Because g_timeout_add will execute the callback after the interval, execute it here once
 		wf_player_update_event_run_cb(NULL /* data */);
 	}
-	else if (!is_active || (interval <= 0 && PlayerData.update_event != 0))
+	else if ((!is_active || interval == 0) && PlayerData.update_event != 0)
 	{
 		g_source_remove(PlayerData.update_event);
 
@@ -1395,6 +3503,72 @@ wf_player_update_event_update(void)
 	}
 }
 
+/*
+ * The interval to update the front-end at.  If nobody listens there is
+ * nothing to do, but the updates continue at a slow pace to notice when that
+ * changes.
+ */
+static guint
+wf_player_update_event_get_interval(gboolean wanted)
+{
+	gint interval;
+
+	interval = wf_settings_static_get_int(WF_SETTING_UPDATE_INTERVAL);
+
+	if (interval <= 0)
+	{
+		return 0;
+	}
+
+	return (wanted) ? (guint) interval : (guint) interval * UPDATE_INTERVAL_IDLE_FACTOR;
+}
+
+/*
+ * While playing, the position moves along with the pipeline clock, so it is
+ * calculated from the last queried position.  The pipeline is only queried
+ * again every POSITION_RESYNC_TIME, or after anything that makes the position
+ * jump, like seeking, pausing or a new song.
+ */
+static gint64
+wf_player_position_estimate(void)
+{
+	GstClock *clock;
+	GstClockTime now;
+
+	if (PlayerData.status != WF_PLAYER_PLAYING)
+	{
+		return wf_player_pipeline_get_position();
+	}
+
+	clock = gst_element_get_clock(PlayerData.pipeline);
+
+	if (clock == NULL)
+	{
+		return wf_player_pipeline_get_position();
+	}
+
+	now = gst_clock_get_time(clock);
+	gst_object_unref(clock);
+
+	if (GST_CLOCK_TIME_IS_VALID(PlayerData.position_clock) &&
+	    now >= PlayerData.position_clock &&
+	    now - PlayerData.position_clock < POSITION_RESYNC_TIME)
+	{
+		return PlayerData.position_base + (gint64) (now - PlayerData.position_clock);
+	}
+
+	PlayerData.position_base = wf_player_pipeline_get_position();
+	PlayerData.position_clock = now;
+
+	return PlayerData.position_base;
+}
+
+static void
+wf_player_position_invalidate(void)
+{
+	PlayerData.position_clock = GST_CLOCK_TIME_NONE;
+}
+
 static gdouble
 wf_player_get_played_fraction(void)
 {
@@ -1467,6 +3641,37 @@ wf_player_queue_rm(WfSong *song)
 	wf_player_songs_updated();
 }
 
+// Add or remove multiple songs to/from the queue, and report the changes once
+void
+wf_player_queue_set_many(WfSong * const *songs, gsize amount, gboolean queue)
+{
+	gsize i;
+
+	g_return_if_fail(songs != NULL || amount == 0);
+
+	for (i = 0; i < amount; i++)
+	{
+		if (!WF_IS_SONG(songs[i]))
+		{
+			continue;
+		}
+
+		if (queue)
+		{
+			wf_song_manager_add_queue_song(songs[i]);
+		}
+		else
+		{
+			wf_song_manager_rm_queue_song(songs[i]);
+		}
+	}
+
+	if (amount > 0)
+	{
+		wf_player_songs_updated();
+	}
+}
+
 void
 wf_player_stop_after_song(WfSong *song)
 {
@@ -1518,6 +3723,8 @@ wf_player_open(WfSong *song)
 
 	g_return_if_fail(wf_song_is_valid(song));
 
+	PlayerData.opened = wf_metrics_start();
+
 	wf_player_pipeline_open(song);
 	wf_player_pipeline_play();
 }
@@ -1765,7 +3972,133 @@ wf_player_finalize(void)
 static void
 wf_player_remote_finalize(void)
 {
-	wf_mpris_deactivate();
+	if (PlayerData.remote)
+	{
+		wf_mpris_deactivate();
+	}
+}
+
+static void
+wf_player_branch_free(WfPlayerBranch *branch)
+{
+	GstPad *pad;
+	GstPad *decoded;
+
+	if (branch == NULL)
+	{
+		return;
+	}
+
+	// Make sure no new pad is requested from a streaming thread
+	g_mutex_lock(&PlayerData.branch_mutex);
+	branch->dropped = TRUE;
+	pad = branch->pad;
+	branch->pad = NULL;
+	decoded = branch->decoded;
+	branch->decoded = NULL;
+	g_mutex_unlock(&PlayerData.branch_mutex);
+
+	if (pad != NULL)
+	{
+		// This also wakes up a streaming thread that is waiting in concat
+		gst_element_release_request_pad(wf_player_pipeline_get_joiner(), pad);
+		gst_object_unref(pad);
+	}
+
+	// Deactivating the pads also releases a held stream
+	gst_element_set_state(branch->decoder, GST_STATE_NULL);
+	gst_element_set_state(branch->source, GST_STATE_NULL);
+
+	if (decoded != NULL)
+	{
+		gst_object_unref(decoded);
+	}
+
+	g_signal_handler_disconnect(branch->decoder, branch->pad_added_handler);
+
+	// Take the elements out of the pipeline, but keep them for the next branch
+	gst_object_ref(branch->source);
+	gst_object_ref(branch->decoder);
+	gst_bin_remove_many(GST_BIN(PlayerData.pipeline), branch->source, branch->decoder, NULL /* terminator */);
+
+	wf_player_cache_put(branch->scheme, branch->source, branch->decoder);
+
+	g_free(branch->scheme);
+	g_object_unref(branch->song);
+	g_slice_free(WfPlayerBranch, branch);
+}
+
+static void
+wf_player_fade_free(gpointer data)
+{
+	g_slice_free(WfPlayerFade, data);
+}
+
+static void
+wf_player_cache_clear(void)
+{
+	if (PlayerData.spare_sources != NULL)
+	{
+		g_hash_table_destroy(PlayerData.spare_sources);
+		PlayerData.spare_sources = NULL;
+	}
+
+	if (PlayerData.spare_stream_source != NULL)
+	{
+		gst_object_unref(PlayerData.spare_stream_source);
+		PlayerData.spare_stream_source = NULL;
+	}
+
+	while (!g_queue_is_empty(&PlayerData.spare_decoders))
+	{
+		gst_object_unref(g_queue_pop_head(&PlayerData.spare_decoders));
+	}
+}
+
+static void
+wf_player_ram_cache_clear(void)
+{
+	if (PlayerData.ram_cache == NULL)
+	{
+		return;
+	}
+
+	wf_player_ram_cache_trim(0);
+
+#if GLIB_CHECK_VERSION(2, 64, 0)
+	g_signal_handler_disconnect(PlayerData.memory_monitor, PlayerData.memory_warning_handler);
+	g_object_unref(PlayerData.memory_monitor);
+	PlayerData.memory_monitor = NULL;
+	PlayerData.memory_warning_handler = 0;
+#endif
+
+	g_hash_table_destroy(PlayerData.ram_cache);
+	PlayerData.ram_cache = NULL;
+}
+
+static void
+wf_player_prefetch_free(WfPlayerPrefetch *prefetch)
+{
+	if (PlayerData.prefetch == prefetch)
+	{
+		// Not cancelled, so the data has been read
+		PlayerData.prefetch = NULL;
+		PlayerData.prefetched = prefetch->song;
+	}
+
+	if (prefetch->stream != NULL)
+	{
+		g_object_unref(prefetch->stream);
+	}
+
+	if (prefetch->content != NULL)
+	{
+		g_byte_array_unref(prefetch->content);
+	}
+
+	g_object_unref(prefetch->cancellable);
+	g_object_unref(prefetch->song);
+	g_slice_free(WfPlayerPrefetch, prefetch);
 }
 
 static void
@@ -1778,6 +4111,20 @@ wf_player_pipeline_destruct(void)
 		gst_element_set_state(PlayerData.pipeline, GST_STATE_NULL);
 	}
 
+	if (PlayerData.crossfade_check > 0)
+	{
+		g_source_remove(PlayerData.crossfade_check);
+		PlayerData.crossfade_check = 0;
+	}
+
+	wf_player_branch_free(PlayerData.standby);
+	wf_player_branch_free(PlayerData.fading);
+	wf_player_branch_free(PlayerData.branch);
+	wf_player_cache_clear();
+	wf_player_ram_cache_clear();
+	wf_player_prefetch_cancel();
+	PlayerData.prefetched = NULL;
+
 	if (PlayerData.bus != NULL)
 	{
 		gst_bus_remove_watch(PlayerData.bus);
@@ -1795,9 +4142,17 @@ wf_player_pipeline_destruct(void)
 	}
 
 	PlayerData.pipeline = NULL;
-	PlayerData.source = NULL;
-	PlayerData.decoder = NULL;
+	PlayerData.concat = NULL;
+	PlayerData.mixer = NULL;
+	PlayerData.crossfade = FALSE;
+	PlayerData.processing = NULL;
+	PlayerData.rgvolume = NULL;
 	PlayerData.sink = NULL;
+	PlayerData.branch = NULL;
+	PlayerData.standby = NULL;
+	PlayerData.standby_failed = NULL;
+	PlayerData.fading = NULL;
+	PlayerData.branch_base = 0;
 	PlayerData.bus = NULL;
 
 	PlayerData.volume_instance = NULL;
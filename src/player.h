@@ -42,6 +42,7 @@ typedef enum _WfPlayerStatus WfPlayerStatus;
 typedef void (*WfFuncReportMsg) (const gchar *msg);
 typedef void (*WfFuncStateChanged) (WfPlayerStatus status, gdouble duration);
 typedef void (*WfFuncPositionUpdated) (gdouble duration, gdouble position);
+typedef gboolean (*WfFuncPositionWanted) (void);
 typedef void (*WfFuncNotification) (WfSong *song, gint64 duration);
 
 enum _WfPlayerStatus
@@ -67,8 +68,11 @@ void wf_player_init(void);
 void wf_player_connect_event_report_msg(WfFuncReportMsg cb_func);
 void wf_player_connect_event_state_changed(WfFuncStateChanged cb_func);
 void wf_player_connect_event_position_updated(WfFuncPositionUpdated cb_func);
+void wf_player_connect_event_position_wanted(WfFuncPositionWanted cb_func);
 void wf_player_connect_event_notification(WfFuncNotification cb_func);
 
+void wf_player_set_remote_enabled(gboolean enabled);
+
 gdouble wf_player_get_volume(void);
 gdouble wf_player_get_volume_percentage(void);
 void wf_player_set_volume(gdouble volume);
@@ -86,6 +90,7 @@ gboolean wf_player_is_active(void);
 void wf_player_toggle_queue(WfSong *song);
 void wf_player_queue_add(WfSong *song);
 void wf_player_queue_rm(WfSong *song);
+void wf_player_queue_set_many(WfSong * const *songs, gsize amount, gboolean queue);
 
 void wf_player_stop_after_song(WfSong *song);
 
@@ -46,6 +46,7 @@
 #include <woofer/song.h>
 #include <woofer/utils.h>
 #include <woofer/memory.h>
+#include <woofer/metrics.h>
 
 // Resource includes
 #include <woofer/static/gdbus.h>
@@ -63,6 +64,10 @@
 /* DESCRIPTION END */
 
 /* DEFINES BEGIN */
+
+// Most song statistics sent in one reply of GetSongStats
+#define REMOTE_STATS_PAGE_MAX 4096
+
 /* DEFINES END */
 
 /* CUSTOM TYPES BEGIN */
@@ -140,6 +145,9 @@ remote_player_property_set_cb(GDBusConnection *connection,
                               GError **error,
                               gpointer user_data);
 
+static GVariant * wf_remote_get_song_stats(guint32 after, guint32 limit);
+static void wf_remote_set_queue_many(GVariant *parameters);
+
 static guint32 wf_remote_get_song_id(WfSong *song);
 
 static gboolean wf_remote_parameters_get_bool(GVariant *parameters, gsize index);
@@ -285,11 +293,16 @@ remote_app_method_called_cb(GDBusConnection *connection,
                             GDBusMethodInvocation *invocation,
                             gpointer user_data)
 {
+	const gchar **v_strv;
 	const gchar *v_str;
+	GVariant *v_variant;
 	GError *error;
 	gchar *method;
-	gboolean v_bool;
+	guint32 v_uint32, v_limit;
 	gint v_int;
+	gint64 start;
+
+	start = wf_metrics_start();
 
 	// Always check with lowercase names
 	method = g_strdup(method_name);
@@ -309,14 +322,42 @@ remote_app_method_called_cb(GDBusConnection *connection,
 
 		g_dbus_method_invocation_return_value(invocation, g_variant_new("(i)", v_int));
 
+		wf_metrics_stop(WF_METRIC_DBUS_CALL, start);
+
 		return;
 	}
 	else if (wf_utils_str_is_equal(method, "addsong"))
 	{
 		v_str = wf_remote_parameters_get_str(parameters, 0);
-		v_bool = wf_library_add_by_uri(v_str, NULL /* func_item_added */, 0 /* checks: default */, FALSE);
+		v_int = wf_library_add_by_uri(v_str, NULL /* func_item_added */, 0 /* checks: default */, FALSE);
+
+		g_dbus_method_invocation_return_value(invocation, g_variant_new("(i)", v_int));
+
+		wf_metrics_stop(WF_METRIC_DBUS_CALL, start);
+
+		return;
+	}
+	else if (wf_utils_str_is_equal(method, "addsongs"))
+	{
+		g_variant_get(parameters, "(^a&s)", &v_strv);
+		v_int = wf_library_add_strv((gchar **) v_strv, NULL /* func_item_added */, 0 /* checks: default */, FALSE);
+		g_free(v_strv);
+
+		g_dbus_method_invocation_return_value(invocation, g_variant_new("(i)", v_int));
+
+		wf_metrics_stop(WF_METRIC_DBUS_CALL, start);
+
+		return;
+	}
+	else if (wf_utils_str_is_equal(method, "getsongstats"))
+	{
+		v_uint32 = wf_remote_parameters_get_uint32(parameters, 0);
+		v_limit = wf_remote_parameters_get_uint32(parameters, 1);
+		v_variant = wf_remote_get_song_stats(v_uint32, v_limit);
 
-		g_dbus_method_invocation_return_value(invocation, g_variant_new("(b)", v_bool));
+		g_dbus_method_invocation_return_value(invocation, g_variant_new_tuple(&v_variant, 1));
+
+		wf_metrics_stop(WF_METRIC_DBUS_CALL, start);
 
 		return;
 	}
@@ -325,10 +366,14 @@ remote_app_method_called_cb(GDBusConnection *connection,
 		error = g_error_new(G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED, "Method <%s> not supported", method_name);
 		g_dbus_method_invocation_take_error(invocation, error);
 
+		wf_metrics_stop(WF_METRIC_DBUS_CALL, start);
+
 		return;
 	}
 
 	g_dbus_method_invocation_return_value(invocation, NULL /* parameters */);
+
+	wf_metrics_stop(WF_METRIC_DBUS_CALL, start);
 }
 
 // GDBusInterfaceGetPropertyFunc
@@ -341,7 +386,10 @@ remote_app_property_get_cb(GDBusConnection *connection,
                            GError **error,
                            gpointer user_data)
 {
-	// No properties to implement
+	if (g_ascii_strcasecmp(property_name, "metrics") == 0)
+	{
+		return wf_metrics_get_variant();
+	}
 
 	g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY, "Property %s.%s not supported", interface_name, property_name);
 
@@ -383,6 +431,9 @@ remote_player_method_called_cb(GDBusConnection *connection,
 	gboolean v_bool;
 	guint32 v_uint32;
 	gdouble v_double;
+	gint64 start;
+
+	start = wf_metrics_start();
 
 	// Always check with lowercase names
 	method = g_strdup(method_name);
@@ -409,6 +460,10 @@ remote_player_method_called_cb(GDBusConnection *connection,
 			v_bool ? wf_player_queue_add(song) : wf_player_queue_rm(song);
 		}
 	}
+	else if (wf_utils_str_is_equal(method, "setqueuemany"))
+	{
+		wf_remote_set_queue_many(parameters);
+	}
 	else if (wf_utils_str_is_equal(method, "stopaftersong"))
 	{
 		v_uint32 = wf_remote_parameters_get_uint32(parameters, 0);
@@ -450,10 +505,14 @@ remote_player_method_called_cb(GDBusConnection *connection,
 		error = g_error_new(G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED, "Method <%s> not supported", method_name);
 		g_dbus_method_invocation_take_error(invocation, error);
 
+		wf_metrics_stop(WF_METRIC_DBUS_CALL, start);
+
 		return;
 	}
 
 	g_dbus_method_invocation_return_value(invocation, NULL /* parameters */);
+
+	wf_metrics_stop(WF_METRIC_DBUS_CALL, start);
 }
 
 // GDBusInterfaceGetPropertyFunc
@@ -574,6 +633,88 @@ remote_player_property_set_cb(GDBusConnection *connection,
 /* CALLBACK FUNCTIONS END */
 
 /* MODULE FUNCTIONS BEGIN */
+
+/*
+ * Get the statistics of up to @limit songs in the order of the library,
+ * starting after the song with hash @after (or at the first song if 0).  A
+ * client can page through the whole library by passing the hash of the last
+ * song it received, until it receives less than it asked for.
+ */
+static GVariant *
+wf_remote_get_song_stats(guint32 after, guint32 limit)
+{
+	GVariantBuilder builder;
+	WfSong *song;
+	guint32 amount = 0;
+
+	if (limit == 0 || limit > REMOTE_STATS_PAGE_MAX)
+	{
+		limit = REMOTE_STATS_PAGE_MAX;
+	}
+
+	g_variant_builder_init(&builder, G_VARIANT_TYPE("a(uidiix)"));
+
+	if (after == 0)
+	{
+		song = wf_song_get_first();
+	}
+	else
+	{
+		// An unknown hash results in an empty page
+		song = wf_song_get_by_hash(after);
+		song = (song != NULL) ? wf_song_get_next(song) : NULL;
+	}
+
+	for (; song != NULL && amount < limit; song = wf_song_get_next(song))
+	{
+		g_variant_builder_add(&builder, "(uidiix)",
+		                      wf_song_get_hash(song),
+		                      wf_song_get_rating(song),
+		                      wf_song_get_score(song),
+		                      wf_song_get_play_count(song),
+		                      wf_song_get_skip_count(song),
+		                      wf_song_get_last_played(song));
+
+		amount++;
+	}
+
+	return g_variant_builder_end(&builder);
+}
+
+static void
+wf_remote_set_queue_many(GVariant *parameters)
+{
+	GVariant *hashes;
+	const guint32 *values;
+	WfSong **songs;
+	gsize length = 0;
+	gsize amount = 0;
+	gsize i;
+	gboolean queue;
+
+	hashes = g_variant_get_child_value(parameters, 0);
+	values = g_variant_get_fixed_array(hashes, &length, sizeof(guint32));
+	queue = wf_remote_parameters_get_bool(parameters, 1);
+
+	songs = g_new(WfSong *, length + 1);
+
+	for (i = 0; i < length; i++)
+	{
+		songs[amount] = wf_song_get_by_hash(values[i]);
+
+		if (songs[amount] != NULL)
+		{
+			amount++;
+		}
+	}
+
+	// Songs are updated only once for the whole list
+	wf_player_queue_set_many(songs, amount, queue);
+
+	g_free(songs);
+	g_variant_unref(hashes);
+}
+
 /* MODULE FUNCTIONS END */
 
 /* MODULE UTILITIES BEGIN */
@@ -643,6 +784,12 @@ wf_remote_parameters_get_str(GVariant *parameters, gsize index)
 void
 wf_remote_finalize(void)
 {
+	if (DBusConnection == NULL)
+	{
+		// Never set up, like when running as a daemon
+		return;
+	}
+
 	g_dbus_connection_unregister_object(DBusConnection, RemoteAppId);
 	g_dbus_connection_unregister_object(DBusConnection, RemotePlayerId);
 
@@ -0,0 +1,369 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ring.c  This file is part of LibWoofer
+ * Copyright (C) 2023  Quico Augustijn
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this library.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <glib.h>
+
+// Global includes
+/*< none >*/
+
+// Module includes
+#include <woofer/ring.h>
+
+// Dependency includes
+/*< none >*/
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * WfRing is a ring buffer of pointers, used for lists that are mostly added
+ * to at one end and trimmed at the other, like the play history.  Adding and
+ * removing at either end is O(1) and items can be read by their position
+ * without walking any nodes.  The first item (index 0) is the front.
+ *
+ * A ring can have a limit: when an item is added to a full ring, the item at
+ * the other end is dropped, so the length never exceeds the limit.  Without a
+ * limit the storage simply grows.  Dropped items and the items still present
+ * when clearing are freed using the free function, if set.  Items taken out
+ * using wf_ring_pop_front() or wf_ring_remove() are not freed.
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Storage to start with for a ring without a limit
+#define DEFAULT_CAPACITY 8
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+struct _WfRing
+{
+	gpointer *items;
+	guint capacity; // Allocated amount of items
+	guint head; // Storage position of the front item
+	guint length;
+	guint limit; // Maximum length, 0 for no limit
+
+	GDestroyNotify free_func;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static guint wf_ring_position(const WfRing *ring, guint index);
+static void wf_ring_resize(WfRing *ring, guint capacity);
+static void wf_ring_drop_back(WfRing *ring);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+/* GLOBAL VARIABLES END */
+
+/* CONSTRUCTORS BEGIN */
+
+/*
+ * wf_ring_new:
+ * @limit: maximum amount of items (or 0 for no limit)
+ * @free_func: (nullable): function to free dropped items with
+ *
+ * Returns: (transfer full): a new, empty ring
+ */
+WfRing *
+wf_ring_new(guint limit, GDestroyNotify free_func)
+{
+	WfRing *ring;
+
+	ring = g_slice_new0(WfRing);
+	ring->limit = limit;
+	ring->free_func = free_func;
+
+	wf_ring_resize(ring, (limit > 0) ? limit : DEFAULT_CAPACITY);
+
+	return ring;
+}
+
+/* CONSTRUCTORS END */
+
+/* GETTERS/SETTERS BEGIN */
+
+guint
+wf_ring_get_length(const WfRing *ring)
+{
+	g_return_val_if_fail(ring != NULL, 0);
+
+	return ring->length;
+}
+
+// Get the item at @index, counted from the front, or %NULL if out of range
+gpointer
+wf_ring_get(const WfRing *ring, guint index)
+{
+	g_return_val_if_fail(ring != NULL, NULL);
+
+	if (index >= ring->length)
+	{
+		return NULL;
+	}
+
+	return ring->items[wf_ring_position(ring, index)];
+}
+
+guint
+wf_ring_get_limit(const WfRing *ring)
+{
+	g_return_val_if_fail(ring != NULL, 0);
+
+	return ring->limit;
+}
+
+// Change the limit, dropping items at the back that no longer fit
+void
+wf_ring_set_limit(WfRing *ring, guint limit)
+{
+	g_return_if_fail(ring != NULL);
+
+	ring->limit = limit;
+
+	while (limit > 0 && ring->length > limit)
+	{
+		wf_ring_drop_back(ring);
+	}
+
+	if (limit > ring->capacity)
+	{
+		wf_ring_resize(ring, limit);
+	}
+}
+
+/* GETTERS/SETTERS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+// Add @data to the front, dropping the item at the back if the ring is full
+void
+wf_ring_push_front(WfRing *ring, gpointer data)
+{
+	g_return_if_fail(ring != NULL);
+
+	if (ring->limit > 0 && ring->length >= ring->limit)
+	{
+		wf_ring_drop_back(ring);
+	}
+
+	if (ring->length == ring->capacity)
+	{
+		wf_ring_resize(ring, ring->capacity * 2);
+	}
+
+	ring->head = (ring->head + ring->capacity - 1) % ring->capacity;
+	ring->items[ring->head] = data;
+	ring->length++;
+}
+
+// Add @data to the back; if the ring is full, @data is dropped instead
+void
+wf_ring_push_back(WfRing *ring, gpointer data)
+{
+	g_return_if_fail(ring != NULL);
+
+	if (ring->limit > 0 && ring->length >= ring->limit)
+	{
+		if (ring->free_func != NULL)
+		{
+			ring->free_func(data);
+		}
+
+		return;
+	}
+
+	if (ring->length == ring->capacity)
+	{
+		wf_ring_resize(ring, ring->capacity * 2);
+	}
+
+	ring->items[wf_ring_position(ring, ring->length)] = data;
+	ring->length++;
+}
+
+// Take the front item out of the ring, returns %NULL if the ring is empty
+gpointer
+wf_ring_pop_front(WfRing *ring)
+{
+	gpointer data;
+
+	g_return_val_if_fail(ring != NULL, NULL);
+
+	if (ring->length == 0)
+	{
+		return NULL;
+	}
+
+	data = ring->items[ring->head];
+	ring->items[ring->head] = NULL;
+	ring->head = (ring->head + 1) % ring->capacity;
+	ring->length--;
+
+	return data;
+}
+
+/*
+ * Take the first occurrence of @data out of the ring.  The items behind it
+ * move up, so this is O(n); only meant for the occasional removal.
+ *
+ * Returns: %TRUE if @data was found and removed
+ */
+gboolean
+wf_ring_remove(WfRing *ring, gconstpointer data)
+{
+	guint x;
+
+	g_return_val_if_fail(ring != NULL, FALSE);
+
+	for (x = 0; x < ring->length; x++)
+	{
+		if (ring->items[wf_ring_position(ring, x)] == data)
+		{
+			break;
+		}
+	}
+
+	if (x == ring->length)
+	{
+		return FALSE;
+	}
+
+	for (; x + 1 < ring->length; x++)
+	{
+		ring->items[wf_ring_position(ring, x)] = ring->items[wf_ring_position(ring, x + 1)];
+	}
+
+	ring->items[wf_ring_position(ring, x)] = NULL;
+	ring->length--;
+
+	return TRUE;
+}
+
+// Free the items from @length onwards, so at most @length items are left
+void
+wf_ring_truncate(WfRing *ring, guint length)
+{
+	g_return_if_fail(ring != NULL);
+
+	while (ring->length > length)
+	{
+		wf_ring_drop_back(ring);
+	}
+}
+
+// Free all items and empty the ring, the storage is kept
+void
+wf_ring_clear(WfRing *ring)
+{
+	g_return_if_fail(ring != NULL);
+
+	while (ring->length > 0)
+	{
+		wf_ring_drop_back(ring);
+	}
+
+	ring->head = 0;
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+// Storage position of the item at @index
+static guint
+wf_ring_position(const WfRing *ring, guint index)
+{
+	return (ring->head + index) % ring->capacity;
+}
+
+// Move the items to new storage of @capacity items, starting at position 0
+static void
+wf_ring_resize(WfRing *ring, guint capacity)
+{
+	gpointer *items;
+	guint x;
+
+	items = g_new0(gpointer, capacity);
+
+	for (x = 0; x < ring->length; x++)
+	{
+		items[x] = ring->items[wf_ring_position(ring, x)];
+	}
+
+	g_free(ring->items);
+
+	ring->items = items;
+	ring->capacity = capacity;
+	ring->head = 0;
+}
+
+// Remove and free the item at the back
+static void
+wf_ring_drop_back(WfRing *ring)
+{
+	guint pos = wf_ring_position(ring, ring->length - 1);
+	gpointer data = ring->items[pos];
+
+	ring->items[pos] = NULL;
+	ring->length--;
+
+	if (ring->free_func != NULL)
+	{
+		ring->free_func(data);
+	}
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+
+void
+wf_ring_free(WfRing *ring)
+{
+	if (ring == NULL)
+	{
+		return;
+	}
+
+	wf_ring_clear(ring);
+	g_free(ring->items);
+
+	g_slice_free(WfRing, ring);
+}
+
+/* DESTRUCTORS END */
+
+/* END OF FILE */
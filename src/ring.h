@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * ring.h  This file is part of LibWoofer
+ * Copyright (C) 2023  Quico Augustijn
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this library.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+#ifndef __WF_RING__
+#define __WF_RING__
+
+/* INCLUDES BEGIN */
+
+#include <glib.h>
+
+/* INCLUDES END */
+
+G_BEGIN_DECLS
+
+/* DEFINES BEGIN */
+/* DEFINES END */
+
+/* MODULE TYPES BEGIN */
+
+typedef struct _WfRing WfRing;
+
+/* MODULE TYPES END */
+
+/* CONSTRUCTOR PROTOTYPES BEGIN */
+
+WfRing * wf_ring_new(guint limit, GDestroyNotify free_func);
+
+/* CONSTRUCTOR PROTOTYPES END */
+
+/* GETTER/SETTER PROTOTYPES BEGIN */
+
+guint wf_ring_get_length(const WfRing *ring);
+gpointer wf_ring_get(const WfRing *ring, guint index);
+
+guint wf_ring_get_limit(const WfRing *ring);
+void wf_ring_set_limit(WfRing *ring, guint limit);
+
+/* GETTER/SETTER PROTOTYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+void wf_ring_push_front(WfRing *ring, gpointer data);
+void wf_ring_push_back(WfRing *ring, gpointer data);
+gpointer wf_ring_pop_front(WfRing *ring);
+gboolean wf_ring_remove(WfRing *ring, gconstpointer data);
+void wf_ring_truncate(WfRing *ring, guint length);
+void wf_ring_clear(WfRing *ring);
+
+/* FUNCTION PROTOTYPES END */
+
+/* UTILITY PROTOTYPES BEGIN */
+/* UTILITY PROTOTYPES END */
+
+/* DESTRUCTOR PROTOTYPES BEGIN */
+
+void wf_ring_free(WfRing *ring);
+
+/* DESTRUCTOR PROTOTYPES END */
+
+G_END_DECLS
+
+#endif /* __WF_RING__ */
+
+/* END OF FILE */
@@ -0,0 +1,462 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * sampler.c  This file is part of LibWoofer
+ * Copyright (C) 2023  Quico Augustijn
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this library.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+/* INCLUDES BEGIN */
+
+// Library includes
+#include <string.h>
+#include <glib.h>
+
+// Global includes
+/*< none >*/
+
+// Module includes
+#include <woofer/sampler.h>
+
+// Dependency includes
+/*< none >*/
+
+// Resource includes
+/*< none >*/
+
+/* INCLUDES END */
+
+/* DESCRIPTION BEGIN */
+
+/*
+ * WfSampler is a weighted sampler: a set of keys, each with a weight, from
+ * which a key can be drawn with a probability proportional to its weight.  It
+ * is built on a Fenwick tree (binary indexed tree) of the weights, so both
+ * finding the key for a drawn value and changing the weight of a single key
+ * take O(log n) instead of walking all keys.
+ *
+ * Keys are never removed; set their weight to 0 instead so they can no longer
+ * be drawn.  Indices are 0-based towards the caller and 1-based internally, as
+ * is common for Fenwick trees.
+ */
+
+/* DESCRIPTION END */
+
+/* DEFINES BEGIN */
+
+// Capacity to start with if none is given
+#define DEFAULT_CAPACITY 64
+
+/* DEFINES END */
+
+/* CUSTOM TYPES BEGIN */
+
+struct _WfSampler
+{
+	guint size;
+	guint capacity;
+
+	gpointer *keys;
+	guint64 *weights; // Plain weights (0-based)
+	guint64 *tree; // Fenwick tree of the weights (1-based)
+
+	guint64 total;
+
+	// Key to index + 1 lookup, so 0 means not present
+	GHashTable *index;
+};
+
+/* CUSTOM TYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+static void wf_sampler_tree_add(WfSampler *sampler, guint index, gint64 delta);
+static guint64 wf_sampler_prefix_sum(const WfSampler *sampler, guint count);
+static void wf_sampler_grow(WfSampler *sampler, guint capacity);
+static void wf_sampler_build_tree(WfSampler *sampler);
+static guint wf_sampler_highest_bit(guint value);
+
+/* FUNCTION PROTOTYPES END */
+
+/* GLOBAL VARIABLES BEGIN */
+/* GLOBAL VARIABLES END */
+
+/* CONSTRUCTORS BEGIN */
+
+/*
+ * wf_sampler_new:
+ * @size: expected amount of keys (or 0 if unknown)
+ *
+ * Returns: (transfer full): a new, empty sampler
+ */
+WfSampler *
+wf_sampler_new(guint size)
+{
+	WfSampler *sampler;
+
+	sampler = g_slice_new0(WfSampler);
+	sampler->capacity = (size > 0) ? size : DEFAULT_CAPACITY;
+	sampler->keys = g_new0(gpointer, sampler->capacity);
+	sampler->weights = g_new0(guint64, sampler->capacity);
+	sampler->tree = g_new0(guint64, sampler->capacity + 1);
+	sampler->index = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	return sampler;
+}
+
+/* CONSTRUCTORS END */
+
+/* GETTERS/SETTERS BEGIN */
+
+guint
+wf_sampler_get_size(const WfSampler *sampler)
+{
+	g_return_val_if_fail(sampler != NULL, 0);
+
+	return sampler->size;
+}
+
+// Sum of all weights: draws should be in range [0, total)
+guint64
+wf_sampler_get_total(const WfSampler *sampler)
+{
+	g_return_val_if_fail(sampler != NULL, 0);
+
+	return sampler->total;
+}
+
+gpointer
+wf_sampler_get_key(const WfSampler *sampler, guint index)
+{
+	g_return_val_if_fail(sampler != NULL, NULL);
+	g_return_val_if_fail(index < sampler->size, NULL);
+
+	return sampler->keys[index];
+}
+
+guint64
+wf_sampler_get_weight(const WfSampler *sampler, guint index)
+{
+	g_return_val_if_fail(sampler != NULL, 0);
+	g_return_val_if_fail(index < sampler->size, 0);
+
+	return sampler->weights[index];
+}
+
+/*
+ * wf_sampler_set_weight:
+ * @index: index of the key as returned by wf_sampler_add()
+ * @weight: the new weight (0 to exclude the key from draws)
+ *
+ * Change the weight of a single key in O(log n).
+ */
+void
+wf_sampler_set_weight(WfSampler *sampler, guint index, guint64 weight)
+{
+	gint64 delta;
+
+	g_return_if_fail(sampler != NULL);
+	g_return_if_fail(index < sampler->size);
+
+	delta = (gint64) weight - (gint64) sampler->weights[index];
+
+	if (delta == 0)
+	{
+		return;
+	}
+
+	sampler->weights[index] = weight;
+	sampler->total += delta;
+
+	wf_sampler_tree_add(sampler, index + 1, delta);
+}
+
+/*
+ * wf_sampler_set_weights:
+ * @weights: (array): the new weights of all keys, in order of their index
+ *
+ * Replace the weights of all keys at once.  This rebuilds the tree in O(n),
+ * which is faster than setting many weights one by one.
+ */
+void
+wf_sampler_set_weights(WfSampler *sampler, const guint64 *weights)
+{
+	guint x;
+
+	g_return_if_fail(sampler != NULL);
+	g_return_if_fail(weights != NULL || sampler->size == 0);
+
+	sampler->total = 0;
+
+	for (x = 0; x < sampler->size; x++)
+	{
+		sampler->weights[x] = weights[x];
+		sampler->total += weights[x];
+	}
+
+	memset(sampler->tree, 0, (sampler->capacity + 1) * sizeof(guint64));
+	wf_sampler_build_tree(sampler);
+}
+
+// Returns %FALSE if @key is not part of @sampler
+gboolean
+wf_sampler_set_weight_for_key(WfSampler *sampler, gconstpointer key, guint64 weight)
+{
+	guint index;
+
+	g_return_val_if_fail(sampler != NULL, FALSE);
+
+	index = GPOINTER_TO_UINT(g_hash_table_lookup(sampler->index, key));
+
+	if (index == 0)
+	{
+		return FALSE;
+	}
+
+	wf_sampler_set_weight(sampler, index - 1, weight);
+
+	return TRUE;
+}
+
+/* GETTERS/SETTERS END */
+
+/* CALLBACK FUNCTIONS BEGIN */
+/* CALLBACK FUNCTIONS END */
+
+/* MODULE FUNCTIONS BEGIN */
+
+/*
+ * wf_sampler_add:
+ * @key: the key to add
+ * @weight: its weight
+ *
+ * Add a new key to the sampler.  If @key is already present, only its weight
+ * is updated.
+ *
+ * Returns: the index of @key
+ */
+guint
+wf_sampler_add(WfSampler *sampler, gpointer key, guint64 weight)
+{
+	guint index, node;
+
+	g_return_val_if_fail(sampler != NULL, 0);
+
+	index = GPOINTER_TO_UINT(g_hash_table_lookup(sampler->index, key));
+
+	if (index > 0)
+	{
+		wf_sampler_set_weight(sampler, index - 1, weight);
+
+		return index - 1;
+	}
+
+	if (sampler->size == sampler->capacity)
+	{
+		wf_sampler_grow(sampler, sampler->capacity * 2);
+	}
+
+	index = sampler->size++;
+	node = index + 1;
+
+	sampler->keys[index] = key;
+	sampler->weights[index] = weight;
+	sampler->total += weight;
+	g_hash_table_insert(sampler->index, key, GUINT_TO_POINTER(node));
+
+	// The new node covers its own weight and that of the nodes it spans
+	sampler->tree[node] = weight + wf_sampler_prefix_sum(sampler, node - 1) - wf_sampler_prefix_sum(sampler, node - (node & (~node + 1)));
+
+	return index;
+}
+
+// Make room for at least @size keys, so adding them does not have to grow
+void
+wf_sampler_reserve(WfSampler *sampler, guint size)
+{
+	g_return_if_fail(sampler != NULL);
+
+	if (size > sampler->capacity)
+	{
+		wf_sampler_grow(sampler, size);
+	}
+}
+
+/*
+ * wf_sampler_clear:
+ *
+ * Remove all keys, but keep the allocated memory around.  This allows the same
+ * sampler to be filled again without allocating anything.
+ */
+void
+wf_sampler_clear(WfSampler *sampler)
+{
+	g_return_if_fail(sampler != NULL);
+
+	// Nodes are fully overwritten when added again, so the tree can stay as is
+	sampler->size = 0;
+	sampler->total = 0;
+
+	g_hash_table_remove_all(sampler->index);
+}
+
+gboolean
+wf_sampler_contains(const WfSampler *sampler, gconstpointer key)
+{
+	g_return_val_if_fail(sampler != NULL, FALSE);
+
+	return g_hash_table_contains(sampler->index, key);
+}
+
+/*
+ * wf_sampler_find:
+ * @target: a value in range [0, total)
+ *
+ * Find the key for which the sum of the weights of all keys before it is at
+ * most @target and the sum including its own weight is more than @target.
+ * With @target drawn uniformly, every key is found with a probability equal to
+ * its share of the total weight.  Keys with weight 0 are never found.
+ *
+ * Returns: the index of the matching key, or -1 if @target is out of range
+ */
+gint
+wf_sampler_find(const WfSampler *sampler, guint64 target)
+{
+	guint pos = 0, next, step;
+
+	g_return_val_if_fail(sampler != NULL, -1);
+
+	if (target >= sampler->total)
+	{
+		return -1;
+	}
+
+	// Descend the tree, skipping every subtree whose sum fits within @target
+	for (step = wf_sampler_highest_bit(sampler->size); step > 0; step >>= 1)
+	{
+		next = pos + step;
+
+		if (next <= sampler->size && sampler->tree[next] <= target)
+		{
+			target -= sampler->tree[next];
+			pos = next;
+		}
+	}
+
+	// @pos is the amount of keys before the match, so also its 0-based index
+	return (gint) pos;
+}
+
+/* MODULE FUNCTIONS END */
+
+/* MODULE UTILITIES BEGIN */
+
+static void
+wf_sampler_tree_add(WfSampler *sampler, guint index, gint64 delta)
+{
+	for (; index <= sampler->size; index += index & (~index + 1))
+	{
+		sampler->tree[index] += delta;
+	}
+}
+
+// Sum of the weights of the first @count keys
+static guint64
+wf_sampler_prefix_sum(const WfSampler *sampler, guint count)
+{
+	guint64 sum = 0;
+
+	for (; count > 0; count -= count & (~count + 1))
+	{
+		sum += sampler->tree[count];
+	}
+
+	return sum;
+}
+
+// Grow to hold @capacity keys; the tree is rebuilt in O(n)
+static void
+wf_sampler_grow(WfSampler *sampler, guint capacity)
+{
+	sampler->capacity = capacity;
+	sampler->keys = g_renew(gpointer, sampler->keys, sampler->capacity);
+	sampler->weights = g_renew(guint64, sampler->weights, sampler->capacity);
+
+	g_free(sampler->tree);
+	sampler->tree = g_new0(guint64, sampler->capacity + 1);
+
+	wf_sampler_build_tree(sampler);
+}
+
+// Fill an all zero tree from the plain weights in O(n)
+static void
+wf_sampler_build_tree(WfSampler *sampler)
+{
+	guint x, parent;
+
+	for (x = 1; x <= sampler->size; x++)
+	{
+		sampler->tree[x] += sampler->weights[x - 1];
+		parent = x + (x & (~x + 1));
+
+		if (parent <= sampler->size)
+		{
+			sampler->tree[parent] += sampler->tree[x];
+		}
+	}
+}
+
+static guint
+wf_sampler_highest_bit(guint value)
+{
+	guint bit = 1;
+
+	if (value == 0)
+	{
+		return 0;
+	}
+
+	while ((bit << 1) != 0 && (bit << 1) <= value)
+	{
+		bit <<= 1;
+	}
+
+	return bit;
+}
+
+/* MODULE UTILITIES END */
+
+/* DESTRUCTORS BEGIN */
+
+void
+wf_sampler_free(WfSampler *sampler)
+{
+	if (sampler == NULL)
+	{
+		return;
+	}
+
+	g_hash_table_unref(sampler->index);
+	g_free(sampler->keys);
+	g_free(sampler->weights);
+	g_free(sampler->tree);
+
+	g_slice_free(WfSampler, sampler);
+}
+
+/* DESTRUCTORS END */
+
+/* END OF FILE */
@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * sampler.h  This file is part of LibWoofer
+ * Copyright (C) 2023  Quico Augustijn
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed "as is" in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  If your
+ * computer no longer boots, divides by 0 or explodes, you are the only
+ * one responsible.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 3 along with this library.  If not, see
+ * <https://www.gnu.org/licenses/gpl-3.0.html>.
+ */
+
+#ifndef __WF_SAMPLER__
+#define __WF_SAMPLER__
+
+/* INCLUDES BEGIN */
+
+#include <glib.h>
+
+/* INCLUDES END */
+
+G_BEGIN_DECLS
+
+/* DEFINES BEGIN */
+/* DEFINES END */
+
+/* MODULE TYPES BEGIN */
+
+typedef struct _WfSampler WfSampler;
+
+/* MODULE TYPES END */
+
+/* CONSTRUCTOR PROTOTYPES BEGIN */
+
+WfSampler * wf_sampler_new(guint size);
+
+/* CONSTRUCTOR PROTOTYPES END */
+
+/* GETTER/SETTER PROTOTYPES BEGIN */
+
+guint wf_sampler_get_size(const WfSampler *sampler);
+guint64 wf_sampler_get_total(const WfSampler *sampler);
+
+gpointer wf_sampler_get_key(const WfSampler *sampler, guint index);
+guint64 wf_sampler_get_weight(const WfSampler *sampler, guint index);
+void wf_sampler_set_weight(WfSampler *sampler, guint index, guint64 weight);
+void wf_sampler_set_weights(WfSampler *sampler, const guint64 *weights);
+
+gboolean wf_sampler_set_weight_for_key(WfSampler *sampler, gconstpointer key, guint64 weight);
+
+/* GETTER/SETTER PROTOTYPES END */
+
+/* FUNCTION PROTOTYPES BEGIN */
+
+guint wf_sampler_add(WfSampler *sampler, gpointer key, guint64 weight);
+gboolean wf_sampler_contains(const WfSampler *sampler, gconstpointer key);
+void wf_sampler_reserve(WfSampler *sampler, guint size);
+void wf_sampler_clear(WfSampler *sampler);
+gint wf_sampler_find(const WfSampler *sampler, guint64 target);
+
+/* FUNCTION PROTOTYPES END */
+
+/* UTILITY PROTOTYPES BEGIN */
+/* UTILITY PROTOTYPES END */
+
+/* DESTRUCTOR PROTOTYPES BEGIN */
+
+void wf_sampler_free(WfSampler *sampler);
+
+/* DESTRUCTOR PROTOTYPES END */
+
+G_END_DECLS
+
+#endif /* __WF_SAMPLER__ */
+
+/* END OF FILE */
@@ -115,6 +115,7 @@ typedef union _WfSettingValue WfSettingValue;
 typedef struct _WfSettingItem WfSettingItem;
 typedef struct _WfStaticSetting WfStaticSetting;
 typedef struct _WfDynamicSetting WfDynamicSetting;
+typedef struct _WfSettingSubscriber WfSettingSubscriber;
 
 typedef struct _WfSettingsDetails WfSettingsDetails;
 
@@ -161,6 +162,17 @@ struct _WfDynamicSetting
 	WfSettingValueType type;
 	WfSettingValue std;
 	WfSettingValue value;
+
+	// Subscribers of type WfSettingSubscriber to notify of changes
+	GSList *subscribers;
+	guint notifying; // Depth of notifications in progress
+};
+
+struct _WfSettingSubscriber
+{
+	guint handler_id;
+	WfFuncSettingChanged func; // %NULL once disconnected during a notification
+	gpointer user_data;
 };
 
 struct _WfSettingsDetails
@@ -170,14 +182,23 @@ struct _WfSettingsDetails
 	// Custom structures used by the song choosing algorithm
 	WfSongFilter filter;
 	WfSongEntries entries;
+	WfSettingsSnapshot snapshot;
 
 	// Contains all static settings
 	WfStaticSetting *general_settings;
 	WfStaticSetting *filter_settings;
 	WfStaticSetting *entry_settings;
 
-	// Contains all dynamically registered settings
-	GSList *registered_settings;
+	// Static settings by their type, filled in when first looked up
+	WfStaticSetting *static_index[WF_SETTING_DEFINED];
+
+	// Contains all dynamically registered settings, in order of registration
+	GPtrArray *registered_settings;
+
+	// Dynamically registered settings by their id
+	GHashTable *registered_index;
+
+	guint last_handler_id;
 
 	// Settings properties
 	gchar *default_path;
@@ -205,8 +226,11 @@ static void wf_settings_static_set_defaults(WfStaticSetting *setting);
 static WfStaticSetting * wf_settings_static_get_struct(WfSettingType type);
 
 static guint wf_settings_dynamic_register(const gchar *name, const gchar *group, WfSettingValueType type, WfSettingValue *value);
+static WfDynamicSetting * wf_settings_dynamic_get_struct(guint32 id);
 static gboolean wf_settings_dynamic_get_value_by_id(guint32 id, WfSettingValue *value_rv);
 static void wf_settings_dynamic_set_value_by_id(guint32 id, WfSettingValueType type, WfSettingValue *value);
+static void wf_settings_dynamic_set_value(WfDynamicSetting *setting, WfSettingValue *value, gboolean take);
+static void wf_settings_dynamic_notify(WfDynamicSetting *setting);
 
 static void wf_settings_extract_keyfile(GKeyFile *key_file);
 static void wf_settings_extract_static(GKeyFile *key_file, WfStaticSetting *settings, const gchar *group);
@@ -214,7 +238,7 @@ static gboolean wf_settings_extract_item(GKeyFile *key_file, const gchar *name,
 
 static void wf_settings_update_keyfile(GKeyFile *key_file);
 static void wf_settings_update_static(GKeyFile *key_file, WfStaticSetting *settings, const gchar *group);
-static void wf_settings_update_dynamic(GKeyFile *key_file, GSList *settings);
+static void wf_settings_update_dynamic(GKeyFile *key_file, GPtrArray *settings);
 static void wf_settings_update_item(GKeyFile *key_file, const gchar *name, const gchar *group, WfSettingValueType type, WfSettingValue *value);
 
 static gboolean wf_settings_process_error(const gchar *group, const gchar *key, GError **error);
@@ -223,9 +247,12 @@ static gboolean wf_settings_check_if_exists(GKeyFile *key_file, const gchar *gro
 
 static gboolean wf_settings_keyfile_write(GKeyFile *key_file, const gchar *file_path);
 
+static gboolean wf_settings_value_is_equal(WfSettingValueType type, const WfSettingValue *a, const WfSettingValue *b);
+
 static void wf_settings_value_destruct(WfSettingValueType type, WfSettingValue *value);
 
 static void wf_settings_dynamic_free_cb(gpointer data);
+static void wf_settings_subscriber_free_cb(gpointer data);
 
 /* FUNCTION PROTOTYPES END */
 
@@ -258,7 +285,7 @@ static WfStaticSetting GeneralSettings[] =
 		{ .v_int = 60000 },
 	},
 	{
-		// Prefer to read a file before playing and then play it from memory
+		// Prefer to play a file from memory (mapped for local files, read completely otherwise)
 		"PreferPlayFromRam",
 		WF_SETTING_PREFER_PLAY_FROM_RAM,
 		SETTING_VALUE_BOOL,
@@ -282,6 +309,70 @@ static WfStaticSetting GeneralSettings[] =
 		{ .v_double = 0.0 },
 		{ .v_double = 1.0 },
 	},
+	{
+		// Prepare the next song in advance, so it follows the current one without a gap
+		"GaplessPlayback",
+		WF_SETTING_GAPLESS_PLAYBACK,
+		SETTING_VALUE_BOOL,
+		{ .v_bool = TRUE },
+	},
+	{
+		// Adjust the volume by the ReplayGain tags of the song (see WfReplayGainMode)
+		"ReplayGain",
+		WF_SETTING_REPLAY_GAIN,
+		SETTING_VALUE_ENUM,
+		{ .v_enum = WF_REPLAY_GAIN_OFF },
+		{ .v_enum = WF_REPLAY_GAIN_OFF },
+		{ .v_enum = WF_REPLAY_GAIN_ALBUM },
+	},
+	{
+		// Extra gain in dB on top of the ReplayGain tags
+		"ReplayGainPreAmp",
+		WF_SETTING_REPLAY_GAIN_PRE_AMP,
+		SETTING_VALUE_DOUBLE,
+		{ .v_double = 0.0 },
+		{ .v_double = -60.0 },
+		{ .v_double = 60.0 },
+	},
+	{
+		// Seconds the end of a song overlaps with the next one, fading between them (0 to disable, needs gapless playback)
+		"CrossfadeDuration",
+		WF_SETTING_CROSSFADE_DURATION,
+		SETTING_VALUE_DOUBLE,
+		{ .v_double = 0.0 },
+		{ .v_double = 0.0 },
+		{ .v_double = 20.0 },
+	},
+	{
+		// Store the library file and its cache compressed (gzip), for less disk I/O
+		"CompressLibrary",
+		WF_SETTING_COMPRESS_LIBRARY,
+		SETTING_VALUE_BOOL,
+		{ .v_bool = FALSE },
+	},
+	{
+		// Preroll the upcoming song after startup, so the first play starts right away (holds the audio device while stopped)
+		"WarmUpPipeline",
+		WF_SETTING_WARM_UP_PIPELINE,
+		SETTING_VALUE_BOOL,
+		{ .v_bool = FALSE },
+	},
+	{
+		// Seek to the nearest key unit instead of the exact position, which is much faster for long files
+		"FastSeek",
+		WF_SETTING_FAST_SEEK,
+		SETTING_VALUE_BOOL,
+		{ .v_bool = TRUE },
+	},
+	{
+		// Megabytes of song data to keep in memory for playing from RAM, so recent songs are not read again
+		"RamCacheSize",
+		WF_SETTING_RAM_CACHE_SIZE,
+		SETTING_VALUE_INT,
+		{ .v_int = 256 },
+		{ .v_int = 0 },
+		{ .v_int = 16384 },
+	},
 
 	// Terminator
 	{ NULL }
@@ -944,6 +1035,22 @@ wf_settings_get_filter(void)
 	return filter;
 }
 
+/*
+ * Get the snapshot of the song picker settings, as taken by the last call of
+ * wf_settings_update_snapshot().
+ */
+const WfSettingsSnapshot *
+wf_settings_get_snapshot(void)
+{
+	if (SettingsData.snapshot.version == 0)
+	{
+		// No snapshot has been taken yet
+		wf_settings_update_snapshot();
+	}
+
+	return &SettingsData.snapshot;
+}
+
 WfSongEntries *
 wf_settings_get_song_entry_modifiers(void)
 {
@@ -1055,11 +1162,17 @@ wf_settings_static_get_struct(WfSettingType type)
 
 	g_return_val_if_fail(type > WF_SETTING_NONE && type < WF_SETTING_DEFINED, NULL);
 
+	// Settings are read on hot paths, so only search the tables once per type
+	if (SettingsData.static_index[type] != NULL)
+	{
+		return SettingsData.static_index[type];
+	}
+
 	for (sett = SettingsData.general_settings; sett != NULL && sett->name != NULL; sett++)
 	{
 		if (sett->setting == type)
 		{
-			return sett;
+			return SettingsData.static_index[type] = sett;
 		}
 	}
 
@@ -1067,7 +1180,7 @@ wf_settings_static_get_struct(WfSettingType type)
 	{
 		if (sett->setting == type)
 		{
-			return sett;
+			return SettingsData.static_index[type] = sett;
 		}
 	}
 
@@ -1075,7 +1188,7 @@ wf_settings_static_get_struct(WfSettingType type)
 	{
 		if (sett->setting == type)
 		{
-			return sett;
+			return SettingsData.static_index[type] = sett;
 		}
 	}
 
@@ -1087,7 +1200,6 @@ wf_settings_dynamic_register(const gchar *name, const gchar *group, WfSettingVal
 {
 	WfDynamicSetting *setting;
 	GKeyFile *key_file = SettingsData.key_file;
-	GSList *list;
 	guint32 id;
 	gboolean res = FALSE;
 
@@ -1098,45 +1210,47 @@ wf_settings_dynamic_register(const gchar *name, const gchar *group, WfSettingVal
 	// Generate an id from the name
 	id = wf_settings_get_id_from_name(name);
 
-	// Check each registered setting
-	for (list = SettingsData.registered_settings; list != NULL; list = list->next)
+	// Check if the setting with this id already exists
+	setting = wf_settings_dynamic_get_struct(id);
+
+	if (setting != NULL)
 	{
-		setting = list->data;
+		g_info("Setting with name <%s> is already registered", name);
 
-		// Check if the setting with this id already exists
-		if (setting != NULL && setting->id == id)
+		if (g_strcmp0(setting->name, name) != 0)
 		{
-			g_info("Setting with name <%s> is already registered", name);
+			g_warning("Setting with name <%s> has the same id as <%s>", name, setting->name);
+		}
 
-			if (setting->type == type)
-			{
-				// Set new default value
-				if (type == SETTING_VALUE_STR)
-				{
-					g_free(setting->value.v_str);
-					setting->value.v_str = value->v_str;
-				}
-				else
-				{
-					setting->value = *value;
-				}
-			}
-			else
-			{
-				// Type is not right; do not set the new value
-				g_warning("Setting with name <%s> does not have the right type", name);
-			}
+		if (setting->type == type)
+		{
+			// Set new default value
+			wf_settings_dynamic_set_value(setting, value, TRUE /* take */);
+		}
+		else
+		{
+			// Type is not right; do not set the new value
+			g_warning("Setting with name <%s> does not have the right type", name);
 
-			// Skip registration and return known id
-			return setting->id;
+			wf_settings_value_destruct(type, value);
 		}
+
+		// Skip registration and return known id
+		return setting->id;
+	}
+
+	if (SettingsData.registered_settings == NULL)
+	{
+		SettingsData.registered_settings = g_ptr_array_new_with_free_func(wf_settings_dynamic_free_cb);
+		SettingsData.registered_index = g_hash_table_new(g_direct_hash, g_direct_equal);
 	}
 
 	// Allocate new structure
 	setting = (WfDynamicSetting *) g_slice_alloc0(sizeof(WfDynamicSetting));
 
-	// Add to the registration list
-	SettingsData.registered_settings = g_slist_append(SettingsData.registered_settings, setting);
+	// Add to the registration list and index
+	g_ptr_array_add(SettingsData.registered_settings, setting);
+	g_hash_table_insert(SettingsData.registered_index, GUINT_TO_POINTER(id), setting);
 
 	// Set basic information
 	setting->id = id;
@@ -1214,30 +1328,37 @@ wf_settings_dynamic_register_str(const gchar *name, const gchar *group, const gc
 	return wf_settings_dynamic_register(name, group, SETTING_VALUE_STR, &v);
 }
 
+static WfDynamicSetting *
+wf_settings_dynamic_get_struct(guint32 id)
+{
+	if (SettingsData.registered_index == NULL)
+	{
+		return NULL;
+	}
+
+	return g_hash_table_lookup(SettingsData.registered_index, GUINT_TO_POINTER(id));
+}
+
 static gboolean
 wf_settings_dynamic_get_value_by_id(guint32 id, WfSettingValue *value_rv)
 {
 	WfDynamicSetting *setting;
-	GSList *list;
 
 	g_return_val_if_fail(id != 0, FALSE);
 	g_return_val_if_fail(value_rv != NULL, FALSE);
 
-	for (list = SettingsData.registered_settings; list != NULL; list = list->next)
-	{
-		setting = list->data;
+	setting = wf_settings_dynamic_get_struct(id);
 
-		if (setting != NULL && setting->id == id)
-		{
-			*value_rv = setting->value;
+	if (setting == NULL)
+	{
+		g_warning("Setting with id <%u> not found", id);
 
-			return TRUE;
-		}
+		return FALSE;
 	}
 
-	g_warning("Setting with id <%d> not found", id);
+	*value_rv = setting->value;
 
-	return FALSE;
+	return TRUE;
 }
 
 gboolean
@@ -1292,33 +1413,161 @@ static void
 wf_settings_dynamic_set_value_by_id(guint32 id, WfSettingValueType type, WfSettingValue *value)
 {
 	WfDynamicSetting *setting;
-	GSList *list;
 
 	g_return_if_fail(id != 0);
 	g_return_if_fail(value != NULL);
 	g_return_if_fail(type != SETTING_VALUE_NONE);
 
-	for (list = SettingsData.registered_settings; list != NULL; list = list->next)
+	setting = wf_settings_dynamic_get_struct(id);
+
+	if (setting == NULL)
+	{
+		g_warning("Setting with id <%u> not found", id);
+
+		return;
+	}
+
+	if (setting->type != type)
 	{
-		setting = list->data;
+		g_warning("Setting with name <%s> does not have the right type", setting->name);
+
+		return;
+	}
+
+	wf_settings_dynamic_set_value(setting, value, FALSE /* take */);
+}
 
-		if (setting != NULL && setting->id == id)
+// Set a new value and notify subscribers if it is different from the old one
+static void
+wf_settings_dynamic_set_value(WfDynamicSetting *setting, WfSettingValue *value, gboolean take)
+{
+	if (wf_settings_value_is_equal(setting->type, &setting->value, value))
+	{
+		if (take)
 		{
-			if (type == SETTING_VALUE_STR)
+			wf_settings_value_destruct(setting->type, value);
+		}
+
+		return;
+	}
+
+	if (setting->type == SETTING_VALUE_STR)
+	{
+		g_free(setting->value.v_str);
+		setting->value.v_str = take ? value->v_str : g_strdup(value->v_str);
+	}
+	else
+	{
+		setting->value = *value;
+	}
+
+	wf_settings_dynamic_notify(setting);
+}
+
+static void
+wf_settings_dynamic_notify(WfDynamicSetting *setting)
+{
+	WfSettingSubscriber *subscriber;
+	GSList *list, *next;
+
+	/*
+	 * Subscribers are allowed to disconnect any subscriber from their
+	 * callback, including themselves.  These are only marked while notifying
+	 * and removed once all notifications are done.
+	 */
+	setting->notifying++;
+
+	for (list = setting->subscribers; list != NULL; list = list->next)
+	{
+		subscriber = list->data;
+
+		if (subscriber->func != NULL)
+		{
+			subscriber->func(setting->id, subscriber->user_data);
+		}
+	}
+
+	setting->notifying--;
+
+	if (setting->notifying > 0)
+	{
+		return;
+	}
+
+	for (list = setting->subscribers; list != NULL; list = next)
+	{
+		next = list->next;
+		subscriber = list->data;
+
+		if (subscriber->func == NULL)
+		{
+			setting->subscribers = g_slist_delete_link(setting->subscribers, list);
+			wf_settings_subscriber_free_cb(subscriber);
+		}
+	}
+}
+
+guint
+wf_settings_dynamic_connect_changed(guint32 id, WfFuncSettingChanged cb_func, gpointer user_data)
+{
+	WfDynamicSetting *setting;
+	WfSettingSubscriber *subscriber;
+
+	g_return_val_if_fail(cb_func != NULL, 0);
+
+	setting = wf_settings_dynamic_get_struct(id);
+
+	if (setting == NULL)
+	{
+		g_warning("Setting with id <%u> not found", id);
+
+		return 0;
+	}
+
+	subscriber = g_slice_new0(WfSettingSubscriber);
+	subscriber->handler_id = ++SettingsData.last_handler_id;
+	subscriber->func = cb_func;
+	subscriber->user_data = user_data;
+
+	setting->subscribers = g_slist_append(setting->subscribers, subscriber);
+
+	return subscriber->handler_id;
+}
+
+void
+wf_settings_dynamic_disconnect_changed(guint32 id, guint handler_id)
+{
+	WfDynamicSetting *setting;
+	WfSettingSubscriber *subscriber;
+	GSList *list;
+
+	setting = wf_settings_dynamic_get_struct(id);
+
+	if (setting == NULL)
+	{
+		return;
+	}
+
+	for (list = setting->subscribers; list != NULL; list = list->next)
+	{
+		subscriber = list->data;
+
+		if (subscriber->handler_id == handler_id)
+		{
+			if (setting->notifying > 0)
 			{
-				g_free(setting->value.v_str);
-				setting->value.v_str = g_strdup(value->v_str);
+				// Still iterated over, see wf_settings_dynamic_notify()
+				subscriber->func = NULL;
 			}
 			else
 			{
-				setting->value = *value;
+				setting->subscribers = g_slist_delete_link(setting->subscribers, list);
+				wf_settings_subscriber_free_cb(subscriber);
 			}
 
 			return;
 		}
 	}
-
-	g_warning("Setting with id <%d> not found", id);
 }
 
 void
@@ -1568,11 +1817,11 @@ wf_settings_update_static(GKeyFile *key_file, WfStaticSetting *settings, const g
 }
 
 static void
-wf_settings_update_dynamic(GKeyFile *key_file, GSList *settings)
+wf_settings_update_dynamic(GKeyFile *key_file, GPtrArray *settings)
 {
 	WfSettingValue value;
 	WfDynamicSetting *sett;
-	GSList *list;
+	guint i;
 
 	g_return_if_fail(key_file != NULL);
 
@@ -1581,9 +1830,9 @@ wf_settings_update_dynamic(GKeyFile *key_file, GSList *settings)
 		return;
 	}
 
-	for (list = settings; list != NULL; list = list->next)
+	for (i = 0; i < settings->len; i++)
 	{
-		sett = list->data;
+		sett = g_ptr_array_index(settings, i);
 
 		// Reset union data
 		memset(&value, 0, sizeof(value));
@@ -1668,6 +1917,7 @@ wf_settings_read_file(void)
 
 	// Now extract the known settings from the key file
 	wf_settings_extract_keyfile(SettingsData.key_file);
+	wf_settings_update_snapshot();
 
 	return TRUE;
 }
@@ -1702,6 +1952,19 @@ wf_settings_queue_write(void)
 	SettingsData.write_queued = TRUE;
 }
 
+// Take a new snapshot of the song picker settings, after they have been updated
+void
+wf_settings_update_snapshot(void)
+{
+	WfSettingsSnapshot *snapshot = &SettingsData.snapshot;
+
+	snapshot->filter = *wf_settings_get_filter();
+	snapshot->entries = *wf_settings_get_song_entry_modifiers();
+
+	// Never use 0, that means no snapshot has been taken
+	snapshot->version = MAX(snapshot->version + 1, 1);
+}
+
 void
 wf_settings_write_if_queued(void)
 {
@@ -1835,6 +2098,34 @@ wf_settings_keyfile_write(GKeyFile *key_file, const gchar *file_path)
 	return res;
 }
 
+static gboolean
+wf_settings_value_is_equal(WfSettingValueType type, const WfSettingValue *a, const WfSettingValue *b)
+{
+	switch (type)
+	{
+		case SETTING_VALUE_BOOL:
+			return (!a->v_bool == !b->v_bool);
+		case SETTING_VALUE_ENUM:
+			return (a->v_enum == b->v_enum);
+		case SETTING_VALUE_INT:
+			return (a->v_int == b->v_int);
+		case SETTING_VALUE_INT64:
+			return (a->v_int64 == b->v_int64);
+		case SETTING_VALUE_UINT64:
+			return (a->v_uint64 == b->v_uint64);
+		case SETTING_VALUE_DOUBLE:
+			return (a->v_double == b->v_double);
+		case SETTING_VALUE_STR:
+			return (g_strcmp0(a->v_str, b->v_str) == 0);
+		case SETTING_VALUE_NONE:
+		case SETTING_VALUE_DEFINED:
+			g_warn_if_reached();
+			break;
+	}
+
+	return FALSE;
+}
+
 /* MODULE UTILITIES END */
 
 /* DESTRUCTORS BEGIN */
@@ -1861,9 +2152,17 @@ wf_settings_dynamic_free_cb(gpointer data)
 	g_free(setting->name);
 	g_free(setting->group);
 
+	g_slist_free_full(setting->subscribers, wf_settings_subscriber_free_cb);
+
 	g_slice_free1(sizeof(WfDynamicSetting), setting);
 }
 
+static void
+wf_settings_subscriber_free_cb(gpointer data)
+{
+	g_slice_free(WfSettingSubscriber, data);
+}
+
 void
 wf_settings_finalize(void)
 {
@@ -1876,7 +2175,15 @@ wf_settings_finalize(void)
 	wf_memory_clear_key_file(&SettingsData.key_file);
 
 	// Free all dynamically registered settings
-	g_slist_free_full(SettingsData.registered_settings, wf_settings_dynamic_free_cb);
+	if (SettingsData.registered_index != NULL)
+	{
+		g_hash_table_destroy(SettingsData.registered_index);
+	}
+
+	if (SettingsData.registered_settings != NULL)
+	{
+		g_ptr_array_free(SettingsData.registered_settings, TRUE);
+	}
 
 	// Reset all data
 	SettingsData = (WfSettingsDetails) { 0 };
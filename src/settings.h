@@ -41,6 +41,7 @@ G_BEGIN_DECLS
 /* MODULE TYPES BEGIN */
 
 typedef enum _WfSettingType WfSettingType;
+typedef enum _WfReplayGainMode WfReplayGainMode;
 
 enum _WfSettingType
 {
@@ -90,9 +91,30 @@ enum _WfSettingType
 	WF_SETTING_MOD_SKIPCOUNT_MULTI,
 	WF_SETTING_MOD_LASTPLAYED_MULTI,
 
+	// The values are part of the ABI, so settings added later go here
+	WF_SETTING_GAPLESS_PLAYBACK,
+	WF_SETTING_REPLAY_GAIN,
+	WF_SETTING_REPLAY_GAIN_PRE_AMP,
+	WF_SETTING_CROSSFADE_DURATION,
+	WF_SETTING_COMPRESS_LIBRARY,
+	WF_SETTING_WARM_UP_PIPELINE,
+	WF_SETTING_FAST_SEEK,
+	WF_SETTING_RAM_CACHE_SIZE,
+
 	WF_SETTING_DEFINED /* Validation checker */
 };
 
+// Which gain of the ReplayGain tags to apply, for %WF_SETTING_REPLAY_GAIN
+enum _WfReplayGainMode
+{
+	WF_REPLAY_GAIN_OFF,
+	WF_REPLAY_GAIN_TRACK,
+	WF_REPLAY_GAIN_ALBUM
+};
+
+// Called after the value of a dynamic setting has changed
+typedef void (*WfFuncSettingChanged) (guint32 id, gpointer user_data);
+
 /* MODULE TYPES END */
 
 /* CONSTRUCTOR PROTOTYPES BEGIN */
@@ -146,6 +168,9 @@ void wf_settings_dynamic_set_uint64_by_id(guint32 id, guint64 v_uint64);
 void wf_settings_dynamic_set_double_by_id(guint32 id, gdouble v_double);
 void wf_settings_dynamic_set_str_by_id(guint32 id, const gchar *v_str);
 
+guint wf_settings_dynamic_connect_changed(guint32 id, WfFuncSettingChanged cb_func, gpointer user_data);
+void wf_settings_dynamic_disconnect_changed(guint32 id, guint handler_id);
+
 gboolean wf_settings_read_file(void);
 gboolean wf_settings_write(void);
 void wf_settings_queue_write(void);
@@ -26,6 +26,8 @@
 
 #include <glib.h>
 
+#include <woofer/intelligence.h>
+
 /* INCLUDES END */
 
 G_BEGIN_DECLS
@@ -34,6 +36,21 @@ G_BEGIN_DECLS
 /* DEFINES END */
 
 /* MODULE TYPES BEGIN */
+
+typedef struct _WfSettingsSnapshot WfSettingsSnapshot;
+
+/*
+ * Copy of the song picker settings, taken when the settings have been updated.
+ * It is not changed afterwards; a new snapshot gets a new version, so anything
+ * derived from a snapshot can be kept until the version changes.
+ */
+struct _WfSettingsSnapshot
+{
+	guint version;
+	WfSongFilter filter;
+	WfSongEntries entries;
+};
+
 /* MODULE TYPES END */
 
 /* CONSTRUCTOR PROTOTYPES BEGIN */
@@ -43,9 +60,15 @@ void wf_settings_init(void);
 /* CONSTRUCTOR PROTOTYPES END */
 
 /* GETTER/SETTER PROTOTYPES BEGIN */
+
+const WfSettingsSnapshot * wf_settings_get_snapshot(void);
+
 /* GETTER/SETTER PROTOTYPES END */
 
 /* FUNCTION PROTOTYPES BEGIN */
+
+void wf_settings_update_snapshot(void);
+
 /* FUNCTION PROTOTYPES END */
 
 /* UTILITY PROTOTYPES BEGIN */
@@ -28,6 +28,7 @@
 /* INCLUDES BEGIN */
 
 // Library includes
+#include <string.h>
 #include <glib.h>
 #include <glib-object.h>
 #include <gio/gio.h>
@@ -44,7 +45,9 @@
 #include <woofer/settings.h>
 #include <woofer/utils.h>
 #include <woofer/characters.h>
+#include <woofer/library_search.h>
 #include <woofer/memory.h>
+#include <woofer/ring.h>
 #include <woofer/tweaks.h>
 
 // Resource includes
@@ -100,11 +103,73 @@
 // Search string of the prefix indicator
 #define WF_SONG_PREFIX "$PREFIX"
 
+// Amount of private structures allocated at once
+#define WF_SONG_PRIV_BLOCK_SIZE 1024
+
+// Amount of songs that keep their #GFile around after it was asked for
+#define WF_SONG_FILE_CACHE_LIMIT 16
+
+// Size of the slot a cached string is kept in, long enough for most phrases
+#define WF_SONG_STRING_SLOT 32
+
 /* DEFINES END */
 
 /* CUSTOM TYPES BEGIN */
 
 typedef enum _WfProp WfProp;
+typedef struct _WfSongDirectory WfSongDirectory;
+typedef struct _WfSongLocation WfSongLocation;
+typedef struct _WfSongFile WfSongFile;
+typedef struct _WfSongString WfSongString;
+typedef struct _WfSongStrings WfSongStrings;
+
+// Directory shared by all songs in it, so its path is only stored once
+struct _WfSongDirectory
+{
+	gchar *path; // Unescaped URI of the directory, including the final slash
+	guint refs; // Amount of songs in this directory
+	gboolean uses_prefix; // %TRUE if the path starts with the global song prefix
+	WfSong *songs; // First song in this directory, the others follow through directory_next
+};
+
+// Location of a song, also the key of the URI index
+struct _WfSongLocation
+{
+	WfSongDirectory *directory; // Shared directory entry
+	gchar *name; // Only filename including extension
+};
+
+// A formatted value, kept in place so a string handed out never moves
+struct _WfSongString
+{
+	gchar slot[WF_SONG_STRING_SLOT]; // Text, if it fits
+	gchar *overflow; // Buffer for text that does not fit in the slot, or %NULL
+	gsize overflow_size;
+	GSList *retired; // Smaller buffers the overflow grew out of
+	const gchar *text; // The slot, the overflow or %NULL if there is no text
+	gboolean valid; // %FALSE if it has to be formatted (again)
+	gint64 expires; // When a relative phrase would read differently
+};
+
+/*
+ * Formatted values of a song, for views that show them on every redraw.  Only
+ * allocated for songs that are actually shown, in a single block with a slot
+ * for each value.  The relative phrases are kept until the moment they would
+ * read differently.  A value without text is cached as well.
+ */
+struct _WfSongStrings
+{
+	WfSongString duration;
+	WfSongString last_played;
+	WfSongString played_on;
+};
+
+// #GFile of a recently used song
+struct _WfSongFile
+{
+	WfSong *song; // Not referenced; the entry is removed when the location changes
+	GFile *file;
+};
 
 struct _WfSongPrivate
 {
@@ -113,25 +178,29 @@ struct _WfSongPrivate
 
 	WfSongStatus status; // Current item's status
 	gint64 fs_modified; // Timestamp of last modification in filesystem
-	gboolean uses_prefix; // %TRUE if the URI uses the global song prefix
 	gboolean in_list; // %TRUE if currently in the library
 	gboolean queued; // %TRUE if the song is in the queue
 	gboolean stop_after_playing; // %TRUE if the playback should stop after this song
 
-	GFile *file; // #GFile container (used for file operations)
-	gchar *uri; // Full URI (location)
-	gchar *name; // Only filename including extension
-	gchar *display_name; // Filename to be shown in interface
+	WfSongLocation location; // Directory and filename, together the URI
+	WfSong *directory_prev; // Previous song in the same directory
+	WfSong *directory_next; // Next song in the same directory
+	gchar *display_name; // Filename to be shown in interface, if different from the filename
+	gchar *plain_uri; // Only built for wf_song_get_plain_uri(), %NULL until asked for
+	GFile *file; // Only created for wf_song_get_file(), %NULL until asked for
 	gchar *tag; // ID (text representation of the hash)
 	guint32 song_hash; // ID (number representation of the hash)
 	guint32 artist_hash; // Hash of the artist string
 	guint32 album_artist_hash; // Hash of the album artist string
 	gint64 updated; // Timestamp of the last metadata update
 
-	gchar *title; // Title read from metadata
-	gchar *artist; // Artist read from metadata
-	gchar *album_artist; // Album artist read from metadata
-	gchar *album; // Album read from metadata
+	const gchar *title; // Title read from metadata (interned)
+	const gchar *artist; // Artist read from metadata (interned)
+	const gchar *album_artist; // Album artist read from metadata (interned)
+	const gchar *album; // Album read from metadata (interned)
+	const gchar *title_key; // Sort key of the title (interned)
+	const gchar *artist_key; // Sort key of the artist (interned)
+	const gchar *album_key; // Sort key of the album (interned)
 	gint number; // Track number read from metadata
 	gint duration; // Duration read from metadata (secconds)
 
@@ -140,6 +209,8 @@ struct _WfSongPrivate
 	gint playcount; // Amount of play times
 	gint skipcount; // Amount of skips
 	gint64 lastplayed; // Timestamp of the last playtime
+
+	WfSongStrings *strings; // Cached formatted values, %NULL until asked for
 };
 
 // Property enum that can be converted to a #guint for easy property lookup
@@ -174,6 +245,35 @@ enum _WfProp
 	WF_PROP_COUNT
 };
 
+typedef struct _WfInternedStr WfInternedStr;
+
+// Entry of the string pool, the string itself is stored in the same block
+struct _WfInternedStr
+{
+	guint refs; // Amount of songs using this string
+	gchar str[]; // The string data (used as key in the pool)
+};
+
+typedef struct _WfSongEvents WfSongEvents;
+
+// The list of songs as it was before wf_song_stash_all()
+struct _WfSongStash
+{
+	WfSong *first;
+	WfSong *last;
+	gint count;
+	GHashTable *index;
+	GHashTable *uri_index;
+	WfSongColumnCounts counts;
+};
+
+struct _WfSongEvents
+{
+	WfFuncSongAdded added;
+	WfFuncSongRemoved removed;
+	WfFuncSongsCleared cleared;
+};
+
 /* CUSTOM TYPES END */
 
 /* FUNCTION PROTOTYPES BEGIN */
@@ -197,12 +297,23 @@ static void wf_song_set_modified(WfSong *song, gint64 timestamp);
 static void wf_song_get_property(GObject *object, guint property_id, GValue *value, GParamSpec *pspec);
 static void wf_song_set_property(GObject *object, guint property_id, const GValue *value, GParamSpec *pspec);
 
-static void wf_song_clear_gfile(WfSong *song);
 static void wf_song_clear_location(WfSong *song);
 
 static WfSong * wf_song_prepend_song(WfSong *song);
 static WfSong * wf_song_append_song(WfSong *song);
 
+static void wf_song_index_add(WfSong *song, gboolean replace);
+static void wf_song_index_remove(WfSong *song);
+static guint wf_song_location_hash_cb(gconstpointer key);
+static gboolean wf_song_location_equal_cb(gconstpointer a, gconstpointer b);
+
+static void wf_song_forget_file(WfSong *song);
+
+static WfSongDirectory * wf_song_directory_get(WfSong *song, const gchar *path);
+static void wf_song_directory_release(WfSong *song, WfSongDirectory *directory);
+static void wf_song_split_uri(const gchar *uri, gchar **directory_rv, const gchar **name_rv);
+static gchar * wf_song_build_uri(const WfSong *song, const gchar *prefix);
+
 static void wf_song_set_new_metadata(WfSong *song, WfSongMetadata *metadata);
 static void wf_song_update_fs_info(WfSong *song);
 
@@ -214,9 +325,22 @@ static gchar * wf_song_new_tag(guint32 hash);
 
 static gboolean wf_song_has_prefix(const gchar *uri);
 
-static gchar * wf_song_last_played_to_string(gint64 last_played);
-static gchar * wf_song_last_played_to_played_on_string(gint64 last_played, gboolean include_time);
+static WfSongStrings * wf_song_get_strings(const WfSong *song);
+static void wf_song_string_set(WfSongString *string, gchar *value, gint64 expires);
+static gchar * wf_song_duration_to_string(gint duration);
+static gchar * wf_song_last_played_to_string(gint64 last_played, gint64 now, gint64 *expires_rv);
+static gchar * wf_song_last_played_to_played_on_string(gint64 last_played, gboolean include_time, gint64 now, gint64 *expires_rv);
+
+static void wf_song_count_columns(const WfSong *song, gint delta);
 
+static void wf_song_set_sort_key(const gchar **key, const gchar *str);
+static const gchar * wf_song_intern_str(const gchar *str);
+static void wf_song_release_str(const gchar *str);
+
+static void wf_song_file_free(gpointer data);
+static void wf_song_string_clear(WfSongString *string);
+static void wf_song_strings_free(WfSongStrings *strings);
+static void wf_song_free_list(WfSong *first);
 static void wf_song_finalize(gpointer object);
 
 /* FUNCTION PROTOTYPES END */
@@ -228,6 +352,35 @@ static WfSong *FirstSong;
 static WfSong *LastSong;
 static gint SongCount = 0;
 
+// Index of all songs in the list, keyed by their hash
+static GHashTable *SongIndex;
+
+// Index of all songs in the list, keyed by their #WfSongLocation
+static GHashTable *SongUriIndex;
+
+// Directories of all songs, keyed by their path (#WfSongDirectory)
+static GHashTable *SongDirectories;
+
+// Most recently used #WfSongFile entries, most recent at the front
+static WfRing *SongFiles;
+G_LOCK_DEFINE_STATIC(SongFiles);
+
+// Callbacks for changes of the list
+static WfSongEvents SongEvents = { 0 };
+
+// While %TRUE, the list is a replacement that is not announced before wf_song_stash_drop()
+static gboolean SongStaging = FALSE;
+
+// Amount of songs in the list with a value for each column
+static WfSongColumnCounts ColumnCounts = { 0 };
+
+// Allocator of the private structures of all songs
+static WfMemorySlab *SongPrivSlab;
+
+// Pool of metadata strings shared by all songs, keyed by the string itself
+static GHashTable *InternedStrings;
+G_LOCK_DEFINE_STATIC(InternedStrings);
+
 // Array of pointers to property specifications
 static GParamSpec *WfProperties[WF_PROP_COUNT];
 
@@ -329,7 +482,7 @@ wf_song_class_init(gpointer g_class, gpointer class_data)
 	/**
 	 * WfSong:file:
 	 *
-	 * The #GFile for the song.  When %NULL, it will be created.
+	 * A #GFile for the location of the song, created when read.
 	 *
 	 * Since: 0.1
 	 **/
@@ -764,10 +917,37 @@ wf_song_add_priv_struct(WfSong *song)
 
 	if (song != NULL && song->priv == NULL)
 	{
-		song->priv = g_slice_alloc0(sizeof(WfSongPrivate));
+		/*
+		 * Take them from a slab, so songs that are created after each
+		 * other (like when reading the library) have their data close
+		 * together, which makes walking the whole list a lot faster.
+		 */
+		if (SongPrivSlab == NULL)
+		{
+			SongPrivSlab = wf_memory_slab_new(sizeof(WfSongPrivate), WF_SONG_PRIV_BLOCK_SIZE);
+		}
+
+		song->priv = wf_memory_slab_alloc0(SongPrivSlab);
 	}
 }
 
+/*
+ * wf_song_get_column_counts:
+ *
+ * Gets the amount of songs in the library that have a value to show in each
+ * of the columns.  These are kept up to date when songs are added, removed
+ * or get new metadata, so no scan of the library is needed.
+ *
+ * Returns: (transfer none): the column counters
+ *
+ * Since: 0.3
+ */
+const WfSongColumnCounts *
+wf_song_get_column_counts(void)
+{
+	return &ColumnCounts;
+}
+
 /**
  * wf_song_get_count:
  *
@@ -859,17 +1039,12 @@ wf_song_get_prev(const WfSong *song)
 WfSong *
 wf_song_get_by_hash(guint32 hash)
 {
-	WfSong *song;
-
-	for (song = FirstSong; song != NULL; song = song->priv->next)
+	if (SongIndex == NULL)
 	{
-		if (song->priv->song_hash == hash)
-		{
-			return song;
-		}
+		return NULL;
 	}
 
-	return NULL;
+	return g_hash_table_lookup(SongIndex, GUINT_TO_POINTER(hash));
 }
 
 /**
@@ -996,11 +1171,15 @@ wf_song_move_after(WfSong *song, WfSong *other_song)
 guint32
 wf_song_get_hash(WfSong *song)
 {
+	gchar *uri;
+
 	g_return_val_if_fail(WF_IS_SONG(song), 0);
 
 	if (song->priv->song_hash == 0)
 	{
-		song->priv->song_hash = wf_chars_get_hash(song->priv->uri);
+		uri = wf_song_build_uri(song, NULL /* prefix */);
+		song->priv->song_hash = wf_chars_get_hash(uri);
+		g_free(uri);
 	}
 
 	return song->priv->song_hash;
@@ -1024,11 +1203,6 @@ wf_song_get_tag(WfSong *song)
 
 	g_return_val_if_fail(WF_IS_SONG(song), NULL);
 
-	if (song->priv->song_hash == 0)
-	{
-		song->priv->song_hash = wf_chars_get_hash(song->priv->uri);
-	}
-	
 	if (song->priv->tag == NULL)
 	{
 		hash = wf_song_get_hash(song);
@@ -1074,11 +1248,38 @@ wf_song_set_tag(WfSong *song, const gchar *tag)
 static void
 wf_song_set_tag_take_str(WfSong *song, gchar *tag)
 {
+	guint64 hash;
+	gchar *end;
+
 	g_return_if_fail(WF_IS_SONG(song));
 
 	g_free(song->priv->tag);
 
 	song->priv->tag = tag;
+
+	if (tag == NULL || !g_str_has_prefix(tag, "song-"))
+	{
+		return;
+	}
+
+	// A song that got another ID because of a hash collision keeps it
+	hash = g_ascii_strtoull(tag + strlen("song-"), &end, 16);
+
+	if (*end != '\0' || hash == 0 || hash > G_MAXUINT32 || hash == song->priv->song_hash)
+	{
+		return;
+	}
+
+	if (song->priv->in_list)
+	{
+		wf_song_index_remove(song);
+		song->priv->song_hash = (guint32) hash;
+		wf_song_index_add(song, FALSE);
+	}
+	else
+	{
+		song->priv->song_hash = (guint32) hash;
+	}
 }
 
 /*
@@ -1151,6 +1352,8 @@ wf_song_set_metadata_updated_now(WfSong *song)
  * wf_song_get_file:
  *
  * Gets the associated #GFile for a given song.  See the #WfSong:file property.
+ * The song keeps the #GFile once this has been called, until its location
+ * changes; use wf_song_dup_file() to get one without that.
  *
  * Returns: (transfer none): the #GFile of a song
  *
@@ -1159,30 +1362,114 @@ wf_song_set_metadata_updated_now(WfSong *song)
 GFile *
 wf_song_get_file(WfSong *song)
 {
+	g_return_val_if_fail(WF_IS_SONG(song), NULL);
+
+	if (song->priv->file == NULL)
+	{
+		song->priv->file = wf_song_dup_file(song);
+	}
+
+	return song->priv->file;
+}
+
+/**
+ * wf_song_dup_file:
+ *
+ * Gets a new reference to a #GFile for the location of a given song.  Most
+ * songs are never opened, so only the last few songs that were asked for keep
+ * their #GFile; for others it is created from the URI.
+ *
+ * Returns: (transfer full): the #GFile of a song.  Unref it with
+ * g_object_unref() when no longer needed.
+ *
+ * Since: 0.3
+ **/
+GFile *
+wf_song_dup_file(WfSong *song)
+{
+	WfSongFile *entry = NULL;
+	GFile *file;
 	gchar *uri;
+	guint length, x;
+	gboolean found = FALSE;
 
 	g_return_val_if_fail(WF_IS_SONG(song), NULL);
 
-	// Create a new #GFile if not present
-	if (song->priv->file == NULL)
+	G_LOCK(SongFiles);
+
+	if (SongFiles == NULL)
+	{
+		SongFiles = wf_ring_new(WF_SONG_FILE_CACHE_LIMIT, wf_song_file_free);
+	}
+
+	length = wf_ring_get_length(SongFiles);
+
+	for (x = 0; x < length && !found; x++)
+	{
+		entry = wf_ring_get(SongFiles, x);
+		found = (entry->song == song);
+	}
+
+	if (!found)
 	{
 		uri = wf_song_get_uri(song);
 
-		song->priv->file = g_file_new_for_uri(uri);
+		entry = g_new(WfSongFile, 1);
+		entry->song = song;
+		entry->file = g_file_new_for_uri(uri);
 
 		g_free(uri);
+
+		// Drops the least recently used entry if full
+		wf_ring_push_front(SongFiles, entry);
+	}
+	else if (entry != wf_ring_get(SongFiles, 0))
+	{
+		// Move it to the front
+		wf_ring_remove(SongFiles, entry);
+		wf_ring_push_front(SongFiles, entry);
+	}
+
+	file = g_object_ref(entry->file);
+
+	G_UNLOCK(SongFiles);
+
+	return file;
+}
+
+// Drop the #GFile of @song if it is kept, for example because its location changes
+static void
+wf_song_forget_file(WfSong *song)
+{
+	WfSongFile *entry;
+	guint length, x;
+
+	G_LOCK(SongFiles);
+
+	length = (SongFiles == NULL) ? 0 : wf_ring_get_length(SongFiles);
+
+	for (x = 0; x < length; x++)
+	{
+		entry = wf_ring_get(SongFiles, x);
+
+		if (entry->song == song)
+		{
+			wf_ring_remove(SongFiles, entry);
+			wf_song_file_free(entry);
+
+			break;
+		}
 	}
 
-	// Sink its reference and return the object
-	return g_object_ref_sink(song->priv->file);
+	G_UNLOCK(SongFiles);
 }
 
 /*
  * wf_song_set_file:
- * @file: (transfer full): the #GFile to use
+ * @file: (transfer none): the #GFile to use
  *
- * Sets the associated #GFile of a given song.  It will take ownership of the
- * #GObject and set other song properties.
+ * Sets the location of a given song to that of @file.  No reference to @file
+ * is kept.
  *
  * Since: 0.1
  */
@@ -1197,23 +1484,32 @@ wf_song_set_file(WfSong *song, GFile *file)
 	// First clear the old location
 	wf_song_clear_location(song);
 
-	// Take ownership and (possibly) increase reference count
-	song->priv->file = (GFile *) g_object_ref_sink(file);
-
-	// Take a copy of the URI
 	uri = g_file_get_uri(file);
-
-	// Set required information
 	wf_song_set_uri_internal(song, uri);
-
-	// Free the original copy
 	g_free(uri);
 }
 
+/*
+ * wf_song_move_to_file:
+ * @file: (transfer none): the new location of the song
+ *
+ * Change the location of a song, for example after its file has been renamed
+ * or moved.  The tag is kept, so the song can still be found in the library
+ * file and keeps its statistics.
+ */
 void
-wf_song_refresh_locations(WfSong *song)
+wf_song_move_to_file(WfSong *song, GFile *file)
 {
-	wf_song_clear_gfile(song);
+	gchar *tag;
+
+	g_return_if_fail(WF_IS_SONG(song));
+	g_return_if_fail(G_IS_FILE(file));
+
+	tag = g_strdup(wf_song_get_tag(song));
+
+	wf_song_set_file(song, file);
+
+	song->priv->tag = tag;
 }
 
 /**
@@ -1229,36 +1525,17 @@ wf_song_refresh_locations(WfSong *song)
 gchar *
 wf_song_get_uri(const WfSong *song)
 {
-	const gchar *prefix;
-	const gchar *str;
-	gchar *uri;
-
 	g_return_val_if_fail(WF_IS_SONG(song), NULL);
 
-	prefix = wf_settings_static_get_str(WF_SETTING_SONG_PREFIX);
-
-	if (prefix != NULL && song->priv->uses_prefix)
-	{
-		// Only use the part of the string after the prefix
-		str = song->priv->uri+strlen(WF_SONG_PREFIX);
-
-		// Replace the prefix text with the actual prefix text
-		uri = g_strjoin(NULL /* separator */, prefix, str, NULL /* terminator */);
-	}
-	else
-	{
-		// Just use the URI as is
-		uri = g_strdup(song->priv->uri);
-	}
-
-	return uri;
+	return wf_song_build_uri(song, wf_settings_static_get_str(WF_SETTING_SONG_PREFIX));
 }
 
 /**
  * wf_song_get_plain_uri:
  *
  * Gets the URI for a given song, without resolving any prefixes.  See the
- * #WfSong:plain-uri property.
+ * #WfSong:plain-uri property.  The song only keeps the full URI once this has
+ * been called; use wf_song_dup_plain_uri() to get a copy without that.
  *
  * Returns: (transfer none): the plain URI of a song
  *
@@ -1269,7 +1546,31 @@ wf_song_get_plain_uri(const WfSong *song)
 {
 	g_return_val_if_fail(WF_IS_SONG(song), NULL);
 
-	return song->priv->uri;
+	if (song->priv->plain_uri == NULL)
+	{
+		song->priv->plain_uri = wf_song_build_uri(song, NULL /* prefix */);
+	}
+
+	return song->priv->plain_uri;
+}
+
+/**
+ * wf_song_dup_plain_uri:
+ *
+ * Gets a copy of the URI for a given song, without resolving any prefixes.
+ * Unlike wf_song_get_plain_uri(), the song does not keep the URI.
+ *
+ * Returns: (transfer full): the plain URI of a song.  Free it with g_free()
+ * when no longer needed.
+ *
+ * Since: 0.3
+ **/
+gchar *
+wf_song_dup_plain_uri(const WfSong *song)
+{
+	g_return_val_if_fail(WF_IS_SONG(song), NULL);
+
+	return wf_song_build_uri(song, NULL /* prefix */);
 }
 
 /**
@@ -1296,18 +1597,53 @@ wf_song_set_uri(WfSong *song, const gchar *uri)
 static void
 wf_song_set_uri_internal(WfSong *song, const gchar *uri)
 {
+	const gchar *name;
+	gchar *directory;
+	gchar *utf8;
+
 	g_return_if_fail(song != NULL);
 	g_return_if_fail(uri != NULL);
 
+	// The hash is about to change, so take the song out of the index first
+	if (song->priv->in_list)
+	{
+		if (SongEvents.removed != NULL && !SongStaging)
+		{
+			SongEvents.removed(song);
+		}
+
+		wf_song_index_remove(song);
+	}
+
 	// Unescape special characters to UTF-8
-	song->priv->uri = g_uri_unescape_string(uri, NULL /* illegal_characters */);
+	utf8 = g_uri_unescape_string(uri, NULL /* illegal_characters */);
+
+	if (utf8 != NULL)
+	{
+		// Songs in the same directory share its path
+		wf_song_split_uri(utf8, &directory, &name);
+
+		song->priv->location.directory = wf_song_directory_get(song, directory);
+		song->priv->location.name = g_strdup(name);
+		song->priv->song_hash = wf_chars_get_hash(utf8);
+
+		g_free(directory);
+		g_free(utf8);
+	}
+
+	if (song->priv->in_list)
+	{
+		wf_song_index_add(song, FALSE);
 
-	// Allocate and set new values
-	song->priv->name = g_path_get_basename(song->priv->uri);
-	song->priv->song_hash = wf_chars_get_hash(song->priv->uri);
+		// The filename is searchable as well
+		wf_library_search_song_changed(song);
 
-	// Figure out if the URI uses the global song prefix
-	song->priv->uses_prefix = wf_song_has_prefix(song->priv->uri);
+		// Remotes know the song by its hash, so it shows up as a new track
+		if (SongEvents.added != NULL && !SongStaging)
+		{
+			SongEvents.added(song, song->priv->prev);
+		}
+	}
 }
 
 /**
@@ -1324,7 +1660,7 @@ wf_song_get_name(const WfSong *song)
 {
 	g_return_val_if_fail(WF_IS_SONG(song), NULL);
 
-	return song->priv->name;
+	return song->priv->location.name;
 }
 
 /**
@@ -1346,7 +1682,7 @@ wf_song_get_name_not_empty(const WfSong *song)
 	g_return_val_if_fail(WF_IS_SONG(song), unknown_str);
 	g_return_val_if_fail(wf_song_is_valid(song), invalid_str);
 
-	return (song->priv->name != NULL) ? song->priv->name : unknown_str;
+	return (song->priv->location.name != NULL) ? song->priv->location.name : unknown_str;
 }
 
 /*
@@ -1365,7 +1701,8 @@ wf_song_set_display_name(WfSong *song, const gchar *name)
 
 	g_free(song->priv->display_name);
 
-	song->priv->display_name = g_strdup(name);
+	// Usually it is the filename, which is stored already
+	song->priv->display_name = (g_strcmp0(name, song->priv->location.name) == 0) ? NULL : g_strdup(name);
 }
 
 /**
@@ -1383,7 +1720,8 @@ wf_song_get_display_name(const WfSong *song)
 {
 	g_return_val_if_fail(WF_IS_SONG(song), NULL);
 
-	return song->priv->display_name;
+	// Only stored if it is not the same as the filename
+	return (song->priv->display_name != NULL) ? song->priv->display_name : song->priv->location.name;
 }
 
 /*
@@ -1432,11 +1770,21 @@ wf_song_get_modified(const WfSong *song)
 void
 wf_song_set_title(WfSong *song, const gchar *title)
 {
+	const gchar *old;
+
 	g_return_if_fail(WF_IS_SONG(song));
 
-	g_free(song->priv->title);
+	wf_song_count_columns(song, -1);
+
+	// Intern first, as @title may be the current value
+	old = song->priv->title;
+	song->priv->title = wf_song_intern_str(title);
+	wf_song_count_columns(song, 1);
+
+	wf_song_set_sort_key(&song->priv->title_key, song->priv->title);
+	wf_song_release_str(old);
 
-	song->priv->title = g_strdup(title);
+	wf_library_search_song_changed(song);
 }
 
 /**
@@ -1456,6 +1804,15 @@ wf_song_get_title(const WfSong *song)
 	return song->priv->title;
 }
 
+// Get the key to sort the songs by #WfSong:title, see wf_chars_get_sort_key()
+const gchar *
+wf_song_get_title_key(const WfSong *song)
+{
+	g_return_val_if_fail(WF_IS_SONG(song), NULL);
+
+	return song->priv->title_key;
+}
+
 /*
  * wf_song_set_artist:
  * @artist: (transfer none): the artist to set
@@ -1467,12 +1824,22 @@ wf_song_get_title(const WfSong *song)
 void
 wf_song_set_artist(WfSong *song, const gchar *artist)
 {
+	const gchar *old;
+
 	g_return_if_fail(WF_IS_SONG(song));
 
-	g_free(song->priv->artist);
+	wf_song_count_columns(song, -1);
+
+	// Intern first, as @artist may be the current value
+	old = song->priv->artist;
+	song->priv->artist = wf_song_intern_str(artist);
+	wf_song_count_columns(song, 1);
 
-	song->priv->artist = g_strdup(artist);
-	song->priv->artist_hash = wf_chars_get_hash_converted(artist);
+	wf_song_set_sort_key(&song->priv->artist_key, song->priv->artist);
+	song->priv->artist_hash = wf_chars_get_hash_converted(song->priv->artist);
+	wf_song_release_str(old);
+
+	wf_library_search_song_changed(song);
 }
 
 /**
@@ -1492,6 +1859,15 @@ wf_song_get_artist(const WfSong *song)
 	return song->priv->artist;
 }
 
+// Get the key to sort the songs by #WfSong:artist, see wf_chars_get_sort_key()
+const gchar *
+wf_song_get_artist_key(const WfSong *song)
+{
+	g_return_val_if_fail(WF_IS_SONG(song), NULL);
+
+	return song->priv->artist_key;
+}
+
 /*
  * wf_song_set_album_artist:
  * @artist: (transfer none): the album artist to set
@@ -1504,12 +1880,17 @@ wf_song_get_artist(const WfSong *song)
 void
 wf_song_set_album_artist(WfSong *song, const gchar *artist)
 {
+	const gchar *old;
+
 	g_return_if_fail(WF_IS_SONG(song));
 
-	g_free(song->priv->album_artist);
+	// Intern first, as @artist may be the current value
+	old = song->priv->album_artist;
+	song->priv->album_artist = wf_song_intern_str(artist);
+	song->priv->album_artist_hash = wf_chars_get_hash_converted(song->priv->album_artist);
+	wf_song_release_str(old);
 
-	song->priv->album_artist = g_strdup(artist);
-	song->priv->album_artist_hash = wf_chars_get_hash_converted(artist);
+	wf_library_search_song_changed(song);
 }
 
 /**
@@ -1557,6 +1938,22 @@ wf_song_get_artist_hash(const WfSong *song)
 	}
 }
 
+/*
+ * wf_song_set_artist_hash:
+ * @hash: the hash as returned by wf_song_get_artist_hash()
+ *
+ * Sets the artist hash without setting the artist strings it is generated
+ * from, for songs of which these strings are only set later.  Setting the
+ * artist or album artist generates the hashes again.
+ */
+void
+wf_song_set_artist_hash(WfSong *song, guint32 hash)
+{
+	g_return_if_fail(WF_IS_SONG(song));
+
+	song->priv->album_artist_hash = hash;
+}
+
 /*
  * wf_song_set_album:
  * @album: (transfer none): the album to set
@@ -1568,11 +1965,21 @@ wf_song_get_artist_hash(const WfSong *song)
 void
 wf_song_set_album(WfSong *song, const gchar *album)
 {
+	const gchar *old;
+
 	g_return_if_fail(WF_IS_SONG(song));
 
-	g_free(song->priv->album);
+	wf_song_count_columns(song, -1);
+
+	// Intern first, as @album may be the current value
+	old = song->priv->album;
+	song->priv->album = wf_song_intern_str(album);
+	wf_song_count_columns(song, 1);
+
+	wf_song_set_sort_key(&song->priv->album_key, song->priv->album);
+	wf_song_release_str(old);
 
-	song->priv->album = g_strdup(album);
+	wf_library_search_song_changed(song);
 }
 
 /**
@@ -1592,6 +1999,15 @@ wf_song_get_album(const WfSong *song)
 	return song->priv->album;
 }
 
+// Get the key to sort the songs by #WfSong:album, see wf_chars_get_sort_key()
+const gchar *
+wf_song_get_album_key(const WfSong *song)
+{
+	g_return_val_if_fail(WF_IS_SONG(song), NULL);
+
+	return song->priv->album_key;
+}
+
 /*
  * wf_song_set_track_number:
  * @number: the track number to set
@@ -1607,7 +2023,9 @@ wf_song_set_track_number(WfSong *song, gint number)
 
 	if (number >= 0)
 	{
+		wf_song_count_columns(song, -1);
 		song->priv->number = number;
+		wf_song_count_columns(song, 1);
 	}
 }
 
@@ -1644,7 +2062,14 @@ wf_song_set_duration_seconds(WfSong *song, gint seconds)
 
 	if (seconds >= 0)
 	{
+		wf_song_count_columns(song, -1);
 		song->priv->duration = seconds;
+		wf_song_count_columns(song, 1);
+
+		if (song->priv->strings != NULL)
+		{
+			song->priv->strings->duration.valid = FALSE;
+		}
 	}
 }
 
@@ -1703,38 +2128,39 @@ wf_song_get_duration(const WfSong *song)
 gchar *
 wf_song_get_duration_string(const WfSong *song)
 {
-	const gint one_hour = 60 * 60, one_min = 60;
-	gint dur, secs = 0, mins = 0, hours = 0;
-	gchar *str;
+	g_return_val_if_fail(WF_IS_SONG(song), NULL);
+
+	return g_strdup(wf_song_peek_duration_string(song));
+}
+
+/**
+ * wf_song_peek_duration_string:
+ *
+ * Same as wf_song_get_duration_string(), but the string is kept by the song,
+ * so asking for it again does not format or allocate it again.  This is meant
+ * for views that draw many songs at once.
+ *
+ * Returns: (transfer none) (nullable): the duration of a song as a string.  It
+ * stays valid as long as @song, but reads differently once the duration
+ * changes.
+ *
+ * Since: 0.3
+ **/
+const gchar *
+wf_song_peek_duration_string(const WfSong *song)
+{
+	WfSongStrings *strings;
 
 	g_return_val_if_fail(WF_IS_SONG(song), NULL);
 
-	dur = song->priv->duration;
+	strings = wf_song_get_strings(song);
 
-	if (dur <= 1)
+	if (!strings->duration.valid)
 	{
-		return NULL;
-	}
-	else
-	{
-		if (dur < one_hour)
-		{
-			mins = dur / one_min; // Rounded
-			secs = dur - (mins * one_min);
-
-			str = g_strdup_printf("%d:%2d", mins, secs);
-		}
-		else
-		{
-			hours = dur / one_hour; // Rounded
-			mins = (dur - (hours * one_hour)) / one_min; // Rounded
-			secs = dur - (hours * one_hour) - (mins * one_min);
-
-			str = g_strdup_printf("%d:%2d:%2d", hours, mins, secs);
-		}
+		wf_song_string_set(&strings->duration, wf_song_duration_to_string(song->priv->duration), G_MAXINT64);
 	}
 
-	return str;
+	return strings->duration.text;
 }
 
 /**
@@ -1901,6 +2327,12 @@ wf_song_set_last_played(WfSong *song, gint64 lastplayed)
 	g_return_if_fail(WF_IS_SONG(song));
 
 	song->priv->lastplayed = lastplayed;
+
+	if (song->priv->strings != NULL)
+	{
+		song->priv->strings->last_played.valid = FALSE;
+		song->priv->strings->played_on.valid = FALSE;
+	}
 }
 
 /**
@@ -1935,15 +2367,45 @@ wf_song_get_last_played(const WfSong *song)
  **/
 gchar *
 wf_song_get_played_on_as_string(const WfSong *song)
+{
+	g_return_val_if_fail(WF_IS_SONG(song), NULL);
+
+	return g_strdup(wf_song_peek_played_on_string(song));
+}
+
+/**
+ * wf_song_peek_played_on_string:
+ *
+ * Same as wf_song_get_played_on_as_string(), but the string is kept by the
+ * song and only formatted again once it would read differently.
+ *
+ * Returns: (transfer none): the moment of the last play as a string.  It stays
+ * valid as long as @song, but may read differently after the next call for
+ * this song.
+ *
+ * Since: 0.3
+ **/
+const gchar *
+wf_song_peek_played_on_string(const WfSong *song)
 {
 	const gboolean include_time = TRUE;
-	gint64 last_played;
+	WfSongStrings *strings;
+	gchar *played_on;
+	gint64 expires;
+	gint64 now;
 
 	g_return_val_if_fail(WF_IS_SONG(song), NULL);
 
-	last_played = wf_song_get_last_played(song);
+	strings = wf_song_get_strings(song);
+	now = wf_utils_time_now();
+
+	if (!strings->played_on.valid || now >= strings->played_on.expires)
+	{
+		played_on = wf_song_last_played_to_played_on_string(song->priv->lastplayed, include_time, now, &expires);
+		wf_song_string_set(&strings->played_on, played_on, expires);
+	}
 
-	return wf_song_last_played_to_played_on_string(last_played, include_time);
+	return strings->played_on.text;
 }
 
 /**
@@ -1960,13 +2422,44 @@ wf_song_get_played_on_as_string(const WfSong *song)
 gchar *
 wf_song_get_last_played_as_string(const WfSong *song)
 {
-	gint64 last_played;
+	g_return_val_if_fail(WF_IS_SONG(song), NULL);
+
+	return g_strdup(wf_song_peek_last_played_string(song));
+}
+
+/**
+ * wf_song_peek_last_played_string:
+ *
+ * Same as wf_song_get_last_played_as_string(), but the string is kept by the
+ * song.  Relative phrases such as "2 days ago" are only formatted again once
+ * they would read differently, so views can ask for it on every redraw.
+ *
+ * Returns: (transfer none): the time since the last play as a string.  It
+ * stays valid as long as @song, but may read differently after the next call
+ * for this song.
+ *
+ * Since: 0.3
+ **/
+const gchar *
+wf_song_peek_last_played_string(const WfSong *song)
+{
+	WfSongStrings *strings;
+	gchar *last_played;
+	gint64 expires;
+	gint64 now;
 
 	g_return_val_if_fail(WF_IS_SONG(song), NULL);
 
-	last_played = wf_song_get_last_played(song);
+	strings = wf_song_get_strings(song);
+	now = wf_utils_time_now();
+
+	if (!strings->last_played.valid || now >= strings->last_played.expires)
+	{
+		last_played = wf_song_last_played_to_string(song->priv->lastplayed, now, &expires);
+		wf_song_string_set(&strings->last_played, last_played, expires);
+	}
 
-	return wf_song_last_played_to_string(last_played);
+	return strings->last_played.text;
 }
 
 /**
@@ -1985,7 +2478,7 @@ wf_song_uses_prefix(const WfSong *song)
 {
 	g_return_val_if_fail(WF_IS_SONG(song), FALSE);
 
-	return song->priv->uses_prefix;
+	return (song->priv->location.directory != NULL && song->priv->location.directory->uses_prefix);
 }
 
 /**
@@ -2115,6 +2608,24 @@ wf_song_get_status(const WfSong *song)
 
 /* MODULE FUNCTIONS BEGIN */
 
+void
+wf_song_connect_event_added(WfFuncSongAdded cb_func)
+{
+	SongEvents.added = cb_func;
+}
+
+void
+wf_song_connect_event_removed(WfFuncSongRemoved cb_func)
+{
+	SongEvents.removed = cb_func;
+}
+
+void
+wf_song_connect_event_cleared(WfFuncSongsCleared cb_func)
+{
+	SongEvents.cleared = cb_func;
+}
+
 /**
  * wf_song_is_valid:
  *
@@ -2131,7 +2642,7 @@ wf_song_is_valid(const WfSong *song)
 {
 	if (!WF_IS_SONG(song) ||
 	    song->priv == NULL ||
-	    song->priv->uri == NULL)
+	    song->priv->location.name == NULL)
 	{
 		return FALSE;
 	}
@@ -2152,56 +2663,146 @@ wf_song_is_valid(const WfSong *song)
 gboolean
 wf_song_is_unique(WfSong *song)
 {
-	WfSong *item;
-
 	g_return_val_if_fail(WF_IS_SONG(song), FALSE);
 
-	for (item = FirstSong; item != NULL; item = song->priv->next)
+	// Songs in the list are also present in the index
+	return !song->priv->in_list;
+}
+
+/*
+ * wf_song_get_by_uri:
+ * @uri: the URI to look for
+ *
+ * Find the song in the list with the given location.
+ *
+ * Returns: (transfer none) (nullable): the song, or %NULL if not found
+ */
+WfSong *
+wf_song_get_by_uri(const gchar *uri)
+{
+	WfSongLocation location;
+	WfSong *song = NULL;
+	gchar *directory;
+	gchar *utf8;
+
+	g_return_val_if_fail(uri != NULL, NULL);
+
+	if (SongUriIndex == NULL)
+	{
+		return NULL;
+	}
+
+	// Compare the locations themselves, so a hash collision is never a match
+	utf8 = g_uri_unescape_string(uri, NULL /* illegal_characters */);
+
+	if (utf8 != NULL)
 	{
-		if (song == item) // Compare pointer
+		wf_song_split_uri(utf8, &directory, (const gchar **) &location.name);
+
+		// Without a song in the directory, no song can have this location
+		location.directory = g_hash_table_lookup(SongDirectories, directory);
+
+		if (location.directory != NULL)
 		{
-			return FALSE;
+			song = g_hash_table_lookup(SongUriIndex, &location);
 		}
+
+		g_free(directory);
+		g_free(utf8);
 	}
 
-	return TRUE;
+	return song;
 }
 
 /*
- * wf_song_is_unique_uri:
- * @uri: (transfer none): the URI to check
+ * wf_song_get_in_directory:
+ * @uri: the URI of a directory
  *
- * Checks if no song present in the song library already has the given URI.
- *
- * Returns: %TRUE if the URI is unique, %FALSE otherwise
+ * Find the songs in the library that are inside the directory with the given
+ * location, including its subdirectories.  Only the directories that hold
+ * songs are compared, not every song.
  *
- * Since: 0.1
+ * Returns: (transfer container) (element-type WfSong): the songs, in no
+ * particular order.  Free the list with g_list_free().
  */
-gboolean
-wf_song_is_unique_uri(const gchar *uri)
+GList *
+wf_song_get_in_directory(const gchar *uri)
 {
-	WfSong *item;
+	WfSongDirectory *directory;
+	GHashTableIter iter;
+	GList *songs = NULL;
+	WfSong *song;
+	const gchar *prefix;
+	gchar *resolved;
 	gchar *utf8;
-	guint32 song_hash;
-	guint32 hash;
+	gchar *path;
+	gpointer value;
 
-	g_return_val_if_fail(uri != NULL, FALSE);
+	g_return_val_if_fail(uri != NULL, NULL);
+
+	if (SongDirectories == NULL)
+	{
+		return NULL;
+	}
 
+	// Directory paths are unescaped and end with a slash
 	utf8 = g_uri_unescape_string(uri, NULL /* illegal_characters */);
-	hash = wf_chars_get_hash(utf8);
-	g_free(utf8);
 
-	for (item = FirstSong; item != NULL; item = item->priv->next)
+	if (utf8 == NULL)
+	{
+		return NULL;
+	}
+
+	path = g_str_has_suffix(utf8, "/") ? g_strdup(utf8) : g_strconcat(utf8, "/", NULL /* terminator */);
+	prefix = wf_settings_static_get_str(WF_SETTING_SONG_PREFIX);
+
+	g_hash_table_iter_init(&iter, SongDirectories);
+
+	while (g_hash_table_iter_next(&iter, NULL /* key */, &value))
 	{
-		song_hash = wf_song_get_hash(item);
+		directory = value;
+
+		// Compare the actual location, like wf_song_get_uri() gives it
+		resolved = (prefix != NULL && directory->uses_prefix) ? g_strconcat(prefix, directory->path + strlen(WF_SONG_PREFIX), NULL /* terminator */) : NULL;
 
-		if (hash == song_hash)
+		if (g_str_has_prefix((resolved != NULL) ? resolved : directory->path, path))
 		{
-			return FALSE;
+			for (song = directory->songs; song != NULL; song = song->priv->directory_next)
+			{
+				if (song->priv->in_list)
+				{
+					songs = g_list_prepend(songs, song);
+				}
+			}
 		}
+
+		g_free(resolved);
 	}
 
-	return TRUE;
+	g_free(path);
+	g_free(utf8);
+
+	return songs;
+}
+
+/*
+ * wf_song_is_unique_uri:
+ * @uri: (transfer none): the URI to check
+ *
+ * Checks if no song present in the song library already has the given URI.
+ * The URIs themselves are compared, so a song whose hash collides with that of
+ * another song can still be added; it gets another ID.
+ *
+ * Returns: %TRUE if the URI is unique, %FALSE otherwise
+ *
+ * Since: 0.1
+ */
+gboolean
+wf_song_is_unique_uri(const gchar *uri)
+{
+	g_return_val_if_fail(uri != NULL, FALSE);
+
+	return (wf_song_get_by_uri(uri) == NULL);
 }
 
 /*
@@ -2292,10 +2893,10 @@ wf_song_get_property(GObject *object, guint property_id, GValue *value, GParamSp
 			g_value_set_enum(value, wf_song_get_status(song));
 			break;
 		case WF_PROP_FILE:
-			g_value_set_object(value, wf_song_get_file(song));
+			g_value_take_object(value, wf_song_dup_file(song));
 			break;
 		case WF_PROP_URI:
-			g_value_set_string(value, wf_song_get_uri(song));
+			g_value_take_string(value, wf_song_get_uri(song));
 			break;
 		case WF_PROP_NAME:
 			g_value_set_string(value, wf_song_get_name(song));
@@ -2409,22 +3010,6 @@ wf_song_reset_stats(WfSong *song)
 	song->priv->stop_after_playing = FALSE;
 }
 
-/*
- * wf_song_clear_gfile:
- *
- * Clear the local #GFile instance.
- *
- * Since: 0.2
- */
-static void
-wf_song_clear_gfile(WfSong *song)
-{
-	g_return_if_fail(WF_IS_SONG(song));
-
-	// Free old values if set
-	wf_memory_clear_object((GObject **) &song->priv->file);
-}
-
 /*
  * wf_song_clear_location:
  *
@@ -2437,14 +3022,26 @@ wf_song_clear_location(WfSong *song)
 {
 	g_return_if_fail(WF_IS_SONG(song));
 
-	// Clear the #GFile
-	wf_song_clear_gfile(song);
+	wf_song_forget_file(song);
+	g_clear_object(&song->priv->file);
+
+	// The URI index uses the location as a key, so take it out before freeing it
+	if (song->priv->in_list)
+	{
+		wf_song_index_remove(song);
+	}
+
+	if (song->priv->location.directory != NULL)
+	{
+		wf_song_directory_release(song, song->priv->location.directory);
+		song->priv->location.directory = NULL;
+	}
 
 	// Free old values if set
-	g_free(song->priv->uri);
-	g_free(song->priv->name);
-	g_free(song->priv->display_name);
-	g_free(song->priv->tag);
+	wf_memory_clear_str(&song->priv->location.name);
+	wf_memory_clear_str(&song->priv->display_name);
+	wf_memory_clear_str(&song->priv->plain_uri);
+	wf_memory_clear_str(&song->priv->tag);
 }
 
 /*
@@ -2481,6 +3078,16 @@ wf_song_prepend_song(WfSong *song)
 	// Song is now present in the library
 	wf_song_ref_sink(song);
 	song->priv->in_list = TRUE;
+	wf_song_count_columns(song, 1);
+	wf_library_search_song_changed(song);
+
+	// The first song in the list wins if the location is there twice
+	wf_song_index_add(song, TRUE);
+
+	if (SongEvents.added != NULL && !SongStaging)
+	{
+		SongEvents.added(song, NULL /* song_before */);
+	}
 
 	return song;
 }
@@ -2519,6 +3126,15 @@ wf_song_append_song(WfSong *song)
 	// Song is now present in the library
 	wf_song_ref_sink(song);
 	song->priv->in_list = TRUE;
+	wf_song_count_columns(song, 1);
+	wf_library_search_song_changed(song);
+
+	wf_song_index_add(song, FALSE);
+
+	if (SongEvents.added != NULL && !SongStaging)
+	{
+		SongEvents.added(song, song->priv->prev);
+	}
 
 	return song;
 }
@@ -2672,6 +3288,15 @@ wf_song_remove(WfSong *song)
 
 	if (song->priv->in_list)
 	{
+		if (SongEvents.removed != NULL && !SongStaging)
+		{
+			SongEvents.removed(song);
+		}
+
+		wf_song_index_remove(song);
+		wf_song_count_columns(song, -1);
+		wf_library_search_song_removed(song);
+
 		// Song is now out of the library
 		song->priv->in_list = FALSE;
 		song->priv->prev = NULL;
@@ -2712,172 +3337,471 @@ wf_song_remove_all(void)
 
 	FirstSong = LastSong = NULL;
 	SongCount = 0;
-}
+	ColumnCounts = (WfSongColumnCounts) { 0 };
 
-// Update a song's metadata by providing a set of new values
-static void
-wf_song_set_new_metadata(WfSong *song, WfSongMetadata *metadata)
-{
-	guint uintValue;
-	guint64 uint64Value;
-	gchar *str;
+	wf_library_search_clear();
 
-	g_return_if_fail(metadata != NULL);
-	g_return_if_fail(song != NULL);
-	g_return_if_fail(WF_IS_SONG(song));
+	if (SongIndex != NULL)
+	{
+		g_hash_table_remove_all(SongIndex);
+		g_hash_table_remove_all(SongUriIndex);
+	}
 
-	uintValue = wf_song_metadata_get_track_number(metadata);
-	wf_song_set_track_number(song, uintValue);
+	if (SongEvents.cleared != NULL && !SongStaging)
+	{
+		SongEvents.cleared();
+	}
+}
 
-	uint64Value = wf_song_metadata_get_duration(metadata);
-	wf_song_set_duration_nanoseconds(song, uint64Value);
+/*
+ * wf_song_stash_all:
+ *
+ * Set all songs of the library aside, leaving an empty library to read a
+ * replacement into.  Songs added from now on are not announced.  Either
+ * wf_song_stash_restore() or wf_song_stash_drop() must follow, before the main
+ * loop runs again.
+ *
+ * Returns: (transfer full): the songs that were set aside
+ */
+WfSongStash *
+wf_song_stash_all(void)
+{
+	WfSongStash *stash;
 
-	str = wf_song_metadata_get_title(metadata);
-	wf_song_set_title(song, str);
+	g_return_val_if_fail(!SongStaging, NULL);
 
-	str = wf_song_metadata_get_artist(metadata);
-	wf_song_set_artist(song, str);
+	stash = g_new0(WfSongStash, 1);
+	stash->first = FirstSong;
+	stash->last = LastSong;
+	stash->count = SongCount;
+	stash->index = SongIndex;
+	stash->uri_index = SongUriIndex;
+	stash->counts = ColumnCounts;
 
-	str = wf_song_metadata_get_album_artist(metadata);
-	wf_song_set_album_artist(song, str);
+	FirstSong = LastSong = NULL;
+	SongCount = 0;
+	SongIndex = SongUriIndex = NULL;
+	ColumnCounts = (WfSongColumnCounts) { 0 };
 
-	str = wf_song_metadata_get_album(metadata);
-	wf_song_set_album(song, str);
+	SongStaging = TRUE;
 
-	wf_song_set_metadata_updated_now(song);
+	return stash;
 }
 
-// Update a song's filesystem info by providing a #GFileInfo
+/*
+ * wf_song_stash_restore:
+ * @stash: (transfer full): the songs set aside by wf_song_stash_all()
+ *
+ * Drop the songs added since @stash was made and put the songs of @stash back,
+ * as if nothing happened.  Nothing is announced.
+ */
 void
-wf_song_set_fs_info(WfSong *song, GFileInfo *info)
+wf_song_stash_restore(WfSongStash *stash)
 {
-	const gchar *name;
-	gint64 seconds;
-	GDateTime *time;
-
-	g_return_if_fail(WF_IS_SONG(song));
-	g_return_if_fail(G_IS_FILE_INFO(info));
+	g_return_if_fail(stash != NULL && SongStaging);
 
-	// Get modification time
-	time = wf_tweaks_file_info_get_modification_date_time(info); // Compatibility call
-	seconds = g_date_time_to_unix(time);
-	wf_song_set_modified(song, seconds);
-	g_date_time_unref(time);
+	wf_song_free_list(FirstSong);
+	g_clear_pointer(&SongIndex, g_hash_table_unref);
+	g_clear_pointer(&SongUriIndex, g_hash_table_unref);
 
-	// Get display filename
-	name = g_file_info_get_display_name(info);
-	wf_song_set_display_name(song, name);
+	FirstSong = stash->first;
+	LastSong = stash->last;
+	SongCount = stash->count;
+	SongIndex = stash->index;
+	SongUriIndex = stash->uri_index;
+	ColumnCounts = stash->counts;
 
-	// Query successful, so song is available
-	wf_song_set_status(song, WF_SONG_AVAILABLE);
+	SongStaging = FALSE;
+	g_free(stash);
 }
 
-// Update the filesystem info of a song's file
-static void
-wf_song_update_fs_info(WfSong *song)
+/*
+ * wf_song_stash_drop:
+ * @stash: (transfer full): the songs set aside by wf_song_stash_all()
+ *
+ * Free the songs of @stash, keeping the songs added since as the library.  To
+ * whoever listens this looks like the library has been cleared and the new
+ * songs have been added one by one.
+ */
+void
+wf_song_stash_drop(WfSongStash *stash)
 {
-	GFile *file;
-	GFileInfo *info;
-	GError *err = NULL;
+	WfSong *song;
 
-	g_return_if_fail(WF_IS_SONG(song));
+	g_return_if_fail(stash != NULL && SongStaging);
 
-	file = wf_song_get_file(song);
-	info = g_file_query_info(file, WF_SONG_FILE_INFO, G_FILE_QUERY_INFO_NONE, NULL /* GCancellable */, &err);
+	wf_song_free_list(stash->first);
+	g_clear_pointer(&stash->index, g_hash_table_unref);
+	g_clear_pointer(&stash->uri_index, g_hash_table_unref);
 
-	if (err != NULL)
+	SongStaging = FALSE;
+	g_free(stash);
+
+	if (SongEvents.cleared != NULL)
 	{
-		// Failed to get the file information
-		g_message("%s", err->message);
+		SongEvents.cleared();
+	}
 
-		if (err->code == G_IO_ERROR_NOT_FOUND)
+	if (SongEvents.added != NULL)
+	{
+		for (song = FirstSong; song != NULL; song = song->priv->next)
 		{
-			wf_song_set_status(song, WF_SONG_NOT_FOUND);
-			wf_song_set_modified(song, -1);
+			SongEvents.added(song, song->priv->prev);
 		}
-
-		g_error_free(err);
-	}
-	else
-	{
-		wf_song_set_fs_info(song, info);
 	}
-
-	wf_memory_clear_object((GObject **) &info);
 }
 
-// Returns %TRUE if an attempt has been made to get the metadata from the file
-gboolean
-wf_song_update_metadata(WfSong *song, gboolean force)
+// Take the songs from @first onwards out of the library and the search, without announcing it
+static void
+wf_song_free_list(WfSong *first)
 {
-	const gchar *uri;
-	WfSongMetadata *metadata;
-	gboolean update = FALSE;
-	gint64 modified = 0, last_updated = 0;
-
-	g_return_val_if_fail(WF_IS_SONG(song), FALSE);
+	WfSong *song = first;
+	WfSong *next;
 
-	uri = wf_song_get_uri(song);
+	while (song != NULL)
+	{
+		next = song->priv->next;
 
-	wf_song_update_fs_info(song);
+		wf_library_search_song_removed(song);
 
-	if (force)
+		song->priv->in_list = FALSE;
+		song->priv->prev = NULL;
+		song->priv->next = NULL;
+
+		g_object_unref(song);
+
+		song = next;
+	}
+}
+
+/*
+ * wf_song_index_add:
+ * @song: the song to add
+ * @replace: whether to replace an existing song with the same location
+ *
+ * Add @song to the hash index, so it can be found by wf_song_get_by_hash() in
+ * constant time.  If another song already has its ID, @song is given the next
+ * free one.  The index does not hold a reference; songs are owned by the
+ * list itself.
+ */
+static void
+wf_song_index_add(WfSong *song, gboolean replace)
+{
+	WfSong *other;
+	gpointer key;
+	guint32 hash;
+	gchar *tag;
+
+	g_return_if_fail(WF_IS_SONG(song));
+
+	if (SongIndex == NULL)
 	{
-		// Update regardless
-		update = TRUE;
+		SongIndex = g_hash_table_new(g_direct_hash, g_direct_equal);
+		SongUriIndex = g_hash_table_new(wf_song_location_hash_cb, wf_song_location_equal_cb);
 	}
-	else
+
+	hash = wf_song_get_hash(song);
+
+	// Different URIs can have the same 32-bit hash; the song gets the next free ID then
+	while ((other = g_hash_table_lookup(SongIndex, GUINT_TO_POINTER(hash))) != NULL && other != song)
 	{
-		last_updated = wf_song_get_metadata_updated(song);
-		modified = wf_song_get_modified(song);
+		hash = (hash == G_MAXUINT32) ? 1 : hash + 1;
+	}
 
-		/*
-		 * Update if the file exists but the file information could not
-		 * be fetched or if the file has been modified since last
-		 * application metadata update.
-		 */
-		if (modified == -1)
-		{
-			update = FALSE;
-		}
-		else if (modified == 0 || last_updated <= modified)
-		{
-			update = TRUE;
-		}
-		else
+	if (hash != song->priv->song_hash)
+	{
+		g_debug("ID of song %s collides, using %x instead of %x", song->priv->location.name, hash, song->priv->song_hash);
+
+		// The tag has to follow, or both songs would share their group in the library file
+		tag = wf_song_new_tag(song->priv->song_hash);
+
+		if (song->priv->tag == NULL || g_str_equal(song->priv->tag, tag))
 		{
-			update = FALSE;
+			wf_song_set_tag_take_str(song, wf_song_new_tag(hash));
 		}
+
+		g_free(tag);
+
+		song->priv->song_hash = hash;
+	}
+
+	g_hash_table_insert(SongIndex, GUINT_TO_POINTER(hash), song);
+
+	/*
+	 * The locations themselves are indexed too, so a hash collision is never
+	 * taken for the same song.  The key is owned by the song, so it has to be
+	 * removed from the index before the location is freed.
+	 */
+	key = &song->priv->location;
+
+	if (song->priv->location.name != NULL && (replace || !g_hash_table_contains(SongUriIndex, key)))
+	{
+		g_hash_table_insert(SongUriIndex, key, song);
 	}
+}
+
+// Remove a song from the hash index, but only if it is the one indexed
+static void
+wf_song_index_remove(WfSong *song)
+{
+	gpointer key;
+
+	g_return_if_fail(WF_IS_SONG(song));
+
+	if (SongIndex == NULL)
+	{
+		return;
+	}
+
+	key = GUINT_TO_POINTER(song->priv->song_hash);
+
+	if (g_hash_table_lookup(SongIndex, key) == song)
+	{
+		g_hash_table_remove(SongIndex, key);
+	}
+
+	key = &song->priv->location;
+
+	if (song->priv->location.name != NULL && g_hash_table_lookup(SongUriIndex, key) == song)
+	{
+		g_hash_table_remove(SongUriIndex, key);
+	}
+}
+
+// Hash a location for the URI index, using the 64-bit hash of the name folded to a #guint
+static guint
+wf_song_location_hash_cb(gconstpointer key)
+{
+	const WfSongLocation *location = key;
+	guint64 hash = wf_chars_get_hash64(location->name);
+
+	return (guint) (hash ^ (hash >> 32)) ^ g_direct_hash(location->directory);
+}
+
+// Directories are shared, so equal directories are the same entry
+static gboolean
+wf_song_location_equal_cb(gconstpointer a, gconstpointer b)
+{
+	const WfSongLocation *loc_a = a;
+	const WfSongLocation *loc_b = b;
+
+	return (loc_a->directory == loc_b->directory && g_str_equal(loc_a->name, loc_b->name));
+}
+
+// Update a song's metadata by providing a set of new values
+static void
+wf_song_set_new_metadata(WfSong *song, WfSongMetadata *metadata)
+{
+	guint uintValue;
+	guint64 uint64Value;
+	gchar *str;
+
+	g_return_if_fail(metadata != NULL);
+	g_return_if_fail(song != NULL);
+	g_return_if_fail(WF_IS_SONG(song));
+
+	uintValue = wf_song_metadata_get_track_number(metadata);
+	wf_song_set_track_number(song, uintValue);
+
+	uint64Value = wf_song_metadata_get_duration(metadata);
+	wf_song_set_duration_nanoseconds(song, uint64Value);
+
+	str = wf_song_metadata_get_title(metadata);
+	wf_song_set_title(song, str);
+
+	str = wf_song_metadata_get_artist(metadata);
+	wf_song_set_artist(song, str);
+
+	str = wf_song_metadata_get_album_artist(metadata);
+	wf_song_set_album_artist(song, str);
+
+	str = wf_song_metadata_get_album(metadata);
+	wf_song_set_album(song, str);
+
+	wf_song_set_metadata_updated_now(song);
+}
+
+// Update a song's filesystem info by providing a #GFileInfo
+void
+wf_song_set_fs_info(WfSong *song, GFileInfo *info)
+{
+	const gchar *name;
+	gint64 seconds;
+	GDateTime *time;
+
+	g_return_if_fail(WF_IS_SONG(song));
+	g_return_if_fail(G_IS_FILE_INFO(info));
+
+	// Get modification time
+	time = wf_tweaks_file_info_get_modification_date_time(info); // Compatibility call
+	seconds = g_date_time_to_unix(time);
+	wf_song_set_modified(song, seconds);
+	g_date_time_unref(time);
+
+	// Get display filename
+	name = g_file_info_get_display_name(info);
+	wf_song_set_display_name(song, name);
+
+	// Query successful, so song is available
+	wf_song_set_status(song, WF_SONG_AVAILABLE);
+}
+
+// Update the filesystem info of a song's file
+static void
+wf_song_update_fs_info(WfSong *song)
+{
+	GFile *file;
+	GFileInfo *info;
+	GError *err = NULL;
 
-	if (update)
+	g_return_if_fail(WF_IS_SONG(song));
+
+	file = wf_song_dup_file(song);
+	info = g_file_query_info(file, WF_SONG_FILE_INFO, G_FILE_QUERY_INFO_NONE, NULL /* GCancellable */, &err);
+	g_object_unref(file);
+
+	if (err != NULL)
 	{
-		metadata = wf_song_metadata_get_for_uri(uri);
+		// Failed to get the file information
+		g_message("%s", err->message);
 
-		if (metadata == NULL)
+		if (err->code == G_IO_ERROR_NOT_FOUND)
 		{
-			return FALSE;
+			wf_song_set_file_missing(song);
 		}
-		else if (!wf_song_metadata_parse(metadata))
-		{
-			wf_song_metadata_free(metadata);
 
-			return FALSE;
-		}
-		else
-		{
-			wf_song_set_new_metadata(song, metadata);
-			wf_song_metadata_free(metadata);
+		g_error_free(err);
+	}
+	else
+	{
+		wf_song_set_fs_info(song, info);
+	}
 
-			return TRUE;
-		}
+	wf_memory_clear_object((GObject **) &info);
+}
+
+// Mark the file of a song as missing, as found out by a file query
+void
+wf_song_set_file_missing(WfSong *song)
+{
+	g_return_if_fail(WF_IS_SONG(song));
+
+	wf_song_set_status(song, WF_SONG_NOT_FOUND);
+	wf_song_set_modified(song, -1);
+}
+
+/*
+ * wf_song_needs_metadata_update:
+ * @force: whether to update regardless of the file modification time
+ *
+ * Refresh the file information of @song and check whether its metadata should
+ * be fetched again from the file.
+ *
+ * Returns: %TRUE if the metadata of @song should be updated
+ */
+gboolean
+wf_song_needs_metadata_update(WfSong *song, gboolean force)
+{
+	g_return_val_if_fail(WF_IS_SONG(song), FALSE);
+
+	wf_song_update_fs_info(song);
+
+	if (force)
+	{
+		// Update regardless
+		return TRUE;
+	}
+
+	return wf_song_metadata_is_outdated(song);
+}
+
+/*
+ * wf_song_metadata_is_outdated:
+ *
+ * Check whether the file of @song has been modified since its metadata was
+ * last fetched, going by the file information that is already known.  Use
+ * wf_song_needs_metadata_update() to refresh that information first.
+ *
+ * Returns: %TRUE if the metadata of @song should be updated
+ */
+gboolean
+wf_song_metadata_is_outdated(const WfSong *song)
+{
+	gint64 modified = 0, last_updated = 0;
+
+	g_return_val_if_fail(WF_IS_SONG(song), FALSE);
+
+	last_updated = wf_song_get_metadata_updated(song);
+	modified = wf_song_get_modified(song);
+
+	/*
+	 * Update if the file exists but the file information could not be
+	 * fetched or if the file has been modified since last application
+	 * metadata update.
+	 */
+	if (modified == -1)
+	{
+		return FALSE;
+	}
+	else if (modified == 0 || last_updated <= modified)
+	{
+		return TRUE;
 	}
 	else
+	{
+		return FALSE;
+	}
+}
+
+/*
+ * wf_song_apply_metadata:
+ * @metadata: (transfer none): parsed metadata to take the values from
+ *
+ * Set the metadata of @song to the values found in @metadata.  As this changes
+ * object properties, it should only be called from the main thread.
+ */
+void
+wf_song_apply_metadata(WfSong *song, WfSongMetadata *metadata)
+{
+	wf_song_set_new_metadata(song, metadata);
+}
+
+// Returns %TRUE if an attempt has been made to get the metadata from the file
+gboolean
+wf_song_update_metadata(WfSong *song, gboolean force)
+{
+	WfSongMetadata *metadata;
+	gchar *uri;
+
+	g_return_val_if_fail(WF_IS_SONG(song), FALSE);
+
+	if (!wf_song_needs_metadata_update(song, force))
 	{
 		// No need to update metadata, already up-to-date
 		return FALSE;
 	}
 
+	uri = wf_song_get_uri(song);
+	metadata = wf_song_metadata_get_for_uri(uri);
+	g_free(uri);
+
+	if (metadata == NULL)
+	{
+		return FALSE;
+	}
+	else if (!wf_song_metadata_parse(metadata))
+	{
+		wf_song_metadata_free(metadata);
+
+		return FALSE;
+	}
+	else
+	{
+		wf_song_set_new_metadata(song, metadata);
+		wf_song_metadata_free(metadata);
+
+		return TRUE;
+	}
 }
 
 /* MODULE FUNCTIONS END */
@@ -2934,10 +3858,213 @@ wf_song_has_prefix(const gchar *uri)
 	return g_str_has_prefix(uri, WF_SONG_PREFIX);
 }
 
+// Get the shared entry of the directory @path, adding @song to it
+static WfSongDirectory *
+wf_song_directory_get(WfSong *song, const gchar *path)
+{
+	WfSongDirectory *directory;
+
+	if (SongDirectories == NULL)
+	{
+		SongDirectories = g_hash_table_new(g_str_hash, g_str_equal);
+	}
+
+	directory = g_hash_table_lookup(SongDirectories, path);
+
+	if (directory == NULL)
+	{
+		directory = g_new0(WfSongDirectory, 1);
+		directory->path = g_strdup(path);
+		directory->uses_prefix = wf_song_has_prefix(path);
+
+		g_hash_table_insert(SongDirectories, directory->path, directory);
+	}
+
+	directory->refs++;
+
+	song->priv->directory_prev = NULL;
+	song->priv->directory_next = directory->songs;
+
+	if (directory->songs != NULL)
+	{
+		directory->songs->priv->directory_prev = song;
+	}
+
+	directory->songs = song;
+
+	return directory;
+}
+
+// Take @song out of its directory, freeing it when no song is left in it
+static void
+wf_song_directory_release(WfSong *song, WfSongDirectory *directory)
+{
+	g_return_if_fail(directory != NULL && directory->refs > 0);
+
+	if (song->priv->directory_prev != NULL)
+	{
+		song->priv->directory_prev->priv->directory_next = song->priv->directory_next;
+	}
+	else
+	{
+		directory->songs = song->priv->directory_next;
+	}
+
+	if (song->priv->directory_next != NULL)
+	{
+		song->priv->directory_next->priv->directory_prev = song->priv->directory_prev;
+	}
+
+	song->priv->directory_prev = NULL;
+	song->priv->directory_next = NULL;
+
+	directory->refs--;
+
+	if (directory->refs == 0)
+	{
+		g_hash_table_remove(SongDirectories, directory->path);
+
+		g_free(directory->path);
+		g_free(directory);
+	}
+}
+
+/*
+ * Split the unescaped @uri into the directory (including the final slash) and
+ * the filename, which points into @uri.  Free @directory_rv with g_free().
+ */
+static void
+wf_song_split_uri(const gchar *uri, gchar **directory_rv, const gchar **name_rv)
+{
+	const gchar *slash = strrchr(uri, '/');
+
+	if (slash == NULL)
+	{
+		*directory_rv = g_strdup("");
+		*name_rv = uri;
+	}
+	else
+	{
+		*directory_rv = g_strndup(uri, (gsize) (slash - uri) + 1);
+		*name_rv = slash + 1;
+	}
+}
+
+/*
+ * Put the location of @song back together.  If @prefix is non-%NULL, it
+ * replaces the prefix indicator of songs that use it.
+ */
+static gchar *
+wf_song_build_uri(const WfSong *song, const gchar *prefix)
+{
+	const WfSongLocation *location = &song->priv->location;
+
+	if (location->name == NULL)
+	{
+		return NULL;
+	}
+
+	if (prefix != NULL && location->directory->uses_prefix)
+	{
+		// Replace the prefix text with the actual prefix text
+		return g_strconcat(prefix, location->directory->path + strlen(WF_SONG_PREFIX), location->name, NULL /* terminator */);
+	}
+
+	return g_strconcat(location->directory->path, location->name, NULL /* terminator */);
+}
+
+// Get the cached strings of @song, allocating them the first time
+static WfSongStrings *
+wf_song_get_strings(const WfSong *song)
+{
+	if (song->priv->strings == NULL)
+	{
+		song->priv->strings = g_new0(WfSongStrings, 1);
+	}
+
+	return song->priv->strings;
+}
+
+/*
+ * Keep @value (taking ownership, may be %NULL) in @string until @expires.  The
+ * text is copied into the slot, or into the overflow buffer if it is too long.
+ * A buffer is never freed while @string is in use, as earlier callers may still
+ * hold on to its text; the overflow only grows, so few buffers are retired.
+ */
+static void
+wf_song_string_set(WfSongString *string, gchar *value, gint64 expires)
+{
+	gsize size;
+
+	if (value == NULL)
+	{
+		string->text = NULL;
+	}
+	else if ((size = strlen(value) + 1) <= sizeof(string->slot))
+	{
+		memcpy(string->slot, value, size);
+		string->text = string->slot;
+		g_free(value);
+	}
+	else if (size <= string->overflow_size)
+	{
+		memcpy(string->overflow, value, size);
+		string->text = string->overflow;
+		g_free(value);
+	}
+	else
+	{
+		if (string->overflow != NULL)
+		{
+			string->retired = g_slist_prepend(string->retired, string->overflow);
+		}
+
+		string->overflow = value;
+		string->overflow_size = size;
+		string->text = value;
+	}
+
+	string->valid = TRUE;
+	string->expires = expires;
+}
+
+// Format @duration (seconds) as described for wf_song_get_duration_string()
 static gchar *
-wf_song_last_played_to_string(gint64 last_played)
+wf_song_duration_to_string(gint duration)
+{
+	const gint one_hour = 60 * 60, one_min = 60;
+	gint dur = duration, secs = 0, mins = 0, hours = 0;
+	gchar *str;
+
+	if (dur <= 1)
+	{
+		return NULL;
+	}
+	else
+	{
+		if (dur < one_hour)
+		{
+			mins = dur / one_min; // Rounded
+			secs = dur - (mins * one_min);
+
+			str = g_strdup_printf("%d:%2d", mins, secs);
+		}
+		else
+		{
+			hours = dur / one_hour; // Rounded
+			mins = (dur - (hours * one_hour)) / one_min; // Rounded
+			secs = dur - (hours * one_hour) - (mins * one_min);
+
+			str = g_strdup_printf("%d:%2d:%2d", hours, mins, secs);
+		}
+	}
+
+	return str;
+}
+
+static gchar *
+wf_song_last_played_to_string(gint64 last_played, gint64 now, gint64 *expires_rv)
 {
-	const gint64 now = wf_utils_time_now();
 	const gint minute = 60;
 	const gint hour = minute * 60;
 	const gint day = hour * 24;
@@ -2954,6 +4081,7 @@ wf_song_last_played_to_string(gint64 last_played)
 		 * The statement above means: if the song has been played in the
 		 * first year before the UNIX Epoch, say it was never played.
 		 */
+		*expires_rv = G_MAXINT64;
 
 		return g_strdup_printf("Never");
 	}
@@ -2965,12 +4093,14 @@ wf_song_last_played_to_string(gint64 last_played)
 	if (time_since < 5)
 	{
 		// Within 5 seconds, say it was played now
+		*expires_rv = last_played + 5;
 
 		string = g_strdup_printf("Just now");
 	}
 	else if (time_since < minute)
 	{
 		// Within a minute, set the amount of seconds
+		*expires_rv = now + 1;
 
 		if (time_since == 1)
 		{
@@ -2986,6 +4116,7 @@ wf_song_last_played_to_string(gint64 last_played)
 		// Within one our, set the amount of minutes
 
 		x = wf_utils_floor(time_since / minute);
+		*expires_rv = last_played + MIN((gint64) (x + 1) * minute, hour);
 
 		if (x == 1)
 		{
@@ -3001,6 +4132,7 @@ wf_song_last_played_to_string(gint64 last_played)
 		// Within one full day, set the amount of hours
 
 		x = wf_utils_floor(time_since / hour);
+		*expires_rv = last_played + MIN((gint64) (x + 1) * hour, day);
 
 		if (x == 1)
 		{
@@ -3016,6 +4148,7 @@ wf_song_last_played_to_string(gint64 last_played)
 		// Within one full week, set the amount of days
 
 		x = wf_utils_floor(time_since / day);
+		*expires_rv = last_played + MIN((gint64) (x + 1) * day, week);
 
 		if (x == 1)
 		{
@@ -3031,6 +4164,7 @@ wf_song_last_played_to_string(gint64 last_played)
 		// Within one full month, set the amount of weeks
 
 		x = wf_utils_floor(time_since / week);
+		*expires_rv = last_played + MIN((gint64) (x + 1) * week, month);
 
 		if (x == 1)
 		{
@@ -3046,6 +4180,7 @@ wf_song_last_played_to_string(gint64 last_played)
 		// Within one full year, set the amount of months
 
 		x = wf_utils_floor(time_since / month);
+		*expires_rv = last_played + MIN((gint64) (x + 1) * month, year);
 
 		if (x == 1)
 		{
@@ -3061,6 +4196,7 @@ wf_song_last_played_to_string(gint64 last_played)
 		// It's been a long time, only mention years
 
 		x = wf_utils_floor(time_since / year);
+		*expires_rv = last_played + (gint64) (x + 1) * year;
 
 		if (x == 1)
 		{
@@ -3076,13 +4212,16 @@ wf_song_last_played_to_string(gint64 last_played)
 }
 
 static gchar *
-wf_song_last_played_to_played_on_string(gint64 last_played, gboolean include_time)
+wf_song_last_played_to_played_on_string(gint64 last_played, gboolean include_time, gint64 now, gint64 *expires_rv)
 {
 	const gint one_year = 60 * 60 * 24 * 365;
 	const gint half_year = one_year / 2;
 	GDateTime *date_time;
 	gchar *date, *string, *month_of_year;
-	gint64 time;
+	gint64 time = now;
+
+	// Only changes when the year starts being shown
+	*expires_rv = (last_played < one_year || (time - last_played) > half_year) ? G_MAXINT64 : last_played + half_year + 1;
 
 	if (last_played < one_year)
 	{
@@ -3090,7 +4229,6 @@ wf_song_last_played_to_played_on_string(gint64 last_played, gboolean include_tim
 	}
 	else
 	{
-		time = wf_utils_time_now();
 		date_time = g_date_time_new_from_unix_local(last_played);
 
 		// Get date_time vars
@@ -3100,6 +4238,8 @@ wf_song_last_played_to_played_on_string(gint64 last_played, gboolean include_tim
 		gint hour = g_date_time_get_hour(date_time);
 		gint minute = g_date_time_get_minute(date_time);
 
+		g_date_time_unref(date_time);
+
 		// Convert @month to a string
 		switch (month)
 		{
@@ -3172,10 +4312,166 @@ wf_song_last_played_to_played_on_string(gint64 last_played, gboolean include_tim
 	return date;
 }
 
+// Add @delta to the column counters for each column @song has a value for
+static void
+wf_song_count_columns(const WfSong *song, gint delta)
+{
+	if (!song->priv->in_list)
+	{
+		return;
+	}
+
+	if (song->priv->number > 0)
+	{
+		ColumnCounts.track_number += delta;
+	}
+
+	if (song->priv->title != NULL)
+	{
+		ColumnCounts.title += delta;
+	}
+
+	if (song->priv->artist != NULL)
+	{
+		ColumnCounts.artist += delta;
+	}
+
+	if (song->priv->album != NULL)
+	{
+		ColumnCounts.album += delta;
+	}
+
+	if (song->priv->duration > 1)
+	{
+		ColumnCounts.duration += delta;
+	}
+}
+
+/*
+ * Replace the sort key in @key by the one for @str.  This is done once when
+ * the metadata changes, so sorting the library does not have to convert the
+ * strings on every comparison.
+ */
+static void
+wf_song_set_sort_key(const gchar **key, const gchar *str)
+{
+	const gchar *old = *key;
+	gchar *new_key = wf_chars_get_sort_key(str);
+
+	*key = wf_song_intern_str(new_key);
+	wf_song_release_str(old);
+
+	g_free(new_key);
+}
+
+/*
+ * Returns a shared copy of @str from the string pool.  Many songs have the
+ * same artist or album, so this saves a separate allocation for every song.
+ * The returned string must be given back using wf_song_release_str().
+ */
+static const gchar *
+wf_song_intern_str(const gchar *str)
+{
+	WfInternedStr *entry;
+	gsize len;
+
+	if (str == NULL)
+	{
+		return NULL;
+	}
+
+	G_LOCK(InternedStrings);
+
+	if (InternedStrings == NULL)
+	{
+		InternedStrings = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+	}
+
+	entry = g_hash_table_lookup(InternedStrings, str);
+
+	if (entry == NULL)
+	{
+		len = strlen(str) + 1;
+
+		entry = g_malloc(sizeof(WfInternedStr) + len);
+		entry->refs = 0;
+		memcpy(entry->str, str, len);
+
+		g_hash_table_insert(InternedStrings, entry->str, entry);
+	}
+
+	entry->refs++;
+
+	G_UNLOCK(InternedStrings);
+
+	return entry->str;
+}
+
+/*
+ * Drops a reference to a string returned by wf_song_intern_str().  The string
+ * is removed from the pool once no song uses it anymore.
+ */
+static void
+wf_song_release_str(const gchar *str)
+{
+	WfInternedStr *entry;
+
+	if (str == NULL)
+	{
+		return;
+	}
+
+	G_LOCK(InternedStrings);
+
+	entry = (InternedStrings == NULL) ? NULL : g_hash_table_lookup(InternedStrings, str);
+
+	if (entry == NULL || entry->str != str)
+	{
+		g_warning("Tried to release a string that is not in the pool");
+	}
+	else if (--entry->refs == 0)
+	{
+		g_hash_table_remove(InternedStrings, str);
+	}
+
+	G_UNLOCK(InternedStrings);
+}
+
 /* MODULE UTILITIES END */
 
 /* DESTRUCTORS BEGIN */
 
+static void
+wf_song_string_clear(WfSongString *string)
+{
+	g_free(string->overflow);
+	g_slist_free_full(string->retired, g_free);
+}
+
+static void
+wf_song_strings_free(WfSongStrings *strings)
+{
+	if (strings == NULL)
+	{
+		return;
+	}
+
+	wf_song_string_clear(&strings->duration);
+	wf_song_string_clear(&strings->last_played);
+	wf_song_string_clear(&strings->played_on);
+	g_free(strings);
+}
+
+// Free a #WfSongFile entry
+static void
+wf_song_file_free(gpointer data)
+{
+	WfSongFile *entry = data;
+
+	g_object_unref(entry->file);
+	g_free(entry);
+}
+
 // This gets invoked when the object is disposed (before destruction)
 static void
 wf_song_finalize(gpointer object)
@@ -3187,11 +4483,19 @@ wf_song_finalize(gpointer object)
 	g_return_if_fail(G_IS_OBJECT_CLASS(parent_class));
 
 	wf_song_clear_location(song);
-
-	g_free(song->priv->title);
-	g_free(song->priv->artist);
-	g_free(song->priv->album_artist);
-	g_free(song->priv->album);
+	wf_song_strings_free(song->priv->strings);
+	song->priv->strings = NULL;
+
+	wf_song_release_str(song->priv->title);
+	wf_song_release_str(song->priv->artist);
+	wf_song_release_str(song->priv->album_artist);
+	wf_song_release_str(song->priv->album);
+	wf_song_release_str(song->priv->title_key);
+	wf_song_release_str(song->priv->artist_key);
+	wf_song_release_str(song->priv->album_key);
+
+	wf_memory_slab_free(SongPrivSlab, song->priv);
+	song->priv = NULL;
 
 	// Chain up parent class methods
 	parent_class->finalize(object);
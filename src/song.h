@@ -108,8 +108,10 @@ guint32 wf_song_get_hash(WfSong *song);
 const gchar * wf_song_get_tag(WfSong *song);
 
 GFile * wf_song_get_file(WfSong *song);
+GFile * wf_song_dup_file(WfSong *song);
 gchar * wf_song_get_uri(const WfSong *song);
 const gchar * wf_song_get_plain_uri(const WfSong *song);
+gchar * wf_song_dup_plain_uri(const WfSong *song);
 const gchar * wf_song_get_name(const WfSong *song);
 const gchar * wf_song_get_name_not_empty(const WfSong *song);
 const gchar * wf_song_get_display_name(const WfSong *song);
@@ -123,6 +125,7 @@ const gchar * wf_song_get_album(const WfSong *song);
 gint wf_song_get_track_number(const WfSong *song);
 gint wf_song_get_duration(const WfSong *song);
 gchar * wf_song_get_duration_string(const WfSong *song);
+const gchar * wf_song_peek_duration_string(const WfSong *song);
 
 gboolean wf_song_is_rating_unset(const WfSong *song);
 void wf_song_set_rating(WfSong *song, gint rating);
@@ -136,7 +139,9 @@ gint wf_song_get_skip_count(const WfSong *song);
 void wf_song_set_last_played(WfSong *song, gint64 lastplayed);
 gint64 wf_song_get_last_played(const WfSong *song);
 gchar * wf_song_get_played_on_as_string(const WfSong *song);
+const gchar * wf_song_peek_played_on_string(const WfSong *song);
 gchar * wf_song_get_last_played_as_string(const WfSong *song);
+const gchar * wf_song_peek_last_played_string(const WfSong *song);
 
 gboolean wf_song_uses_prefix(const WfSong *song);
 gboolean wf_song_is_in_list(const WfSong *song);
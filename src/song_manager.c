@@ -38,7 +38,10 @@
 #include <woofer/intelligence.h>
 #include <woofer/intelligence_private.h>
 #include <woofer/settings.h>
+#include <woofer/settings_private.h>
 #include <woofer/statistics.h>
+#include <woofer/ring.h>
+#include <woofer/utils_private.h>
 
 // Resource includes
 /*< none >*/
@@ -54,16 +57,39 @@
  * idling, so the software can always quickly respond with something new to
  * play, without doing a lot of calculations or anything that may lead to
  * latency.
+ *
+ * The list of next songs is planned a configurable amount of songs ahead, all
+ * drawn in a single pass.  When the settings or statistics change, only the
+ * part of the plan starting at the first song that can no longer be chosen is
+ * thrown away and planned again.
+ *
+ * The history, the recent artists and the planned songs are saved next to the
+ * library file when finalizing and restored when initializing, so the first
+ * song after a restart is known right away and the filters still see what has
+ * been played recently.
  */
 
 /* DESCRIPTION END */
 
 /* DEFINES BEGIN */
 
-// Define the maximum amount of items to keep (0 means no limit)
+// Define the minimum amount of items to keep, more if the settings need it
 #define PLAYED_ITEMS_LIMIT 100
 #define PLAYED_ARTISTS_LIMIT 50
 
+// Amount of songs to plan ahead
+#define LOOKAHEAD_DEFAULT 1
+#define LOOKAHEAD_MAX 64
+
+// Suffix appended to the library file path to get the path of the saved lists
+#define STATE_SUFFIX ".state"
+
+// Names used in the state file
+#define STATE_GROUP "SongManager"
+#define STATE_KEY_HISTORY "History"
+#define STATE_KEY_ARTISTS "Artists"
+#define STATE_KEY_NEXT "Next"
+
 /* DEFINES END */
 
 /* CUSTOM TYPES BEGIN */
@@ -74,6 +100,7 @@ typedef struct _WfSongManagerDetails WfSongManagerDetails;
 struct _WfSongManagerEvents
 {
 	WfFuncSongsChanged songs_changed;
+	WfFuncUpcomingChanged upcoming_changed; // For the player, to prepare the song in advance
 };
 
 struct _WfSongManagerDetails
@@ -84,10 +111,12 @@ struct _WfSongManagerDetails
 
 	WfSong *current;
 
-	GList *list_previous;
-	GList *list_next;
+	WfRing *list_previous; // Play history, most recent first
+	WfRing *list_next; // Songs to play next, in order
 	GList *list_queue;
-	GList *artists;
+	WfRing *artists; // Artist hashes of the history, most recent first
+
+	guint lookahead; // Amount of songs to keep in the list of next songs
 
 	gboolean incognito;
 };
@@ -97,15 +126,23 @@ struct _WfSongManagerDetails
 /* FUNCTION PROTOTYPES BEGIN */
 
 static void wf_song_manager_emit_songs_changed(WfSongManagerEvents *events, WfSong *song_previous, WfSong *song_current, WfSong *song_next);
+static void wf_song_manager_emit_upcoming_changed(WfSongManagerEvents *events, WfSong *song_upcoming);
 
-static WfSong * wf_song_manager_choose_new_song(void);
+static void wf_song_manager_fill_next(guint amount);
+static void wf_song_manager_replan_next(guint keep);
 static void wf_song_manager_add_prev_song(WfSong *song);
 static void wf_song_manager_rm_prev_song(WfSong *song);
 static void wf_song_manager_add_next_song(WfSong *song);
-static GList * wf_song_manager_add_recent_artist(GList *list, guint32 artist);
+static void wf_song_manager_update_limits(const WfSettingsSnapshot *settings);
 
-static WfSong * wf_song_manager_get_song(GList *node);
-static GList * wf_song_manager_trim_list_length(GList *list, guint limit, GDestroyNotify free_func);
+static WfSong * wf_song_manager_get_song(gpointer data);
+static void wf_song_manager_load_song(WfSong *song);
+
+static gchar * wf_song_manager_state_get_path(void);
+static void wf_song_manager_state_restore(void);
+static void wf_song_manager_state_save(void);
+static void wf_song_manager_state_restore_ring(GKeyFile *key_file, const gchar *key, WfRing *ring, gboolean songs);
+static void wf_song_manager_state_save_ring(GKeyFile *key_file, const gchar *key, WfRing *ring, gboolean songs);
 
 /* FUNCTION PROTOTYPES END */
 
@@ -128,6 +165,15 @@ wf_song_manager_init(void)
 	}
 
 	SongManagerData.active = TRUE;
+
+	SongManagerData.list_previous = wf_ring_new(PLAYED_ITEMS_LIMIT, g_object_unref);
+	SongManagerData.list_next = wf_ring_new(0 /* limit */, g_object_unref);
+	SongManagerData.artists = wf_ring_new(PLAYED_ARTISTS_LIMIT, NULL /* free_func */);
+
+	SongManagerData.lookahead = LOOKAHEAD_DEFAULT;
+
+	// Continue where the previous run left off
+	wf_song_manager_state_restore();
 };
 
 /* CONSTRUCTORS END */
@@ -146,6 +192,23 @@ wf_song_manager_set_incognito(gboolean enable)
 	SongManagerData.incognito = enable;
 }
 
+guint
+wf_song_manager_get_lookahead(void)
+{
+	return SongManagerData.lookahead;
+}
+
+/*
+ * Set the amount of songs to plan ahead.  The list of next songs gets filled up
+ * to this amount by wf_song_manager_sync().  Songs that are already planned
+ * beyond the new amount are kept.
+ */
+void
+wf_song_manager_set_lookahead(guint amount)
+{
+	SongManagerData.lookahead = CLAMP(amount, 1, LOOKAHEAD_MAX);
+}
+
 WfSong *
 wf_song_manager_get_queue_song(void)
 {
@@ -153,17 +216,15 @@ wf_song_manager_get_queue_song(void)
 	
 	node = g_list_first(SongManagerData.list_queue);
 
-	return wf_song_manager_get_song(node);
+	return (node == NULL) ? NULL : wf_song_manager_get_song(node->data);
 }
 
 WfSong *
 wf_song_manager_get_next_song(void)
 {
 	WfSong *song;
-	GList *node;
 
-	node = g_list_first(SongManagerData.list_next);
-	song = wf_song_manager_get_song(node);
+	song = wf_song_manager_get_song(wf_ring_get(SongManagerData.list_next, 0));
 
 	// Remove if song is not in the library
 	if (song != NULL && !wf_song_is_in_list(song))
@@ -175,14 +236,27 @@ wf_song_manager_get_next_song(void)
 	}
 	else if (song == NULL)
 	{
-		// Get a new song
-		song = wf_song_manager_choose_new_song();
-		wf_song_manager_add_next_song(song);
+		// Get a new song, the rest is planned when syncing
+		wf_song_manager_fill_next(1);
+		song = wf_song_manager_get_song(wf_ring_get(SongManagerData.list_next, 0));
 	}
 
 	return song;
 }
 
+// Get the planned song at @index, where 0 is the song that plays next
+WfSong *
+wf_song_manager_get_upcoming_song(guint index)
+{
+	return wf_song_manager_get_song(wf_ring_get(SongManagerData.list_next, index));
+}
+
+guint
+wf_song_manager_get_upcoming_length(void)
+{
+	return wf_ring_get_length(SongManagerData.list_next);
+}
+
 WfSong *
 wf_song_manager_get_current_song(void)
 {
@@ -192,9 +266,7 @@ wf_song_manager_get_current_song(void)
 WfSong *
 wf_song_manager_get_prev_song(void)
 {
-	GList *node = g_list_first(SongManagerData.list_previous);
-
-	return wf_song_manager_get_song(node);
+	return wf_song_manager_get_song(wf_ring_get(SongManagerData.list_previous, 0));
 }
 
 /* GETTERS/SETTERS END */
@@ -221,51 +293,98 @@ wf_song_manager_emit_songs_changed(WfSongManagerEvents *events, WfSong *song_pre
 	}
 }
 
-static WfSong *
-wf_song_manager_choose_new_song(void)
+void
+wf_song_manager_connect_event_upcoming_changed(WfFuncUpcomingChanged cb_func)
 {
-	WfSong *song;
-	WfSong *current = SongManagerData.current;
-	WfSongFilter *filter = wf_settings_get_filter();
-	WfSongEntries *modifiers = wf_settings_get_song_entry_modifiers();
-	GList *list = wf_library_get(); // Will duplicate
-	GList *prev = SongManagerData.list_previous;
-	GList *next = SongManagerData.list_next;
-	GList *artists = SongManagerData.artists;
-	guint32 artist = 0;
+	SongManagerData.events.upcoming_changed = cb_func;
+}
 
-	if (list == NULL)
+static void
+wf_song_manager_emit_upcoming_changed(WfSongManagerEvents *events, WfSong *song_upcoming)
+{
+	g_return_if_fail(events != NULL);
+
+	if (events->upcoming_changed != NULL)
 	{
-		// Library is empty
-		return NULL;
+		events->upcoming_changed(song_upcoming);
 	}
+}
 
-	if (current != NULL)
-	{
-		artist = wf_song_get_artist_hash(current);
+// Plan new songs until the list of next songs contains @amount songs
+static void
+wf_song_manager_fill_next(guint amount)
+{
+	WfSong *songs[LOOKAHEAD_MAX];
+	const WfSettingsSnapshot *settings = wf_settings_get_snapshot();
+	guint length;
+	guint count;
+	guint x;
+
+	length = wf_ring_get_length(SongManagerData.list_next);
+	amount = MIN(amount, LOOKAHEAD_MAX);
 
-		// Remove current song from the list so it can never be chosen
-		list = g_list_remove_all(list, current);
+	if (length >= amount || wf_song_get_count() == 0)
+	{
+		// Nothing to do or library is empty
+		return;
 	}
 
-	if (list == NULL)
+	/*
+	 * Get the new songs from the candidate pool of the intelligence module,
+	 * which is kept up-to-date as songs change.  All of them are drawn in
+	 * one pass, so the filters only have to be applied once.  The current
+	 * song is never chosen and its artist counts as the most recent one.
+	 * The rings are passed as they are, so nothing has to be copied.
+	 */
+	count = wf_intelligence_pool_choose_new_songs(SongManagerData.current,
+	                                              SongManagerData.list_previous,
+	                                              SongManagerData.list_next,
+	                                              SongManagerData.artists,
+	                                              settings,
+	                                              songs,
+	                                              amount - length);
+
+	for (x = 0; x < count; x++)
 	{
-		// Current song is the only song present
-		return NULL;
+		wf_song_manager_add_next_song(songs[x]);
 	}
+}
+
+/*
+ * Throw away the planned songs starting at the first one that can not be
+ * chosen anymore, because it left the library or its statistics or the
+ * settings changed, and plan the tail again.  The songs before it are kept.
+ * The first @keep songs are only checked for being in the library, so a next
+ * song that has already been reported does not change behind the back of the
+ * caller.
+ */
+static void
+wf_song_manager_replan_next(guint keep)
+{
+	const WfSettingsSnapshot *settings = wf_settings_get_snapshot();
+	WfSong *song;
+	guint length;
+	guint x;
 
-	// Copy artist list and add the current one to it
-	artists = g_list_copy(artists);
-	artists = wf_song_manager_add_recent_artist(artists, artist);
+	length = wf_ring_get_length(SongManagerData.list_next);
 
-	// Get a new song
-	song = wf_intelligence_choose_new_song(&list, prev, next, artists, filter, modifiers);
+	for (x = 0; x < length; x++)
+	{
+		song = wf_song_manager_get_song(wf_ring_get(SongManagerData.list_next, x));
 
-	// Free the lists
-	g_list_free(list);
-	g_list_free(artists);
+		if (song == NULL || !wf_song_is_in_list(song) ||
+		    (x >= keep && !wf_intelligence_pool_song_is_eligible(song, settings)))
+		{
+			g_debug("Planning the next songs again from position %u of %u", x, length);
 
-	return song;
+			break;
+		}
+	}
+
+	// Drops the references of the invalidated songs
+	wf_ring_truncate(SongManagerData.list_next, x);
+
+	wf_song_manager_fill_next(SongManagerData.lookahead);
 }
 
 void
@@ -316,18 +435,18 @@ wf_song_manager_add_prev_song(WfSong *song)
 	// Add a reference in case the song gets removed from the library
 	g_object_ref(song);
 
-	// Add song to play history
-	SongManagerData.list_previous = g_list_prepend(SongManagerData.list_previous, song);
+	// Add song to play history, which drops the oldest song if it is full
+	wf_ring_push_front(SongManagerData.list_previous, song);
 }
 
 static void
 wf_song_manager_rm_prev_song(WfSong *song)
 {
-	// Remove the previously added reference
-	g_object_unref(song);
-
-	// Remove song
-	SongManagerData.list_previous = g_list_remove(SongManagerData.list_previous, song);
+	// Remove song and the previously added reference
+	if (wf_ring_remove(SongManagerData.list_previous, song))
+	{
+		g_object_unref(song);
+	}
 }
 
 static void
@@ -339,27 +458,25 @@ wf_song_manager_add_next_song(WfSong *song)
 		g_object_ref(song);
 
 		// Add song
-		SongManagerData.list_next = g_list_append(SongManagerData.list_next, song);
+		wf_ring_push_back(SongManagerData.list_next, song);
 	}
 }
 
 void
 wf_song_manager_rm_next_song(WfSong *song)
 {
-	// Remove the previously added reference
-	g_object_unref(song);
-
-	// Remove song
-	SongManagerData.list_next = g_list_remove(SongManagerData.list_next, song);
+	// Remove song and the previously added reference
+	if (wf_ring_remove(SongManagerData.list_next, song))
+	{
+		g_object_unref(song);
+	}
 }
 
 void
 wf_song_manager_clear_next(void)
 {
-	// Free the list and drop references to the songs
-	g_list_free_full(SongManagerData.list_next, g_object_unref);
-
-	SongManagerData.list_next = NULL;
+	// Empty the list and drop references to the songs
+	wf_ring_clear(SongManagerData.list_next);
 }
 
 void
@@ -378,22 +495,44 @@ wf_song_manager_refresh_next(void)
 	wf_song_manager_songs_updated(active);
 }
 
-static GList *
-wf_song_manager_add_recent_artist(GList *list, guint32 artist)
+// Keep enough history for what the filters of @settings look at
+static void
+wf_song_manager_update_limits(const WfSettingsSnapshot *settings)
 {
-	if (artist != 0)
+	guint items = PLAYED_ITEMS_LIMIT;
+	guint artists = PLAYED_ARTISTS_LIMIT;
+
+	if (settings->filter.remove_recents_amount > 0)
 	{
-		// Add artist
-		return g_list_prepend(list, GUINT_TO_POINTER(artist));
+		items = MAX(items, (guint) settings->filter.remove_recents_amount);
 	}
 
-	return NULL;
+	if (settings->filter.recent_artists > 0)
+	{
+		artists = MAX(artists, (guint) settings->filter.recent_artists);
+	}
+
+	wf_ring_set_limit(SongManagerData.list_previous, items);
+	wf_ring_set_limit(SongManagerData.artists, artists);
 }
 
 void
 wf_song_manager_settings_updated(void)
 {
-	wf_song_manager_refresh_next();
+	const WfSettingsSnapshot *settings;
+
+	// Filters and modifiers may have changed, so the candidates have to be determined again
+	wf_settings_update_snapshot();
+	wf_intelligence_pool_invalidate();
+
+	settings = wf_settings_get_snapshot();
+	wf_song_manager_update_limits(settings);
+
+	// Only plan again what the new settings invalidated
+	wf_song_manager_replan_next(0 /* keep */);
+
+	// Report the update
+	wf_song_manager_songs_updated(SongManagerData.current != NULL);
 }
 
 void
@@ -425,7 +564,13 @@ wf_song_manager_songs_updated(gboolean playback_active)
 		next = NULL;
 	}
 
+	// These are about to be shown, so they have to be complete
+	wf_song_manager_load_song(prev);
+	wf_song_manager_load_song(current);
+	wf_song_manager_load_song(next);
+
 	wf_song_manager_emit_songs_changed(&SongManagerData.events, prev, current, next);
+	wf_song_manager_emit_upcoming_changed(&SongManagerData.events, next);
 }
 
 void
@@ -459,11 +604,17 @@ wf_song_manager_add_played_song(WfSong *song, gdouble played_fraction, gboolean
 
 	// Add artist (if known) to the artist history list
 	artist = wf_song_get_artist_hash(song);
-	SongManagerData.artists = wf_song_manager_add_recent_artist(SongManagerData.artists, artist);
 
-	// Update statistics
+	if (artist != 0)
+	{
+		wf_ring_push_front(SongManagerData.artists, GUINT_TO_POINTER(artist));
+	}
+
+	// Update statistics, which marks the song dirty and reports it only once
 	if (!SongManagerData.incognito)
 	{
+		wf_stats_transaction_begin();
+
 		if (!skip_score_update)
 		{
 			wf_stats_modify_and_update_score(song, played_fraction);
@@ -473,12 +624,11 @@ wf_song_manager_add_played_song(WfSong *song, gdouble played_fraction, gboolean
 		wf_stats_modify_and_update_skipcount(song, played_fraction, FALSE /* decrease */);
 		wf_stats_modify_and_update_lastplayed(song, played_fraction, 0 /* timestamp */);
 
-		// Write the updated file to disk when idle
-		wf_library_queue_write();
-	}
+		// Notifies that the song has updated stats (this includes updated timestamps)
+		wf_stats_transaction_commit();
 
-	// Notify that songs have updated stats (this includes updated timestamps)
-	wf_library_updated_stats();
+		// The changed songs are written by the library's background writer
+	}
 
 	// Reset the currently playing as this one has *been* played
 	SongManagerData.current = NULL;
@@ -512,21 +662,16 @@ wf_song_manager_played_song_revert(void)
 void
 wf_song_manager_sync(void)
 {
-	WfSong *song;
-
-	// Get a new song from the algorithm while we have the time
-	if (SongManagerData.list_next == NULL)
-	{
-		song = wf_song_manager_choose_new_song();
-		wf_song_manager_add_next_song(song);
-	}
+	/*
+	 * Plan the next songs while we have the time.  Statistics may have
+	 * changed since the last sync, so the planned songs are checked first,
+	 * except for the next song, which has been reported already.
+	 */
+	wf_song_manager_replan_next(1 /* keep */);
 
-	// Write the library file if modified
-	wf_library_write(FALSE);
+	// Modified songs are written by the library's background writer
 
-	// Trim lists length
-	SongManagerData.list_previous = wf_song_manager_trim_list_length(SongManagerData.list_previous, PLAYED_ITEMS_LIMIT, g_object_unref);
-	SongManagerData.artists = wf_song_manager_trim_list_length(SongManagerData.artists, PLAYED_ARTISTS_LIMIT, NULL /* GDestroyNotify */);
+	// The history lists are kept within their limits when adding to them
 }
 
 /* MODULE FUNCTIONS END */
@@ -534,71 +679,203 @@ wf_song_manager_sync(void)
 /* MODULE UTILITIES BEGIN */
 
 static WfSong *
-wf_song_manager_get_song(GList *node)
+wf_song_manager_get_song(gpointer data)
 {
-	WfSong *song;
+	if (data != NULL && WF_IS_SONG(data))
+	{
+		return data;
+	}
 
-	if (node != NULL)
+	return NULL;
+}
+
+// Complete @song if the library is still being loaded
+static void
+wf_song_manager_load_song(WfSong *song)
+{
+	if (song != NULL)
 	{
-		song = node->data;
+		wf_library_load_song(song);
+	}
+}
 
-		if (WF_IS_SONG(song))
+static gchar *
+wf_song_manager_state_get_path(void)
+{
+	const gchar *library_path = wf_library_get_file();
+
+	if (library_path == NULL)
+	{
+		return NULL;
+	}
+
+	return g_strconcat(library_path, STATE_SUFFIX, NULL /* terminator */);
+}
+
+/*
+ * Read the lists saved by wf_song_manager_state_save().  Songs are looked up
+ * by their hash, so songs that left the library since are simply skipped and
+ * the planned songs are checked again by the next sync.
+ */
+static void
+wf_song_manager_state_restore(void)
+{
+	GKeyFile *key_file;
+	GError *error = NULL;
+	gchar *path;
+
+	path = wf_song_manager_state_get_path();
+
+	if (path == NULL)
+	{
+		return;
+	}
+
+	key_file = g_key_file_new();
+
+	if (!g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, &error))
+	{
+		if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
 		{
-			return song;
+			g_info("Could not read the saved song lists %s: %s", path, error->message);
 		}
+
+		g_error_free(error);
 	}
+	else
+	{
+		wf_song_manager_state_restore_ring(key_file, STATE_KEY_HISTORY, SongManagerData.list_previous, TRUE);
+		wf_song_manager_state_restore_ring(key_file, STATE_KEY_ARTISTS, SongManagerData.artists, FALSE);
+		wf_song_manager_state_restore_ring(key_file, STATE_KEY_NEXT, SongManagerData.list_next, TRUE);
 
-	return NULL;
+		g_debug("Restored %u songs of history and %u planned songs",
+		        wf_ring_get_length(SongManagerData.list_previous),
+		        wf_ring_get_length(SongManagerData.list_next));
+	}
+
+	g_key_file_free(key_file);
+	g_free(path);
 }
 
-static GList *
-wf_song_manager_trim_list_length(GList *list, guint limit, GDestroyNotify free_func)
+/*
+ * Save the history, the recent artists and the planned songs next to the
+ * library file.  In incognito mode, the history that has been saved before is
+ * kept instead, so nothing of what has been played since gets stored.
+ */
+static void
+wf_song_manager_state_save(void)
 {
-	GList *last_node;
-	GList *node;
-	GList *next;
-	gpointer data;
+	GKeyFile *key_file;
+	GError *error = NULL;
+	gchar *path;
+
+	path = wf_song_manager_state_get_path();
 
-	// If nothing to do, return
-	if (list == NULL || limit == 0)
+	if (path == NULL)
 	{
-		return list;
+		return;
 	}
 
-	// Get last node to keep
-	last_node = g_list_nth(list, limit - 1);
+	key_file = g_key_file_new();
 
-	if (last_node == NULL)
+	if (SongManagerData.incognito)
 	{
-		return list;
+		// Failure only means there is nothing to keep
+		g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, NULL /* error */);
 	}
-	else if (list == last_node)
+	else
 	{
-		// Only item in the list: do not trim
-		return list;
+		wf_song_manager_state_save_ring(key_file, STATE_KEY_HISTORY, SongManagerData.list_previous, TRUE);
+		wf_song_manager_state_save_ring(key_file, STATE_KEY_ARTISTS, SongManagerData.artists, FALSE);
 	}
 
-	// End list right there
-	node = last_node->next;
-	last_node->next = NULL;
+	wf_song_manager_state_save_ring(key_file, STATE_KEY_NEXT, SongManagerData.list_next, TRUE);
 
-	// Free all remaining elements
-	while (node != NULL)
+	if (!wf_utils_save_file_to_disk(key_file, path, &error))
 	{
-		next = node->next;
-		data = node->data;
+		g_warning("Could not save the song lists to %s: %s", path, error->message);
+		g_error_free(error);
+	}
+
+	g_key_file_free(key_file);
+	g_free(path);
+}
 
-		if (free_func != NULL)
+// Append the hashes saved under @key to @ring, as songs that are in the library if @songs is %TRUE
+static void
+wf_song_manager_state_restore_ring(GKeyFile *key_file, const gchar *key, WfRing *ring, gboolean songs)
+{
+	WfSong *song;
+	gint *hashes;
+	gsize length = 0;
+	gsize x;
+
+	hashes = g_key_file_get_integer_list(key_file, STATE_GROUP, key, &length, NULL /* error */);
+
+	if (hashes == NULL)
+	{
+		return;
+	}
+
+	for (x = 0; x < length; x++)
+	{
+		if (!songs)
 		{
-			free_func(data);
+			if (hashes[x] != 0)
+			{
+				wf_ring_push_back(ring, GUINT_TO_POINTER((guint32) hashes[x]));
+			}
+
+			continue;
 		}
 
-		g_list_free_1(node);
+		song = wf_song_get_by_hash((guint32) hashes[x]);
 
-		node = next;
+		if (song != NULL && wf_song_is_in_list(song))
+		{
+			wf_song_manager_load_song(song);
+
+			// Dropped again by the ring if it is full
+			wf_ring_push_back(ring, g_object_ref(song));
+		}
 	}
 
-	return list;
+	g_free(hashes);
+}
+
+// Save the items of @ring under @key as hashes, of the songs it holds if @songs is %TRUE
+static void
+wf_song_manager_state_save_ring(GKeyFile *key_file, const gchar *key, WfRing *ring, gboolean songs)
+{
+	WfSong *song;
+	gint *hashes;
+	guint length;
+	guint count = 0;
+	guint x;
+
+	length = wf_ring_get_length(ring);
+	hashes = g_new(gint, MAX(length, 1));
+
+	for (x = 0; x < length; x++)
+	{
+		if (!songs)
+		{
+			hashes[count++] = (gint) GPOINTER_TO_UINT(wf_ring_get(ring, x));
+
+			continue;
+		}
+
+		song = wf_song_manager_get_song(wf_ring_get(ring, x));
+
+		if (song != NULL)
+		{
+			hashes[count++] = (gint) wf_song_get_hash(song);
+		}
+	}
+
+	g_key_file_set_integer_list(key_file, STATE_GROUP, key, hashes, count);
+
+	g_free(hashes);
 }
 
 /* MODULE UTILITIES END */
@@ -608,10 +885,15 @@ wf_song_manager_trim_list_length(GList *list, guint limit, GDestroyNotify free_f
 void
 wf_song_manager_finalize(void)
 {
-	g_list_free_full(SongManagerData.list_previous, g_object_unref);
-	g_list_free_full(SongManagerData.list_next, g_object_unref);
+	if (SongManagerData.active)
+	{
+		wf_song_manager_state_save();
+	}
+
+	wf_ring_free(SongManagerData.list_previous);
+	wf_ring_free(SongManagerData.list_next);
 	g_list_free_full(SongManagerData.list_queue, g_object_unref);
-	g_list_free(SongManagerData.artists);
+	wf_ring_free(SongManagerData.artists);
 
 	SongManagerData = (WfSongManagerDetails) { 0 };
 }
@@ -39,6 +39,7 @@ G_BEGIN_DECLS
 /* MODULE TYPES BEGIN */
 
 typedef void (*WfFuncSongsChanged) (WfSong *song_prev, WfSong *song_current, WfSong *song_next);
+typedef void (*WfFuncUpcomingChanged) (WfSong *song_upcoming);
 
 /* MODULE TYPES END */
 
@@ -53,16 +54,23 @@ void wf_song_manager_init(void);
 gboolean wf_song_manager_get_incognito(void);
 void wf_song_manager_set_incognito(gboolean enable);
 
+guint wf_song_manager_get_lookahead(void);
+void wf_song_manager_set_lookahead(guint amount);
+
 WfSong * wf_song_manager_get_queue_song(void);
 WfSong * wf_song_manager_get_next_song(void);
 WfSong * wf_song_manager_get_current_song(void);
 WfSong * wf_song_manager_get_prev_song(void);
 
+WfSong * wf_song_manager_get_upcoming_song(guint index);
+guint wf_song_manager_get_upcoming_length(void);
+
 /* GETTER/SETTER PROTOTYPES END */
 
 /* FUNCTION PROTOTYPES BEGIN */
 
 void wf_song_manager_connect_event_songs_changed(WfFuncSongsChanged cb_func);
+void wf_song_manager_connect_event_upcoming_changed(WfFuncUpcomingChanged cb_func);
 
 void wf_song_manager_add_queue_song(WfSong *song);
 void wf_song_manager_rm_queue_song(WfSong *song);
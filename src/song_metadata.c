@@ -39,7 +39,7 @@
 #include <woofer/song_metadata.h>
 
 // Dependency includes
-/*< none >*/
+#include <woofer/metrics.h>
 
 // Resource includes
 /*< none >*/
@@ -56,6 +56,12 @@
  * structure gets filled with standard metadata tags and can then be received
  * by using the respective song_metadata_get calls.
  *
+ * Parsing is done using a probe pipeline that is kept alive and reused for
+ * every file, instead of being built and torn down again each time.  Every
+ * thread gets its own probe, so files can be parsed concurrently.  All tag
+ * messages up until preroll are merged into a single list, together with the
+ * duration of the stream.
+ *
  *
  * GStreamer tags available (85 in total)
  * GST_TAG_TITLE
@@ -156,12 +162,25 @@
 
 /* CUSTOM TYPES BEGIN */
 
+typedef struct _WfSongMetadataProbe WfSongMetadataProbe;
+
 struct _WfSongMetadata
 {
 	GstTagList *list;
 	gchar *uri;
 };
 
+// Reusable pipeline used to fetch the tags of files
+struct _WfSongMetadataProbe
+{
+	GstElement *pipeline;
+	GstElement *decode;
+	GstElement *sink;
+
+	// Sinks added for extra streams, removed again on reset
+	GSList *extra_sinks;
+};
+
 /* CUSTOM TYPES END */
 
 /* FUNCTION PROTOTYPES BEGIN */
@@ -172,17 +191,26 @@ static gchar * wf_song_metadata_get_string(const WfSongMetadata *metadata, const
 static guint wf_song_metadata_get_uint(const WfSongMetadata *metadata, const gchar *tag);
 static guint64 wf_song_metadata_get_uint64(const WfSongMetadata *metadata, const gchar *tag);
 
-static void wf_song_metadata_pad_added_cb(GstElement *decoder, GstPad *pad, GstElement *fakesink);
+static WfSongMetadataProbe * wf_song_metadata_get_probe(void);
+static WfSongMetadataProbe * wf_song_metadata_probe_new(void);
+static void wf_song_metadata_probe_reset(WfSongMetadataProbe *probe);
+
+static void wf_song_metadata_pad_added_cb(GstElement *decoder, GstPad *pad, WfSongMetadataProbe *probe);
 
 static const gchar * wf_song_metadata_get_type_name(const GType type);
 static const GValue * wf_song_metadata_get_tag(GstTagList *list, const gchar *tag, const guint index, const GType type);
 static const GValue * wf_song_metadata_get_first_tag(GstTagList *list, const gchar *tag, const GType type);
 
 static void wf_song_metadata_finalize(WfSongMetadata *metadata);
+static void wf_song_metadata_probe_free(gpointer data);
 
 /* FUNCTION PROTOTYPES END */
 
 /* GLOBAL VARIABLES BEGIN */
+
+// Probe of the calling thread, freed on thread exit
+static GPrivate ProbeKey = G_PRIVATE_INIT(wf_song_metadata_probe_free);
+
 /* GLOBAL VARIABLES END */
 
 /* CONSTRUCTORS BEGIN */
@@ -191,9 +219,11 @@ WfSongMetadata *
 wf_song_metadata_get_for_uri(const gchar *uri)
 {
 	WfSongMetadata *metadata;
+	gint64 start;
 
 	g_return_val_if_fail(uri != NULL, NULL);
 
+	start = wf_metrics_start();
 	metadata = g_slice_alloc0(sizeof(WfSongMetadata));
 
 	if (metadata == NULL)
@@ -205,10 +235,12 @@ wf_song_metadata_get_for_uri(const gchar *uri)
 	else if (!wf_song_metadata_init(metadata, uri))
 	{
 		g_slice_free1(sizeof(WfSongMetadata), metadata);
-
-		return NULL;
+		metadata = NULL;
 	}
 
+	// Failed attempts take time as well
+	wf_metrics_stop(WF_METRIC_METADATA_PARSE, start);
+
 	return metadata;
 }
 
@@ -232,10 +264,62 @@ wf_song_metadata_init(WfSongMetadata *metadata, const gchar *uri)
 	}
 }
 
+static WfSongMetadataProbe *
+wf_song_metadata_probe_new(void)
+{
+	WfSongMetadataProbe *probe;
+
+	probe = g_slice_alloc0(sizeof(WfSongMetadataProbe));
+
+	probe->pipeline = gst_pipeline_new("probe");
+	probe->decode = gst_element_factory_make("uridecodebin", NULL /* name */);
+	probe->sink = gst_element_factory_make("fakesink", NULL /* name */);
+
+	if (probe->decode == NULL || probe->sink == NULL)
+	{
+		g_warning("Failed to create elements for metadata parsing!");
+
+		if (probe->decode != NULL)
+		{
+			gst_object_unref(probe->decode);
+		}
+
+		if (probe->sink != NULL)
+		{
+			gst_object_unref(probe->sink);
+		}
+
+		wf_song_metadata_probe_free(probe);
+
+		return NULL;
+	}
+
+	gst_bin_add_many(GST_BIN(probe->pipeline), probe->decode, probe->sink, NULL /* terminator */);
+
+	g_signal_connect(probe->decode, "pad-added", G_CALLBACK(wf_song_metadata_pad_added_cb), probe);
+
+	return probe;
+}
+
 /* CONSTRUCTORS END */
 
 /* GETTERS/SETTERS BEGIN */
 
+// Get the probe of the calling thread, creating it if needed
+static WfSongMetadataProbe *
+wf_song_metadata_get_probe(void)
+{
+	WfSongMetadataProbe *probe = g_private_get(&ProbeKey);
+
+	if (probe == NULL)
+	{
+		probe = wf_song_metadata_probe_new();
+		g_private_set(&ProbeKey, probe);
+	}
+
+	return probe;
+}
+
 static gchar *
 wf_song_metadata_get_string(const WfSongMetadata *metadata, const gchar *tag)
 {
@@ -468,18 +552,34 @@ wf_song_metadata_get_album_artist(const WfSongMetadata *metadata)
 /* CALLBACK FUNCTIONS BEGIN */
 
 static void
-wf_song_metadata_pad_added_cb(GstElement *decoder, GstPad *pad, GstElement *fakesink)
+wf_song_metadata_pad_added_cb(GstElement *decoder, GstPad *pad, WfSongMetadataProbe *probe)
 {
-	GstPad *sinkpad = gst_element_get_static_pad(fakesink, "sink");
+	GstElement *sink = probe->sink;
+	GstPad *sinkpad = gst_element_get_static_pad(sink, "sink");
 
-	// Check if pad is already linked
-	if (!gst_pad_is_linked(sinkpad))
+	// Give every additional stream its own sink, so all of them preroll
+	if (gst_pad_is_linked(sinkpad))
 	{
-		// Now link the pad
-		if (gst_pad_link(pad, sinkpad) != GST_PAD_LINK_OK)
+		gst_object_unref(sinkpad);
+
+		sink = gst_element_factory_make("fakesink", NULL /* name */);
+
+		if (sink == NULL)
 		{
-			g_warning("Failed to link pads for metadata fetching!");
+			return;
 		}
+
+		gst_bin_add(GST_BIN(probe->pipeline), sink);
+		gst_element_sync_state_with_parent(sink);
+		probe->extra_sinks = g_slist_prepend(probe->extra_sinks, sink);
+
+		sinkpad = gst_element_get_static_pad(sink, "sink");
+	}
+
+	// Now link the pad
+	if (gst_pad_link(pad, sinkpad) != GST_PAD_LINK_OK)
+	{
+		g_warning("Failed to link pads for metadata fetching!");
 	}
 
 	gst_object_unref(sinkpad);
@@ -492,81 +592,137 @@ wf_song_metadata_pad_added_cb(GstElement *decoder, GstPad *pad, GstElement *fake
 gboolean
 wf_song_metadata_parse(WfSongMetadata *metadata)
 {
-	const GstMessageType wait_types = GST_MESSAGE_ERROR | GST_MESSAGE_TAG;
-	GstElement *pipeline, *decode, *sink;
+	const GstMessageType wait_types = GST_MESSAGE_ERROR | GST_MESSAGE_TAG | GST_MESSAGE_ASYNC_DONE;
+	WfSongMetadataProbe *probe;
+	GstStateChangeReturn ret;
 	GstMessage *msg;
-	GstTagList *tags = NULL;
+	GstBus *bus;
+	GstTagList *tags = NULL, *list = NULL;
 	GError *err = NULL;
-	gboolean result = TRUE;
+	gboolean done = FALSE, result = TRUE;
+	gint64 deadline, remaining;
+	gint64 duration = -1;
+	guint64 tag_duration;
 	gchar *str = NULL;
 
 	g_return_val_if_fail(metadata != NULL, FALSE);
 
-	pipeline = gst_pipeline_new("pipeline");
-	decode = gst_element_factory_make("uridecodebin", NULL /* name */);
-	g_object_set(decode, "uri", metadata->uri, NULL /* terminator */);
-	gst_bin_add(GST_BIN(pipeline), decode);
+	probe = wf_song_metadata_get_probe();
 
-	sink = gst_element_factory_make("fakesink", NULL /* name */);
-	gst_bin_add(GST_BIN(pipeline), sink);
+	if (probe == NULL)
+	{
+		return FALSE;
+	}
 
-	g_signal_connect(decode, "pad-added", G_CALLBACK(wf_song_metadata_pad_added_cb), sink);
+	g_object_set(probe->decode, "uri", metadata->uri, NULL /* terminator */);
 
-	gst_element_set_state(pipeline, GST_STATE_PAUSED);
+	ret = gst_element_set_state(probe->pipeline, GST_STATE_PAUSED);
 
-	if (TAG_BUS_TIMEOUT <= 0)
-	{
-		msg = gst_bus_pop_filtered(GST_ELEMENT_BUS(pipeline), wait_types);
-	}
-	else
+	if (ret == GST_STATE_CHANGE_FAILURE)
 	{
-		msg = gst_bus_timed_pop_filtered(GST_ELEMENT_BUS(pipeline), TAG_BUS_TIMEOUT * GST_SECOND, wait_types);
-	}
+		g_warning("Could not start metadata pipeline for %s", metadata->uri);
+		wf_song_metadata_probe_reset(probe);
 
-	if (msg == NULL)
-	{
-		g_warning("Could not get metadata tags from empty GstMessage");
-		result = FALSE;
+		return FALSE;
 	}
-	else if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR)
+
+	bus = gst_element_get_bus(probe->pipeline);
+	deadline = g_get_monotonic_time() + TAG_BUS_TIMEOUT * G_USEC_PER_SEC;
+
+	// Collect all tags until the pipeline has prerolled
+	while (!done)
 	{
-		gst_message_parse_error(msg, &err, NULL /* debug */);
-		
-		if (err != NULL)
+		if (TAG_BUS_TIMEOUT <= 0)
+		{
+			msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, wait_types);
+		}
+		else
 		{
-			str = err->message;
+			remaining = deadline - g_get_monotonic_time();
+			msg = (remaining > 0) ? gst_bus_timed_pop_filtered(bus, remaining * GST_USECOND, wait_types) : NULL;
 		}
 
-		g_warning("Could not get metadata tags from GstMessage: %s", str);
-		result = FALSE;
+		if (msg == NULL)
+		{
+			// Timed out; use whatever has been collected so far
+			if (list == NULL)
+			{
+				g_warning("Could not get metadata tags from empty GstMessage");
+				result = FALSE;
+			}
 
-		g_clear_error(&err);
-	}
-	else if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_TAG)
-	{
-		gst_message_parse_tag(msg, &tags);
+			done = TRUE;
+		}
+		else if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR)
+		{
+			gst_message_parse_error(msg, &err, NULL /* debug */);
 
-		metadata->list = tags;
-		result = TRUE;
-	}
-	else
-	{
-		g_warning("GStreamer message from element %s: %d", GST_OBJECT_NAME(msg->src), GST_MESSAGE_TYPE(msg));
-		result = FALSE;
-	}
+			if (err != NULL)
+			{
+				str = err->message;
+			}
 
-	if (msg != NULL)
-	{
-		gst_message_unref(msg);
+			g_warning("Could not get metadata tags from GstMessage: %s", str);
+			result = FALSE;
+			done = TRUE;
+
+			g_clear_error(&err);
+		}
+		else if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_TAG)
+		{
+			gst_message_parse_tag(msg, &tags);
+
+			if (list == NULL)
+			{
+				list = tags;
+			}
+			else
+			{
+				// Keep tags found earlier, add the ones not seen yet
+				gst_tag_list_insert(list, tags, GST_TAG_MERGE_KEEP);
+				gst_tag_list_unref(tags);
+			}
+
+			tags = NULL;
+		}
+		else if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ASYNC_DONE)
+		{
+			// Prerolled, so all streams have been seen
+			if (list == NULL)
+			{
+				list = gst_tag_list_new_empty();
+			}
+
+			done = TRUE;
+		}
+
+		if (msg != NULL)
+		{
+			gst_message_unref(msg);
+		}
 	}
 
-	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(bus);
+
+	if (result && list != NULL)
+	{
+		// Streams do not always have a duration tag, so ask the pipeline
+		if (!gst_tag_list_get_uint64(list, GST_TAG_DURATION, &tag_duration)
+		    && gst_element_query_duration(probe->pipeline, GST_FORMAT_TIME, &duration)
+		    && duration > 0)
+		{
+			gst_tag_list_add(list, GST_TAG_MERGE_KEEP, GST_TAG_DURATION, (guint64) duration, NULL /* terminator */);
+		}
 
-	if (pipeline != NULL)
+		metadata->list = list;
+	}
+	else if (list != NULL)
 	{
-		gst_object_unref(pipeline);
+		gst_tag_list_unref(list);
 	}
 
+	wf_song_metadata_probe_reset(probe);
+
 	return result;
 }
 
@@ -574,6 +730,33 @@ wf_song_metadata_parse(WfSongMetadata *metadata)
 
 /* MODULE UTILITIES BEGIN */
 
+// Bring the probe back to a state in which it can take the next URI
+static void
+wf_song_metadata_probe_reset(WfSongMetadataProbe *probe)
+{
+	GSList *item;
+	GstBus *bus;
+
+	g_return_if_fail(probe != NULL);
+
+	gst_element_set_state(probe->pipeline, GST_STATE_READY);
+
+	for (item = probe->extra_sinks; item != NULL; item = item->next)
+	{
+		gst_element_set_state(item->data, GST_STATE_NULL);
+		gst_bin_remove(GST_BIN(probe->pipeline), item->data);
+	}
+
+	g_slist_free(probe->extra_sinks);
+	probe->extra_sinks = NULL;
+
+	// Drop any messages left over from this file
+	bus = gst_element_get_bus(probe->pipeline);
+	gst_bus_set_flushing(bus, TRUE);
+	gst_bus_set_flushing(bus, FALSE);
+	gst_object_unref(bus);
+}
+
 static const gchar *
 wf_song_metadata_get_type_name(const GType type)
 {
@@ -672,6 +855,47 @@ wf_song_metadata_free(WfSongMetadata *metadata)
 	g_slice_free1(sizeof(WfSongMetadata), metadata);
 }
 
+/**
+ * wf_song_metadata_release_probe:
+ *
+ * Free the probe of the calling thread, if any.  Probes of other threads are
+ * freed automatically when those threads exit.
+ *
+ * Since: 0.3
+ **/
+void
+wf_song_metadata_release_probe(void)
+{
+	WfSongMetadataProbe *probe = g_private_get(&ProbeKey);
+
+	if (probe != NULL)
+	{
+		g_private_set(&ProbeKey, NULL);
+		wf_song_metadata_probe_free(probe);
+	}
+}
+
+static void
+wf_song_metadata_probe_free(gpointer data)
+{
+	WfSongMetadataProbe *probe = data;
+
+	if (probe == NULL)
+	{
+		return;
+	}
+
+	// Elements that were added to the bin are owned by the pipeline
+	if (probe->pipeline != NULL)
+	{
+		gst_element_set_state(probe->pipeline, GST_STATE_NULL);
+		g_slist_free(probe->extra_sinks);
+		gst_object_unref(probe->pipeline);
+	}
+
+	g_slice_free1(sizeof(WfSongMetadataProbe), probe);
+}
+
 static void
 wf_song_metadata_finalize(WfSongMetadata *metadata)
 {
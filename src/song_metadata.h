@@ -158,6 +158,8 @@ gboolean wf_song_metadata_parse(WfSongMetadata *metadata);
 
 void wf_song_metadata_free(WfSongMetadata *metadata);
 
+void wf_song_metadata_release_probe(void);
+
 /* DESTRUCTOR PROTOTYPES END */
 
 G_END_DECLS
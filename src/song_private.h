@@ -28,6 +28,7 @@
 #include <gio/gio.h>
 
 #include <woofer/song.h>
+#include <woofer/song_metadata.h>
 
 /* INCLUDES END */
 
@@ -37,6 +38,27 @@ G_BEGIN_DECLS
 /* DEFINES END */
 
 /* MODULE TYPES BEGIN */
+
+// Changes to the list of songs in the library
+typedef void (*WfFuncSongAdded) (WfSong *song, WfSong *song_before);
+typedef void (*WfFuncSongRemoved) (WfSong *song);
+typedef void (*WfFuncSongsCleared) (void);
+
+typedef struct _WfSongColumnCounts WfSongColumnCounts;
+
+// Songs of the library set aside while a replacement is read (see wf_song_stash_all())
+typedef struct _WfSongStash WfSongStash;
+
+// Amount of songs in the library that have a value for the respective column
+struct _WfSongColumnCounts
+{
+	gint track_number;
+	gint title;
+	gint artist;
+	gint album;
+	gint duration;
+};
+
 /* MODULE TYPES END */
 
 /* CONSTRUCTOR PROTOTYPES BEGIN */
@@ -50,12 +72,17 @@ gint64 wf_song_get_metadata_updated(const WfSong *song);
 void wf_song_set_metadata_updated(WfSong *song, gint64 timestamp);
 void wf_song_set_metadata_updated_now(WfSong *song);
 
-void wf_song_refresh_locations(WfSong *song);
+void wf_song_move_to_file(WfSong *song, GFile *file);
 
 void wf_song_set_title(WfSong *song, const gchar *title);
 void wf_song_set_artist(WfSong *song, const gchar *artist);
 void wf_song_set_album_artist(WfSong *song, const gchar *artist);
 void wf_song_set_album(WfSong *song, const gchar *album);
+void wf_song_set_artist_hash(WfSong *song, guint32 hash);
+
+const gchar * wf_song_get_title_key(const WfSong *song);
+const gchar * wf_song_get_artist_key(const WfSong *song);
+const gchar * wf_song_get_album_key(const WfSong *song);
 void wf_song_set_track_number(WfSong *song, gint number);
 void wf_song_set_duration_seconds(WfSong *song, gint seconds);
 void wf_song_set_duration_nanoseconds(WfSong *song, gint64 nanoseconds);
@@ -68,14 +95,30 @@ void wf_song_set_status(WfSong *song, WfSongStatus state);
 
 /* FUNCTION PROTOTYPES BEGIN */
 
+const WfSongColumnCounts * wf_song_get_column_counts(void);
+
+void wf_song_connect_event_added(WfFuncSongAdded cb_func);
+void wf_song_connect_event_removed(WfFuncSongRemoved cb_func);
+void wf_song_connect_event_cleared(WfFuncSongsCleared cb_func);
+
 gboolean wf_song_is_unique(WfSong *song);
 gboolean wf_song_is_unique_uri(const gchar *uri);
+WfSong * wf_song_get_by_uri(const gchar *uri);
+GList * wf_song_get_in_directory(const gchar *uri);
 
 void wf_song_reset_stats(WfSong *song);
 
 void wf_song_remove_all(void);
 
+WfSongStash * wf_song_stash_all(void);
+void wf_song_stash_restore(WfSongStash *stash);
+void wf_song_stash_drop(WfSongStash *stash);
+
 void wf_song_set_fs_info(WfSong *song, GFileInfo *info);
+void wf_song_set_file_missing(WfSong *song);
+gboolean wf_song_needs_metadata_update(WfSong *song, gboolean force);
+gboolean wf_song_metadata_is_outdated(const WfSong *song);
+void wf_song_apply_metadata(WfSong *song, WfSongMetadata *metadata);
 gboolean wf_song_update_metadata(WfSong *song, gboolean force);
 
 /* FUNCTION PROTOTYPES END */
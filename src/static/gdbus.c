@@ -137,6 +137,108 @@ static GDBusMethodInfo wf_org_woofer_app_method_addsong =
 	NULL
 };
 
+// Arguments addsongs for in
+
+// Argument URIs
+static GDBusArgInfo wf_addsongs_arg_uris_in =
+{
+	-1,
+	"URIs",
+	"as",
+	NULL
+};
+
+// Array with argument pointers
+static GDBusArgInfo * wf_addsongs_arg_in_pointers[] =
+{
+	&wf_addsongs_arg_uris_in,
+	NULL
+};
+
+// Arguments addsongs for out
+
+// Argument Added
+static GDBusArgInfo wf_addsongs_arg_added_out =
+{
+	-1,
+	"Added",
+	"i",
+	NULL
+};
+
+// Array with argument pointers
+static GDBusArgInfo * wf_addsongs_arg_out_pointers[] =
+{
+	&wf_addsongs_arg_added_out,
+	NULL
+};
+
+// Method AddSongs
+static GDBusMethodInfo wf_org_woofer_app_method_addsongs =
+{
+	-1,
+	"AddSongs",
+	wf_addsongs_arg_in_pointers,
+	wf_addsongs_arg_out_pointers,
+	NULL
+};
+
+// Arguments getsongstats for in
+
+// Argument After
+static GDBusArgInfo wf_getsongstats_arg_after_in =
+{
+	-1,
+	"After",
+	"u",
+	NULL
+};
+
+// Argument Limit
+static GDBusArgInfo wf_getsongstats_arg_limit_in =
+{
+	-1,
+	"Limit",
+	"u",
+	NULL
+};
+
+// Array with argument pointers
+static GDBusArgInfo * wf_getsongstats_arg_in_pointers[] =
+{
+	&wf_getsongstats_arg_after_in,
+	&wf_getsongstats_arg_limit_in,
+	NULL
+};
+
+// Arguments getsongstats for out
+
+// Argument Stats
+static GDBusArgInfo wf_getsongstats_arg_stats_out =
+{
+	-1,
+	"Stats",
+	"a(uidiix)",
+	NULL
+};
+
+// Array with argument pointers
+static GDBusArgInfo * wf_getsongstats_arg_out_pointers[] =
+{
+	&wf_getsongstats_arg_stats_out,
+	NULL
+};
+
+// Method GetSongStats
+static GDBusMethodInfo wf_org_woofer_app_method_getsongstats =
+{
+	-1,
+	"GetSongStats",
+	wf_getsongstats_arg_in_pointers,
+	wf_getsongstats_arg_out_pointers,
+	NULL
+};
+
 // Array with method pointers
 static GDBusMethodInfo * wf_org_woofer_app_method_pointers[] =
 {
@@ -144,11 +246,32 @@ static GDBusMethodInfo * wf_org_woofer_app_method_pointers[] =
 	&wf_org_woofer_app_method_raise,
 	&wf_org_woofer_app_method_refreshmetadata,
 	&wf_org_woofer_app_method_addsong,
+	&wf_org_woofer_app_method_addsongs,
+	&wf_org_woofer_app_method_getsongstats,
 	NULL
 };
 
 // Signals for org_woofer_app
 
+// Properties for org_woofer_app
+
+// Property Metrics
+static GDBusPropertyInfo wf_org_woofer_app_property_metrics =
+{
+	-1,
+	"Metrics",
+	"a{s(ttttat)}",
+	G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+	NULL
+};
+
+// Array with property pointers
+static GDBusPropertyInfo * wf_org_woofer_app_property_pointers[] =
+{
+	&wf_org_woofer_app_property_metrics,
+	NULL
+};
+
 // Interface org.woofer.app
 static GDBusInterfaceInfo wf_org_woofer_app_interface =
 {
@@ -156,7 +279,7 @@ static GDBusInterfaceInfo wf_org_woofer_app_interface =
 	"org.woofer.app",
 	wf_org_woofer_app_method_pointers,
 	NULL,
-	NULL,
+	wf_org_woofer_app_property_pointers,
 	NULL
 };
 
@@ -238,6 +361,44 @@ static GDBusMethodInfo wf_org_woofer_player_method_setqueue =
 	NULL
 };
 
+// Arguments setqueuemany for in
+
+// Argument Songs
+static GDBusArgInfo wf_setqueuemany_arg_songs_in =
+{
+	-1,
+	"Songs",
+	"au",
+	NULL
+};
+
+// Argument Queue
+static GDBusArgInfo wf_setqueuemany_arg_queue_in =
+{
+	-1,
+	"Queue",
+	"b",
+	NULL
+};
+
+// Array with argument pointers
+static GDBusArgInfo * wf_setqueuemany_arg_in_pointers[] =
+{
+	&wf_setqueuemany_arg_songs_in,
+	&wf_setqueuemany_arg_queue_in,
+	NULL
+};
+
+// Method SetQueueMany
+static GDBusMethodInfo wf_org_woofer_player_method_setqueuemany =
+{
+	-1,
+	"SetQueueMany",
+	wf_setqueuemany_arg_in_pointers,
+	NULL,
+	NULL
+};
+
 // Arguments stopaftersong for in
 
 // Argument Song
@@ -359,6 +520,7 @@ static GDBusMethodInfo * wf_org_woofer_player_method_pointers[] =
 {
 	&wf_org_woofer_player_method_setplaying,
 	&wf_org_woofer_player_method_setqueue,
+	&wf_org_woofer_player_method_setqueuemany,
 	&wf_org_woofer_player_method_stopaftersong,
 	&wf_org_woofer_player_method_seek,
 	&wf_org_woofer_player_method_play,
@@ -594,6 +594,365 @@ mp2_org_mpris_mediaplayer2_player_get_interface_info(void)
 	return &mp2_org_mpris_mediaplayer2_player_interface;
 }
 
+// Methods for org_mpris_mediaplayer2_tracklist
+
+// Arguments gettracksmetadata for in
+
+// Argument TrackIds
+static GDBusArgInfo mp2_gettracksmetadata_arg_trackids_in =
+{
+	-1,
+	"TrackIds",
+	"ao",
+	NULL
+};
+
+// Array with argument pointers
+static GDBusArgInfo * mp2_gettracksmetadata_arg_in_pointers[] =
+{
+	&mp2_gettracksmetadata_arg_trackids_in,
+	NULL
+};
+
+// Arguments gettracksmetadata for out
+
+// Argument Metadata
+static GDBusArgInfo mp2_gettracksmetadata_arg_metadata_out =
+{
+	-1,
+	"Metadata",
+	"aa{sv}",
+	NULL
+};
+
+// Array with argument pointers
+static GDBusArgInfo * mp2_gettracksmetadata_arg_out_pointers[] =
+{
+	&mp2_gettracksmetadata_arg_metadata_out,
+	NULL
+};
+
+// Method GetTracksMetadata
+static GDBusMethodInfo mp2_org_mpris_mediaplayer2_tracklist_method_gettracksmetadata =
+{
+	-1,
+	"GetTracksMetadata",
+	mp2_gettracksmetadata_arg_in_pointers,
+	mp2_gettracksmetadata_arg_out_pointers,
+	NULL
+};
+
+// Arguments addtrack for in
+
+// Argument Uri
+static GDBusArgInfo mp2_addtrack_arg_uri_in =
+{
+	-1,
+	"Uri",
+	"s",
+	NULL
+};
+
+// Argument AfterTrack
+static GDBusArgInfo mp2_addtrack_arg_aftertrack_in =
+{
+	-1,
+	"AfterTrack",
+	"o",
+	NULL
+};
+
+// Argument SetAsCurrent
+static GDBusArgInfo mp2_addtrack_arg_setascurrent_in =
+{
+	-1,
+	"SetAsCurrent",
+	"b",
+	NULL
+};
+
+// Array with argument pointers
+static GDBusArgInfo * mp2_addtrack_arg_in_pointers[] =
+{
+	&mp2_addtrack_arg_uri_in,
+	&mp2_addtrack_arg_aftertrack_in,
+	&mp2_addtrack_arg_setascurrent_in,
+	NULL
+};
+
+// Method AddTrack
+static GDBusMethodInfo mp2_org_mpris_mediaplayer2_tracklist_method_addtrack =
+{
+	-1,
+	"AddTrack",
+	mp2_addtrack_arg_in_pointers,
+	NULL,
+	NULL
+};
+
+// Arguments removetrack for in
+
+// Argument TrackId
+static GDBusArgInfo mp2_removetrack_arg_trackid_in =
+{
+	-1,
+	"TrackId",
+	"o",
+	NULL
+};
+
+// Array with argument pointers
+static GDBusArgInfo * mp2_removetrack_arg_in_pointers[] =
+{
+	&mp2_removetrack_arg_trackid_in,
+	NULL
+};
+
+// Method RemoveTrack
+static GDBusMethodInfo mp2_org_mpris_mediaplayer2_tracklist_method_removetrack =
+{
+	-1,
+	"RemoveTrack",
+	mp2_removetrack_arg_in_pointers,
+	NULL,
+	NULL
+};
+
+// Arguments goto for in
+
+// Argument TrackId
+static GDBusArgInfo mp2_goto_arg_trackid_in =
+{
+	-1,
+	"TrackId",
+	"o",
+	NULL
+};
+
+// Array with argument pointers
+static GDBusArgInfo * mp2_goto_arg_in_pointers[] =
+{
+	&mp2_goto_arg_trackid_in,
+	NULL
+};
+
+// Method GoTo
+static GDBusMethodInfo mp2_org_mpris_mediaplayer2_tracklist_method_goto =
+{
+	-1,
+	"GoTo",
+	mp2_goto_arg_in_pointers,
+	NULL,
+	NULL
+};
+
+// Array with method pointers
+static GDBusMethodInfo * mp2_org_mpris_mediaplayer2_tracklist_method_pointers[] =
+{
+	&mp2_org_mpris_mediaplayer2_tracklist_method_gettracksmetadata,
+	&mp2_org_mpris_mediaplayer2_tracklist_method_addtrack,
+	&mp2_org_mpris_mediaplayer2_tracklist_method_removetrack,
+	&mp2_org_mpris_mediaplayer2_tracklist_method_goto,
+	NULL
+};
+
+// Signals for org_mpris_mediaplayer2_tracklist
+
+// Arguments tracklistreplaced for out
+
+// Argument Tracks
+static GDBusArgInfo mp2_tracklistreplaced_arg_tracks_out =
+{
+	-1,
+	"Tracks",
+	"ao",
+	NULL
+};
+
+// Argument CurrentTrack
+static GDBusArgInfo mp2_tracklistreplaced_arg_currenttrack_out =
+{
+	-1,
+	"CurrentTrack",
+	"o",
+	NULL
+};
+
+// Array with argument pointers
+static GDBusArgInfo * mp2_tracklistreplaced_arg_out_pointers[] =
+{
+	&mp2_tracklistreplaced_arg_tracks_out,
+	&mp2_tracklistreplaced_arg_currenttrack_out,
+	NULL
+};
+
+// Signal TrackListReplaced
+static GDBusSignalInfo mp2_org_mpris_mediaplayer2_tracklist_signal_tracklistreplaced =
+{
+	-1,
+	"TrackListReplaced",
+	mp2_tracklistreplaced_arg_out_pointers,
+	NULL
+};
+
+// Arguments trackadded for out
+
+// Argument Metadata
+static GDBusArgInfo mp2_trackadded_arg_metadata_out =
+{
+	-1,
+	"Metadata",
+	"a{sv}",
+	NULL
+};
+
+// Argument AfterTrack
+static GDBusArgInfo mp2_trackadded_arg_aftertrack_out =
+{
+	-1,
+	"AfterTrack",
+	"o",
+	NULL
+};
+
+// Array with argument pointers
+static GDBusArgInfo * mp2_trackadded_arg_out_pointers[] =
+{
+	&mp2_trackadded_arg_metadata_out,
+	&mp2_trackadded_arg_aftertrack_out,
+	NULL
+};
+
+// Signal TrackAdded
+static GDBusSignalInfo mp2_org_mpris_mediaplayer2_tracklist_signal_trackadded =
+{
+	-1,
+	"TrackAdded",
+	mp2_trackadded_arg_out_pointers,
+	NULL
+};
+
+// Arguments trackremoved for out
+
+// Argument TrackId
+static GDBusArgInfo mp2_trackremoved_arg_trackid_out =
+{
+	-1,
+	"TrackId",
+	"o",
+	NULL
+};
+
+// Array with argument pointers
+static GDBusArgInfo * mp2_trackremoved_arg_out_pointers[] =
+{
+	&mp2_trackremoved_arg_trackid_out,
+	NULL
+};
+
+// Signal TrackRemoved
+static GDBusSignalInfo mp2_org_mpris_mediaplayer2_tracklist_signal_trackremoved =
+{
+	-1,
+	"TrackRemoved",
+	mp2_trackremoved_arg_out_pointers,
+	NULL
+};
+
+// Arguments trackmetadatachanged for out
+
+// Argument TrackId
+static GDBusArgInfo mp2_trackmetadatachanged_arg_trackid_out =
+{
+	-1,
+	"TrackId",
+	"o",
+	NULL
+};
+
+// Argument Metadata
+static GDBusArgInfo mp2_trackmetadatachanged_arg_metadata_out =
+{
+	-1,
+	"Metadata",
+	"a{sv}",
+	NULL
+};
+
+// Array with argument pointers
+static GDBusArgInfo * mp2_trackmetadatachanged_arg_out_pointers[] =
+{
+	&mp2_trackmetadatachanged_arg_trackid_out,
+	&mp2_trackmetadatachanged_arg_metadata_out,
+	NULL
+};
+
+// Signal TrackMetadataChanged
+static GDBusSignalInfo mp2_org_mpris_mediaplayer2_tracklist_signal_trackmetadatachanged =
+{
+	-1,
+	"TrackMetadataChanged",
+	mp2_trackmetadatachanged_arg_out_pointers,
+	NULL
+};
+
+// Array with signal pointers
+static GDBusSignalInfo * mp2_org_mpris_mediaplayer2_tracklist_signal_pointers[] =
+{
+	&mp2_org_mpris_mediaplayer2_tracklist_signal_tracklistreplaced,
+	&mp2_org_mpris_mediaplayer2_tracklist_signal_trackadded,
+	&mp2_org_mpris_mediaplayer2_tracklist_signal_trackremoved,
+	&mp2_org_mpris_mediaplayer2_tracklist_signal_trackmetadatachanged,
+	NULL
+};
+
+// Properties for org_mpris_mediaplayer2_tracklist
+
+// Property Tracks
+static GDBusPropertyInfo mp2_org_mpris_mediaplayer2_tracklist_property_tracks =
+{
+	-1,
+	"Tracks",
+	"ao",
+	G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+	NULL
+};
+
+// Property CanEditTracks
+static GDBusPropertyInfo mp2_org_mpris_mediaplayer2_tracklist_property_canedittracks =
+{
+	-1,
+	"CanEditTracks",
+	"b",
+	G_DBUS_PROPERTY_INFO_FLAGS_READABLE,
+	NULL
+};
+
+// Array with property pointers
+static GDBusPropertyInfo * mp2_org_mpris_mediaplayer2_tracklist_property_pointers[] =
+{
+	&mp2_org_mpris_mediaplayer2_tracklist_property_tracks,
+	&mp2_org_mpris_mediaplayer2_tracklist_property_canedittracks,
+	NULL
+};
+
+// Interface org.mpris.MediaPlayer2.TrackList
+static GDBusInterfaceInfo mp2_org_mpris_mediaplayer2_tracklist_interface =
+{
+	-1,
+	"org.mpris.MediaPlayer2.TrackList",
+	mp2_org_mpris_mediaplayer2_tracklist_method_pointers,
+	mp2_org_mpris_mediaplayer2_tracklist_signal_pointers,
+	mp2_org_mpris_mediaplayer2_tracklist_property_pointers,
+	NULL
+};
+
+GDBusInterfaceInfo *
+mp2_org_mpris_mediaplayer2_tracklist_get_interface_info(void)
+{
+	return &mp2_org_mpris_mediaplayer2_tracklist_interface;
+}
+
 /* INTROSPECTION DATA END */
 
 /* END OF FILE */
@@ -36,6 +36,8 @@ GDBusInterfaceInfo * mp2_org_mpris_mediaplayer2_get_interface_info(void);
 
 GDBusInterfaceInfo * mp2_org_mpris_mediaplayer2_player_get_interface_info(void);
 
+GDBusInterfaceInfo * mp2_org_mpris_mediaplayer2_tracklist_get_interface_info(void);
+
 /* FUNCTION PROTOTYPES END */
 
 G_END_DECLS
@@ -27,6 +27,7 @@
 
 #include <woofer/settings.h>
 #include <woofer/library.h>
+#include <woofer/daemon.h>
 #include <woofer/constants.h>
 
 /* INCLUDES END */
@@ -127,12 +128,31 @@ static const GOptionEntry AppOptions[] =
 		"('~/.config/" WF_TAG "/" WF_LIBRARY_FILENAME "' by default)",
 		"filepath"
 	},
+	{
+		"lazy", '\0', G_OPTION_FLAG_NONE,
+		G_OPTION_ARG_NONE, &AppEntries.lazy,
+		"Start quickly by loading the song information of the library in the background",
+		NULL
+	},
 	{
 		"background", 'b', G_OPTION_FLAG_NONE,
 		G_OPTION_ARG_NONE, &AppEntries.background,
 		"Start the application in the background (do not show main window on startup)",
 		NULL
 	},
+	{
+		"daemon", '\0', G_OPTION_FLAG_NONE,
+		G_OPTION_ARG_NONE, &AppEntries.daemon,
+		"Run without desktop integration, controlled through a Unix socket only",
+		NULL
+	},
+	{
+		"socket", '\0', G_OPTION_FLAG_NONE,
+		G_OPTION_ARG_FILENAME, &AppEntries.socket,
+		"Provide a location for the control socket of --daemon "
+		"('$XDG_RUNTIME_DIR/" WF_DAEMON_SOCKET_NAME "' by default); the playback options are then sent to it",
+		"filepath"
+	},
 
 	// Runtime application options (after startup or remote activation)
 	{
@@ -45,7 +45,10 @@ struct _WfApplicationEntries
 	/* Startup options */
 	gchar *config;
 	gchar *library;
+	gboolean lazy;
 	gboolean background;
+	gboolean daemon;
+	gchar *socket;
 
 	/* Runtime options */
 	gboolean play_pause;
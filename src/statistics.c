@@ -33,6 +33,7 @@
 // Dependency includes
 #include <woofer/song.h>
 #include <woofer/song_manager.h>
+#include <woofer/library_private.h>
 #include <woofer/settings.h>
 #include <woofer/utils.h>
 
@@ -50,6 +51,11 @@
  * Since this module only contains utilities for other modules, all of these
  * "utilities" are part of the normal module functions and constructors,
  * destructors, etc. are left out.
+ *
+ * Several changes can be grouped in a transaction.  The values are applied
+ * right away, but the songs are only marked as dirty and the stats updated
+ * event is only emitted when the transaction is committed, once for all of the
+ * changes.
  */
 
 /* DESCRIPTION END */
@@ -78,16 +84,89 @@
 /* DEFINES END */
 
 /* CUSTOM TYPES BEGIN */
+
+typedef struct _WfStatsTransaction WfStatsTransaction;
+
+struct _WfStatsTransaction
+{
+	guint depth; // Amount of transactions that have been begun, but not committed
+	GHashTable *songs; // Songs changed during the transaction
+};
+
 /* CUSTOM TYPES END */
 
 /* FUNCTION PROTOTYPES BEGIN */
+
+static void wf_stats_song_changed(WfSong *song);
+
 /* FUNCTION PROTOTYPES END */
 
 /* GLOBAL VARIABLES BEGIN */
+
+static WfStatsTransaction TransactionData = { 0 };
+
 /* GLOBAL VARIABLES END */
 
 /* MODULE FUNCTIONS BEGIN */
 
+/*
+ * wf_stats_transaction_begin:
+ *
+ * Begin a transaction: all statistics updates until the matching call of
+ * wf_stats_transaction_commit() are handled together.  Transactions can be
+ * nested; only the outermost commit takes effect.
+ */
+void
+wf_stats_transaction_begin(void)
+{
+	if (TransactionData.songs == NULL)
+	{
+		TransactionData.songs = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_object_unref, NULL /* value_destroy_func */);
+	}
+
+	TransactionData.depth++;
+}
+
+/*
+ * wf_stats_transaction_commit:
+ *
+ * Commit the transaction begun by wf_stats_transaction_begin().  Every song
+ * that has been changed is marked as dirty once and, if anything has changed,
+ * the stats updated event of the library is emitted once.
+ */
+void
+wf_stats_transaction_commit(void)
+{
+	GHashTableIter iter;
+	gpointer key;
+	gboolean changed;
+
+	g_return_if_fail(TransactionData.depth > 0);
+
+	TransactionData.depth--;
+
+	if (TransactionData.depth > 0)
+	{
+		// Part of an outer transaction
+		return;
+	}
+
+	changed = (g_hash_table_size(TransactionData.songs) > 0);
+	g_hash_table_iter_init(&iter, TransactionData.songs);
+
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+	{
+		wf_library_mark_song_dirty(key);
+	}
+
+	g_hash_table_remove_all(TransactionData.songs);
+
+	if (changed)
+	{
+		wf_library_updated_stats();
+	}
+}
+
 /*
  * wf_stats_update_rating:
  * @song: song to alter
@@ -150,6 +229,9 @@ wf_stats_update_rating(WfSong *song, gint rating, gint increase)
 
 	// Save the new rating
 	wf_song_set_rating(song, rating_value);
+
+	// Only this song needs to be written
+	wf_stats_song_changed(song);
 }
 
 /*
@@ -214,6 +296,9 @@ wf_stats_update_score(WfSong *song, gdouble score, gdouble increase)
 
 	// Save the new score
 	wf_song_set_score(song, score_value);
+
+	// Only this song needs to be written
+	wf_stats_song_changed(song);
 }
 
 /*
@@ -265,6 +350,9 @@ wf_stats_update_playcount(WfSong *song, gint playcount, gint increase)
 
 	// Save the new play count
 	wf_song_set_play_count(song, playcount_value);
+
+	// Only this song needs to be written
+	wf_stats_song_changed(song);
 }
 
 /*
@@ -316,6 +404,9 @@ wf_stats_update_skipcount(WfSong *song, gint skipcount, gint increase)
 
 	// Save the new skip count
 	wf_song_set_skip_count(song, skipcount_value);
+
+	// Only this song needs to be written
+	wf_stats_song_changed(song);
 }
 
 /*
@@ -367,6 +458,9 @@ wf_stats_update_lastplayed(WfSong *song, gint64 lastplayed, gint increase)
 
 	// Save the new last played
 	wf_song_set_last_played(song, lastplayed_value);
+
+	// Only this song needs to be written
+	wf_stats_song_changed(song);
 }
 
 // Make sure to run this function *prior* running the update_playcount respective function, because it relies on the non-updated playcount
@@ -545,6 +639,20 @@ wf_stats_modify_and_update_lastplayed(WfSong *song, gdouble played_fraction, gin
 
 /* MODULE UTILITIES BEGIN */
 
+// The statistics of @song have changed; mark it dirty now or when committing
+static void
+wf_stats_song_changed(WfSong *song)
+{
+	if (TransactionData.depth == 0)
+	{
+		wf_library_mark_song_dirty(song);
+	}
+	else if (!g_hash_table_contains(TransactionData.songs, song))
+	{
+		g_hash_table_add(TransactionData.songs, g_object_ref(song));
+	}
+}
+
 gboolean
 wf_stats_rating_is_valid(gint rating)
 {
@@ -46,6 +46,9 @@ G_BEGIN_DECLS
 
 /* FUNCTION PROTOTYPES BEGIN */
 
+void wf_stats_transaction_begin(void);
+void wf_stats_transaction_commit(void);
+
 void wf_stats_update_rating(WfSong *song, gint rating, gint increase);
 void wf_stats_update_score(WfSong *song, gdouble score, gdouble increase);
 void wf_stats_update_playcount(WfSong *song, gint playcount, gint increase);
@@ -36,6 +36,7 @@
 
 // Dependency includes
 #include <woofer/song.h>
+#include <woofer/characters.h>
 
 // Resource includes
 /*< none >*/
@@ -60,12 +61,23 @@
 /* DESCRIPTION END */
 
 /* DEFINES BEGIN */
+
+// Start of data compressed in the gzip format
+#define COMPRESSED_MAGIC "\x1f\x8b"
+#define COMPRESSED_MAGIC_LENGTH 2
+
+// Favor speed, as files are written often; the gain of higher levels is small
+#define COMPRESSION_LEVEL 3
+
 /* DEFINES END */
 
 /* CUSTOM TYPES BEGIN */
 /* CUSTOM TYPES END */
 
 /* FUNCTION PROTOTYPES BEGIN */
+
+static gboolean wf_utils_make_parent_directory(const gchar *filename);
+
 /* FUNCTION PROTOTYPES END */
 
 /* GLOBAL VARIABLES BEGIN */
@@ -82,17 +94,12 @@ wf_utils_str_is_equal(const gchar *str1, const gchar *str2)
 gchar *
 wf_utils_str_to_lower(gchar *str)
 {
-	gchar *s;
-
 	if (str == NULL)
 	{
 		return str;
 	}
 
-	for (s = str; *s != '\0'; s++)
-	{
-		*s = g_ascii_tolower(*s);
-	}
+	wf_chars_ascii_down(str, strlen(str));
 
 	return str;
 }
@@ -374,19 +381,229 @@ wf_utils_file_is_dotfile(GFile *file)
 // Wrapper for g_key_file_save_to_file that makes sure the file directory exists before writing
 gboolean
 wf_utils_save_file_to_disk(GKeyFile *key_file, const gchar *filename, GError **error)
+{
+	g_return_val_if_fail(filename != NULL, FALSE);
+
+	if (!wf_utils_make_parent_directory(filename))
+	{
+		return FALSE;
+	}
+
+	/*
+	 * Try saving the file; this writes to a temporary file first and then
+	 * renames it, so the original is never left half-written
+	 */
+	return g_key_file_save_to_file(key_file, filename, error);
+}
+
+/*
+ * wf_utils_save_data_to_disk:
+ * @filename: the file to write
+ * @data: (array length=length): the content to write
+ * @length: the length of @data
+ * @compress: %TRUE to write @data compressed with gzip
+ * @error: return location for a #GError, or %NULL
+ *
+ * Write @data to @filename like wf_utils_save_file_to_disk() does, optionally
+ * compressed.  Files written compressed can be read back using
+ * wf_utils_open_file_stream() and wf_utils_decompress(), which detect the
+ * compression themselves.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+wf_utils_save_data_to_disk(const gchar *filename, const gchar *data, gsize length, gboolean compress, GError **error)
+{
+	GBytes *compressed = NULL;
+	gboolean result;
+
+	g_return_val_if_fail(filename != NULL, FALSE);
+	g_return_val_if_fail(data != NULL || length == 0, FALSE);
+
+	if (!wf_utils_make_parent_directory(filename))
+	{
+		return FALSE;
+	}
+
+	if (compress)
+	{
+		compressed = wf_utils_compress(data, length, error);
+
+		if (compressed == NULL)
+		{
+			return FALSE;
+		}
+
+		data = g_bytes_get_data(compressed, &length);
+	}
+
+	// Also written to a temporary file first
+	result = g_file_set_contents(filename, data, (gssize) length, error);
+
+	if (compressed != NULL)
+	{
+		g_bytes_unref(compressed);
+	}
+
+	return result;
+}
+
+/*
+ * wf_utils_open_file_stream:
+ * @filename: the file to read
+ * @error: return location for a #GError, or %NULL
+ *
+ * Open @filename for reading.  If the file has been written compressed by
+ * wf_utils_save_data_to_disk(), the returned stream decompresses it on the
+ * fly, so the caller does not need to know.
+ *
+ * Returns: (transfer full) (nullable): the stream to read from, or %NULL
+ */
+GInputStream *
+wf_utils_open_file_stream(const gchar *filename, GError **error)
+{
+	GFileInputStream *file_stream;
+	GInputStream *stream, *converted;
+	GConverter *decompressor;
+	const gchar *start;
+	GFile *file;
+	gsize available = 0;
+
+	g_return_val_if_fail(filename != NULL, NULL);
+
+	file = g_file_new_for_path(filename);
+	file_stream = g_file_read(file, NULL /* GCancellable */, error);
+	g_object_unref(file);
+
+	if (file_stream == NULL)
+	{
+		return NULL;
+	}
+
+	stream = g_buffered_input_stream_new(G_INPUT_STREAM(file_stream));
+	g_object_unref(file_stream);
+
+	// Look at the first bytes without consuming them
+	if (g_buffered_input_stream_fill(G_BUFFERED_INPUT_STREAM(stream), COMPRESSED_MAGIC_LENGTH, NULL /* GCancellable */, error) < 0)
+	{
+		g_object_unref(stream);
+
+		return NULL;
+	}
+
+	start = g_buffered_input_stream_peek_buffer(G_BUFFERED_INPUT_STREAM(stream), &available);
+
+	if (!wf_utils_data_is_compressed(start, available))
+	{
+		return stream;
+	}
+
+	decompressor = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+	converted = g_converter_input_stream_new(stream, decompressor);
+
+	g_object_unref(decompressor);
+	g_object_unref(stream);
+
+	return converted;
+}
+
+/*
+ * wf_utils_data_is_compressed:
+ * @data: (array length=length) (nullable): the start of the data
+ * @length: the length of @data
+ *
+ * Returns: %TRUE if @data starts like data written compressed by
+ * wf_utils_save_data_to_disk()
+ */
+gboolean
+wf_utils_data_is_compressed(const gchar *data, gsize length)
+{
+	return (data != NULL &&
+	        length >= COMPRESSED_MAGIC_LENGTH &&
+	        memcmp(data, COMPRESSED_MAGIC, COMPRESSED_MAGIC_LENGTH) == 0);
+}
+
+/*
+ * wf_utils_compress:
+ * @data: (array length=length): the data to compress
+ * @length: the length of @data
+ * @error: return location for a #GError, or %NULL
+ *
+ * Returns: (transfer full) (nullable): @data compressed with gzip
+ */
+GBytes *
+wf_utils_compress(const gchar *data, gsize length, GError **error)
+{
+	GOutputStream *memory, *stream;
+	GConverter *compressor;
+	GBytes *result = NULL;
+
+	compressor = G_CONVERTER(g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP, COMPRESSION_LEVEL));
+	memory = g_memory_output_stream_new_resizable();
+	stream = g_converter_output_stream_new(memory, compressor);
+
+	// Closing the stream flushes the compressor and closes the memory stream as well
+	if (g_output_stream_write_all(stream, data, length, NULL /* bytes_written */, NULL /* GCancellable */, error) &&
+	    g_output_stream_close(stream, NULL /* GCancellable */, error))
+	{
+		result = g_memory_output_stream_steal_as_bytes(G_MEMORY_OUTPUT_STREAM(memory));
+	}
+
+	g_object_unref(stream);
+	g_object_unref(memory);
+	g_object_unref(compressor);
+
+	return result;
+}
+
+/*
+ * wf_utils_decompress:
+ * @data: (array length=length): the data written by wf_utils_compress()
+ * @length: the length of @data
+ * @error: return location for a #GError, or %NULL
+ *
+ * Returns: (transfer full) (nullable): the decompressed data
+ */
+GBytes *
+wf_utils_decompress(const gchar *data, gsize length, GError **error)
+{
+	GInputStream *memory, *stream;
+	GOutputStream *output;
+	GConverter *decompressor;
+	GBytes *result = NULL;
+
+	decompressor = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+	memory = g_memory_input_stream_new_from_data(data, (gssize) length, NULL /* destroy */);
+	stream = g_converter_input_stream_new(memory, decompressor);
+	output = g_memory_output_stream_new_resizable();
+
+	if (g_output_stream_splice(output, stream, G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET, NULL /* GCancellable */, error) >= 0)
+	{
+		result = g_memory_output_stream_steal_as_bytes(G_MEMORY_OUTPUT_STREAM(output));
+	}
+
+	g_object_unref(output);
+	g_object_unref(stream);
+	g_object_unref(memory);
+	g_object_unref(decompressor);
+
+	return result;
+}
+
+// Make sure the directory of @filename exists before writing it
+static gboolean
+wf_utils_make_parent_directory(const gchar *filename)
 {
 	gchar *dir;
 	GFile *file;
 	GError *err = NULL;
 
-	g_return_val_if_fail(filename != NULL, FALSE);
-
 	dir = g_path_get_dirname(filename);
 	file = g_file_new_for_path(dir);
 
 	if (!g_file_make_directory_with_parents(file, NULL/* GCancellable */, &err))
 	{
-		if (g_io_error_from_errno(err->code) != G_IO_ERROR_EXISTS)
+		if (g_error_matches(err, G_IO_ERROR, G_IO_ERROR_EXISTS))
 		{
 			// Already exists; no need to panic
 			g_error_free(err);
@@ -396,13 +613,17 @@ wf_utils_save_file_to_disk(GKeyFile *key_file, const gchar *filename, GError **e
 			g_warning("Failed to create directory <%s>: %s (%d)", dir, err->message, err->code);
 
 			g_error_free(err);
+			g_object_unref(file);
+			g_free(dir);
 
 			return FALSE;
 		}
 	}
 
-	// Try saving the file
-	return g_key_file_save_to_file(key_file, filename, error);
+	g_object_unref(file);
+	g_free(dir);
+
+	return TRUE;
 }
 
 /* MODULE FUNCTIONS END */
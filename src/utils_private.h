@@ -57,6 +57,12 @@ enum _WfFileTypeInfo
 gchar * wf_utils_get_config_filepath(const gchar *filename, const gchar *app_name);
 
 gboolean wf_utils_save_file_to_disk(GKeyFile *key_file, const gchar *filename, GError **error);
+gboolean wf_utils_save_data_to_disk(const gchar *filename, const gchar *data, gsize length, gboolean compress, GError **error);
+GInputStream * wf_utils_open_file_stream(const gchar *filename, GError **error);
+
+gboolean wf_utils_data_is_compressed(const gchar *data, gsize length);
+GBytes * wf_utils_compress(const gchar *data, gsize length, GError **error);
+GBytes * wf_utils_decompress(const gchar *data, gsize length, GError **error);
 
 /* FUNCTION PROTOTYPES END */
 